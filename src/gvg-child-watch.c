@@ -0,0 +1,158 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Waits for a child process like g_child_watch_add(), but with wait4() so the
+ * child's resource usage is known.
+ * 
+ * The wait happens in a thread of its own, and the result is dispatched to
+ * the main thread.  Freeing a watch before the child exited only prevents the
+ * callback from being called: the child is still reaped, so it doesn't become
+ * a zombie.
+ */
+
+#include "gvg-child-watch.h"
+
+#include <glib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+struct _GvgChildWatch
+{
+  GPid              pid;
+  GvgChildWatchFunc func;
+  gpointer          data;
+  
+  GMutex            lock;
+  gboolean          freed;  /* whether the owner doesn't want it anymore */
+  
+  gint              status;
+  struct rusage     usage;
+};
+
+
+static void
+child_watch_destroy (GvgChildWatch *watch)
+{
+  g_mutex_clear (&watch->lock);
+  g_slice_free (GvgChildWatch, watch);
+}
+
+static gboolean
+child_watch_dispatch (gpointer data)
+{
+  GvgChildWatch  *watch = data;
+  gboolean        freed;
+  
+  g_mutex_lock (&watch->lock);
+  freed = watch->freed;
+  g_mutex_unlock (&watch->lock);
+  
+  if (! freed) {
+    watch->func (watch->pid, watch->status, &watch->usage, watch->data);
+  }
+  child_watch_destroy (watch);
+  
+  return FALSE;
+}
+
+static gpointer
+child_watch_thread (gpointer data)
+{
+  GvgChildWatch  *watch = data;
+  pid_t           ret;
+  
+  do {
+    ret = wait4 (watch->pid, &watch->status, 0, &watch->usage);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) {
+    g_warning ("failed to wait for child %d: %s", (gint) watch->pid,
+               g_strerror (errno));
+    watch->status = 0;
+    memset (&watch->usage, 0, sizeof watch->usage);
+  }
+  
+  g_mutex_lock (&watch->lock);
+  if (watch->freed) {
+    g_mutex_unlock (&watch->lock);
+    child_watch_destroy (watch);
+  } else {
+    g_idle_add_full (G_PRIORITY_DEFAULT, child_watch_dispatch, watch, NULL);
+    g_mutex_unlock (&watch->lock);
+  }
+  
+  return NULL;
+}
+
+/* watches @pid, which must be a child of ours not watched by anything else */
+GvgChildWatch *
+gvg_child_watch_new (GPid               pid,
+                     GvgChildWatchFunc  func,
+                     gpointer           data)
+{
+  GvgChildWatch *watch;
+  
+  g_return_val_if_fail (func != NULL, NULL);
+  
+  watch = g_slice_new0 (GvgChildWatch);
+  watch->pid = pid;
+  watch->func = func;
+  watch->data = data;
+  g_mutex_init (&watch->lock);
+  watch->freed = FALSE;
+  
+  g_thread_unref (g_thread_new ("child-watch", child_watch_thread, watch));
+  
+  return watch;
+}
+
+/* changes the function to call when the child exits, e.g. to hand the child
+ * over to something else.  must be called from the main thread */
+void
+gvg_child_watch_set_func (GvgChildWatch     *watch,
+                          GvgChildWatchFunc  func,
+                          gpointer           data)
+{
+  g_return_if_fail (watch != NULL);
+  g_return_if_fail (func != NULL);
+  
+  /* the callback is only called from the main thread, so no need to lock */
+  watch->func = func;
+  watch->data = data;
+}
+
+/* stops watching the child.  must not be called from the watch's callback,
+ * nor after it */
+void
+gvg_child_watch_free (GvgChildWatch *watch)
+{
+  g_return_if_fail (watch != NULL);
+  
+  g_mutex_lock (&watch->lock);
+  watch->freed = TRUE;
+  g_mutex_unlock (&watch->lock);
+  /* whoever of the thread and the dispatch comes next destroys it */
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_CHILD_WATCH
+#define H_GVG_CHILD_WATCH
+
+#include <glib.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgChildWatch GvgChildWatch;
+
+/* called in the main thread once the child exited, with its wait status and
+ * resource usage.  the watch is freed right after */
+typedef void (*GvgChildWatchFunc) (GPid                 pid,
+                                   gint                 status,
+                                   const struct rusage *usage,
+                                   gpointer             data);
+
+
+GvgChildWatch  *gvg_child_watch_new       (GPid               pid,
+                                           GvgChildWatchFunc  func,
+                                           gpointer           data);
+void            gvg_child_watch_set_func  (GvgChildWatch     *watch,
+                                           GvgChildWatchFunc  func,
+                                           gpointer           data);
+void            gvg_child_watch_free      (GvgChildWatch *watch);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,431 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Indexes the errors of a saved memcheck XML file, for it to be shown without
+ * parsing it all.
+ * 
+ * A quick scan of the mapped file only looks for the boundaries of <error>
+ * elements, and for the few fields shown before an error is expanded: its
+ * kind, description and unique ID.  The rest, mostly the stacks, can then be
+ * parsed from the error's byte range when needed.  The pages the scan touched
+ * are released afterwards, so the memory used depends on how many errors are
+ * looked at, not on the size of the file.
+ * 
+ * Only uncompressed files can be indexed, as compressed streams can't be read
+ * from the middle.
+ */
+
+#include "gvg-memcheck-index.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+#define ERROR_START "<error>"
+#define ERROR_END   "</error>"
+
+
+typedef struct _Entry Entry;
+
+struct _Entry
+{
+  guint64       offset;   /* of the <error> tag in the file */
+  guint32       len;      /* up to the end of the </error> tag */
+  guint32       unique;
+  const gchar  *kind;     /* interned */
+  const gchar  *what;     /* in @strings */
+};
+
+struct _GvgMemcheckIndex
+{
+  GMappedFile  *mapping;
+  const gchar  *data;
+  gsize         size;
+  guint         pid;
+  guint         ppid;
+  GArray       *entries;
+  GStringChunk *strings;
+};
+
+
+/* finds @str in @len bytes of @data */
+static const gchar *
+find_string (const gchar *data,
+             gsize        len,
+             const gchar *str)
+{
+  gsize         str_len = strlen (str);
+  const gchar  *end     = data + len;
+  const gchar  *p       = data;
+  
+  while ((p = memchr (p, str[0], (gsize) (end - p))) != NULL) {
+    if ((gsize) (end - p) < str_len) {
+      break;
+    } else if (memcmp (p, str, str_len) == 0) {
+      return p;
+    }
+    p++;
+  }
+  
+  return NULL;
+}
+
+/* finds the content of the first element opened by @open in @len bytes of
+ * @data */
+static const gchar *
+find_content (const gchar *data,
+              gsize        len,
+              const gchar *open,
+              const gchar *close,
+              gsize       *content_len)
+{
+  const gchar *start;
+  const gchar *end;
+  
+  start = find_string (data, len, open);
+  if (! start) {
+    return NULL;
+  }
+  start += strlen (open);
+  end = find_string (start, len - (gsize) (start - data), close);
+  if (! end) {
+    return NULL;
+  }
+  *content_len = (gsize) (end - start);
+  
+  return start;
+}
+
+/* appends @len bytes of XML character data to @str, replacing entities */
+static void
+append_unescaped (GString     *str,
+                  const gchar *text,
+                  gsize        len)
+{
+  const gchar *end = text + len;
+  
+  while (text < end) {
+    const gchar *amp = memchr (text, '&', (gsize) (end - text));
+    const gchar *semi;
+    gsize        name_len;
+    
+    if (! amp) {
+      g_string_append_len (str, text, end - text);
+      break;
+    }
+    g_string_append_len (str, text, amp - text);
+    semi = memchr (amp, ';', (gsize) (end - amp));
+    if (! semi) {
+      g_string_append_len (str, amp, end - amp);
+      break;
+    }
+    
+    name_len = (gsize) (semi - amp - 1);
+    if (name_len == 2 && strncmp (amp + 1, "lt", 2) == 0) {
+      g_string_append_c (str, '<');
+    } else if (name_len == 2 && strncmp (amp + 1, "gt", 2) == 0) {
+      g_string_append_c (str, '>');
+    } else if (name_len == 3 && strncmp (amp + 1, "amp", 3) == 0) {
+      g_string_append_c (str, '&');
+    } else if (name_len == 4 && strncmp (amp + 1, "quot", 4) == 0) {
+      g_string_append_c (str, '"');
+    } else if (name_len == 4 && strncmp (amp + 1, "apos", 4) == 0) {
+      g_string_append_c (str, '\'');
+    } else if (name_len > 1 && amp[1] == '#') {
+      gboolean hex = amp[2] == 'x';
+      
+      g_string_append_unichar (str, (gunichar) g_ascii_strtoull (amp + (hex ? 3 : 2),
+                                                                 NULL,
+                                                                 hex ? 16 : 10));
+    } else {
+      g_string_append_len (str, amp, semi + 1 - amp);
+    }
+    text = semi + 1;
+  }
+}
+
+/* gets the value of the first numeric element opened by @open, or 0 */
+static guint64
+find_number (const gchar *data,
+             gsize        len,
+             const gchar *open,
+             const gchar *close,
+             GString     *scratch)
+{
+  const gchar  *content;
+  gsize         content_len;
+  
+  content = find_content (data, len, open, close, &content_len);
+  if (! content) {
+    return 0;
+  }
+  g_string_truncate (scratch, 0);
+  g_string_append_len (scratch, content, (gssize) content_len);
+  
+  /* unique IDs are hexadecimal with a 0x prefix */
+  return g_ascii_strtoull (scratch->str, NULL, 0);
+}
+
+static void
+index_error (GvgMemcheckIndex *self,
+             const gchar      *error,
+             gsize             len,
+             GString          *scratch)
+{
+  Entry         entry;
+  const gchar  *content;
+  gsize         content_len;
+  
+  entry.offset = (guint64) (error - self->data);
+  entry.len = (guint32) len;
+  entry.unique = (guint32) find_number (error, len, "<unique>", "</unique>",
+                                        scratch);
+  
+  entry.kind = NULL;
+  content = find_content (error, len, "<kind>", "</kind>", &content_len);
+  if (content) {
+    g_string_truncate (scratch, 0);
+    g_string_append_len (scratch, content, (gssize) content_len);
+    entry.kind = g_intern_string (scratch->str);
+  }
+  
+  /* leaks have an <xwhat> with the text and figures instead */
+  content = find_content (error, len, "<what>", "</what>", &content_len);
+  if (! content) {
+    const gchar *xwhat;
+    gsize        xwhat_len;
+    
+    xwhat = find_content (error, len, "<xwhat>", "</xwhat>", &xwhat_len);
+    if (xwhat) {
+      content = find_content (xwhat, xwhat_len, "<text>", "</text>",
+                              &content_len);
+    }
+  }
+  entry.what = NULL;
+  if (content) {
+    g_string_truncate (scratch, 0);
+    append_unescaped (scratch, content, content_len);
+    entry.what = g_string_chunk_insert_len (self->strings, scratch->str,
+                                            (gssize) scratch->len);
+  }
+  
+  g_array_append_val (self->entries, entry);
+}
+
+/* scans the whole file for errors */
+static void
+index_errors (GvgMemcheckIndex *self)
+{
+  GString      *scratch = g_string_new (NULL);
+  const gchar  *end     = self->data + self->size;
+  const gchar  *error;
+  const gchar  *p       = self->data;
+  
+  while ((error = find_string (p, (gsize) (end - p), ERROR_START)) != NULL) {
+    const gchar *error_end;
+    
+    if (p == self->data) {
+      /* the process information comes before the first error */
+      self->pid = (guint) find_number (p, (gsize) (error - p),
+                                       "<pid>", "</pid>", scratch);
+      self->ppid = (guint) find_number (p, (gsize) (error - p),
+                                        "<ppid>", "</ppid>", scratch);
+    }
+    error_end = find_string (error, (gsize) (end - error), ERROR_END);
+    if (! error_end) {
+      g_warning ("truncated error at offset %" G_GSIZE_FORMAT,
+                 (gsize) (error - self->data));
+      break;
+    }
+    error_end += strlen (ERROR_END);
+    if ((gsize) (error_end - error) > G_MAXUINT32) {
+      g_warning ("error at offset %" G_GSIZE_FORMAT " too long, skipping",
+                 (gsize) (error - self->data));
+    } else {
+      index_error (self, error, (gsize) (error_end - error), scratch);
+    }
+    p = error_end;
+  }
+  
+  g_string_free (scratch, TRUE);
+}
+
+/* indexes the memcheck XML file @filename, which must not be compressed */
+GvgMemcheckIndex *
+gvg_memcheck_index_new (const gchar  *filename,
+                        GError      **error)
+{
+  GvgMemcheckIndex *self;
+  GMappedFile      *mapping;
+  const gchar      *data;
+  gsize             size;
+  gsize             i;
+  
+  g_return_val_if_fail (filename != NULL, NULL);
+  
+  mapping = g_mapped_file_new (filename, FALSE, error);
+  if (! mapping) {
+    return NULL;
+  }
+  data = g_mapped_file_get_contents (mapping);
+  size = g_mapped_file_get_length (mapping);
+  for (i = 0; i < size && g_ascii_isspace (data[i]); i++);
+  if (i >= size || data[i] != '<') {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                 "Cannot index \"%s\": not an uncompressed XML file",
+                 filename);
+    g_mapped_file_unref (mapping);
+    return NULL;
+  }
+  
+  self = g_slice_new (GvgMemcheckIndex);
+  self->mapping = mapping;
+  self->data    = data;
+  self->size    = size;
+  self->pid     = 0;
+  self->ppid    = 0;
+  self->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+  self->strings = g_string_chunk_new (64 * 1024);
+  
+#ifdef MADV_SEQUENTIAL
+  madvise ((gpointer) self->data, self->size, MADV_SEQUENTIAL);
+#endif
+  index_errors (self);
+  /* from now on errors are read here and there, and only when needed */
+#ifdef MADV_DONTNEED
+  madvise ((gpointer) self->data, self->size, MADV_DONTNEED);
+#endif
+#ifdef MADV_RANDOM
+  madvise ((gpointer) self->data, self->size, MADV_RANDOM);
+#endif
+  
+  return self;
+}
+
+void
+gvg_memcheck_index_free (GvgMemcheckIndex *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_array_free (self->entries, TRUE);
+  g_string_chunk_free (self->strings);
+  g_mapped_file_unref (self->mapping);
+  g_slice_free (GvgMemcheckIndex, self);
+}
+
+/* gets the PID of the process the file comes from, or 0 if unknown */
+guint
+gvg_memcheck_index_get_pid (GvgMemcheckIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->pid;
+}
+
+guint
+gvg_memcheck_index_get_ppid (GvgMemcheckIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->ppid;
+}
+
+guint
+gvg_memcheck_index_get_n_errors (GvgMemcheckIndex *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->entries->len;
+}
+
+/* gets the ID Valgrind gave to the @n-th error, e.g. in its error counts */
+guint
+gvg_memcheck_index_get_unique (GvgMemcheckIndex *self,
+                               guint             n)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (n < self->entries->len, 0);
+  
+  return g_array_index (self->entries, Entry, n).unique;
+}
+
+/* gets the kind of the @n-th error as Valgrind names it, or %NULL */
+const gchar *
+gvg_memcheck_index_get_kind (GvgMemcheckIndex *self,
+                             guint             n)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n < self->entries->len, NULL);
+  
+  return g_array_index (self->entries, Entry, n).kind;
+}
+
+/* gets the description of the @n-th error, or %NULL */
+const gchar *
+gvg_memcheck_index_get_what (GvgMemcheckIndex *self,
+                             guint             n)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n < self->entries->len, NULL);
+  
+  return g_array_index (self->entries, Entry, n).what;
+}
+
+/* gets the @n-th <error> element as it is in the file, to be parsed.  this
+ * reads it from the disk if needed */
+const gchar *
+gvg_memcheck_index_get_error (GvgMemcheckIndex *self,
+                              guint             n,
+                              gsize            *len)
+{
+  Entry *entry;
+  
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (n < self->entries->len, NULL);
+  g_return_val_if_fail (len != NULL, NULL);
+  
+  entry = &g_array_index (self->entries, Entry, n);
+  *len = entry->len;
+  
+  return &self->data[entry->offset];
+}
+
+/* whether the @n-th <error> element contains @text as it is in the file, e.g.
+ * to only parse the errors a search may find something in */
+gboolean
+gvg_memcheck_index_error_contains (GvgMemcheckIndex *self,
+                                   guint             n,
+                                   const gchar      *text)
+{
+  const gchar *error;
+  gsize        len;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (n < self->entries->len, FALSE);
+  g_return_val_if_fail (text != NULL && *text, FALSE);
+  
+  error = gvg_memcheck_index_get_error (self, n, &len);
+  
+  return find_string (error, len, text) != NULL;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_MEMCHECK_INDEX
+#define H_GVG_MEMCHECK_INDEX
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgMemcheckIndex GvgMemcheckIndex;
+
+
+GvgMemcheckIndex *gvg_memcheck_index_new        (const gchar  *filename,
+                                                 GError      **error);
+void              gvg_memcheck_index_free       (GvgMemcheckIndex *self);
+guint             gvg_memcheck_index_get_pid    (GvgMemcheckIndex *self);
+guint             gvg_memcheck_index_get_ppid   (GvgMemcheckIndex *self);
+guint             gvg_memcheck_index_get_n_errors (GvgMemcheckIndex *self);
+guint             gvg_memcheck_index_get_unique (GvgMemcheckIndex *self,
+                                                 guint             n);
+const gchar      *gvg_memcheck_index_get_kind   (GvgMemcheckIndex *self,
+                                                 guint             n);
+const gchar      *gvg_memcheck_index_get_what   (GvgMemcheckIndex *self,
+                                                 guint             n);
+const gchar      *gvg_memcheck_index_get_error  (GvgMemcheckIndex *self,
+                                                 guint             n,
+                                                 gsize            *len);
+gboolean          gvg_memcheck_index_error_contains (GvgMemcheckIndex *self,
+                                                     guint             n,
+                                                     const gchar      *text);
+
+
+G_END_DECLS
+
+#endif /* guard */
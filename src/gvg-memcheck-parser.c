@@ -29,6 +29,9 @@
 #include "gvg.h"
 #include "gvg-xml-parser.h"
 #include "gvg-memcheck-store.h"
+#include "gvg-memcheck-index.h"
+#include "gvg-enum-types.h"
+#include "gvg-cclosure-marshal.h"
 
 
 #define set_ptr(ptr, val) \
@@ -40,30 +43,82 @@
 
 #define STREQ(t, n) (strcmp ((t), (n)) == 0)
 
+#define N_ERROR_KINDS (GVG_MEMCHECK_ERROR_KIND_LEAK_STILL_REACHABLE + 1)
+
 
 typedef struct _GvgMemcheckFrame GvgMemcheckFrame;
+typedef struct _GvgMemcheckRow   GvgMemcheckRow;
 
+/* strings are kept by the parser, see gvg_xml_parser_keep() */
 struct _GvgMemcheckFrame
 {
-  guint64 ip;
-  gchar  *obj;
-  gchar  *func;
-  gchar  *dir;
-  gchar  *file;
-  guint   line;
+  guint64       ip;
+  const gchar  *obj;
+  const gchar  *func;
+  const gchar  *dir;
+  const gchar  *file;
+  guint         line;
+};
+
+/* a row to be inserted in the store.  records are arrays of rows, each row's
+ * parent being an earlier row in the same record.  the label of frames and
+ * their location are kept by the parser, other strings are owned by the row */
+struct _GvgMemcheckRow
+{
+  gint                  parent; /* index of the parent row, or -1 */
+  GvgRowType            type;
+  gchar                *label;
+  guint64               ip;
+  const gchar          *obj;
+  const gchar          *dir;
+  const gchar          *file;
+  guint                 line;
+  GvgMemcheckErrorKind  kind;
+  guint                 pid;
+  guint                 ppid;
+  guint                 group;
+  guint                 snapshot;
+  guint                 output_position;
+  guint                 pass;
+  guint                 record; /* to load later, see load_error(), or 0 */
 };
 
 struct _GvgMemcheckParserPrivate
 {
-  GtkTreeIter   parent_iter;
-  GtkTreeIter   root_parent_iter;
   GtkTreeStore *store;
+  guint         pid;  /* the process the output comes from */
+  guint         ppid; /* and its parent */
+  
+  /* leak snapshots.  @snapshot is the last requested one and may be set from
+   * any thread, @snapshot_shown the last one we emitted a header for */
+  volatile gint snapshot;
+  guint         snapshot_shown;
+  gboolean      finished;
+  
+  /* errors applied to the store, by kind.  ANY counts all of them */
+  guint         error_counts[N_ERROR_KINDS];
+  /* the parser this one is a copy of, which counts its errors too */
+  GvgMemcheckParser *origin;
+  
+  /* the pass of the run results belong to, see gvg_memcheck_parser_set_pass().
+   * stacks of @stack_limit frames or more are counted as truncated */
+  guint         pass;
+  guint         stack_limit;
+  guint         n_truncated_stacks;
   
+  GArray           *record;     /* the error being built */
+  gint              parent_row; /* current parent row in @record */
   guint             stack_len;
   GvgMemcheckFrame  frame;
+  GString          *display;    /* to build frame labels */
+  
+  GtkTreeIter      *target;     /* the row to add the error's rows to */
 };
 
 
+#define record_row(record, i) (&g_array_index ((record), GvgMemcheckRow, (i)))
+
+
 G_DEFINE_TYPE (GvgMemcheckParser,
                gvg_memcheck_parser,
                GVG_TYPE_XML_PARSER)
@@ -79,34 +134,109 @@ static void     gvg_memcheck_parser_set_property    (GObject      *object,
                                                      const GValue *value,
                                                      GParamSpec   *pspec);
 static void     gvg_memcheck_parser_element_start   (GvgXmlParser *parser,
-                                                     const gchar  *name,
-                                                     const gchar **atts,
-                                                     const gchar  *path);
-static void     gvg_memcheck_parser_element_end     (GvgXmlParser  *parser,
-                                                     const gchar   *name,
-                                                     const gchar   *content,
-                                                     const gchar   *path);
+                                                     guint         id,
+                                                     const gchar **atts);
+static void     gvg_memcheck_parser_element_end     (GvgXmlParser *parser,
+                                                     guint         id,
+                                                     const gchar  *content,
+                                                     gsize         len);
+static void     gvg_memcheck_parser_record_apply    (GvgXmlParser *parser,
+                                                     gpointer      record);
+static GvgXmlParser *gvg_memcheck_parser_dup        (GvgXmlParser *parser);
+static void     gvg_memcheck_parser_reset           (GvgXmlParser *parser);
+static void     gvg_memcheck_parser_recovered       (GvgXmlParser *parser,
+                                                     guint64       n_dropped);
 
 
+enum
+{
+  SIGNAL_ERROR,
+  N_SIGNALS
+};
+
 enum
 {
   PROP_0,
   PROP_STORE
 };
 
+/* the elements we handle, see gvg_xml_parser_class_add_element() */
+enum
+{
+  ELEMENT_OUTPUT = 1,
+  ELEMENT_TOOL,
+  ELEMENT_PID,
+  ELEMENT_PPID,
+  ELEMENT_STATE,
+  ELEMENT_ERRORCOUNTS,
+  ELEMENT_ERROR,
+  ELEMENT_KIND,
+  ELEMENT_WHAT,
+  ELEMENT_AUXWHAT,
+  ELEMENT_STACK,
+  ELEMENT_FRAME,
+  ELEMENT_FRAME_IP,
+  ELEMENT_FRAME_OBJ,
+  ELEMENT_FRAME_FN,
+  ELEMENT_FRAME_DIR,
+  ELEMENT_FRAME_FILE,
+  ELEMENT_FRAME_LINE
+};
+
+static const struct {
+  const gchar  *path;
+  guint         id;
+} elements[] = {
+  { "/valgrindoutput",                        ELEMENT_OUTPUT },
+  { "/valgrindoutput/tool",                   ELEMENT_TOOL },
+  { "/valgrindoutput/pid",                    ELEMENT_PID },
+  { "/valgrindoutput/ppid",                   ELEMENT_PPID },
+  { "/valgrindoutput/status/state",           ELEMENT_STATE },
+  { "/valgrindoutput/errorcounts",            ELEMENT_ERRORCOUNTS },
+  { "/valgrindoutput/error",                  ELEMENT_ERROR },
+  { "/valgrindoutput/error/kind",             ELEMENT_KIND },
+  { "/valgrindoutput/error/what",             ELEMENT_WHAT },
+  { "/valgrindoutput/error/xwhat/text",       ELEMENT_WHAT },
+  { "/valgrindoutput/error/auxwhat",          ELEMENT_AUXWHAT },
+  { "/valgrindoutput/error/stack",            ELEMENT_STACK },
+  { "/valgrindoutput/error/stack/frame",      ELEMENT_FRAME },
+  { "/valgrindoutput/error/stack/frame/ip",   ELEMENT_FRAME_IP },
+  { "/valgrindoutput/error/stack/frame/obj",  ELEMENT_FRAME_OBJ },
+  { "/valgrindoutput/error/stack/frame/fn",   ELEMENT_FRAME_FN },
+  { "/valgrindoutput/error/stack/frame/dir",  ELEMENT_FRAME_DIR },
+  { "/valgrindoutput/error/stack/frame/file", ELEMENT_FRAME_FILE },
+  { "/valgrindoutput/error/stack/frame/line", ELEMENT_FRAME_LINE }
+};
+
+
+static guint signals[N_SIGNALS] = { 0 };
+
 
 static void
 gvg_memcheck_parser_class_init (GvgMemcheckParserClass *klass)
 {
   GObjectClass       *object_class      = G_OBJECT_CLASS (klass);
   GvgXmlParserClass  *xml_parser_class  = GVG_XML_PARSER_CLASS (klass);
+  guint               i;
   
   object_class->finalize          = gvg_memcheck_parser_finalize;
   object_class->set_property      = gvg_memcheck_parser_set_property;
   object_class->get_property      = gvg_memcheck_parser_get_property;
   
-  xml_parser_class->element_start = gvg_memcheck_parser_element_start;
-  xml_parser_class->element_end   = gvg_memcheck_parser_element_end;
+  xml_parser_class->element_start_id  = gvg_memcheck_parser_element_start;
+  xml_parser_class->element_end_id    = gvg_memcheck_parser_element_end;
+  xml_parser_class->record_apply      = gvg_memcheck_parser_record_apply;
+  xml_parser_class->record_free       = (GDestroyNotify) g_array_unref;
+  xml_parser_class->dup               = gvg_memcheck_parser_dup;
+  xml_parser_class->reset             = gvg_memcheck_parser_reset;
+  xml_parser_class->recovered         = gvg_memcheck_parser_recovered;
+  
+  for (i = 0; i < G_N_ELEMENTS (elements); i++) {
+    gvg_xml_parser_class_add_element (xml_parser_class,
+                                      elements[i].path, elements[i].id);
+  }
+  gvg_xml_parser_class_set_record_element (xml_parser_class,
+                                           "/valgrindoutput/error");
   
   g_object_class_install_property (object_class,
                                    PROP_STORE,
@@ -118,6 +248,21 @@ gvg_memcheck_parser_class_init (GvgMemcheckParserClass *klass)
                                                         G_PARAM_STATIC_STRINGS |
                                                         G_PARAM_CONSTRUCT_ONLY));
   
+  /* emitted when an error is added to the store, with the number of errors
+   * of its kind so far.  the errors of copies (see gvg_xml_parser_dup()) are
+   * also counted and emitted by the parser they were copied from, so it sees
+   * all the errors of a run however many streams it has */
+  signals[SIGNAL_ERROR] = g_signal_new ("error",
+                                        GVG_TYPE_MEMCHECK_PARSER,
+                                        G_SIGNAL_RUN_LAST,
+                                        0,
+                                        NULL, NULL,
+                                        gvg_cclosure_marshal_VOID__ENUM_UINT,
+                                        G_TYPE_NONE,
+                                        2,
+                                        GVG_TYPE_MEMCHECK_ERROR_KIND,
+                                        G_TYPE_UINT);
+  
   g_type_class_add_private (klass, sizeof (GvgMemcheckParserPrivate));
 }
 
@@ -128,6 +273,18 @@ gvg_memcheck_parser_init (GvgMemcheckParser *self)
                                             GvgMemcheckParserPrivate);
   
   self->priv->store       = NULL;
+  self->priv->pid         = 0u;
+  self->priv->ppid        = 0u;
+  self->priv->snapshot    = 0;
+  self->priv->snapshot_shown = 0u;
+  self->priv->finished    = FALSE;
+  memset (self->priv->error_counts, 0, sizeof self->priv->error_counts);
+  self->priv->origin      = NULL;
+  self->priv->pass        = 0u;
+  self->priv->stack_limit = 0u;
+  self->priv->n_truncated_stacks = 0u;
+  self->priv->record      = NULL;
+  self->priv->parent_row  = -1;
   self->priv->stack_len   = 0u;
   self->priv->frame.dir   = NULL;
   self->priv->frame.file  = NULL;
@@ -135,6 +292,11 @@ gvg_memcheck_parser_init (GvgMemcheckParser *self)
   self->priv->frame.ip    = 0x0u;
   self->priv->frame.line  = 0u;
   self->priv->frame.obj   = NULL;
+  self->priv->display     = g_string_new (NULL);
+  self->priv->target      = NULL;
+  
+  /* a broken error shouldn't hide all the next ones */
+  gvg_xml_parser_set_recover (GVG_XML_PARSER (self), TRUE);
 }
 
 static void
@@ -143,10 +305,13 @@ gvg_memcheck_parser_finalize (GObject *object)
   GvgMemcheckParser *self = GVG_MEMCHECK_PARSER (object);
   
   g_object_unref (self->priv->store);
-  set_ptr (self->priv->frame.dir, NULL);
-  set_ptr (self->priv->frame.file, NULL);
-  set_ptr (self->priv->frame.func, NULL);
-  set_ptr (self->priv->frame.obj, NULL);
+  if (self->priv->origin) {
+    g_object_unref (self->priv->origin);
+  }
+  if (self->priv->record) {
+    g_array_unref (self->priv->record);
+  }
+  g_string_free (self->priv->display, TRUE);
   
   G_OBJECT_CLASS (gvg_memcheck_parser_parent_class)->finalize (object);
 }
@@ -192,40 +357,210 @@ gvg_memcheck_parser_set_property (GObject      *object,
   }
 }
 
+static void
+row_clear (gpointer data)
+{
+  GvgMemcheckRow *row = data;
+  
+  if (row->type != GVG_ROW_TYPE_FRAME) {
+    g_free (row->label);
+  }
+}
+
+static GArray *
+record_new (void)
+{
+  GArray *record;
+  
+  record = g_array_sized_new (FALSE, FALSE, sizeof (GvgMemcheckRow), 16);
+  g_array_set_clear_func (record, row_clear);
+  
+  return record;
+}
+
+/* appends a row to @record, taking ownership of @label.  returns the index of
+ * the new row */
+static gint
+record_append_row (GArray      *record,
+                   gint         parent,
+                   GvgRowType   type,
+                   gchar       *label)
+{
+  GvgMemcheckRow row = { 0 };
+  
+  row.parent  = parent;
+  row.type    = type;
+  row.label   = label;
+  row.kind    = GVG_MEMCHECK_ERROR_KIND_ANY;
+  g_array_append_val (record, row);
+  
+  return (gint) record->len - 1;
+}
+
+/* tags a record's toplevel row with where it comes from */
+static void
+record_tag (GvgMemcheckParser *self,
+            GArray            *record)
+{
+  GvgMemcheckRow *row = record_row (record, 0);
+  
+  row->pid = self->priv->pid;
+  row->ppid = self->priv->ppid;
+  row->group = gvg_xml_parser_get_group (GVG_XML_PARSER (self));
+  row->output_position = gvg_xml_parser_get_output_position (GVG_XML_PARSER (self));
+  row->pass = self->priv->pass;
+}
+
+/* emits a record made of a single toplevel row */
+static void
+emit_row (GvgMemcheckParser *self,
+          GvgRowType         type,
+          const gchar       *label)
+{
+  GArray *record = record_new ();
+  
+  record_append_row (record, -1, type, g_strdup (label));
+  record_tag (self, record);
+  gvg_xml_parser_emit_record (GVG_XML_PARSER (self), record);
+}
+
+static void
+insert_row (GvgMemcheckParser *self,
+            GvgMemcheckRow    *row,
+            GtkTreeIter       *parent,
+            GtkTreeIter       *iter)
+{
+  gtk_tree_store_insert_with_values (self->priv->store, iter, parent, -1,
+                                     GVG_MEMCHECK_STORE_COLUMN_TYPE, row->type,
+                                     GVG_MEMCHECK_STORE_COLUMN_LABEL, row->label,
+                                     GVG_MEMCHECK_STORE_COLUMN_IP, row->ip,
+                                     GVG_MEMCHECK_STORE_COLUMN_OBJECT, row->obj,
+                                     GVG_MEMCHECK_STORE_COLUMN_DIR, row->dir,
+                                     GVG_MEMCHECK_STORE_COLUMN_FILE, row->file,
+                                     GVG_MEMCHECK_STORE_COLUMN_LINE, row->line,
+                                     GVG_MEMCHECK_STORE_COLUMN_KIND, row->kind,
+                                     GVG_MEMCHECK_STORE_COLUMN_PID, row->pid,
+                                     GVG_MEMCHECK_STORE_COLUMN_PPID, row->ppid,
+                                     GVG_MEMCHECK_STORE_COLUMN_GROUP, row->group,
+                                     GVG_MEMCHECK_STORE_COLUMN_SNAPSHOT, row->snapshot,
+                                     GVG_MEMCHECK_STORE_COLUMN_OUTPUT_POSITION, row->output_position,
+                                     GVG_MEMCHECK_STORE_COLUMN_PASS, row->pass,
+                                     -1);
+}
+
+/* counts an error of @kind and emits ::error, on @self and the parser it is a
+ * copy of */
+static void
+count_error (GvgMemcheckParser    *self,
+             GvgMemcheckErrorKind  kind)
+{
+  self->priv->error_counts[GVG_MEMCHECK_ERROR_KIND_ANY] ++;
+  if (kind != GVG_MEMCHECK_ERROR_KIND_ANY) {
+    self->priv->error_counts[kind] ++;
+  }
+  g_signal_emit (self, signals[SIGNAL_ERROR], 0,
+                 kind, self->priv->error_counts[kind]);
+  if (self->priv->origin) {
+    count_error (self->priv->origin, kind);
+  }
+}
+
+static void
+gvg_memcheck_parser_record_apply (GvgXmlParser *parser,
+                                  gpointer      data)
+{
+  GvgMemcheckParser  *self    = (GvgMemcheckParser *) parser;
+  GArray             *record  = data;
+  GtkTreeIter        *iters   = g_newa (GtkTreeIter, record->len);
+  guint               i;
+  
+  if (self->priv->target) {
+    /* loading an error's rows under the one already there, see load_error() */
+    if (record_row (record, 0)->type == GVG_ROW_TYPE_ERROR) {
+      iters[0] = *self->priv->target;
+      for (i = 1; i < record->len; i++) {
+        GvgMemcheckRow *row = record_row (record, i);
+        
+        insert_row (self, row, &iters[row->parent], &iters[i]);
+      }
+    }
+    return;
+  }
+  
+  for (i = 0; i < record->len; i++) {
+    GvgMemcheckRow *row = record_row (record, i);
+    
+    insert_row (self, row, row->parent < 0 ? NULL : &iters[row->parent],
+                &iters[i]);
+  }
+  if (record_row (record, 0)->record > 0) {
+    gvg_memcheck_store_set_unloaded (GVG_MEMCHECK_STORE (self->priv->store),
+                                     &iters[0], record_row (record, 0)->record);
+  }
+  /* insertion with values doesn't emit ::row-changed, but filters need to
+   * re-check the entry once it has all its children */
+  if (record->len > 1) {
+    GtkTreeModel *model = GTK_TREE_MODEL (self->priv->store);
+    GtkTreePath  *path  = gtk_tree_model_get_path (model, &iters[0]);
+    
+    gtk_tree_model_row_changed (model, path, &iters[0]);
+    gtk_tree_path_free (path);
+  }
+  
+  if (record_row (record, 0)->type == GVG_ROW_TYPE_ERROR) {
+    count_error (self, record_row (record, 0)->kind);
+  }
+}
+
 static void
 gvg_memcheck_parser_element_start (GvgXmlParser *parser,
-                                   const gchar  *name,
-                                   const gchar **atts,
-                                   const gchar  *path)
+                                   guint         id,
+                                   const gchar **atts)
 {
   GvgMemcheckParser *self = (GvgMemcheckParser *) parser;
   
   //~ g_debug ("element start");
   
-  if        (STREQ (path, "/valgrindoutput/error")) {
-    gtk_tree_store_append (self->priv->store, &self->priv->parent_iter, NULL);
-    gtk_tree_store_set (self->priv->store, &self->priv->parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_ERROR, -1);
-    self->priv->root_parent_iter = self->priv->parent_iter;
-  } else if (STREQ (path, "/valgrindoutput/error/stack")) {
-    self->priv->stack_len = 0;
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame")) {
-    set_ptr (self->priv->frame.obj,   NULL);
-    set_ptr (self->priv->frame.func,  NULL);
-    set_ptr (self->priv->frame.dir,   NULL);
-    set_ptr (self->priv->frame.file,  NULL);
-    self->priv->frame.ip    = 0u;
-    self->priv->frame.line  = 0u;
-    self->priv->stack_len ++;
+  switch (id) {
+    case ELEMENT_OUTPUT:
+      /* a new stream, e.g. when the parser is reused for another run */
+      self->priv->finished = FALSE;
+      self->priv->snapshot_shown = 0u;
+      break;
+    
+    case ELEMENT_ERROR:
+      if (self->priv->record) {
+        g_array_unref (self->priv->record);
+      }
+      self->priv->record = record_new ();
+      self->priv->parent_row = record_append_row (self->priv->record, -1,
+                                                  GVG_ROW_TYPE_ERROR, NULL);
+      record_tag (self, self->priv->record);
+      break;
+    
+    case ELEMENT_STACK:
+      self->priv->stack_len = 0;
+      break;
+    
+    case ELEMENT_FRAME:
+      self->priv->frame.obj   = NULL;
+      self->priv->frame.func  = NULL;
+      self->priv->frame.dir   = NULL;
+      self->priv->frame.file  = NULL;
+      self->priv->frame.ip    = 0u;
+      self->priv->frame.line  = 0u;
+      self->priv->stack_len ++;
+      break;
   }
 }
 
-static gchar *
-get_frame_display (GvgMemcheckFrame  *frame,
+/* builds the label of a frame in @str */
+static void
+get_frame_display (GString           *str,
+                   GvgMemcheckFrame  *frame,
                    guint              nth)
 {
-  GString *str = g_string_new (NULL);
-  
+  g_string_truncate (str, 0);
   g_string_append (str, nth < 2 ? _("at") : _("by"));
   /*g_string_append_printf (str, " %#x: ", frame->ip);*/
   g_string_append (str, " ");
@@ -235,8 +570,6 @@ get_frame_display (GvgMemcheckFrame  *frame,
   } else {
     g_string_append_printf (str, _(" (in %s)"), frame->obj);
   }
-  
-  return g_string_free (str, FALSE);
 }
 
 static GvgMemcheckErrorKind
@@ -274,6 +607,51 @@ parse_kind (const gchar *str)
   return GVG_MEMCHECK_ERROR_KIND_ANY;
 }
 
+static gboolean
+is_leak_kind (GvgMemcheckErrorKind kind)
+{
+  return (kind == GVG_MEMCHECK_ERROR_KIND_LEAK_DEFINITELY_LOST ||
+          kind == GVG_MEMCHECK_ERROR_KIND_LEAK_INDIRECTLY_LOST ||
+          kind == GVG_MEMCHECK_ERROR_KIND_LEAK_POSSIBLY_LOST ||
+          kind == GVG_MEMCHECK_ERROR_KIND_LEAK_STILL_REACHABLE);
+}
+
+/* Valgrind only reports leaks while the program runs when asked through vgdb,
+ * so a leak error before the final status belongs to the last requested
+ * snapshot.  tags @record with it, emitting the snapshot's header first if
+ * it's its first error */
+static void
+tag_leak_snapshot (GvgMemcheckParser *self,
+                   GArray            *record)
+{
+  GvgMemcheckRow *row = record_row (record, 0);
+  guint           snapshot;
+  
+  if (self->priv->finished || ! is_leak_kind (row->kind)) {
+    return;
+  }
+  snapshot = (guint) g_atomic_int_get (&self->priv->snapshot);
+  if (snapshot == 0) {
+    return;
+  }
+  if (snapshot != self->priv->snapshot_shown) {
+    GArray     *header = record_new ();
+    GDateTime  *now = g_date_time_new_now_local ();
+    gchar      *time = g_date_time_format (now, "%H:%M:%S");
+    
+    record_append_row (header, -1, GVG_ROW_TYPE_STATUS,
+                       g_strdup_printf (_("Leak snapshot %u at %s"),
+                                        snapshot, time));
+    record_tag (self, header);
+    record_row (header, 0)->snapshot = snapshot;
+    gvg_xml_parser_emit_record (GVG_XML_PARSER (self), header);
+    g_free (time);
+    g_date_time_unref (now);
+    self->priv->snapshot_shown = snapshot;
+  }
+  row->snapshot = snapshot;
+}
+
 static guint64
 str_to_uint64 (const gchar *str)
 {
@@ -304,85 +682,192 @@ str_to_uint (const gchar *str)
 }
 
 static void
-gvg_memcheck_parser_element_end (GvgXmlParser  *parser,
-                                 const gchar   *name,
-                                 const gchar   *content,
-                                 const gchar   *path)
+gvg_memcheck_parser_element_end (GvgXmlParser *parser,
+                                 guint         id,
+                                 const gchar  *content,
+                                 gsize         len)
 {
   GvgMemcheckParser *self = (GvgMemcheckParser *) parser;
   
   //~ g_debug ("element end");
   
-  if        (STREQ (path, "/valgrindoutput")) {
-    gtk_tree_store_append (self->priv->store, &self->priv->parent_iter, NULL);
-    gtk_tree_store_set (self->priv->store, &self->priv->parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_OTHER,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, "== END ==", -1);
-  } else if (STREQ (path, "/valgrindoutput/tool")) {
-    g_assert (STREQ (content, "memcheck"));
-  } else if (STREQ (path, "/valgrindoutput/status/state")) {
-    const gchar *label;
+  if (id >= ELEMENT_ERROR && ! self->priv->record) {
+    /* nothing else is interesting outside an error */
+    return;
+  }
+  
+  switch (id) {
+    case ELEMENT_OUTPUT:
+      emit_row (self, GVG_ROW_TYPE_OTHER, "== END ==");
+      break;
+    
+    case ELEMENT_TOOL:
+      g_assert (STREQ (content, "memcheck"));
+      break;
+    
+    case ELEMENT_PID:
+      self->priv->pid = str_to_uint (content);
+      break;
+    
+    case ELEMENT_PPID:
+      self->priv->ppid = str_to_uint (content);
+      break;
+    
+    case ELEMENT_STATE: {
+      const gchar *label;
+      
+      if        (STREQ (content, "RUNNING")) {
+        label = _("Program started");
+      } else if (STREQ (content, "FINISHED")) {
+        label = _("Program terminated");
+        /* what follows is the final leak check */
+        self->priv->finished = TRUE;
+      } else {
+        g_warning ("Unknown Valgrind status \"%s\"", content);
+        label = content;
+      }
+      
+      emit_row (self, GVG_ROW_TYPE_STATUS, label);
+      break;
+    }
+    
+    case ELEMENT_ERRORCOUNTS:
+      emit_row (self, GVG_ROW_TYPE_OTHER, "ERRORCOUNTS");
+      break;
     
-    if        (STREQ (content, "RUNNING")) {
-      label = _("Program started");
-    } else if (STREQ (content, "FINISHED")) {
-      label = _("Program terminated");
-    } else {
-      g_warning ("Unknown Valgrind status \"%s\"", content);
-      label = content;
+    case ELEMENT_ERROR:
+      tag_leak_snapshot (self, self->priv->record);
+      gvg_xml_parser_emit_record (parser, self->priv->record);
+      self->priv->record = NULL;
+      break;
+    
+    case ELEMENT_STACK:
+      if (self->priv->stack_limit > 0 &&
+          self->priv->stack_len >= self->priv->stack_limit) {
+        self->priv->n_truncated_stacks ++;
+      }
+      break;
+    
+    case ELEMENT_FRAME: {
+      GvgMemcheckRow *row;
+      gint            idx;
+      
+      idx = record_append_row (self->priv->record, self->priv->parent_row,
+                               GVG_ROW_TYPE_FRAME, NULL);
+      row = record_row (self->priv->record, idx);
+      /* labels repeat as much as stacks do, so they are kept as well */
+      get_frame_display (self->priv->display, &self->priv->frame,
+                         self->priv->stack_len);
+      row->label = (gchar *) gvg_xml_parser_keep (parser,
+                                                  self->priv->display->str,
+                                                  self->priv->display->len);
+      row->ip   = self->priv->frame.ip;
+      row->line = self->priv->frame.line;
+      row->obj  = self->priv->frame.obj;
+      row->dir  = self->priv->frame.dir;
+      row->file = self->priv->frame.file;
+      break;
     }
     
-    gtk_tree_store_append (self->priv->store, &self->priv->parent_iter, NULL);
-    gtk_tree_store_set (self->priv->store, &self->priv->parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_STATUS,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, label, -1);
-  } else if (STREQ (path, "/valgrindoutput/errorcounts")) {
-    gtk_tree_store_append (self->priv->store, &self->priv->parent_iter, NULL);
-    gtk_tree_store_set (self->priv->store, &self->priv->parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, "ERRORCOUNTS", -1);
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame")) {
-    GtkTreeIter iter;
-    gchar      *text;
+    case ELEMENT_FRAME_IP:
+      self->priv->frame.ip = str_to_uint64 (content);
+      break;
+    
+    case ELEMENT_FRAME_OBJ:
+      self->priv->frame.obj = gvg_xml_parser_keep (parser, content, len);
+      break;
     
-    text = get_frame_display (&self->priv->frame, self->priv->stack_len);
-    gtk_tree_store_append (self->priv->store, &iter, &self->priv->parent_iter);
-    gtk_tree_store_set (self->priv->store, &iter,
-                        GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_FRAME,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, text,
-                        GVG_MEMCHECK_STORE_COLUMN_IP, self->priv->frame.ip,
-                        GVG_MEMCHECK_STORE_COLUMN_OBJECT, self->priv->frame.obj,
-                        GVG_MEMCHECK_STORE_COLUMN_DIR, self->priv->frame.dir,
-                        GVG_MEMCHECK_STORE_COLUMN_FILE, self->priv->frame.file,
-                        GVG_MEMCHECK_STORE_COLUMN_LINE, self->priv->frame.line,
-                        -1);
-    g_free (text);
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/ip")) {
-    self->priv->frame.ip = str_to_uint64 (content);
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/obj")) {
-    set_ptr (self->priv->frame.obj, g_strdup (content));
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/fn")) {
-    set_ptr (self->priv->frame.func, g_strdup (content));
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/dir")) {
-    set_ptr (self->priv->frame.dir, g_strdup (content));
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/file")) {
-    set_ptr (self->priv->frame.file, g_strdup (content));
-  } else if (STREQ (path, "/valgrindoutput/error/stack/frame/line")) {
-    self->priv->frame.line = str_to_uint (content);
-  } else if (STREQ (path, "/valgrindoutput/error/xwhat/text") ||
-             STREQ (path, "/valgrindoutput/error/what")) {
-    gtk_tree_store_set (self->priv->store, &self->priv->root_parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, content, -1);
-  } else if (STREQ (path, "/valgrindoutput/error/kind")) {
-    gtk_tree_store_set (self->priv->store, &self->priv->root_parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_KIND, parse_kind (content),
-                        -1);
-  } else if (STREQ (path, "/valgrindoutput/error/auxwhat")) {
-    gtk_tree_store_append (self->priv->store, &self->priv->parent_iter,
-                           &self->priv->parent_iter);
-    gtk_tree_store_set (self->priv->store, &self->priv->parent_iter,
-                        GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_ERROR,
-                        GVG_MEMCHECK_STORE_COLUMN_LABEL, content, -1);
+    case ELEMENT_FRAME_FN:
+      self->priv->frame.func = gvg_xml_parser_keep (parser, content, len);
+      break;
+    
+    case ELEMENT_FRAME_DIR:
+      self->priv->frame.dir = gvg_xml_parser_keep (parser, content, len);
+      break;
+    
+    case ELEMENT_FRAME_FILE:
+      self->priv->frame.file = gvg_xml_parser_keep (parser, content, len);
+      break;
+    
+    case ELEMENT_FRAME_LINE:
+      self->priv->frame.line = str_to_uint (content);
+      break;
+    
+    case ELEMENT_WHAT:
+      set_ptr (record_row (self->priv->record, 0)->label,
+               g_strndup (content, len));
+      break;
+    
+    case ELEMENT_KIND:
+      record_row (self->priv->record, 0)->kind = parse_kind (content);
+      break;
+    
+    case ELEMENT_AUXWHAT:
+      self->priv->parent_row = record_append_row (self->priv->record,
+                                                  self->priv->parent_row,
+                                                  GVG_ROW_TYPE_ERROR,
+                                                  g_strndup (content, len));
+      break;
+  }
+}
+
+static GvgXmlParser *
+gvg_memcheck_parser_dup (GvgXmlParser *parser)
+{
+  GvgMemcheckParser *self = (GvgMemcheckParser *) parser;
+  GvgMemcheckParser *dup;
+  
+  dup = GVG_MEMCHECK_PARSER (gvg_memcheck_parser_new (GVG_MEMCHECK_STORE (self->priv->store)));
+  gvg_memcheck_parser_set_pass (dup, self->priv->pass, self->priv->stack_limit);
+  dup->priv->origin = g_object_ref (self->priv->origin ? self->priv->origin :
+                                                         self);
+  
+  return GVG_XML_PARSER (dup);
+}
+
+static void
+gvg_memcheck_parser_reset (GvgXmlParser *parser)
+{
+  GvgMemcheckParser *self = (GvgMemcheckParser *) parser;
+  
+  if (self->priv->record) {
+    g_array_unref (self->priv->record);
+    self->priv->record = NULL;
   }
+  self->priv->parent_row = -1;
+  self->priv->stack_len = 0u;
+  memset (&self->priv->frame, 0, sizeof self->priv->frame);
+  self->priv->pid = 0u;
+  self->priv->ppid = 0u;
+  self->priv->finished = FALSE;
+  self->priv->snapshot_shown = 0u;
+  memset (self->priv->error_counts, 0, sizeof self->priv->error_counts);
+  self->priv->n_truncated_stacks = 0u;
+}
+
+/* drops the error being parsed and tells the user something is missing */
+static void
+gvg_memcheck_parser_recovered (GvgXmlParser *parser,
+                               guint64       n_dropped)
+{
+  GvgMemcheckParser  *self = (GvgMemcheckParser *) parser;
+  gchar              *size;
+  gchar              *label;
+  
+  if (self->priv->record) {
+    g_array_unref (self->priv->record);
+    self->priv->record = NULL;
+  }
+  self->priv->parent_row = -1;
+  self->priv->stack_len = 0u;
+  memset (&self->priv->frame, 0, sizeof self->priv->frame);
+  
+  /* the format macro can't be part of a translatable string */
+  size = g_strdup_printf ("%" G_GUINT64_FORMAT, n_dropped);
+  label = g_strdup_printf (_("Skipped %s bytes of malformed output"), size);
+  emit_row (self, GVG_ROW_TYPE_STATUS, label);
+  g_free (label);
+  g_free (size);
 }
 
 GvgXmlParser *
@@ -390,3 +875,170 @@ gvg_memcheck_parser_new (GvgMemcheckStore *store)
 {
   return g_object_new (GVG_TYPE_MEMCHECK_PARSER, "store", store, NULL);
 }
+
+/* starts a new leak snapshot: leak errors parsed from now on, until the next
+ * snapshot, are grouped under it.  may be called from any thread, returns the
+ * snapshot number */
+guint
+gvg_memcheck_parser_begin_leak_snapshot (GvgMemcheckParser *self)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK_PARSER (self), 0);
+  
+  return (guint) g_atomic_int_add (&self->priv->snapshot, 1) + 1;
+}
+
+/* gets how many errors of @kind were added to the store, or how many errors in
+ * total for GVG_MEMCHECK_ERROR_KIND_ANY, including those of the copies of
+ * @self.  must be called from the thread applying the records */
+guint
+gvg_memcheck_parser_get_error_count (GvgMemcheckParser    *self,
+                                     GvgMemcheckErrorKind  kind)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK_PARSER (self), 0);
+  g_return_val_if_fail (kind < N_ERROR_KINDS, 0);
+  
+  return self->priv->error_counts[kind];
+}
+
+/* adds a status row to the store right away, bypassing the parsing.  must be
+ * called from the thread applying the records */
+void
+gvg_memcheck_parser_add_status (GvgMemcheckParser *self,
+                                const gchar       *label)
+{
+  GArray *record;
+  
+  g_return_if_fail (GVG_IS_MEMCHECK_PARSER (self));
+  g_return_if_fail (label != NULL);
+  
+  record = record_new ();
+  record_append_row (record, -1, GVG_ROW_TYPE_STATUS, g_strdup (label));
+  record_tag (self, record);
+  gvg_memcheck_parser_record_apply (GVG_XML_PARSER (self), record);
+  g_array_unref (record);
+}
+
+/* parses the @record-th error of the indexed file for its rows to be added
+ * under @iter, see gvg_memcheck_store_set_load_func() */
+static void
+load_error (GvgMemcheckStore *store,
+            GtkTreeIter      *iter,
+            guint             record,
+            gpointer          data)
+{
+  static const gchar  output_start[] = "<valgrindoutput>";
+  static const gchar  output_end[]   = "</valgrindoutput>";
+  GvgMemcheckIndex   *index = data;
+  GvgMemcheckParser  *parser;
+  const gchar        *error;
+  gsize               len;
+  
+  error = gvg_memcheck_index_get_error (index, record - 1, &len);
+  /* a parser of our own, as it references the store that owns us */
+  parser = GVG_MEMCHECK_PARSER (gvg_memcheck_parser_new (store));
+  parser->priv->target = iter;
+  /* the error is parsed as the only one of a stream */
+  gvg_xml_parser_push (GVG_XML_PARSER (parser), output_start,
+                       sizeof output_start - 1, FALSE);
+  gvg_xml_parser_push (GVG_XML_PARSER (parser), error, len, FALSE);
+  gvg_xml_parser_push (GVG_XML_PARSER (parser), output_end,
+                       sizeof output_end - 1, TRUE);
+  g_object_unref (parser);
+}
+
+/* whether the rows load_error() would add for @record may contain @text.
+ * only the error as it is in the file is searched, so a text that may come
+ * from escaping or from how frames are displayed (see get_frame_display())
+ * is assumed to be there */
+static gboolean
+error_may_contain (GvgMemcheckStore *store,
+                   guint             record,
+                   const gchar      *text,
+                   gpointer          data)
+{
+  GvgMemcheckIndex *index = data;
+  
+  if (strpbrk (text, "&<>\"' (:)") != NULL ||
+      strstr (_("at"), text) || strstr (_("by"), text) ||
+      strstr (_(" (in %s)"), text) || strstr ("???", text)) {
+    return TRUE;
+  }
+  
+  return gvg_memcheck_index_error_contains (index, record - 1, text);
+}
+
+/*
+ * loads the saved memcheck XML file @filename lazily.  its errors are indexed
+ * and added to the store right away, but with only their kind and description:
+ * the rest of an error is parsed from the file when its row is loaded, see
+ * gvg_memcheck_store_load().  the file has to be uncompressed, and stays
+ * mapped until the store is cleared.  the store shouldn't have other unloaded
+ * rows.  must be called from the thread applying the records, while not
+ * parsing
+ */
+gboolean
+gvg_memcheck_parser_load_indexed (GvgMemcheckParser  *self,
+                                  const gchar        *filename,
+                                  GError            **error)
+{
+  GvgMemcheckIndex *index;
+  guint             n_errors;
+  guint             i;
+  
+  g_return_val_if_fail (GVG_IS_MEMCHECK_PARSER (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  
+  index = gvg_memcheck_index_new (filename, error);
+  if (! index) {
+    return FALSE;
+  }
+  gvg_memcheck_store_set_load_func (GVG_MEMCHECK_STORE (self->priv->store),
+                                    load_error, error_may_contain, index,
+                                    (GDestroyNotify) gvg_memcheck_index_free);
+  
+  self->priv->pid = gvg_memcheck_index_get_pid (index);
+  self->priv->ppid = gvg_memcheck_index_get_ppid (index);
+  n_errors = gvg_memcheck_index_get_n_errors (index);
+  for (i = 0; i < n_errors; i++) {
+    const gchar    *kind = gvg_memcheck_index_get_kind (index, i);
+    const gchar    *what = gvg_memcheck_index_get_what (index, i);
+    GArray         *record = record_new ();
+    GvgMemcheckRow *row;
+    
+    record_append_row (record, -1, GVG_ROW_TYPE_ERROR, g_strdup (what));
+    record_tag (self, record);
+    row = record_row (record, 0);
+    row->kind = kind ? parse_kind (kind) : GVG_MEMCHECK_ERROR_KIND_ANY;
+    row->record = i + 1;
+    gvg_memcheck_parser_record_apply (GVG_XML_PARSER (self), record);
+    g_array_unref (record);
+  }
+  
+  return TRUE;
+}
+
+/* tags the results parsed from now on as belonging to the @pass-th pass of
+ * a run that may be repeated with different settings (see the "adaptive"
+ * property of GvgMemcheck), 0 meaning the run isn't.  @stack_limit is the
+ * number of callers the run records, so stacks that long are counted as
+ * truncated, or 0 not to count them.  must not be called while parsing */
+void
+gvg_memcheck_parser_set_pass (GvgMemcheckParser *self,
+                              guint              pass,
+                              guint              stack_limit)
+{
+  g_return_if_fail (GVG_IS_MEMCHECK_PARSER (self));
+  
+  self->priv->pass = pass;
+  self->priv->stack_limit = stack_limit;
+}
+
+/* gets how many stacks parsed since the last reset were as long as the stack
+ * limit given to gvg_memcheck_parser_set_pass(), and thus likely truncated */
+guint
+gvg_memcheck_parser_get_n_truncated_stacks (GvgMemcheckParser *self)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK_PARSER (self), 0);
+  
+  return self->priv->n_truncated_stacks;
+}
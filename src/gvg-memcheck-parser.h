@@ -76,6 +76,18 @@ struct _GvgMemcheckParserClass
 
 GType             gvg_memcheck_parser_get_type    (void) G_GNUC_CONST;
 GvgXmlParser     *gvg_memcheck_parser_new         (GvgMemcheckStore *store);
+guint             gvg_memcheck_parser_begin_leak_snapshot (GvgMemcheckParser *self);
+guint             gvg_memcheck_parser_get_error_count     (GvgMemcheckParser    *self,
+                                                           GvgMemcheckErrorKind  kind);
+void              gvg_memcheck_parser_add_status          (GvgMemcheckParser *self,
+                                                           const gchar       *label);
+void              gvg_memcheck_parser_set_pass            (GvgMemcheckParser *self,
+                                                           guint              pass,
+                                                           guint              stack_limit);
+guint             gvg_memcheck_parser_get_n_truncated_stacks  (GvgMemcheckParser *self);
+gboolean          gvg_memcheck_parser_load_indexed        (GvgMemcheckParser  *self,
+                                                           const gchar        *filename,
+                                                           GError            **error);
 
 
 G_END_DECLS
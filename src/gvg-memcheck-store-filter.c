@@ -34,6 +34,8 @@ struct _GvgMemcheckStoreFilterPrivate
   GvgMemcheckErrorKind  kind;
   gchar                *text;
   gboolean              invert;
+  guint                 pid;
+  GHashTable           *parents;  /* PID -> PPID of the processes seen */
   
   GSource              *timeout_source;
 };
@@ -60,7 +62,8 @@ enum
   PROP_0,
   PROP_KIND,
   PROP_TEXT,
-  PROP_INVERT
+  PROP_INVERT,
+  PROP_PID
 };
 
 
@@ -100,6 +103,15 @@ gvg_memcheck_store_filter_class_init (GvgMemcheckStoreFilterClass *klass)
                                                          FALSE,
                                                          G_PARAM_READWRITE |
                                                          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_PID,
+                                   g_param_spec_uint ("pid",
+                                                      "PID",
+                                                      "The process to show the errors of, along with its "
+                                                      "children's, or 0 for all",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
   
   g_type_class_add_private ((gpointer) klass,
                             sizeof (GvgMemcheckStoreFilterPrivate));
@@ -126,6 +138,10 @@ gvg_memcheck_store_filter_get_property (GObject    *object,
       g_value_set_boolean (value, self->priv->invert);
       break;
     
+    case PROP_PID:
+      g_value_set_uint (value, self->priv->pid);
+      break;
+    
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -152,6 +168,10 @@ gvg_memcheck_store_filter_set_property (GObject      *object,
       gvg_memcheck_store_filter_set_invert (self, g_value_get_boolean (value));
       break;
     
+    case PROP_PID:
+      gvg_memcheck_store_filter_set_pid (self, g_value_get_uint (value));
+      break;
+    
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       return;
@@ -249,6 +269,17 @@ gvg_memcheck_store_filter_filter_text (GvgMemcheckStoreFilter  *self,
   if (! gtk_tree_model_iter_has_child (model, &iter)) {
     return TRUE;
   }
+  /* the text may be in the children of an unloaded entry.  it only matches on
+   * its own until they are loaded and it gets checked again, and only entries
+   * which may contain it are loaded */
+  if (self->priv->text && *self->priv->text && GVG_IS_MEMCHECK_STORE (model)) {
+    GvgMemcheckStore *store = GVG_MEMCHECK_STORE (model);
+    
+    if (! gvg_memcheck_store_is_loaded (store, &iter) &&
+        gvg_memcheck_store_may_contain (store, &iter, self->priv->text)) {
+      gvg_memcheck_store_queue_load (store, &iter);
+    }
+  }
   
   match = filter_text_iter_matches (self, model, &iter);
   if (self->priv->invert) {
@@ -258,12 +289,53 @@ gvg_memcheck_store_filter_filter_text (GvgMemcheckStoreFilter  *self,
   return match;
 }
 
+static gboolean
+gvg_memcheck_store_filter_filter_pid (GvgMemcheckStoreFilter *self,
+                                      GtkTreeModel           *model,
+                                      GtkTreeIter            *iter)
+{
+  GtkTreeIter parent;
+  guint       pid;
+  guint       ppid;
+  guint       depth;
+  
+  /* always make a decision using a toplevel */
+  if (gtk_tree_model_iter_parent (model, &parent, iter)) {
+    return gvg_memcheck_store_filter_filter_pid (self, model, &parent);
+  }
+  
+  gtk_tree_model_get (model, iter,
+                      GVG_MEMCHECK_STORE_COLUMN_PID, &pid,
+                      GVG_MEMCHECK_STORE_COLUMN_PPID, &ppid,
+                      -1);
+  /* remember the process tree as we see it, parents come first anyway */
+  if (pid > 0) {
+    g_hash_table_insert (self->priv->parents,
+                         GUINT_TO_POINTER (pid), GUINT_TO_POINTER (ppid));
+  }
+  
+  if (self->priv->pid == 0) {
+    return TRUE;
+  }
+  /* the depth limit protects against loops due to PID reuse */
+  for (depth = 0; pid > 0 && depth < 256; depth++) {
+    if (pid == self->priv->pid) {
+      return TRUE;
+    }
+    pid = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->parents,
+                                                 GUINT_TO_POINTER (pid)));
+  }
+  
+  return FALSE;
+}
+
 static gboolean
 gvg_memcheck_store_filter_filter_func (GtkTreeModel *model,
                                        GtkTreeIter  *iter,
                                        gpointer      data)
 {
-  return (gvg_memcheck_store_filter_filter_kind (data, model, iter) &&
+  return (gvg_memcheck_store_filter_filter_pid (data, model, iter) &&
+          gvg_memcheck_store_filter_filter_kind (data, model, iter) &&
           gvg_memcheck_store_filter_filter_text (data, model, iter));
 }
 
@@ -309,6 +381,8 @@ gvg_memcheck_store_filter_init (GvgMemcheckStoreFilter *self)
   self->priv->kind            = GVG_MEMCHECK_ERROR_KIND_ANY;
   self->priv->text            = NULL;
   self->priv->invert          = FALSE;
+  self->priv->pid             = 0;
+  self->priv->parents         = g_hash_table_new (NULL, NULL);
   self->priv->timeout_source  = NULL;
   
   gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (self),
@@ -376,6 +450,7 @@ gvg_memcheck_store_filter_finalize (GObject *object)
     self->priv->timeout_source = NULL;
   }
   g_free (self->priv->text);
+  g_hash_table_destroy (self->priv->parents);
   
   G_OBJECT_CLASS (gvg_memcheck_store_filter_parent_class)->finalize (object);
 }
@@ -455,3 +530,22 @@ gvg_memcheck_store_filter_set_invert (GvgMemcheckStoreFilter *self,
   gvg_memcheck_store_filter_refilter (self, TRUE);
   g_object_notify (G_OBJECT (self), "invert");
 }
+
+guint
+gvg_memcheck_store_filter_get_pid (GvgMemcheckStoreFilter *self)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK_STORE_FILTER (self), 0);
+  
+  return self->priv->pid;
+}
+
+void
+gvg_memcheck_store_filter_set_pid (GvgMemcheckStoreFilter *self,
+                                   guint                   pid)
+{
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE_FILTER (self));
+  
+  self->priv->pid = pid;
+  gvg_memcheck_store_filter_refilter (self, TRUE);
+  g_object_notify (G_OBJECT (self), "pid");
+}
@@ -67,6 +67,9 @@ void                  gvg_memcheck_store_filter_set_text    (GvgMemcheckStoreFil
 gboolean              gvg_memcheck_store_filter_get_invert  (GvgMemcheckStoreFilter *self);
 void                  gvg_memcheck_store_filter_set_invert  (GvgMemcheckStoreFilter *self,
                                                              gboolean                invert);
+guint                 gvg_memcheck_store_filter_get_pid     (GvgMemcheckStoreFilter *self);
+void                  gvg_memcheck_store_filter_set_pid     (GvgMemcheckStoreFilter *self,
+                                                             guint                   pid);
 
 
 G_END_DECLS
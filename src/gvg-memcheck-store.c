@@ -24,7 +24,30 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 
+#include "gvg.h"
 #include "gvg-enum-types.h"
+#include "gvg-memcheck-parser.h"
+
+
+/* how many frames identify an error across runs */
+#define SIGNATURE_FRAMES 3
+/* how many queued rows to load at once, see gvg_memcheck_store_queue_load() */
+#define LOAD_BATCH_SIZE 32
+
+
+struct _GvgMemcheckStorePrivate
+{
+  /* fills unloaded rows, see gvg_memcheck_store_set_unloaded() */
+  GvgMemcheckStoreLoadFunc  load_func;
+  GvgMemcheckStoreMatchFunc match_func;
+  gpointer                  load_data;
+  GDestroyNotify            load_destroy;
+  
+  GQueue                   *queue;    /* iters of rows to load */
+  GHashTable               *queued;   /* their records */
+  guint                     load_source;
+  gboolean                  loading;
+};
 
 
 G_DEFINE_TYPE (GvgMemcheckStore,
@@ -32,10 +55,88 @@ G_DEFINE_TYPE (GvgMemcheckStore,
                GTK_TYPE_TREE_STORE)
 
 
+enum
+{
+  SIGNAL_CLEAR,
+  N_SIGNALS
+};
+
+
+static guint signals[N_SIGNALS] = { 0 };
+
+
+static void
+clear_queue (GvgMemcheckStore *self)
+{
+  GtkTreeIter *iter;
+  
+  while ((iter = g_queue_pop_head (self->priv->queue)) != NULL) {
+    gtk_tree_iter_free (iter);
+  }
+  g_hash_table_remove_all (self->priv->queued);
+  if (self->priv->load_source) {
+    g_source_remove (self->priv->load_source);
+    self->priv->load_source = 0;
+  }
+}
+
+static void
+gvg_memcheck_store_real_clear (GvgMemcheckStore *self)
+{
+  /* the rows to load are going away */
+  gvg_memcheck_store_set_load_func (self, NULL, NULL, NULL, NULL);
+  gtk_tree_store_clear (GTK_TREE_STORE (self));
+}
+
+static void
+gvg_memcheck_store_finalize (GObject *object)
+{
+  GvgMemcheckStore *self = GVG_MEMCHECK_STORE (object);
+  
+  gvg_memcheck_store_set_load_func (self, NULL, NULL, NULL, NULL);
+  g_queue_free (self->priv->queue);
+  g_hash_table_destroy (self->priv->queued);
+  
+  G_OBJECT_CLASS (gvg_memcheck_store_parent_class)->finalize (object);
+}
+
 static void
 gvg_memcheck_store_class_init (GvgMemcheckStoreClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  
+  object_class->finalize = gvg_memcheck_store_finalize;
+  
+  klass->clear = gvg_memcheck_store_real_clear;
+  
+  /* emitted to remove all the rows.  every row removal is notified, and some
+   * models (like GtkTreeModelFilter) and views handle each in linear time.
+   * handlers should detach these beforehand, and connect after to reattach
+   * them */
+  signals[SIGNAL_CLEAR] = g_signal_new ("clear",
+                                        GVG_TYPE_MEMCHECK_STORE,
+                                        G_SIGNAL_RUN_LAST,
+                                        G_STRUCT_OFFSET (GvgMemcheckStoreClass,
+                                                         clear),
+                                        NULL, NULL,
+                                        g_cclosure_marshal_VOID__VOID,
+                                        G_TYPE_NONE,
+                                        0);
   
+  g_type_class_add_private (klass, sizeof (GvgMemcheckStorePrivate));
+}
+
+/* queued iters may be invalid after a removal */
+static void
+gvg_memcheck_store_row_deleted (GtkTreeModel *model,
+                                GtkTreePath  *path,
+                                gpointer      data)
+{
+  GvgMemcheckStore *self = GVG_MEMCHECK_STORE (model);
+  
+  if (! self->priv->loading) {
+    clear_queue (self);
+  }
 }
 
 static void
@@ -43,6 +144,18 @@ gvg_memcheck_store_init (GvgMemcheckStore *self)
 {
   GType column_types[GVG_MEMCHECK_STORE_N_COLUMNS] = { 0 };
   
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_MEMCHECK_STORE,
+                                            GvgMemcheckStorePrivate);
+  
+  self->priv->load_func     = NULL;
+  self->priv->match_func    = NULL;
+  self->priv->load_data     = NULL;
+  self->priv->load_destroy  = NULL;
+  self->priv->queue         = g_queue_new ();
+  self->priv->queued        = g_hash_table_new (NULL, NULL);
+  self->priv->load_source   = 0;
+  self->priv->loading       = FALSE;
+  
   column_types[GVG_MEMCHECK_STORE_COLUMN_TYPE]    = GVG_TYPE_ROW_TYPE;
   column_types[GVG_MEMCHECK_STORE_COLUMN_LABEL]   = G_TYPE_STRING;
   column_types[GVG_MEMCHECK_STORE_COLUMN_IP]      = G_TYPE_UINT64;
@@ -51,9 +164,353 @@ gvg_memcheck_store_init (GvgMemcheckStore *self)
   column_types[GVG_MEMCHECK_STORE_COLUMN_FILE]    = G_TYPE_STRING;
   column_types[GVG_MEMCHECK_STORE_COLUMN_LINE]    = G_TYPE_UINT;
   column_types[GVG_MEMCHECK_STORE_COLUMN_KIND]    = GVG_TYPE_MEMCHECK_ERROR_KIND;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_PID]     = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_PPID]    = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_GROUP]   = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_SNAPSHOT] = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_OUTPUT_POSITION] = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_PASS] = G_TYPE_UINT;
+  column_types[GVG_MEMCHECK_STORE_COLUMN_RECORD] = G_TYPE_UINT;
   
   gtk_tree_store_set_column_types (GTK_TREE_STORE (self),
                                    G_N_ELEMENTS (column_types), column_types);
+  
+  g_signal_connect (self, "row-deleted",
+                    G_CALLBACK (gvg_memcheck_store_row_deleted), NULL);
+}
+
+/* removes all the rows, e.g. to reuse the store for another run */
+void
+gvg_memcheck_store_clear (GvgMemcheckStore *self)
+{
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  
+  g_signal_emit (self, signals[SIGNAL_CLEAR], 0);
+}
+
+/* appends the labels of the frames under @parent to @signature, depth first,
+ * until it has SIGNATURE_FRAMES of them */
+static void
+append_frames (GtkTreeModel *model,
+               GtkTreeIter  *parent,
+               GString      *signature,
+               guint        *n_frames)
+{
+  GtkTreeIter iter;
+  gboolean    valid;
+  
+  for (valid = gtk_tree_model_iter_children (model, &iter, parent);
+       valid && *n_frames < SIGNATURE_FRAMES;
+       valid = gtk_tree_model_iter_next (model, &iter)) {
+    GvgRowType  type;
+    gchar      *label;
+    
+    gtk_tree_model_get (model, &iter,
+                        GVG_MEMCHECK_STORE_COLUMN_TYPE, &type,
+                        GVG_MEMCHECK_STORE_COLUMN_LABEL, &label,
+                        -1);
+    if (type == GVG_ROW_TYPE_FRAME) {
+      g_string_append_c (signature, '\n');
+      g_string_append (signature, label);
+      (*n_frames) ++;
+    } else {
+      append_frames (model, &iter, signature, n_frames);
+    }
+    g_free (label);
+  }
+}
+
+/* identifies the error at @iter across runs by its kind and innermost frames,
+ * as addresses and sizes in its description may differ */
+static gchar *
+error_signature (GtkTreeModel *model,
+                 GtkTreeIter  *iter)
+{
+  GString              *signature = g_string_new (NULL);
+  GvgMemcheckErrorKind  kind;
+  guint                 n_frames = 0;
+  
+  gtk_tree_model_get (model, iter, GVG_MEMCHECK_STORE_COLUMN_KIND, &kind, -1);
+  g_string_append_printf (signature, "%d", kind);
+  append_frames (model, iter, signature, &n_frames);
+  
+  return g_string_free (signature, FALSE);
+}
+
+static void
+get_row_origin (GtkTreeModel *model,
+                GtkTreeIter  *iter,
+                GvgRowType   *type,
+                guint        *group,
+                guint        *pass)
+{
+  gtk_tree_model_get (model, iter,
+                      GVG_MEMCHECK_STORE_COLUMN_TYPE, type,
+                      GVG_MEMCHECK_STORE_COLUMN_GROUP, group,
+                      GVG_MEMCHECK_STORE_COLUMN_PASS, pass,
+                      -1);
+}
+
+/*
+ * merges the results of the @pass-th pass of a run (see
+ * gvg_memcheck_parser_set_pass()) with those of its earlier passes, all being
+ * in @group.  errors of the earlier passes that @pass found again are removed
+ * in favor of the new ones, as are the earlier status rows.  errors only the
+ * earlier passes found are kept, and their number is returned
+ */
+guint
+gvg_memcheck_store_merge_pass (GvgMemcheckStore *self,
+                               guint             group,
+                               guint             pass)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (self);
+  GHashTable   *found;
+  GtkTreeIter   iter;
+  gboolean      valid;
+  GvgRowType    row_type;
+  guint         row_group;
+  guint         row_pass;
+  guint         n_kept = 0;
+  
+  g_return_val_if_fail (GVG_IS_MEMCHECK_STORE (self), 0);
+  g_return_val_if_fail (pass > 1, 0);
+  
+  found = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (valid = gtk_tree_model_get_iter_first (model, &iter); valid;
+       valid = gtk_tree_model_iter_next (model, &iter)) {
+    get_row_origin (model, &iter, &row_type, &row_group, &row_pass);
+    if (row_group == group && row_pass == pass &&
+        row_type == GVG_ROW_TYPE_ERROR) {
+      g_hash_table_insert (found, error_signature (model, &iter), NULL);
+    }
+  }
+  
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  while (valid) {
+    get_row_origin (model, &iter, &row_type, &row_group, &row_pass);
+    if (row_group == group && row_pass > 0 && row_pass < pass) {
+      gboolean drop = TRUE;
+      
+      if (row_type == GVG_ROW_TYPE_ERROR) {
+        gchar *signature = error_signature (model, &iter);
+        
+        drop = g_hash_table_lookup_extended (found, signature, NULL, NULL);
+        g_free (signature);
+        if (! drop) {
+          n_kept ++;
+        }
+      }
+      if (drop) {
+        /* moves to the next row */
+        valid = gtk_tree_store_remove (GTK_TREE_STORE (self), &iter);
+        continue;
+      }
+    }
+    valid = gtk_tree_model_iter_next (model, &iter);
+  }
+  g_hash_table_destroy (found);
+  
+  return n_kept;
+}
+
+/* removes all the results of @group (see gvg_xml_parser_set_group()) */
+void
+gvg_memcheck_store_remove_group (GvgMemcheckStore *self,
+                                 guint             group)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (self);
+  GtkTreeIter   iter;
+  gboolean      valid;
+  
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  
+  valid = gtk_tree_model_get_iter_first (model, &iter);
+  while (valid) {
+    guint row_group;
+    
+    gtk_tree_model_get (model, &iter,
+                        GVG_MEMCHECK_STORE_COLUMN_GROUP, &row_group,
+                        -1);
+    if (row_group == group) {
+      /* moves to the next row */
+      valid = gtk_tree_store_remove (GTK_TREE_STORE (self), &iter);
+    } else {
+      valid = gtk_tree_model_iter_next (model, &iter);
+    }
+  }
+}
+
+/*
+ * sets the function filling unloaded rows, and optionally the one telling
+ * whether they may contain a text without loading them, which both get @data.
+ * only one source of unloaded rows is supported at a time, so the store
+ * should be cleared before setting other functions.  clearing the store
+ * unsets them
+ */
+void
+gvg_memcheck_store_set_load_func (GvgMemcheckStore         *self,
+                                  GvgMemcheckStoreLoadFunc  func,
+                                  GvgMemcheckStoreMatchFunc match_func,
+                                  gpointer                  data,
+                                  GDestroyNotify            destroy)
+{
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  
+  clear_queue (self);
+  if (self->priv->load_destroy) {
+    self->priv->load_destroy (self->priv->load_data);
+  }
+  self->priv->load_func = func;
+  self->priv->match_func = match_func;
+  self->priv->load_data = data;
+  self->priv->load_destroy = destroy;
+}
+
+/*
+ * marks the row at @iter as having children yet to be added by the load
+ * function, which will get @record to know which.  the row gets a placeholder
+ * child in the meantime, for views to show it can be expanded
+ */
+void
+gvg_memcheck_store_set_unloaded (GvgMemcheckStore *self,
+                                 GtkTreeIter      *iter,
+                                 guint             record)
+{
+  GtkTreeIter placeholder;
+  
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (record > 0);
+  
+  gtk_tree_store_set (GTK_TREE_STORE (self), iter,
+                      GVG_MEMCHECK_STORE_COLUMN_RECORD, record,
+                      -1);
+  gtk_tree_store_insert_with_values (GTK_TREE_STORE (self), &placeholder,
+                                     iter, -1,
+                                     GVG_MEMCHECK_STORE_COLUMN_TYPE, GVG_ROW_TYPE_OTHER,
+                                     -1);
+}
+
+static guint
+get_row_record (GvgMemcheckStore *self,
+                GtkTreeIter      *iter)
+{
+  guint record;
+  
+  gtk_tree_model_get (GTK_TREE_MODEL (self), iter,
+                      GVG_MEMCHECK_STORE_COLUMN_RECORD, &record,
+                      -1);
+  
+  return record;
+}
+
+gboolean
+gvg_memcheck_store_is_loaded (GvgMemcheckStore *self,
+                              GtkTreeIter      *iter)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK_STORE (self), TRUE);
+  g_return_val_if_fail (iter != NULL, TRUE);
+  
+  return get_row_record (self, iter) == 0;
+}
+
+/* whether the row at @iter may contain @text once loaded, so a search only
+ * has to load those.  a loaded row is always considered to */
+gboolean
+gvg_memcheck_store_may_contain (GvgMemcheckStore *self,
+                                GtkTreeIter      *iter,
+                                const gchar      *text)
+{
+  guint record;
+  
+  g_return_val_if_fail (GVG_IS_MEMCHECK_STORE (self), TRUE);
+  g_return_val_if_fail (iter != NULL, TRUE);
+  g_return_val_if_fail (text != NULL, TRUE);
+  
+  record = get_row_record (self, iter);
+  if (record == 0 || ! *text || ! self->priv->match_func) {
+    return TRUE;
+  }
+  
+  return self->priv->match_func (self, record, text, self->priv->load_data);
+}
+
+/* adds the children of the row at @iter right away if it's unloaded, e.g.
+ * before expanding it.  must not be called while filters run, see
+ * gvg_memcheck_store_queue_load() */
+void
+gvg_memcheck_store_load (GvgMemcheckStore *self,
+                         GtkTreeIter      *iter)
+{
+  GtkTreeModel *model = GTK_TREE_MODEL (self);
+  GtkTreeIter   placeholder;
+  guint         record;
+  
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  g_return_if_fail (iter != NULL);
+  
+  record = get_row_record (self, iter);
+  if (record == 0 || ! self->priv->load_func) {
+    return;
+  }
+  
+  self->priv->loading = TRUE;
+  /* the placeholder stays first, for the row to keep a child meanwhile */
+  gtk_tree_model_iter_children (model, &placeholder, iter);
+  self->priv->load_func (self, iter, record, self->priv->load_data);
+  gtk_tree_store_remove (GTK_TREE_STORE (self), &placeholder);
+  self->priv->loading = FALSE;
+  /* this also has filters check the entry again with its children */
+  gtk_tree_store_set (GTK_TREE_STORE (self), iter,
+                      GVG_MEMCHECK_STORE_COLUMN_RECORD, 0,
+                      -1);
+  g_hash_table_remove (self->priv->queued, GUINT_TO_POINTER (record));
+}
+
+static gboolean
+load_queued (gpointer data)
+{
+  GvgMemcheckStore *self = data;
+  GtkTreeIter      *iter;
+  guint             i;
+  
+  for (i = 0; i < LOAD_BATCH_SIZE &&
+              (iter = g_queue_pop_head (self->priv->queue)) != NULL; i++) {
+    gvg_memcheck_store_load (self, iter);
+    gtk_tree_iter_free (iter);
+  }
+  if (g_queue_is_empty (self->priv->queue)) {
+    self->priv->load_source = 0;
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+/* loads the row at @iter soon if it's unloaded.  unlike
+ * gvg_memcheck_store_load(), this may be called from a filter's visible
+ * function, which mustn't change the model */
+void
+gvg_memcheck_store_queue_load (GvgMemcheckStore *self,
+                               GtkTreeIter      *iter)
+{
+  guint record;
+  
+  g_return_if_fail (GVG_IS_MEMCHECK_STORE (self));
+  g_return_if_fail (iter != NULL);
+  
+  record = get_row_record (self, iter);
+  if (record == 0 || ! self->priv->load_func ||
+      g_hash_table_lookup_extended (self->priv->queued,
+                                    GUINT_TO_POINTER (record), NULL, NULL)) {
+    return;
+  }
+  
+  g_hash_table_insert (self->priv->queued, GUINT_TO_POINTER (record), NULL);
+  g_queue_push_tail (self->priv->queue, gtk_tree_iter_copy (iter));
+  if (! self->priv->load_source) {
+    self->priv->load_source = g_idle_add (load_queued, self);
+  }
 }
 
 GvgMemcheckStore *
@@ -46,25 +46,73 @@ enum
   GVG_MEMCHECK_STORE_COLUMN_FILE,
   GVG_MEMCHECK_STORE_COLUMN_LINE,
   GVG_MEMCHECK_STORE_COLUMN_KIND,
+  GVG_MEMCHECK_STORE_COLUMN_PID,
+  GVG_MEMCHECK_STORE_COLUMN_PPID,
+  GVG_MEMCHECK_STORE_COLUMN_GROUP,
+  GVG_MEMCHECK_STORE_COLUMN_SNAPSHOT,
+  GVG_MEMCHECK_STORE_COLUMN_OUTPUT_POSITION,
+  GVG_MEMCHECK_STORE_COLUMN_PASS,
+  GVG_MEMCHECK_STORE_COLUMN_RECORD,
   
   GVG_MEMCHECK_STORE_N_COLUMNS
 };
 
-typedef struct _GvgMemcheckStore      GvgMemcheckStore;
-typedef struct _GvgMemcheckStoreClass GvgMemcheckStoreClass;
+typedef struct _GvgMemcheckStore        GvgMemcheckStore;
+typedef struct _GvgMemcheckStoreClass   GvgMemcheckStoreClass;
+typedef struct _GvgMemcheckStorePrivate GvgMemcheckStorePrivate;
+
+/* adds the children of the unloaded row at @iter, see
+ * gvg_memcheck_store_set_unloaded() */
+typedef void  (*GvgMemcheckStoreLoadFunc) (GvgMemcheckStore *store,
+                                           GtkTreeIter      *iter,
+                                           guint             record,
+                                           gpointer          data);
+/* whether the children the load function would add for @record may contain
+ * @text, %TRUE if unsure */
+typedef gboolean  (*GvgMemcheckStoreMatchFunc) (GvgMemcheckStore *store,
+                                                guint             record,
+                                                const gchar      *text,
+                                                gpointer          data);
 
 struct _GvgMemcheckStore
 {
   GtkTreeStore parent_instance;
+  
+  GvgMemcheckStorePrivate *priv;
 };
 
 struct _GvgMemcheckStoreClass
 {
   GtkTreeStoreClass parent_class;
+  
+  void  (*clear)  (GvgMemcheckStore *self);
 };
 
 
 GType             gvg_memcheck_store_get_type         (void) G_GNUC_CONST;
+void              gvg_memcheck_store_clear            (GvgMemcheckStore *self);
+guint             gvg_memcheck_store_merge_pass       (GvgMemcheckStore *self,
+                                                       guint             group,
+                                                       guint             pass);
+void              gvg_memcheck_store_remove_group     (GvgMemcheckStore *self,
+                                                       guint             group);
+void              gvg_memcheck_store_set_load_func    (GvgMemcheckStore         *self,
+                                                       GvgMemcheckStoreLoadFunc  func,
+                                                       GvgMemcheckStoreMatchFunc match_func,
+                                                       gpointer                  data,
+                                                       GDestroyNotify            destroy);
+void              gvg_memcheck_store_set_unloaded     (GvgMemcheckStore *self,
+                                                       GtkTreeIter      *iter,
+                                                       guint             record);
+gboolean          gvg_memcheck_store_is_loaded        (GvgMemcheckStore *self,
+                                                       GtkTreeIter      *iter);
+gboolean          gvg_memcheck_store_may_contain      (GvgMemcheckStore *self,
+                                                       GtkTreeIter      *iter,
+                                                       const gchar      *text);
+void              gvg_memcheck_store_load             (GvgMemcheckStore *self,
+                                                       GtkTreeIter      *iter);
+void              gvg_memcheck_store_queue_load       (GvgMemcheckStore *self,
+                                                       GtkTreeIter      *iter);
 GvgMemcheckStore *gvg_memcheck_store_new              (void);
 
 
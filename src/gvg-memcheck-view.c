@@ -95,12 +95,35 @@ gvg_memcheck_view_row_activated (GtkTreeView       *view,
   }
 }
 
+/* adds the children of unloaded rows before they are shown */
+static gboolean
+gvg_memcheck_view_test_expand_row (GtkTreeView *view,
+                                   GtkTreeIter *iter,
+                                   GtkTreePath *path)
+{
+  GtkTreeModel *model = gtk_tree_view_get_model (view);
+  GtkTreeIter   child_iter = *iter;
+  
+  if (GTK_IS_TREE_MODEL_FILTER (model)) {
+    gtk_tree_model_filter_convert_iter_to_child_iter (GTK_TREE_MODEL_FILTER (model),
+                                                      &child_iter, iter);
+    model = gtk_tree_model_filter_get_model (GTK_TREE_MODEL_FILTER (model));
+  }
+  if (GVG_IS_MEMCHECK_STORE (model)) {
+    gvg_memcheck_store_load (GVG_MEMCHECK_STORE (model), &child_iter);
+  }
+  
+  /* allow expansion */
+  return FALSE;
+}
+
 static void
 gvg_memcheck_view_class_init (GvgMemcheckViewClass *klass)
 {
   GtkTreeViewClass *tree_view_class = GTK_TREE_VIEW_CLASS (klass);
   
   tree_view_class->row_activated = gvg_memcheck_view_row_activated;
+  tree_view_class->test_expand_row = gvg_memcheck_view_test_expand_row;
   
   signals[SIGNAL_FILE_ACTIVATED] = g_signal_new ("file-activated",
                                                  GVG_TYPE_MEMCHECK_VIEW,
@@ -169,6 +192,26 @@ gvg_memcheck_view_ip_column_set_data (GtkCellLayout   *cell_layout,
   g_free (text);
 }
 
+static void
+gvg_memcheck_view_pid_column_set_data (GtkCellLayout   *cell_layout,
+                                       GtkCellRenderer *cell,
+                                       GtkTreeModel    *model,
+                                       GtkTreeIter     *iter,
+                                       gpointer         data)
+{
+  GvgMemcheckView  *self = data;
+  guint             pid;
+  gchar            *text = NULL;
+  
+  gtk_tree_model_get (model, iter, GVG_MEMCHECK_STORE_COLUMN_PID, &pid, -1);
+  /* only toplevel rows have a PID, children come from the same process */
+  if (pid > 0) {
+    text = g_strdup_printf ("%u", pid);
+  }
+  g_object_set (cell, "text", text, "visible", text != NULL, NULL);
+  g_free (text);
+}
+
 static void
 gvg_memcheck_view_init (GvgMemcheckView *self)
 {
@@ -191,6 +234,14 @@ gvg_memcheck_view_init (GvgMemcheckView *self)
                                       gvg_memcheck_view_ip_column_set_data,
                                       self, NULL);
   gtk_tree_view_append_column (GTK_TREE_VIEW (self), col);
+  /* originating process column */
+  cell = gtk_cell_renderer_text_new ();
+  col = g_object_new (GTK_TYPE_TREE_VIEW_COLUMN, "title", _("PID"), NULL);
+  gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (col), cell, FALSE);
+  gtk_cell_layout_set_cell_data_func (GTK_CELL_LAYOUT (col), cell,
+                                      gvg_memcheck_view_pid_column_set_data,
+                                      self, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (self), col);
 }
 
 
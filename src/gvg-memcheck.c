@@ -23,10 +23,42 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gi18n.h>
+#include <sys/wait.h>
+#include <string.h>
 
 #include "gvg.h"
 #include "gvg-memcheck-parser.h"
 #include "gvg-memcheck-options.h"
+#include "gvg-memcheck-store.h"
+#include "gvg-options.h"
+#include "gvg-enum-types.h"
+
+
+#define N_ERROR_KINDS (GVG_MEMCHECK_ERROR_KIND_LEAK_STILL_REACHABLE + 1)
+/* how long vgdb may take to dump the leaks when a budget is exceeded */
+#define VGDB_TIMEOUT 10
+
+
+struct _GvgMemcheckPrivate
+{
+  guint   snapshot_interval;
+  guint   snapshot_timeout;
+  GPid    vgdb_pid;   /* the vgdb asking for the current snapshot, or 0 */
+  guint   vgdb_watch;
+  gchar  *budget_message; /* set while dumping the leaks before a stop */
+  guint   budget_timeout;
+  
+  /* number of errors of each kind after which the run is stopped, or 0 */
+  guint   thresholds[N_ERROR_KINDS];
+  
+  gboolean  adaptive;
+  guint     adaptive_num_callers;
+  guint     pass;         /* pass of the current adaptive run, or 0 */
+  gboolean  next_pass;    /* whether the run starting is the second pass */
+  gchar    *pass_message; /* describes the second pass */
+  guint     n_kept_errors; /* errors only the first pass found */
+};
 
 
 G_DEFINE_TYPE (GvgMemcheck,
@@ -34,14 +66,447 @@ G_DEFINE_TYPE (GvgMemcheck,
                GVG_TYPE_GVG)
 
 
+static void     gvg_memcheck_constructed    (GObject *object);
+static void     gvg_memcheck_finalize       (GObject *object);
+static void     gvg_memcheck_get_property   (GObject    *object,
+                                             guint       prop_id,
+                                             GValue     *value,
+                                             GParamSpec *pspec);
+static void     gvg_memcheck_set_property   (GObject      *object,
+                                             guint         prop_id,
+                                             const GValue *value,
+                                             GParamSpec   *pspec);
+static void     gvg_memcheck_started        (Gvg *gvg);
+static gboolean gvg_memcheck_continue_run   (Gvg *gvg);
+static void     gvg_memcheck_copy_settings  (Gvg *gvg,
+                                             Gvg *source);
+static void     gvg_memcheck_budget_exceeded  (Gvg         *gvg,
+                                               const gchar *message);
+static guint    gvg_memcheck_get_n_errors   (Gvg *gvg);
+
+
+enum
+{
+  PROP_0,
+  PROP_LEAK_SNAPSHOT_INTERVAL,
+  PROP_ADAPTIVE,
+  PROP_ADAPTIVE_NUM_CALLERS
+};
+
+
 static void
 gvg_memcheck_class_init (GvgMemcheckClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GvgClass     *gvg_class    = GVG_CLASS (klass);
+  
+  object_class->constructed   = gvg_memcheck_constructed;
+  object_class->finalize      = gvg_memcheck_finalize;
+  object_class->set_property  = gvg_memcheck_set_property;
+  object_class->get_property  = gvg_memcheck_get_property;
+  
+  gvg_class->started          = gvg_memcheck_started;
+  gvg_class->budget_exceeded  = gvg_memcheck_budget_exceeded;
+  gvg_class->get_n_errors     = gvg_memcheck_get_n_errors;
+  gvg_class->continue_run     = gvg_memcheck_continue_run;
+  gvg_class->copy_settings    = gvg_memcheck_copy_settings;
+  
+  g_object_class_install_property (object_class,
+                                   PROP_LEAK_SNAPSHOT_INTERVAL,
+                                   g_param_spec_uint ("leak-snapshot-interval",
+                                                      "Leak snapshot interval",
+                                                      "Interval in seconds between leak snapshots of "
+                                                      "the running program, or 0 for none",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_ADAPTIVE,
+                                   g_param_spec_boolean ("adaptive",
+                                                         "Adaptive",
+                                                         "Whether to run the program again with origin "
+                                                         "tracking and deeper stacks when the first, "
+                                                         "cheaper run finds errors that need them",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_ADAPTIVE_NUM_CALLERS,
+                                   g_param_spec_uint ("adaptive-num-callers",
+                                                      "Adaptive num callers",
+                                                      "Number of callers to record in the second "
+                                                      "pass of an adaptive run when stacks were "
+                                                      "truncated",
+                                                      1, 500, 50,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  
+  g_type_class_add_private (klass, sizeof (GvgMemcheckPrivate));
 }
 
 static void
 gvg_memcheck_init (GvgMemcheck *self)
 {
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_MEMCHECK,
+                                            GvgMemcheckPrivate);
+  
+  self->priv->snapshot_interval = 0;
+  self->priv->snapshot_timeout  = 0;
+  self->priv->vgdb_pid          = 0;
+  self->priv->vgdb_watch        = 0;
+  self->priv->budget_message    = NULL;
+  self->priv->budget_timeout    = 0;
+  memset (self->priv->thresholds, 0, sizeof self->priv->thresholds);
+  self->priv->adaptive          = FALSE;
+  self->priv->adaptive_num_callers = 50;
+  self->priv->pass              = 0;
+  self->priv->next_pass         = FALSE;
+  self->priv->pass_message      = NULL;
+  self->priv->n_kept_errors     = 0;
+}
+
+static const gchar *
+error_kind_nick (GvgMemcheckErrorKind kind)
+{
+  GEnumClass *enum_class = g_type_class_ref (GVG_TYPE_MEMCHECK_ERROR_KIND);
+  GEnumValue *value = g_enum_get_value (enum_class, kind);
+  
+  g_type_class_unref (enum_class);
+  
+  return value ? value->value_nick : "unknown";
+}
+
+static void
+parser_error (GvgMemcheckParser    *parser,
+              GvgMemcheckErrorKind  kind,
+              guint                 count,
+              GvgMemcheck          *self)
+{
+  guint total;
+  
+  if (gvg_get_pid (GVG (self)) == 0 || gvg_is_stopping (GVG (self))) {
+    return;
+  }
+  
+  total = gvg_memcheck_parser_get_error_count (parser,
+                                               GVG_MEMCHECK_ERROR_KIND_ANY);
+  if (kind != GVG_MEMCHECK_ERROR_KIND_ANY &&
+      self->priv->thresholds[kind] > 0 &&
+      count >= self->priv->thresholds[kind]) {
+    gchar *message;
+    
+    message = g_strdup_printf (_("Stopped after %u %s error(s)"),
+                               count, error_kind_nick (kind));
+    gvg_stop_for_reason (GVG (self), GVG_STOP_REASON_ERROR_THRESHOLD, message);
+    g_free (message);
+  } else if (self->priv->thresholds[GVG_MEMCHECK_ERROR_KIND_ANY] > 0 &&
+             total >= self->priv->thresholds[GVG_MEMCHECK_ERROR_KIND_ANY]) {
+    gchar *message;
+    
+    message = g_strdup_printf (_("Stopped after %u error(s)"), total);
+    gvg_stop_for_reason (GVG (self), GVG_STOP_REASON_ERROR_THRESHOLD, message);
+    g_free (message);
+  }
+}
+
+static void
+gvg_memcheck_constructed (GObject *object)
+{
+  GvgMemcheck  *self = GVG_MEMCHECK (object);
+  GvgXmlParser *parser;
+  
+  if (G_OBJECT_CLASS (gvg_memcheck_parent_class)->constructed) {
+    G_OBJECT_CLASS (gvg_memcheck_parent_class)->constructed (object);
+  }
+  
+  /* the copies parsing traced processes and listener connections count
+   * their errors on it too */
+  g_object_get (self, "parser", &parser, NULL);
+  if (parser) {
+    g_signal_connect_object (parser, "error",
+                             G_CALLBACK (parser_error), self, 0);
+    g_object_unref (parser);
+  }
+}
+
+static void
+gvg_memcheck_finalize (GObject *object)
+{
+  GvgMemcheck *self = GVG_MEMCHECK (object);
+  
+  if (self->priv->snapshot_timeout) {
+    g_source_remove (self->priv->snapshot_timeout);
+  }
+  if (self->priv->budget_timeout) {
+    g_source_remove (self->priv->budget_timeout);
+  }
+  g_free (self->priv->budget_message);
+  g_free (self->priv->pass_message);
+  /* vgdb exits by itself, only stop watching it */
+  if (self->priv->vgdb_watch) {
+    g_source_remove (self->priv->vgdb_watch);
+    g_spawn_close_pid (self->priv->vgdb_pid);
+  }
+  
+  G_OBJECT_CLASS (gvg_memcheck_parent_class)->finalize (object);
+}
+
+static gboolean
+snapshot_timeout_handler (gpointer data)
+{
+  GvgMemcheck *self = data;
+  
+  /* nothing to do between runs */
+  if (gvg_get_pid (GVG (self)) != 0) {
+    GError *err = NULL;
+    
+    if (! gvg_memcheck_snapshot_leaks (self, &err)) {
+      g_warning ("failed to take leak snapshot: %s", err->message);
+      g_error_free (err);
+    }
+  }
+  
+  return TRUE;
+}
+
+static void
+set_snapshot_interval (GvgMemcheck *self,
+                       guint        interval)
+{
+  if (self->priv->snapshot_timeout) {
+    g_source_remove (self->priv->snapshot_timeout);
+    self->priv->snapshot_timeout = 0;
+  }
+  self->priv->snapshot_interval = interval;
+  if (interval > 0) {
+    self->priv->snapshot_timeout = g_timeout_add_seconds (interval,
+                                                          snapshot_timeout_handler,
+                                                          self);
+  }
+}
+
+static void
+gvg_memcheck_get_property (GObject    *object,
+                           guint       prop_id,
+                           GValue     *value,
+                           GParamSpec *pspec)
+{
+  GvgMemcheck *self = GVG_MEMCHECK (object);
+  
+  switch (prop_id) {
+    case PROP_LEAK_SNAPSHOT_INTERVAL:
+      g_value_set_uint (value, self->priv->snapshot_interval);
+      break;
+    
+    case PROP_ADAPTIVE:
+      g_value_set_boolean (value, self->priv->adaptive);
+      break;
+    
+    case PROP_ADAPTIVE_NUM_CALLERS:
+      g_value_set_uint (value, self->priv->adaptive_num_callers);
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gvg_memcheck_set_property (GObject      *object,
+                           guint         prop_id,
+                           const GValue *value,
+                           GParamSpec   *pspec)
+{
+  GvgMemcheck *self = GVG_MEMCHECK (object);
+  
+  switch (prop_id) {
+    case PROP_LEAK_SNAPSHOT_INTERVAL:
+      set_snapshot_interval (self, g_value_get_uint (value));
+      break;
+    
+    case PROP_ADAPTIVE:
+      self->priv->adaptive = g_value_get_boolean (value);
+      break;
+    
+    case PROP_ADAPTIVE_NUM_CALLERS:
+      self->priv->adaptive_num_callers = g_value_get_uint (value);
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* tags the results with the pass of the run, starting an adaptive run if
+ * needed.  only actual runs can be repeated, not loads */
+static void
+gvg_memcheck_started (Gvg *gvg)
+{
+  GvgMemcheck  *self = GVG_MEMCHECK (gvg);
+  GvgXmlParser *parser;
+  GvgOptions   *options;
+  guint         num_callers = 0;
+  
+  if (self->priv->next_pass) {
+    self->priv->next_pass = FALSE;
+    self->priv->pass = 2;
+  } else {
+    /* a new run */
+    self->priv->n_kept_errors = 0;
+    self->priv->pass = self->priv->adaptive && gvg_get_program_argv (gvg) ? 1 : 0;
+  }
+  
+  g_object_get (gvg, "parser", &parser, "options", &options, NULL);
+  if (self->priv->pass == 1 && options) {
+    g_object_get (options, "num-callers", &num_callers, NULL);
+  }
+  gvg_memcheck_parser_set_pass (GVG_MEMCHECK_PARSER (parser),
+                                self->priv->pass, num_callers);
+  g_object_unref (parser);
+  if (options) {
+    g_object_unref (options);
+  }
+}
+
+/* runs the program again with the settings that tell more about the errors
+ * the first pass found, if any.  only the options of the second run are
+ * changed.  returns whether the second pass started */
+static gboolean
+start_second_pass (GvgMemcheck       *self,
+                   GvgMemcheckParser *parser)
+{
+  Gvg        *gvg = GVG (self);
+  GvgOptions *options;
+  GvgOptions *options2;
+  guint       n_uninit;
+  guint       n_truncated;
+  guint       num_callers;
+  gboolean    track_origins;
+  gchar     **argv;
+  gboolean    success;
+  GError     *err = NULL;
+  
+  g_object_get (gvg, "options", &options, NULL);
+  if (! GVG_IS_MEMCHECK_OPTIONS (options)) {
+    if (options) {
+      g_object_unref (options);
+    }
+    return FALSE;
+  }
+  
+  n_uninit = gvg_memcheck_parser_get_error_count (parser,
+                                                  GVG_MEMCHECK_ERROR_KIND_UNINIT_CONDITION) +
+             gvg_memcheck_parser_get_error_count (parser,
+                                                  GVG_MEMCHECK_ERROR_KIND_UNINIT_VALUE);
+  n_truncated = gvg_memcheck_parser_get_n_truncated_stacks (parser);
+  g_object_get (options,
+                "num-callers", &num_callers,
+                "track-origins", &track_origins,
+                NULL);
+  /* nothing the second pass would do better */
+  if ((n_uninit == 0 || track_origins) &&
+      (n_truncated == 0 || num_callers >= self->priv->adaptive_num_callers)) {
+    g_object_unref (options);
+    return FALSE;
+  }
+  
+  options2 = gvg_options_copy (options);
+  if (n_uninit > 0) {
+    g_object_set (options2, "track-origins", TRUE, NULL);
+  }
+  if (n_truncated > 0) {
+    num_callers = MAX (num_callers, self->priv->adaptive_num_callers);
+    g_object_set (options2, "num-callers", num_callers, NULL);
+  }
+  
+  g_free (self->priv->pass_message);
+  if (n_uninit > 0 && n_truncated > 0) {
+    self->priv->pass_message = g_strdup_printf (_("Ran again with origin tracking "
+                                                  "and %u callers"),
+                                                num_callers);
+  } else if (n_uninit > 0) {
+    self->priv->pass_message = g_strdup (_("Ran again with origin tracking"));
+  } else {
+    self->priv->pass_message = g_strdup_printf (_("Ran again with %u callers"),
+                                                num_callers);
+  }
+  
+  /* the program arguments are replaced by the run */
+  argv = g_strdupv ((gchar **) gvg_get_program_argv (gvg));
+  self->priv->next_pass = TRUE;
+  success = gvg_run_with_options (gvg, argv, options2, &err);
+  if (! success) {
+    self->priv->next_pass = FALSE;
+    g_warning ("failed to run the second pass: %s", err->message);
+    g_error_free (err);
+  }
+  g_strfreev (argv);
+  g_object_unref (options2);
+  g_object_unref (options);
+  
+  return success;
+}
+
+/* records why the run was stopped along with its results, and goes on with
+ * the next pass of an adaptive run.  ::finished is only emitted once the
+ * second pass completed and its results were merged, so its handlers see
+ * the whole run */
+static gboolean
+gvg_memcheck_continue_run (Gvg *gvg)
+{
+  GvgMemcheck  *self = GVG_MEMCHECK (gvg);
+  const gchar  *message;
+  GvgXmlParser *parser;
+  GvgStopReason reason;
+  
+  g_object_get (gvg, "parser", &parser, NULL);
+  reason = gvg_get_stop_reason (gvg, &message);
+  if (reason != GVG_STOP_REASON_NONE && message) {
+    gvg_memcheck_parser_add_status (GVG_MEMCHECK_PARSER (parser), message);
+  }
+  
+  if (self->priv->pass == 1 && reason == GVG_STOP_REASON_NONE &&
+      start_second_pass (self, GVG_MEMCHECK_PARSER (parser))) {
+    /* the second pass is running */
+    g_object_unref (parser);
+    return TRUE;
+  } else if (self->priv->pass == 2) {
+    GvgMemcheckStore *store;
+    
+    g_object_get (parser, "store", &store, NULL);
+    self->priv->n_kept_errors = gvg_memcheck_store_merge_pass (store,
+                                                               gvg_xml_parser_get_group (parser),
+                                                               2);
+    gvg_memcheck_parser_add_status (GVG_MEMCHECK_PARSER (parser),
+                                    self->priv->pass_message);
+    g_object_unref (store);
+  } else {
+    /* a single pass was enough */
+    self->priv->pass = 0;
+  }
+  g_object_unref (parser);
+  
+  return FALSE;
+}
+
+/* the parser also counts the errors of its copies, so this covers traced
+ * processes and listener connections too.  an adaptive run also has the
+ * errors only its first pass found */
+static guint
+gvg_memcheck_get_n_errors (Gvg *gvg)
+{
+  GvgXmlParser *parser;
+  guint         n_errors;
+  
+  g_object_get (gvg, "parser", &parser, NULL);
+  n_errors = gvg_memcheck_parser_get_error_count (GVG_MEMCHECK_PARSER (parser),
+                                                  GVG_MEMCHECK_ERROR_KIND_ANY);
+  n_errors += GVG_MEMCHECK (gvg)->priv->n_kept_errors;
+  g_object_unref (parser);
+  
+  return n_errors;
 }
 
 GvgMemcheck *
@@ -53,3 +518,182 @@ gvg_memcheck_new (GvgMemcheckOptions *options,
                        "parser", parser,
                        NULL);
 }
+
+/* stops the run after its budget was exceeded, once the leaks were dumped */
+static void
+stop_for_budget (GvgMemcheck *self)
+{
+  gchar *message = self->priv->budget_message;
+  
+  if (self->priv->budget_timeout) {
+    g_source_remove (self->priv->budget_timeout);
+    self->priv->budget_timeout = 0;
+  }
+  self->priv->budget_message = NULL;
+  GVG_CLASS (gvg_memcheck_parent_class)->budget_exceeded (GVG (self), message);
+  g_free (message);
+}
+
+static void
+vgdb_exited (GPid     pid,
+             gint     status,
+             gpointer data)
+{
+  GvgMemcheck *self = data;
+  
+  if (! WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+    g_warning ("vgdb failed to check for leaks");
+  }
+  g_spawn_close_pid (pid);
+  self->priv->vgdb_pid = 0;
+  self->priv->vgdb_watch = 0;
+  if (self->priv->budget_message) {
+    stop_for_budget (self);
+  }
+}
+
+/* asks the running Valgrind to check for leaks through vgdb.  @mode is
+ * the leak_check monitor command's delta mode.  does nothing if a check is
+ * already running */
+static gboolean
+check_leaks (GvgMemcheck  *self,
+             const gchar  *mode,
+             GError      **error)
+{
+  GvgXmlParser *parser;
+  gchar        *pid_arg;
+  gboolean      success;
+  
+  if (self->priv->vgdb_pid != 0) {
+    return TRUE;
+  }
+  
+  g_object_get (self, "parser", &parser, NULL);
+  /* start the snapshot first so none of its errors can be parsed before */
+  gvg_memcheck_parser_begin_leak_snapshot (GVG_MEMCHECK_PARSER (parser));
+  pid_arg = g_strdup_printf ("--pid=%d", (gint) gvg_get_pid (GVG (self)));
+  {
+    const gchar *argv[] = {
+      "vgdb", pid_arg, "leak_check", "full", mode, NULL
+    };
+    
+    /* the results come as errors in the XML output, we don't need what vgdb
+     * itself prints */
+    success = g_spawn_async (NULL, (gchar **) argv, NULL,
+                             G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD |
+                             G_SPAWN_STDOUT_TO_DEV_NULL,
+                             NULL, NULL, &self->priv->vgdb_pid, error);
+  }
+  if (success) {
+    self->priv->vgdb_watch = g_child_watch_add (self->priv->vgdb_pid,
+                                                vgdb_exited, self);
+  } else {
+    self->priv->vgdb_pid = 0;
+  }
+  g_free (pid_arg);
+  g_object_unref (parser);
+  
+  return success;
+}
+
+static gboolean
+budget_timeout_handler (gpointer data)
+{
+  GvgMemcheck *self = data;
+  
+  g_warning ("vgdb takes too long to check for leaks, stopping anyway");
+  self->priv->budget_timeout = 0;
+  stop_for_budget (self);
+  
+  return FALSE;
+}
+
+/* dumps all the leaks before stopping, so even a hung run has them */
+static void
+gvg_memcheck_budget_exceeded (Gvg         *gvg,
+                              const gchar *message)
+{
+  GvgMemcheck *self = GVG_MEMCHECK (gvg);
+  GError      *err = NULL;
+  
+  if (self->priv->budget_message) {
+    return;
+  }
+  
+  self->priv->budget_message = g_strdup (message);
+  if (! check_leaks (self, "any", &err)) {
+    g_warning ("failed to check for leaks: %s", err->message);
+    g_error_free (err);
+    stop_for_budget (self);
+  } else {
+    self->priv->budget_timeout = g_timeout_add_seconds (VGDB_TIMEOUT,
+                                                        budget_timeout_handler,
+                                                        self);
+  }
+}
+
+/*
+ * takes a snapshot of the leaks of the running program without stopping it,
+ * using Valgrind's gdbserver (see the "vgdb" option).  only the leaks that
+ * grew since the previous snapshot are reported, grouped under a timestamped
+ * header.  does nothing if the previous snapshot is still being taken
+ */
+gboolean
+gvg_memcheck_snapshot_leaks (GvgMemcheck *self,
+                             GError     **error)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK (self), FALSE);
+  g_return_val_if_fail (gvg_get_pid (GVG (self)) != 0, FALSE);
+  
+  return check_leaks (self, "increased", error);
+}
+
+/*
+ * sets the number of errors of @kind after which a run is stopped, or 0 for no
+ * limit.  GVG_MEMCHECK_ERROR_KIND_ANY limits the total number of errors.  the
+ * results parsed so far are kept, and the reason of the stop is added to them
+ * (see also gvg_get_stop_reason())
+ */
+void
+gvg_memcheck_set_error_threshold (GvgMemcheck          *self,
+                                  GvgMemcheckErrorKind  kind,
+                                  guint                 threshold)
+{
+  g_return_if_fail (GVG_IS_MEMCHECK (self));
+  g_return_if_fail (kind < N_ERROR_KINDS);
+  
+  self->priv->thresholds[kind] = threshold;
+}
+
+guint
+gvg_memcheck_get_error_threshold (GvgMemcheck          *self,
+                                  GvgMemcheckErrorKind  kind)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK (self), 0);
+  g_return_val_if_fail (kind < N_ERROR_KINDS, 0);
+  
+  return self->priv->thresholds[kind];
+}
+
+static void
+gvg_memcheck_copy_settings (Gvg *gvg,
+                            Gvg *source)
+{
+  GvgMemcheck *self = GVG_MEMCHECK (gvg);
+  
+  memcpy (self->priv->thresholds, GVG_MEMCHECK (source)->priv->thresholds,
+          sizeof self->priv->thresholds);
+}
+
+/* gets which pass of an adaptive run the current or last run is (see the
+ * "adaptive" property): 1 for the first one, 2 for the second one, and 0 if
+ * the run isn't adaptive.  ::finished is only emitted once all passes
+ * completed, and its handlers get 2 if the program ran twice and 0 if a
+ * single pass was enough */
+guint
+gvg_memcheck_get_pass (GvgMemcheck *self)
+{
+  g_return_val_if_fail (GVG_IS_MEMCHECK (self), 0);
+  
+  return self->priv->pass;
+}
@@ -57,10 +57,12 @@ typedef enum {
 
 typedef struct _GvgMemcheck         GvgMemcheck;
 typedef struct _GvgMemcheckClass    GvgMemcheckClass;
+typedef struct _GvgMemcheckPrivate  GvgMemcheckPrivate;
 
 struct _GvgMemcheck
 {
-  Gvg parent;
+  Gvg                 parent;
+  GvgMemcheckPrivate *priv;
 };
 
 struct _GvgMemcheckClass
@@ -72,6 +74,14 @@ struct _GvgMemcheckClass
 GType               gvg_memcheck_get_type       (void) G_GNUC_CONST;
 GvgMemcheck        *gvg_memcheck_new            (GvgMemcheckOptions *options,
                                                  GvgMemcheckParser  *parser);
+gboolean            gvg_memcheck_snapshot_leaks (GvgMemcheck *self,
+                                                 GError     **error);
+void                gvg_memcheck_set_error_threshold  (GvgMemcheck          *self,
+                                                       GvgMemcheckErrorKind  kind,
+                                                       guint                 threshold);
+guint               gvg_memcheck_get_error_threshold  (GvgMemcheck          *self,
+                                                       GvgMemcheckErrorKind  kind);
+guint               gvg_memcheck_get_pass       (GvgMemcheck *self);
 
 
 G_END_DECLS
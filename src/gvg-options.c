@@ -34,6 +34,7 @@ struct _GvgOptionsPrivate
   guint       show_below_main : 1;
   guint       track_fds : 1;
   guint       time_stamp : 1;
+  guint       vgdb : 1;
   
   guint       num_callers;
   guint64     max_stackframe;
@@ -64,6 +65,7 @@ enum
   PROP_SHOW_BELOW_MAIN,
   PROP_TRACK_FDS,
   PROP_TIME_STAMP,
+  PROP_VGDB,
   PROP_NUM_CALLERS,
   PROP_MAX_STACKFRAME,
   PROP_MAIN_STACKSIZE
@@ -121,6 +123,16 @@ gvg_options_class_init (GvgOptionsClass *klass)
                                                          FALSE,
                                                          G_PARAM_READWRITE |
                                                          G_PARAM_STATIC_STRINGS));
+  /* needed for querying the running program, e.g. for leak snapshots */
+  g_object_class_install_property (object_class,
+                                   PROP_VGDB,
+                                   g_param_spec_boolean ("vgdb",
+                                                         "vgdb",
+                                                         "Whether to enable the gdbserver "
+                                                         "used by vgdb",
+                                                         TRUE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
   g_object_class_install_property (object_class,
                                    PROP_NUM_CALLERS,
                                    g_param_spec_uint ("num-callers",
@@ -161,6 +173,7 @@ gvg_options_init (GvgOptions *self)
   self->priv->show_below_main = FALSE;
   self->priv->track_fds       = FALSE;
   self->priv->time_stamp      = FALSE;
+  self->priv->vgdb            = TRUE;
   self->priv->num_callers     = 12;
   self->priv->max_stackframe  = 2000000;
   self->priv->main_stacksize  = -1;
@@ -195,6 +208,10 @@ gvg_options_get_property (GObject    *object,
       g_value_set_boolean (value, self->priv->time_stamp != 0);
       break;
     
+    case PROP_VGDB:
+      g_value_set_boolean (value, self->priv->vgdb != 0);
+      break;
+    
     case PROP_NUM_CALLERS:
       g_value_set_uint (value, self->priv->num_callers);
       break;
@@ -241,6 +258,10 @@ gvg_options_set_property (GObject      *object,
       self->priv->time_stamp = g_value_get_boolean (value) != FALSE;
       break;
     
+    case PROP_VGDB:
+      self->priv->vgdb = g_value_get_boolean (value) != FALSE;
+      break;
+    
     case PROP_NUM_CALLERS:
       self->priv->num_callers = g_value_get_uint (value);
       break;
@@ -366,3 +387,36 @@ gvg_options_to_args (GvgOptions     *self,
   }
   g_free (props);
 }
+
+/* creates new options of the same type and with the same values as @self,
+ * e.g. to change some of them for a single run */
+GvgOptions *
+gvg_options_copy (GvgOptions *self)
+{
+  GObject      *copy;
+  guint         i;
+  guint         n_props;
+  GParamSpec  **props;
+  GObjectClass *object_class;
+  
+  g_return_val_if_fail (GVG_IS_OPTIONS (self), NULL);
+  
+  object_class = G_OBJECT_GET_CLASS (self);
+  copy = g_object_new (G_OBJECT_TYPE (self), NULL);
+  props = g_object_class_list_properties (object_class, &n_props);
+  for (i = 0; i < n_props; i++) {
+    GValue value = {0};
+    
+    if ((props[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+        (props[i]->flags & G_PARAM_CONSTRUCT_ONLY)) {
+      continue;
+    }
+    g_value_init (&value, props[i]->value_type);
+    g_object_get_property (G_OBJECT (self), props[i]->name, &value);
+    g_object_set_property (copy, props[i]->name, &value);
+    g_value_unset (&value);
+  }
+  g_free (props);
+  
+  return GVG_OPTIONS (copy);
+}
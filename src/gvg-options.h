@@ -58,6 +58,7 @@ GType         gvg_options_get_type      (void) G_GNUC_CONST;
 GvgOptions   *gvg_options_new           (void);
 void          gvg_options_to_args       (GvgOptions     *self,
                                          GvgArgsBuilder *builder);
+GvgOptions   *gvg_options_copy          (GvgOptions *self);
 
 
 G_END_DECLS
@@ -0,0 +1,368 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Keeps the last output of a program, line by line, in a fixed-size ring.
+ * 
+ * Each line is timestamped when it starts arriving and numbered by its
+ * position in the whole output, so other events (e.g. errors) can tell what
+ * the program was printing at the time by recording the number of lines
+ * received so far.
+ * 
+ * Line texts are stored contiguously in a ring of the size given at creation,
+ * so memory stays bounded however much the program writes.  When there is no
+ * more room, the oldest lines are dropped, or appended to the spill file if
+ * there is one, one "SECONDS STREAM TEXT" line each, SECONDS being relative
+ * to the log's creation.  Line N of the spill file is thus position N - 1.
+ */
+
+#include "gvg-output-log.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+
+/* longer lines are split, so that a single line can't fill the ring */
+#define MAX_LINE_LENGTH 4096
+
+#define N_STREAMS       (GVG_OUTPUT_STREAM_STDERR + 1)
+
+
+typedef struct _LogEntry LogEntry;
+
+struct _LogEntry
+{
+  gint64          time;
+  GvgOutputStream stream;
+  gsize           offset; /* of the text in the ring */
+  gsize           len;
+};
+
+struct _GvgOutputLog
+{
+  gchar          *data;
+  gsize           size;
+  gsize           tail;   /* where the next line's text goes */
+  GQueue          lines;  /* LogEntry, oldest first */
+  guint           first_position; /* of the oldest line in memory */
+  gint64          start_time;
+  
+  GOutputStream  *spill;
+  
+  /* lines being received, per stream */
+  GString        *partial[N_STREAMS];
+  gint64          partial_time[N_STREAMS];
+};
+
+
+/* @size is the size of the ring in bytes, and @spill_file if not %NULL a file
+ * to which write the lines dropped from it */
+GvgOutputLog *
+gvg_output_log_new (gsize         size,
+                    const gchar  *spill_file,
+                    GError      **error)
+{
+  GvgOutputLog  *self;
+  GOutputStream *spill = NULL;
+  guint          i;
+  
+  g_return_val_if_fail (size > 1, NULL);
+  
+  if (spill_file) {
+    GFile             *file = g_file_new_for_path (spill_file);
+    GFileOutputStream *stream;
+    
+    stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL,
+                             error);
+    g_object_unref (file);
+    if (! stream) {
+      return NULL;
+    }
+    spill = g_buffered_output_stream_new (G_OUTPUT_STREAM (stream));
+    g_object_unref (stream);
+  }
+  
+  self = g_slice_new (GvgOutputLog);
+  self->data            = g_malloc (size);
+  self->size            = size;
+  self->tail            = 0;
+  g_queue_init (&self->lines);
+  self->first_position  = 0;
+  self->start_time      = g_get_monotonic_time ();
+  self->spill           = spill;
+  for (i = 0; i < N_STREAMS; i++) {
+    self->partial[i]      = g_string_new (NULL);
+    self->partial_time[i] = 0;
+  }
+  
+  return self;
+}
+
+static void
+entry_free (LogEntry *entry)
+{
+  g_slice_free (LogEntry, entry);
+}
+
+void
+gvg_output_log_free (GvgOutputLog *self)
+{
+  guint i;
+  
+  g_return_if_fail (self != NULL);
+  
+  if (self->spill) {
+    GError *err = NULL;
+    
+    if (! g_output_stream_close (self->spill, NULL, &err)) {
+      g_warning ("failed to close output spill file: %s", err->message);
+      g_error_free (err);
+    }
+    g_object_unref (self->spill);
+  }
+  for (i = 0; i < N_STREAMS; i++) {
+    g_string_free (self->partial[i], TRUE);
+  }
+  g_queue_foreach (&self->lines, (GFunc) entry_free, NULL);
+  g_queue_clear (&self->lines);
+  g_free (self->data);
+  g_slice_free (GvgOutputLog, self);
+}
+
+/* writes @entry to the spill file.  on failure, the file is dropped and
+ * nothing more will be written */
+static void
+log_spill (GvgOutputLog *self,
+           LogEntry     *entry)
+{
+  gint64    time = entry->time - self->start_time;
+  gchar    *line;
+  GError   *err  = NULL;
+  
+  line = g_strdup_printf ("%" G_GINT64_FORMAT ".%06d %s %s\n",
+                          time / G_USEC_PER_SEC,
+                          (gint) (time % G_USEC_PER_SEC),
+                          entry->stream == GVG_OUTPUT_STREAM_STDERR ? "err" : "out",
+                          self->data + entry->offset);
+  if (! g_output_stream_write_all (self->spill, line, strlen (line), NULL,
+                                   NULL, &err)) {
+    g_warning ("failed to write output spill file: %s", err->message);
+    g_error_free (err);
+    g_object_unref (self->spill);
+    self->spill = NULL;
+  }
+  g_free (line);
+}
+
+/* drops the oldest line */
+static void
+log_evict (GvgOutputLog *self)
+{
+  LogEntry *entry = g_queue_pop_head (&self->lines);
+  
+  if (self->spill) {
+    log_spill (self, entry);
+  }
+  entry_free (entry);
+  self->first_position ++;
+  if (g_queue_is_empty (&self->lines)) {
+    self->tail = 0;
+  }
+}
+
+/* whether [@offset, @offset + @len) of the ring is free */
+static gboolean
+log_has_room (GvgOutputLog *self,
+              gsize         offset,
+              gsize         len)
+{
+  LogEntry *oldest = g_queue_peek_head (&self->lines);
+  
+  if (! oldest) {
+    return TRUE;
+  } else if (oldest->offset < self->tail) {
+    /* used space doesn't wrap, there's room after it and before it */
+    return offset == self->tail || offset + len <= oldest->offset;
+  } else {
+    /* used space wraps, there's only room between its end and its start */
+    return offset >= self->tail && offset + len <= oldest->offset;
+  }
+}
+
+static void
+log_add_line (GvgOutputLog    *self,
+              GvgOutputStream  stream,
+              gint64           time,
+              const gchar     *text,
+              gsize            len)
+{
+  LogEntry *entry;
+  gsize     need = len + 1; /* with a nul terminator */
+  gsize     offset;
+  
+  /* texts are kept contiguous, so wrap early if it doesn't fit at the end */
+  for (;;) {
+    offset = self->tail + need <= self->size ? self->tail : 0;
+    if (log_has_room (self, offset, need)) {
+      break;
+    }
+    log_evict (self);
+  }
+  
+  memcpy (self->data + offset, text, len);
+  self->data[offset + len] = 0;
+  self->tail = offset + need;
+  
+  entry = g_slice_new (LogEntry);
+  entry->time   = time;
+  entry->stream = stream;
+  entry->offset = offset;
+  entry->len    = len;
+  g_queue_push_tail (&self->lines, entry);
+}
+
+/* adds data received on @stream, lines being complete at each newline */
+void
+gvg_output_log_append (GvgOutputLog    *self,
+                       GvgOutputStream  stream,
+                       const gchar     *data,
+                       gsize            len)
+{
+  GString  *partial;
+  gsize     max_len;
+  
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (stream < N_STREAMS);
+  
+  partial = self->partial[stream];
+  max_len = MIN (MAX_LINE_LENGTH, self->size - 1);
+  while (len > 0) {
+    const gchar  *nl = memchr (data, '\n', len);
+    gsize         n  = nl ? (gsize) (nl - data) : len;
+    
+    if (partial->len == 0) {
+      self->partial_time[stream] = g_get_monotonic_time ();
+      if (nl && n <= max_len) {
+        /* a whole line, no need to copy it twice */
+        log_add_line (self, stream, self->partial_time[stream], data, n);
+        data += n + 1;
+        len -= n + 1;
+        continue;
+      }
+    }
+    
+    if (n > max_len - partial->len) {
+      n = max_len - partial->len;
+      nl = NULL;
+    }
+    g_string_append_len (partial, data, (gssize) n);
+    data += n;
+    len -= n;
+    if (nl) {
+      data++;
+      len--;
+    }
+    if (nl || partial->len >= max_len) {
+      log_add_line (self, stream, self->partial_time[stream],
+                    partial->str, partial->len);
+      g_string_truncate (partial, 0);
+    }
+  }
+}
+
+/* completes the lines being received, e.g. once the streams are closed */
+void
+gvg_output_log_flush (GvgOutputLog *self)
+{
+  guint i;
+  
+  g_return_if_fail (self != NULL);
+  
+  for (i = 0; i < N_STREAMS; i++) {
+    if (self->partial[i]->len > 0) {
+      log_add_line (self, i, self->partial_time[i],
+                    self->partial[i]->str, self->partial[i]->len);
+      g_string_truncate (self->partial[i], 0);
+    }
+  }
+}
+
+/* gets the number of complete lines received so far, which is also the
+ * position of the next one */
+guint
+gvg_output_log_get_n_lines (GvgOutputLog *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->first_position + g_queue_get_length (&self->lines);
+}
+
+/* gets the position of the oldest line still in memory */
+guint
+gvg_output_log_get_first_position (GvgOutputLog *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->first_position;
+}
+
+/* gets the monotonic time the log was created at, which spilled lines are
+ * relative to */
+gint64
+gvg_output_log_get_start_time (GvgOutputLog *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->start_time;
+}
+
+/* calls @func for each line in memory from position @from onwards */
+void
+gvg_output_log_foreach (GvgOutputLog     *self,
+                        guint             from,
+                        GvgOutputLogFunc  func,
+                        gpointer          user_data)
+{
+  GList  *item;
+  guint   position;
+  
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (func != NULL);
+  
+  position = self->first_position;
+  for (item = self->lines.head; item; item = item->next, position++) {
+    LogEntry       *entry = item->data;
+    GvgOutputLine   line;
+    
+    if (position < from) {
+      continue;
+    }
+    line.position = position;
+    line.time     = entry->time;
+    line.stream   = entry->stream;
+    line.text     = self->data + entry->offset;
+    line.len      = entry->len;
+    if (! func (&line, user_data)) {
+      break;
+    }
+  }
+}
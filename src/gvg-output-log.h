@@ -0,0 +1,73 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_OUTPUT_LOG
+#define H_GVG_OUTPUT_LOG
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef enum
+{
+  GVG_OUTPUT_STREAM_STDOUT,
+  GVG_OUTPUT_STREAM_STDERR
+} GvgOutputStream;
+
+typedef struct _GvgOutputLog  GvgOutputLog;
+typedef struct _GvgOutputLine GvgOutputLine;
+
+struct _GvgOutputLine
+{
+  guint           position; /* index of the line in the whole output */
+  gint64          time;     /* monotonic time at which it started arriving */
+  GvgOutputStream stream;
+  const gchar    *text;     /* without the newline, nul-terminated */
+  gsize           len;
+};
+
+/* returns %FALSE to stop iterating */
+typedef gboolean  (*GvgOutputLogFunc) (const GvgOutputLine *line,
+                                       gpointer             user_data);
+
+
+GvgOutputLog   *gvg_output_log_new                (gsize         size,
+                                                   const gchar  *spill_file,
+                                                   GError      **error);
+void            gvg_output_log_free               (GvgOutputLog *log);
+void            gvg_output_log_append             (GvgOutputLog    *log,
+                                                   GvgOutputStream  stream,
+                                                   const gchar     *data,
+                                                   gsize            len);
+void            gvg_output_log_flush              (GvgOutputLog *log);
+guint           gvg_output_log_get_n_lines        (GvgOutputLog *log);
+guint           gvg_output_log_get_first_position (GvgOutputLog *log);
+gint64          gvg_output_log_get_start_time     (GvgOutputLog *log);
+void            gvg_output_log_foreach            (GvgOutputLog     *log,
+                                                   guint             from,
+                                                   GvgOutputLogFunc  func,
+                                                   gpointer          user_data);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,283 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Reads a pipe through a growable ring buffer.
+ * 
+ * The pipe is set non-blocking and drained with as few read() calls as
+ * possible: each call fills all the free space of the buffer at once, and the
+ * buffer grows when a read fills it completely.  A short read means the pipe
+ * is empty, so there's no need to poll() between reads.  The data is then
+ * handed to the consumer directly from the buffer, without any copy.
+ * 
+ * When the kernel allows it, the pipe's own buffer is also enlarged so the
+ * writer can get further before we have to wake up.
+ */
+
+#include "gvg-pipe-reader.h"
+
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+
+#define PIPE_SIZE           (1024 * 1024)
+#define BUFFER_MIN_SIZE     (64 * 1024)
+#define BUFFER_MAX_SIZE     (16 * 1024 * 1024)
+
+
+struct _GvgPipeReader
+{
+  gint    fd;
+  
+  gchar  *data;
+  gsize   size;
+  gsize   head;   /* position of the first readable byte */
+  gsize   len;    /* number of readable bytes */
+  
+  guint64 n_bytes;
+  guint64 n_reads;
+};
+
+
+/* tries to enlarge the pipe's buffer, returns its actual size */
+static gsize
+set_pipe_size (gint   fd,
+               gsize  size)
+{
+#ifdef F_SETPIPE_SZ
+  gint ret;
+  
+  ret = fcntl (fd, F_SETPIPE_SZ, (gint) size);
+  if (ret < 0 && errno == EPERM) {
+    gchar *contents;
+    
+    /* unprivileged users are limited to pipe-max-size */
+    if (g_file_get_contents ("/proc/sys/fs/pipe-max-size", &contents,
+                             NULL, NULL)) {
+      guint64 max_size = g_ascii_strtoull (contents, NULL, 10);
+      
+      if (max_size > 0 && max_size < size) {
+        ret = fcntl (fd, F_SETPIPE_SZ, (gint) max_size);
+      }
+      g_free (contents);
+    }
+  }
+  if (ret < 0) {
+    ret = fcntl (fd, F_GETPIPE_SZ);
+  }
+  
+  return ret > 0 ? (gsize) ret : 0;
+#else
+  return 0;
+#endif
+}
+
+/* @fd must stay open as long as the reader is used */
+GvgPipeReader *
+gvg_pipe_reader_new (gint fd)
+{
+  GvgPipeReader  *self;
+  gint            flags;
+  
+  g_return_val_if_fail (fd >= 0, NULL);
+  
+  flags = fcntl (fd, F_GETFL);
+  if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    g_warning ("failed to make pipe non-blocking: %s", g_strerror (errno));
+  }
+  
+  self = g_slice_new (GvgPipeReader);
+  self->fd      = fd;
+  /* make sure we can empty the whole pipe at once */
+  self->size    = CLAMP (set_pipe_size (fd, PIPE_SIZE),
+                         BUFFER_MIN_SIZE, BUFFER_MAX_SIZE);
+  self->data    = g_malloc (self->size);
+  self->head    = 0;
+  self->len     = 0;
+  self->n_bytes = 0;
+  self->n_reads = 0;
+  
+  return self;
+}
+
+void
+gvg_pipe_reader_free (GvgPipeReader *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_free (self->data);
+  g_slice_free (GvgPipeReader, self);
+}
+
+/* doubles the buffer size, keeping unconsumed data */
+static void
+reader_grow (GvgPipeReader *self)
+{
+  gsize   new_size = MIN (self->size * 2, BUFFER_MAX_SIZE);
+  gchar  *data;
+  
+  if (new_size <= self->size) {
+    return;
+  }
+  
+  if (self->head + self->len <= self->size) {
+    data = g_realloc (self->data, new_size);
+  } else {
+    gsize first = self->size - self->head;
+    
+    /* the data wraps, so unwrap it in the new buffer */
+    data = g_malloc (new_size);
+    memcpy (data, self->data + self->head, first);
+    memcpy (data + first, self->data, self->len - first);
+    g_free (self->data);
+    self->head = 0;
+  }
+  self->data = data;
+  self->size = new_size;
+}
+
+/* reads as much as possible in the free space, in a single call */
+static gssize
+reader_fill (GvgPipeReader *self)
+{
+  struct iovec  iov[2];
+  gint          n_iov = 0;
+  gsize         tail  = (self->head + self->len) % self->size;
+  gssize        ret;
+  
+  if (self->len == self->size) {
+    return -1;
+  } else if (tail >= self->head) {
+    iov[n_iov].iov_base = self->data + tail;
+    iov[n_iov].iov_len  = self->size - tail;
+    n_iov++;
+    if (self->head > 0) {
+      iov[n_iov].iov_base = self->data;
+      iov[n_iov].iov_len  = self->head;
+      n_iov++;
+    }
+  } else {
+    iov[n_iov].iov_base = self->data + tail;
+    iov[n_iov].iov_len  = self->head - tail;
+    n_iov++;
+  }
+  
+  do {
+    ret = readv (self->fd, iov, n_iov);
+    self->n_reads++;
+  } while (ret < 0 && errno == EINTR);
+  
+  if (ret > 0) {
+    self->len += (gsize) ret;
+    self->n_bytes += (guint64) ret;
+  }
+  
+  return ret;
+}
+
+/* hands readable data to @func, span by span */
+static void
+reader_consume (GvgPipeReader     *self,
+                GvgPipeReaderFunc  func,
+                gpointer           user_data)
+{
+  while (self->len > 0) {
+    gsize span = MIN (self->len, self->size - self->head);
+    gsize n;
+    
+    n = func (self->data + self->head, span, user_data);
+    g_warn_if_fail (n <= span);
+    n = MIN (n, span);
+    self->head = (self->head + n) % self->size;
+    self->len -= n;
+    if (n < span) {
+      break;
+    }
+  }
+  if (self->len == 0) {
+    /* start over to get the largest contiguous free space */
+    self->head = 0;
+  }
+}
+
+/* reads all data currently available in the pipe and gives it to @func.
+ * returns %FALSE when the pipe reached end of file or failed */
+gboolean
+gvg_pipe_reader_drain (GvgPipeReader     *self,
+                       GvgPipeReaderFunc  func,
+                       gpointer           user_data)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+  
+  for (;;) {
+    gsize   room = self->size - self->len;
+    gssize  ret;
+    
+    if (room == 0) {
+      reader_grow (self);
+      room = self->size - self->len;
+      if (room == 0) {
+        g_warning ("pipe data isn't consumed, giving up");
+        return FALSE;
+      }
+    }
+    
+    ret = reader_fill (self);
+    if (ret < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return TRUE;
+      }
+      g_warning ("failed to read pipe: %s", g_strerror (errno));
+      return FALSE;
+    } else if (ret == 0) {
+      return FALSE;
+    }
+    
+    reader_consume (self, func, user_data);
+    if ((gsize) ret < room) {
+      /* short read, the pipe is empty */
+      return TRUE;
+    } else {
+      /* the data didn't fit, use a larger buffer next time */
+      reader_grow (self);
+    }
+  }
+}
+
+void
+gvg_pipe_reader_get_stats (GvgPipeReader *self,
+                           guint64       *n_bytes,
+                           guint64       *n_reads)
+{
+  g_return_if_fail (self != NULL);
+  
+  if (n_bytes) {
+    *n_bytes = self->n_bytes;
+  }
+  if (n_reads) {
+    *n_reads = self->n_reads;
+  }
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_PIPE_READER
+#define H_GVG_PIPE_READER
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgPipeReader GvgPipeReader;
+
+/* called with contiguous spans of read data, returns how many bytes of it
+ * were consumed.  unconsumed data is given again with the next span */
+typedef gsize (*GvgPipeReaderFunc) (const gchar  *data,
+                                    gsize         len,
+                                    gpointer      user_data);
+
+
+GvgPipeReader  *gvg_pipe_reader_new       (gint fd);
+void            gvg_pipe_reader_free      (GvgPipeReader *reader);
+gboolean        gvg_pipe_reader_drain     (GvgPipeReader     *reader,
+                                           GvgPipeReaderFunc  func,
+                                           gpointer           user_data);
+void            gvg_pipe_reader_get_stats (GvgPipeReader *reader,
+                                           guint64       *n_bytes,
+                                           guint64       *n_reads);
+
+
+G_END_DECLS
+
+#endif /* guard */
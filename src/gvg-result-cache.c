@@ -0,0 +1,963 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Persistent cache of run results, so an unchanged program doesn't need to be
+ * checked again.
+ * 
+ * A run is described by a key file listing everything its results depend
+ * on: the program's resolved path and identity, the identity of each shared
+ * library it links to (as listed by ldd), its arguments, the Valgrind binary
+ * and version, the Valgrind options including those it reads from its option
+ * files and environment, and the identity of the suppression files.  A
+ * file's identity is its GNU build-id when it has one, and the SHA-256 of its
+ * contents otherwise.  The cache key is the SHA-256 of that description.
+ * Describing a run reads all these files, so it can be done in a thread with
+ * gvg_result_cache_describe_async().
+ * 
+ * Each entry is made of three files in the cache directory: KEY.xml.gz, the
+ * raw XML output as saved by GvgXmlJournal, its timing file, and KEY.info,
+ * the description the key was computed from plus when it was created.  An
+ * entry is only ever removed explicitly, with gvg_result_cache_invalidate()
+ * or gvg_result_cache_clear(), and the info files tell what each entry is
+ * for.
+ */
+
+#include "gvg-result-cache.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <elf.h>
+
+
+#define RESULTS_SUFFIX  ".xml.gz"
+#define PART_SUFFIX     ".part"
+#define TIMING_SUFFIX   ".timing"
+#define INFO_SUFFIX     ".info"
+
+#define GROUP_RUN       "run"
+#define GROUP_CACHE     "cache"
+
+
+struct _GvgResultCache
+{
+  gchar  *dir;
+};
+
+
+/* @dir is the directory holding the cache, or %NULL for the default one in
+ * the user's cache directory */
+GvgResultCache *
+gvg_result_cache_new (const gchar *dir)
+{
+  GvgResultCache *self;
+  
+  self = g_slice_new (GvgResultCache);
+  if (dir) {
+    self->dir = g_strdup (dir);
+  } else {
+    self->dir = g_build_filename (g_get_user_cache_dir (), "gvg", "results",
+                                  NULL);
+  }
+  
+  return self;
+}
+
+void
+gvg_result_cache_free (GvgResultCache *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_free (self->dir);
+  g_slice_free (GvgResultCache, self);
+}
+
+const gchar *
+gvg_result_cache_get_dir (GvgResultCache *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  
+  return self->dir;
+}
+
+/* finds the GNU build-id note in the notes at @data */
+static gchar *
+find_build_id_note (const guchar *data,
+                    gsize         len)
+{
+  gsize pos = 0;
+  
+  /* 32 and 64 bit notes have the same layout */
+  while (len - pos >= sizeof (Elf32_Nhdr)) {
+    const Elf32_Nhdr *nhdr      = (const Elf32_Nhdr *) (data + pos);
+    gsize             name_size = (nhdr->n_namesz + 3) & ~ (gsize) 3;
+    gsize             desc_size = (nhdr->n_descsz + 3) & ~ (gsize) 3;
+    const guchar     *name      = data + pos + sizeof *nhdr;
+    
+    pos += sizeof *nhdr;
+    if (name_size > len - pos || desc_size > len - pos - name_size) {
+      break;
+    }
+    if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+        memcmp (name, "GNU", 4) == 0 && nhdr->n_descsz > 0) {
+      const guchar *desc = name + name_size;
+      GString      *id   = g_string_new (NULL);
+      guint         i;
+      
+      for (i = 0; i < nhdr->n_descsz; i++) {
+        g_string_append_printf (id, "%02x", desc[i]);
+      }
+      return g_string_free (id, FALSE);
+    }
+    pos += name_size + desc_size;
+  }
+  
+  return NULL;
+}
+
+/* reads the GNU build-id of the ELF file at @data, if it's a native one */
+static gchar *
+read_build_id (const guchar *data,
+               gsize         len)
+{
+  guint64 phoff;
+  guint   phnum;
+  guint   phentsize;
+  guint   i;
+  
+  if (len < EI_NIDENT || memcmp (data, ELFMAG, SELFMAG) != 0 ||
+      data[EI_DATA] != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? ELFDATA2LSB
+                                                         : ELFDATA2MSB)) {
+    return NULL;
+  }
+  
+  if (data[EI_CLASS] == ELFCLASS64 && len >= sizeof (Elf64_Ehdr)) {
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *) data;
+    
+    phoff = ehdr->e_phoff;
+    phnum = ehdr->e_phnum;
+    phentsize = ehdr->e_phentsize;
+  } else if (data[EI_CLASS] == ELFCLASS32 && len >= sizeof (Elf32_Ehdr)) {
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *) data;
+    
+    phoff = ehdr->e_phoff;
+    phnum = ehdr->e_phnum;
+    phentsize = ehdr->e_phentsize;
+  } else {
+    return NULL;
+  }
+  
+  for (i = 0; i < phnum; i++) {
+    guint64 off = phoff + (guint64) i * phentsize;
+    guint64 type;
+    guint64 offset;
+    guint64 size;
+    gchar  *id;
+    
+    if (off > len || phentsize > len - off) {
+      break;
+    }
+    if (data[EI_CLASS] == ELFCLASS64) {
+      const Elf64_Phdr *phdr = (const Elf64_Phdr *) (data + off);
+      
+      type = phdr->p_type;
+      offset = phdr->p_offset;
+      size = phdr->p_filesz;
+    } else {
+      const Elf32_Phdr *phdr = (const Elf32_Phdr *) (data + off);
+      
+      type = phdr->p_type;
+      offset = phdr->p_offset;
+      size = phdr->p_filesz;
+    }
+    if (type == PT_NOTE && offset <= len && size <= len - offset &&
+        (id = find_build_id_note (data + offset, (gsize) size)) != NULL) {
+      return id;
+    }
+  }
+  
+  return NULL;
+}
+
+/* gets something identifying the contents of @filename */
+static gchar *
+identify_file (const gchar  *filename,
+               GError      **error)
+{
+  GMappedFile  *file;
+  const guchar *data;
+  gsize         len;
+  gchar        *id;
+  
+  file = g_mapped_file_new (filename, FALSE, error);
+  if (! file) {
+    return NULL;
+  }
+  data = (const guchar *) g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
+  id = data ? read_build_id (data, len) : NULL;
+  if (id) {
+    gchar *tmp = id;
+    
+    id = g_strconcat ("build-id:", tmp, NULL);
+    g_free (tmp);
+  } else {
+    gchar *sum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, len);
+    
+    id = g_strconcat ("sha256:", sum, NULL);
+    g_free (sum);
+  }
+  g_mapped_file_unref (file);
+  
+  return id;
+}
+
+/* gets the absolute path of the program @argv0 would run */
+static gchar *
+resolve_program (const gchar  *argv0,
+                 GError      **error)
+{
+  gchar *path;
+  gchar *real;
+  
+  if (strchr (argv0, G_DIR_SEPARATOR)) {
+    path = g_strdup (argv0);
+  } else {
+    path = g_find_program_in_path (argv0);
+  }
+  real = path ? realpath (path, NULL) : NULL;
+  g_free (path);
+  if (! real) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                 "cannot find program \"%s\"", argv0);
+    return NULL;
+  }
+  /* realpath() uses malloc() */
+  path = g_strdup (real);
+  free (real);
+  
+  return path;
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (* (const gchar *const *) a, * (const gchar *const *) b);
+}
+
+/* lists the shared libraries @program links to, sorted.  programs that
+ * aren't dynamically linked, and failures to find out, give an empty list */
+static GPtrArray *
+list_libraries (const gchar *program)
+{
+  GPtrArray    *libraries = g_ptr_array_new_with_free_func (g_free);
+  const gchar  *argv[]    = { "ldd", program, NULL };
+  gchar        *output    = NULL;
+  gint          status;
+  GError       *err       = NULL;
+  
+  if (! g_spawn_sync (NULL, (gchar **) argv, NULL,
+                      G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                      NULL, NULL, &output, NULL, &status, &err)) {
+    g_debug ("failed to list libraries of %s: %s", program, err->message);
+    g_error_free (err);
+  } else if (status == 0) {
+    gchar **lines = g_strsplit (output, "\n", -1);
+    guint   i;
+    
+    /* lines are either "NAME => PATH (ADDRESS)" or "PATH (ADDRESS)", and
+     * virtual libraries have no path */
+    for (i = 0; lines[i]; i++) {
+      gchar *path = strstr (lines[i], "=>");
+      gchar *end;
+      
+      path = g_strchug (path ? path + 2 : lines[i]);
+      end = strstr (path, " (");
+      if (end) {
+        *end = 0;
+      }
+      if (g_path_is_absolute (path)) {
+        g_ptr_array_add (libraries, g_strdup (path));
+      }
+    }
+    g_strfreev (lines);
+  }
+  g_free (output);
+  g_ptr_array_sort (libraries, compare_strings);
+  
+  return libraries;
+}
+
+/* gets the options Valgrind reads besides its command line, in the order it
+ * applies them */
+static gchar *
+get_extra_options (void)
+{
+  GString      *options = g_string_new (NULL);
+  gchar        *files[] = {
+    g_build_filename (g_get_home_dir (), ".valgrindrc", NULL),
+    NULL,
+    g_strdup ("./.valgrindrc")
+  };
+  guint         i;
+  
+  for (i = 0; i < G_N_ELEMENTS (files); i++) {
+    gchar *contents = NULL;
+    
+    if (! files[i]) {
+      g_string_append (options, g_getenv ("VALGRIND_OPTS"));
+    } else if (g_file_get_contents (files[i], &contents, NULL, NULL)) {
+      g_string_append (options, contents);
+    }
+    g_string_append_c (options, '\n');
+    g_free (contents);
+    g_free (files[i]);
+  }
+  
+  return g_string_free (options, FALSE);
+}
+
+/* finds the suppression files Valgrind reads by default.  they are installed
+ * along with its tools, which it finds from $VALGRIND_LIB or a directory
+ * chosen when it was built, so the usual ones relative to the binary are
+ * tried */
+static gchar *
+find_default_suppressions (GvgValgrindInfo *valgrind)
+{
+  const gchar  *libdirs[] = { "libexec", "lib", "lib64" };
+  gchar        *prefix;
+  gchar        *bindir;
+  gchar        *filename = NULL;
+  guint         i;
+  
+  if (g_getenv ("VALGRIND_LIB")) {
+    return g_build_filename (g_getenv ("VALGRIND_LIB"), "default.supp", NULL);
+  }
+  
+  bindir = g_path_get_dirname (gvg_valgrind_info_get_path (valgrind));
+  prefix = g_path_get_dirname (bindir);
+  for (i = 0; ! filename && i < G_N_ELEMENTS (libdirs); i++) {
+    filename = g_build_filename (prefix, libdirs[i], "valgrind", "default.supp",
+                                 NULL);
+    if (! g_file_test (filename, G_FILE_TEST_IS_REGULAR)) {
+      g_free (filename);
+      filename = NULL;
+    }
+  }
+  g_free (prefix);
+  g_free (bindir);
+  
+  return filename;
+}
+
+/* lists the suppression files given with --suppressions in @options */
+static void
+add_suppressions (GPtrArray    *suppressions,
+                  const gchar **options)
+{
+  guint i;
+  
+  for (i = 0; options[i]; i++) {
+    if (g_str_has_prefix (options[i], "--suppressions=")) {
+      g_ptr_array_add (suppressions,
+                       g_strdup (options[i] + strlen ("--suppressions=")));
+    }
+  }
+}
+
+/*
+ * describes a run of @program_argv with Valgrind options @option_args (as
+ * built by gvg_options_to_args()) by Valgrind @valgrind, for
+ * gvg_result_cache_get_key().  @valgrind may be %NULL when only the program
+ * and its libraries matter.  fails if the program can't be found or read.
+ * may be called from any thread
+ */
+GKeyFile *
+gvg_result_cache_describe (const gchar     **program_argv,
+                           const gchar     **option_args,
+                           GvgValgrindInfo  *valgrind,
+                           GError          **error)
+{
+  GKeyFile   *description;
+  GPtrArray  *libraries;
+  GPtrArray  *library_ids;
+  gchar      *program;
+  gchar      *program_id;
+  guint       i;
+  
+  g_return_val_if_fail (program_argv != NULL && program_argv[0] != NULL, NULL);
+  g_return_val_if_fail (option_args != NULL, NULL);
+  
+  program = resolve_program (program_argv[0], error);
+  if (! program) {
+    return NULL;
+  }
+  program_id = identify_file (program, error);
+  if (! program_id) {
+    g_free (program);
+    return NULL;
+  }
+  
+  libraries = list_libraries (program);
+  library_ids = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; i < libraries->len; i++) {
+    gchar *id = identify_file (g_ptr_array_index (libraries, i), NULL);
+    
+    g_ptr_array_add (library_ids, id ? id : g_strdup ("missing"));
+  }
+  
+  description = g_key_file_new ();
+  g_key_file_set_string (description, GROUP_RUN, "program", program);
+  g_key_file_set_string (description, GROUP_RUN, "program-id", program_id);
+  g_key_file_set_string_list (description, GROUP_RUN, "argv", program_argv,
+                              g_strv_length ((gchar **) program_argv));
+  g_key_file_set_string_list (description, GROUP_RUN, "options", option_args,
+                              g_strv_length ((gchar **) option_args));
+  g_key_file_set_string_list (description, GROUP_RUN, "libraries",
+                              (const gchar **) libraries->pdata,
+                              libraries->len);
+  g_key_file_set_string_list (description, GROUP_RUN, "library-ids",
+                              (const gchar **) library_ids->pdata,
+                              library_ids->len);
+  
+  if (valgrind) {
+    const gchar  *path = gvg_valgrind_info_get_path (valgrind);
+    gchar        *valgrind_id = identify_file (path, NULL);
+    gchar        *extra_options = get_extra_options ();
+    gchar       **extra_args = g_strsplit_set (extra_options, " \t\n", -1);
+    gchar        *default_suppressions = find_default_suppressions (valgrind);
+    GPtrArray    *suppressions = g_ptr_array_new_with_free_func (g_free);
+    GPtrArray    *suppression_ids = g_ptr_array_new_with_free_func (g_free);
+    
+    if (default_suppressions) {
+      g_ptr_array_add (suppressions, default_suppressions);
+    }
+    add_suppressions (suppressions, (const gchar **) extra_args);
+    add_suppressions (suppressions, option_args);
+    for (i = 0; i < suppressions->len; i++) {
+      gchar *id = identify_file (g_ptr_array_index (suppressions, i), NULL);
+      
+      g_ptr_array_add (suppression_ids, id ? id : g_strdup ("missing"));
+    }
+    
+    g_key_file_set_string (description, GROUP_RUN, "valgrind", path);
+    g_key_file_set_string (description, GROUP_RUN, "valgrind-id",
+                           valgrind_id ? valgrind_id : "missing");
+    g_key_file_set_string (description, GROUP_RUN, "valgrind-version",
+                           gvg_valgrind_info_get_version (valgrind));
+    g_key_file_set_string (description, GROUP_RUN, "extra-options",
+                           g_strstrip (extra_options));
+    g_key_file_set_string_list (description, GROUP_RUN, "suppressions",
+                                (const gchar **) suppressions->pdata,
+                                suppressions->len);
+    g_key_file_set_string_list (description, GROUP_RUN, "suppression-ids",
+                                (const gchar **) suppression_ids->pdata,
+                                suppression_ids->len);
+    
+    g_ptr_array_free (suppression_ids, TRUE);
+    g_ptr_array_free (suppressions, TRUE);
+    g_strfreev (extra_args);
+    g_free (extra_options);
+    g_free (valgrind_id);
+  }
+  
+  g_ptr_array_free (library_ids, TRUE);
+  g_ptr_array_free (libraries, TRUE);
+  g_free (program_id);
+  g_free (program);
+  
+  return description;
+}
+
+typedef struct _DescribeData DescribeData;
+
+struct _DescribeData
+{
+  gchar           **program_argv;
+  gchar           **option_args;
+  GvgValgrindInfo  *valgrind;
+  GKeyFile         *description;
+};
+
+static void
+describe_data_free (DescribeData *data)
+{
+  g_strfreev (data->program_argv);
+  g_strfreev (data->option_args);
+  if (data->description) {
+    g_key_file_free (data->description);
+  }
+  g_slice_free (DescribeData, data);
+}
+
+static void
+describe_thread (GSimpleAsyncResult *result,
+                 GObject            *object,
+                 GCancellable       *cancellable)
+{
+  DescribeData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GError       *err = NULL;
+  
+  data->description = gvg_result_cache_describe ((const gchar **) data->program_argv,
+                                                 (const gchar **) data->option_args,
+                                                 data->valgrind, &err);
+  if (! data->description) {
+    g_simple_async_result_take_error (result, err);
+  }
+}
+
+/* like gvg_result_cache_describe(), but in a thread so reading the files
+ * doesn't block.  @callback should call gvg_result_cache_describe_finish() */
+void
+gvg_result_cache_describe_async (const gchar         **program_argv,
+                                 const gchar         **option_args,
+                                 GvgValgrindInfo      *valgrind,
+                                 GCancellable         *cancellable,
+                                 GAsyncReadyCallback   callback,
+                                 gpointer              user_data)
+{
+  GSimpleAsyncResult *result;
+  DescribeData       *data;
+  
+  g_return_if_fail (program_argv != NULL && program_argv[0] != NULL);
+  g_return_if_fail (option_args != NULL);
+  
+  data = g_slice_new (DescribeData);
+  data->program_argv  = g_strdupv ((gchar **) program_argv);
+  data->option_args   = g_strdupv ((gchar **) option_args);
+  data->valgrind      = valgrind;
+  data->description   = NULL;
+  
+  result = g_simple_async_result_new (NULL, callback, user_data,
+                                      gvg_result_cache_describe_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+                                             (GDestroyNotify) describe_data_free);
+  g_simple_async_result_set_check_cancellable (result, cancellable);
+  g_simple_async_result_run_in_thread (result, describe_thread,
+                                       G_PRIORITY_DEFAULT, cancellable);
+  g_object_unref (result);
+}
+
+/* gets the description gvg_result_cache_describe_async() built, or %NULL if
+ * it failed or was cancelled */
+GKeyFile *
+gvg_result_cache_describe_finish (GAsyncResult  *result,
+                                  GError       **error)
+{
+  DescribeData *data;
+  GKeyFile     *description;
+  
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+                                                        gvg_result_cache_describe_async),
+                        NULL);
+  
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error)) {
+    return NULL;
+  }
+  
+  data = g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+  description = data->description;
+  data->description = NULL;
+  
+  return description;
+}
+
+/*
+ * lists the files a run of @program_argv depends on, as in its description:
+ * the program's resolved path, followed by the shared libraries it links to
+ * if @libraries is %TRUE.  only listing the libraries takes a while.  fails if
+ * the program can't be found.  may be called from any thread
+ */
+gchar **
+gvg_result_cache_list_files (const gchar **program_argv,
+                             gboolean      libraries,
+                             GError      **error)
+{
+  GPtrArray  *files;
+  gchar      *program;
+  
+  g_return_val_if_fail (program_argv != NULL && program_argv[0] != NULL, NULL);
+  
+  program = resolve_program (program_argv[0], error);
+  if (! program) {
+    return NULL;
+  }
+  
+  files = g_ptr_array_new ();
+  g_ptr_array_add (files, program);
+  if (libraries) {
+    GPtrArray  *library_list = list_libraries (program);
+    guint       i;
+    
+    /* the paths now belong to @files */
+    g_ptr_array_set_free_func (library_list, NULL);
+    for (i = 0; i < library_list->len; i++) {
+      g_ptr_array_add (files, g_ptr_array_index (library_list, i));
+    }
+    g_ptr_array_free (library_list, TRUE);
+  }
+  g_ptr_array_add (files, NULL);
+  
+  return (gchar **) g_ptr_array_free (files, FALSE);
+}
+
+static void
+list_files_thread (GSimpleAsyncResult *result,
+                   GObject            *object,
+                   GCancellable       *cancellable)
+{
+  const gchar **program_argv = g_simple_async_result_get_op_res_gpointer (result);
+  gchar       **files;
+  GError       *err = NULL;
+  
+  files = gvg_result_cache_list_files (program_argv, TRUE, &err);
+  if (! files) {
+    g_simple_async_result_take_error (result, err);
+  } else {
+    g_simple_async_result_set_op_res_gpointer (result, files,
+                                               (GDestroyNotify) g_strfreev);
+  }
+}
+
+/* like gvg_result_cache_list_files() with the libraries, but in a thread.
+ * @callback should call gvg_result_cache_list_files_finish() */
+void
+gvg_result_cache_list_files_async (const gchar         **program_argv,
+                                   GCancellable         *cancellable,
+                                   GAsyncReadyCallback   callback,
+                                   gpointer              user_data)
+{
+  GSimpleAsyncResult *result;
+  
+  g_return_if_fail (program_argv != NULL && program_argv[0] != NULL);
+  
+  result = g_simple_async_result_new (NULL, callback, user_data,
+                                      gvg_result_cache_list_files_async);
+  g_simple_async_result_set_op_res_gpointer (result,
+                                             g_strdupv ((gchar **) program_argv),
+                                             (GDestroyNotify) g_strfreev);
+  g_simple_async_result_set_check_cancellable (result, cancellable);
+  g_simple_async_result_run_in_thread (result, list_files_thread,
+                                       G_PRIORITY_DEFAULT, cancellable);
+  g_object_unref (result);
+}
+
+/* gets the files gvg_result_cache_list_files_async() listed, or %NULL if it
+ * failed or was cancelled */
+gchar **
+gvg_result_cache_list_files_finish (GAsyncResult  *result,
+                                    GError       **error)
+{
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+                                                        gvg_result_cache_list_files_async),
+                        NULL);
+  
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error)) {
+    return NULL;
+  }
+  
+  return g_strdupv (g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result)));
+}
+
+/* gets the cache key of a run from its description */
+gchar *
+gvg_result_cache_get_key (GKeyFile *description)
+{
+  gchar  *data;
+  gsize   len;
+  gchar  *key;
+  
+  g_return_val_if_fail (description != NULL, NULL);
+  
+  data = g_key_file_to_data (description, &len, NULL);
+  key = g_compute_checksum_for_string (G_CHECKSUM_SHA256, data, (gssize) len);
+  g_free (data);
+  
+  return key;
+}
+
+static gchar *
+entry_filename (GvgResultCache *self,
+                const gchar    *key,
+                const gchar    *suffix,
+                const gchar    *suffix2)
+{
+  gchar *basename;
+  gchar *filename;
+  
+  basename = g_strconcat (key, suffix, suffix2, NULL);
+  filename = g_build_filename (self->dir, basename, NULL);
+  g_free (basename);
+  
+  return filename;
+}
+
+/* gets the results file for @key if there is one, to be loaded with
+ * gvg_load_file() */
+gchar *
+gvg_result_cache_lookup (GvgResultCache *self,
+                         const gchar    *key)
+{
+  gchar    *results;
+  gchar    *info;
+  gboolean  found;
+  
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  
+  results = entry_filename (self, key, RESULTS_SUFFIX, NULL);
+  info = entry_filename (self, key, INFO_SUFFIX, NULL);
+  /* the info file is written last, so the entry is complete if it exists */
+  found = g_file_test (info, G_FILE_TEST_IS_REGULAR) &&
+          g_file_test (results, G_FILE_TEST_IS_REGULAR);
+  g_free (info);
+  if (! found) {
+    g_free (results);
+    results = NULL;
+  }
+  
+  return results;
+}
+
+/* gets the file in which to journal the results of a run for @key, which
+ * become part of the cache on gvg_result_cache_commit().  if the run fails,
+ * gvg_result_cache_abort() removes it */
+gchar *
+gvg_result_cache_begin (GvgResultCache  *self,
+                        const gchar     *key,
+                        GError         **error)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  
+  if (g_mkdir_with_parents (self->dir, 0700) < 0) {
+    gint errsv = errno;
+    
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                 "failed to create cache directory \"%s\": %s",
+                 self->dir, g_strerror (errsv));
+    return NULL;
+  }
+  
+  return entry_filename (self, key, RESULTS_SUFFIX, PART_SUFFIX);
+}
+
+static gboolean
+rename_entry_file (GvgResultCache  *self,
+                   const gchar     *key,
+                   const gchar     *suffix,
+                   GError         **error)
+{
+  gchar    *from = entry_filename (self, key, RESULTS_SUFFIX PART_SUFFIX, suffix);
+  gchar    *to   = entry_filename (self, key, RESULTS_SUFFIX, suffix);
+  gboolean  success = TRUE;
+  
+  if (g_rename (from, to) < 0) {
+    gint errsv = errno;
+    
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                 "failed to rename \"%s\": %s", from, g_strerror (errsv));
+    success = FALSE;
+  }
+  g_free (from);
+  g_free (to);
+  
+  return success;
+}
+
+/* adds the results journaled in the file gvg_result_cache_begin() gave for
+ * @key to the cache, along with the run's @description */
+gboolean
+gvg_result_cache_commit (GvgResultCache  *self,
+                         const gchar     *key,
+                         GKeyFile        *description,
+                         GError         **error)
+{
+  GKeyFile   *info;
+  GDateTime  *now;
+  gchar      *created;
+  gchar      *data;
+  gsize       len;
+  gchar      *filename;
+  gboolean    success;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  g_return_val_if_fail (description != NULL, FALSE);
+  
+  if (! rename_entry_file (self, key, NULL, error) ||
+      ! rename_entry_file (self, key, TIMING_SUFFIX, error)) {
+    gvg_result_cache_abort (self, key);
+    return FALSE;
+  }
+  
+  /* don't touch the caller's description, its key would change */
+  data = g_key_file_to_data (description, &len, NULL);
+  info = g_key_file_new ();
+  g_key_file_load_from_data (info, data, len, G_KEY_FILE_KEEP_COMMENTS, NULL);
+  g_free (data);
+  now = g_date_time_new_now_local ();
+  created = g_date_time_format (now, "%Y-%m-%d %H:%M:%S");
+  g_key_file_set_string (info, GROUP_CACHE, "key", key);
+  g_key_file_set_string (info, GROUP_CACHE, "created", created);
+  g_free (created);
+  g_date_time_unref (now);
+  
+  data = g_key_file_to_data (info, &len, NULL);
+  filename = entry_filename (self, key, INFO_SUFFIX, NULL);
+  success = g_file_set_contents (filename, data, (gssize) len, error);
+  g_free (filename);
+  g_free (data);
+  g_key_file_free (info);
+  
+  return success;
+}
+
+/* drops the results of a run started with gvg_result_cache_begin() */
+void
+gvg_result_cache_abort (GvgResultCache *self,
+                        const gchar    *key)
+{
+  gchar *filename;
+  
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (key != NULL);
+  
+  filename = entry_filename (self, key, RESULTS_SUFFIX PART_SUFFIX, NULL);
+  g_unlink (filename);
+  g_free (filename);
+  filename = entry_filename (self, key, RESULTS_SUFFIX PART_SUFFIX,
+                             TIMING_SUFFIX);
+  g_unlink (filename);
+  g_free (filename);
+}
+
+/* lists the keys of the entries in the cache */
+gchar **
+gvg_result_cache_list (GvgResultCache *self)
+{
+  GPtrArray    *keys;
+  GDir         *dir;
+  
+  g_return_val_if_fail (self != NULL, NULL);
+  
+  keys = g_ptr_array_new ();
+  dir = g_dir_open (self->dir, 0, NULL);
+  if (dir) {
+    const gchar *name;
+    
+    while ((name = g_dir_read_name (dir)) != NULL) {
+      if (g_str_has_suffix (name, INFO_SUFFIX)) {
+        g_ptr_array_add (keys, g_strndup (name,
+                                          strlen (name) - strlen (INFO_SUFFIX)));
+      }
+    }
+    g_dir_close (dir);
+  }
+  g_ptr_array_sort (keys, compare_strings);
+  g_ptr_array_add (keys, NULL);
+  
+  return (gchar **) g_ptr_array_free (keys, FALSE);
+}
+
+/* gets the description of the run an entry is for, and when it was created
+ * (the "created" key of the "cache" group) */
+GKeyFile *
+gvg_result_cache_get_info (GvgResultCache  *self,
+                           const gchar     *key,
+                           GError         **error)
+{
+  GKeyFile *info;
+  gchar    *filename;
+  
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  
+  info = g_key_file_new ();
+  filename = entry_filename (self, key, INFO_SUFFIX, NULL);
+  if (! g_key_file_load_from_file (info, filename, G_KEY_FILE_NONE, error)) {
+    g_key_file_free (info);
+    info = NULL;
+  }
+  g_free (filename);
+  
+  return info;
+}
+
+/* removes an entry from the cache, so the next run for it is a real one */
+gboolean
+gvg_result_cache_invalidate (GvgResultCache  *self,
+                             const gchar     *key,
+                             GError         **error)
+{
+  gchar    *filename;
+  gboolean  success = TRUE;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (key != NULL, FALSE);
+  
+  /* the info file first, so a partial removal leaves no entry */
+  filename = entry_filename (self, key, INFO_SUFFIX, NULL);
+  if (g_unlink (filename) < 0) {
+    gint errsv = errno;
+    
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                 "failed to remove cache entry %s: %s", key,
+                 g_strerror (errsv));
+    success = FALSE;
+  }
+  g_free (filename);
+  filename = entry_filename (self, key, RESULTS_SUFFIX, NULL);
+  g_unlink (filename);
+  g_free (filename);
+  filename = entry_filename (self, key, RESULTS_SUFFIX, TIMING_SUFFIX);
+  g_unlink (filename);
+  g_free (filename);
+  
+  return success;
+}
+
+/* removes all entries from the cache */
+gboolean
+gvg_result_cache_clear (GvgResultCache  *self,
+                        GError         **error)
+{
+  gchar   **keys;
+  gboolean  success = TRUE;
+  guint     i;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  
+  keys = gvg_result_cache_list (self);
+  for (i = 0; success && keys[i]; i++) {
+    success = gvg_result_cache_invalidate (self, keys[i], error);
+  }
+  g_strfreev (keys);
+  
+  return success;
+}
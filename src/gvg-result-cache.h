@@ -0,0 +1,85 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_RESULT_CACHE
+#define H_GVG_RESULT_CACHE
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gvg-valgrind-info.h"
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgResultCache GvgResultCache;
+
+
+GvgResultCache *gvg_result_cache_new          (const gchar *dir);
+void            gvg_result_cache_free         (GvgResultCache *cache);
+const gchar    *gvg_result_cache_get_dir      (GvgResultCache *cache);
+GKeyFile       *gvg_result_cache_describe     (const gchar     **program_argv,
+                                               const gchar     **option_args,
+                                               GvgValgrindInfo  *valgrind,
+                                               GError          **error);
+void            gvg_result_cache_describe_async   (const gchar         **program_argv,
+                                                   const gchar         **option_args,
+                                                   GvgValgrindInfo      *valgrind,
+                                                   GCancellable         *cancellable,
+                                                   GAsyncReadyCallback   callback,
+                                                   gpointer              user_data);
+GKeyFile       *gvg_result_cache_describe_finish  (GAsyncResult  *result,
+                                                   GError       **error);
+gchar         **gvg_result_cache_list_files   (const gchar **program_argv,
+                                               gboolean      libraries,
+                                               GError      **error);
+void            gvg_result_cache_list_files_async  (const gchar         **program_argv,
+                                                    GCancellable         *cancellable,
+                                                    GAsyncReadyCallback   callback,
+                                                    gpointer              user_data);
+gchar         **gvg_result_cache_list_files_finish (GAsyncResult  *result,
+                                                    GError       **error);
+gchar          *gvg_result_cache_get_key      (GKeyFile *description);
+gchar          *gvg_result_cache_lookup       (GvgResultCache *cache,
+                                               const gchar    *key);
+gchar          *gvg_result_cache_begin        (GvgResultCache  *cache,
+                                               const gchar     *key,
+                                               GError         **error);
+gboolean        gvg_result_cache_commit       (GvgResultCache  *cache,
+                                               const gchar     *key,
+                                               GKeyFile        *description,
+                                               GError         **error);
+void            gvg_result_cache_abort        (GvgResultCache *cache,
+                                               const gchar    *key);
+gchar         **gvg_result_cache_list         (GvgResultCache *cache);
+GKeyFile       *gvg_result_cache_get_info     (GvgResultCache  *cache,
+                                               const gchar     *key,
+                                               GError         **error);
+gboolean        gvg_result_cache_invalidate   (GvgResultCache  *cache,
+                                               const gchar     *key,
+                                               GError         **error);
+gboolean        gvg_result_cache_clear        (GvgResultCache  *cache,
+                                               GError         **error);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,539 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Runs many programs under Valgrind concurrently, at most a given number at a
+ * time (by default, as many as there are CPUs).
+ * 
+ * Each job is run by its own Gvg, of the same type, options and settings as a
+ * template one (see gvg_copy_settings(), the files of a run such as the
+ * journal aren't shared), and parsed by a copy of the template's parser.  All
+ * results end up in the same storage, each job's being tagged with the job
+ * identifier as the parser group (see gvg_xml_parser_set_group()).
+ */
+
+#include "gvg-run-queue.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <unistd.h>
+
+#include "gvg.h"
+#include "gvg-xml-parser.h"
+#include "gvg-options.h"
+#include "gvg-cclosure-marshal.h"
+
+
+typedef enum
+{
+  JOB_PENDING,
+  JOB_RUNNING,
+  JOB_DONE
+} JobState;
+
+typedef struct _Job Job;
+
+struct _Job
+{
+  GvgRunQueue  *queue;
+  guint         id;
+  gchar       **argv;
+  JobState      state;
+  Gvg          *gvg;
+  gulong        finished_handler;
+  gint64        start_time;
+  gint64        end_time;
+};
+
+struct _GvgRunQueuePrivate
+{
+  Gvg        *template_;
+  guint       max_jobs;
+  GPtrArray  *jobs;     /* all jobs, job N being at index N - 1 */
+  GQueue      pending;
+  guint       n_running;
+};
+
+
+G_DEFINE_TYPE (GvgRunQueue,
+               gvg_run_queue,
+               G_TYPE_OBJECT)
+
+
+static void     gvg_run_queue_finalize      (GObject *object);
+static void     gvg_run_queue_get_property  (GObject    *object,
+                                             guint       prop_id,
+                                             GValue     *value,
+                                             GParamSpec *pspec);
+static void     gvg_run_queue_set_property  (GObject      *object,
+                                             guint         prop_id,
+                                             const GValue *value,
+                                             GParamSpec   *pspec);
+
+
+enum
+{
+  SIGNAL_JOB_STARTED,
+  SIGNAL_JOB_FINISHED,
+  SIGNAL_FINISHED,
+  N_SIGNALS
+};
+
+enum
+{
+  PROP_0,
+  PROP_TEMPLATE,
+  PROP_MAX_JOBS,
+  PROP_N_PENDING,
+  PROP_N_RUNNING
+};
+
+
+static guint signals[N_SIGNALS] = { 0 };
+
+
+static void
+gvg_run_queue_class_init (GvgRunQueueClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  
+  object_class->finalize      = gvg_run_queue_finalize;
+  object_class->get_property  = gvg_run_queue_get_property;
+  object_class->set_property  = gvg_run_queue_set_property;
+  
+  g_object_class_install_property (object_class,
+                                   PROP_TEMPLATE,
+                                   g_param_spec_object ("template",
+                                                        "Template",
+                                                        "The Gvg whose type, parser and settings are "
+                                                        "used for the jobs",
+                                                        GVG_TYPE_GVG,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_CONSTRUCT_ONLY));
+  g_object_class_install_property (object_class,
+                                   PROP_MAX_JOBS,
+                                   g_param_spec_uint ("max-jobs",
+                                                      "Maximum jobs",
+                                                      "Maximum number of jobs to run at the same time, "
+                                                      "or 0 for the number of CPUs",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_CONSTRUCT));
+  g_object_class_install_property (object_class,
+                                   PROP_N_PENDING,
+                                   g_param_spec_uint ("n-pending",
+                                                      "Pending jobs",
+                                                      "Number of jobs waiting to be run",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_N_RUNNING,
+                                   g_param_spec_uint ("n-running",
+                                                      "Running jobs",
+                                                      "Number of jobs currently running",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_STRINGS));
+  
+  signals[SIGNAL_JOB_STARTED] = g_signal_new ("job-started",
+                                              GVG_TYPE_RUN_QUEUE,
+                                              G_SIGNAL_RUN_LAST,
+                                              G_STRUCT_OFFSET (GvgRunQueueClass,
+                                                               job_started),
+                                              NULL, NULL,
+                                              g_cclosure_marshal_VOID__UINT,
+                                              G_TYPE_NONE,
+                                              1,
+                                              G_TYPE_UINT);
+  /* the wall time is in seconds */
+  signals[SIGNAL_JOB_FINISHED] = g_signal_new ("job-finished",
+                                               GVG_TYPE_RUN_QUEUE,
+                                               G_SIGNAL_RUN_LAST,
+                                               G_STRUCT_OFFSET (GvgRunQueueClass,
+                                                                job_finished),
+                                               NULL, NULL,
+                                               gvg_cclosure_marshal_VOID__UINT_DOUBLE,
+                                               G_TYPE_NONE,
+                                               2,
+                                               G_TYPE_UINT,
+                                               G_TYPE_DOUBLE);
+  /* emitted when the last job finished and none is pending */
+  signals[SIGNAL_FINISHED] = g_signal_new ("finished",
+                                           GVG_TYPE_RUN_QUEUE,
+                                           G_SIGNAL_RUN_LAST,
+                                           G_STRUCT_OFFSET (GvgRunQueueClass,
+                                                            finished),
+                                           NULL, NULL,
+                                           g_cclosure_marshal_VOID__VOID,
+                                           G_TYPE_NONE,
+                                           0);
+  
+  g_type_class_add_private (klass, sizeof (GvgRunQueuePrivate));
+}
+
+static void
+job_free (Job *job)
+{
+  if (job->gvg) {
+    g_signal_handler_disconnect (job->gvg, job->finished_handler);
+    g_object_unref (job->gvg);
+  }
+  g_strfreev (job->argv);
+  g_slice_free (Job, job);
+}
+
+static void
+gvg_run_queue_init (GvgRunQueue *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_RUN_QUEUE,
+                                            GvgRunQueuePrivate);
+  
+  self->priv->template_ = NULL;
+  self->priv->max_jobs  = 0;
+  self->priv->jobs      = g_ptr_array_new_with_free_func ((GDestroyNotify) job_free);
+  g_queue_init (&self->priv->pending);
+  self->priv->n_running = 0;
+}
+
+static void
+gvg_run_queue_finalize (GObject *object)
+{
+  GvgRunQueue *self = GVG_RUN_QUEUE (object);
+  
+  /* running jobs are terminated when their Gvg goes away */
+  g_queue_clear (&self->priv->pending);
+  g_ptr_array_unref (self->priv->jobs);
+  if (self->priv->template_) {
+    g_object_unref (self->priv->template_);
+  }
+  
+  G_OBJECT_CLASS (gvg_run_queue_parent_class)->finalize (object);
+}
+
+static void
+gvg_run_queue_get_property (GObject    *object,
+                            guint       prop_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+  GvgRunQueue *self = GVG_RUN_QUEUE (object);
+  
+  switch (prop_id) {
+    case PROP_TEMPLATE:
+      g_value_set_object (value, self->priv->template_);
+      break;
+    
+    case PROP_MAX_JOBS:
+      g_value_set_uint (value, self->priv->max_jobs);
+      break;
+    
+    case PROP_N_PENDING:
+      g_value_set_uint (value, gvg_run_queue_get_n_pending (self));
+      break;
+    
+    case PROP_N_RUNNING:
+      g_value_set_uint (value, gvg_run_queue_get_n_running (self));
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void schedule (GvgRunQueue *self);
+
+static void
+gvg_run_queue_set_property (GObject      *object,
+                            guint         prop_id,
+                            const GValue *value,
+                            GParamSpec   *pspec)
+{
+  GvgRunQueue *self = GVG_RUN_QUEUE (object);
+  
+  switch (prop_id) {
+    case PROP_TEMPLATE:
+      self->priv->template_ = g_value_dup_object (value);
+      break;
+    
+    case PROP_MAX_JOBS:
+      self->priv->max_jobs = g_value_get_uint (value);
+      /* more room maybe */
+      if (self->priv->template_) {
+        schedule (self);
+      }
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static guint
+get_max_jobs (GvgRunQueue *self)
+{
+  glong n_cpus;
+  
+  if (self->priv->max_jobs > 0) {
+    return self->priv->max_jobs;
+  }
+  
+  n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  return n_cpus > 0 ? (guint) n_cpus : 1;
+}
+
+static gboolean
+unref_idle (gpointer data)
+{
+  g_object_unref (data);
+  
+  return FALSE;
+}
+
+static void
+job_finish (Job *job)
+{
+  GvgRunQueue *self = job->queue;
+  
+  if (job->gvg) {
+    g_signal_handler_disconnect (job->gvg, job->finished_handler);
+    /* we may be called from one of its handlers, so don't destroy it now */
+    g_idle_add (unref_idle, job->gvg);
+    job->gvg = NULL;
+  }
+  job->state = JOB_DONE;
+  job->end_time = g_get_monotonic_time ();
+  self->priv->n_running--;
+  g_object_notify (G_OBJECT (self), "n-running");
+  
+  g_signal_emit (self, signals[SIGNAL_JOB_FINISHED], 0, job->id,
+                 gvg_run_queue_get_job_wall_time (self, job->id));
+}
+
+static void
+check_finished (GvgRunQueue *self)
+{
+  if (self->priv->n_running == 0 && g_queue_is_empty (&self->priv->pending)) {
+    g_signal_emit (self, signals[SIGNAL_FINISHED], 0);
+  }
+}
+
+static void
+job_gvg_finished (Gvg      *gvg,
+                  gpointer  data)
+{
+  Job *job = data;
+  
+  GvgRunQueue *self = job->queue;
+  
+  g_debug ("job %u finished", job->id);
+  job_finish (job);
+  schedule (self);
+  check_finished (self);
+}
+
+/* returns %FALSE if the job failed to start, in which case it has to be
+ * finished */
+static gboolean
+job_start (Job *job)
+{
+  GvgRunQueue  *self = job->queue;
+  GvgXmlParser *parser;
+  GvgXmlParser *job_parser;
+  GvgOptions   *options;
+  GError       *err = NULL;
+  
+  g_object_get (self->priv->template_,
+                "parser", &parser,
+                "options", &options,
+                NULL);
+  job_parser = gvg_xml_parser_dup (parser);
+  gvg_xml_parser_set_group (job_parser, job->id);
+  job->gvg = g_object_new (G_OBJECT_TYPE (self->priv->template_),
+                           "parser", job_parser,
+                           "options", options,
+                           NULL);
+  gvg_copy_settings (job->gvg, self->priv->template_);
+  g_object_unref (job_parser);
+  g_object_unref (parser);
+  if (options) {
+    g_object_unref (options);
+  }
+  job->finished_handler = g_signal_connect (job->gvg, "finished",
+                                            G_CALLBACK (job_gvg_finished), job);
+  
+  job->state = JOB_RUNNING;
+  job->start_time = g_get_monotonic_time ();
+  self->priv->n_running++;
+  g_object_notify (G_OBJECT (self), "n-running");
+  g_signal_emit (self, signals[SIGNAL_JOB_STARTED], 0, job->id);
+  
+  if (! gvg_run (job->gvg, (const gchar **) job->argv, &err)) {
+    g_warning ("failed to run job %u: %s", job->id, err->message);
+    g_error_free (err);
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+/* starts pending jobs while there is room */
+static void
+schedule (GvgRunQueue *self)
+{
+  guint max_jobs = get_max_jobs (self);
+  
+  while (self->priv->n_running < max_jobs &&
+         ! g_queue_is_empty (&self->priv->pending)) {
+    Job *job = g_queue_pop_head (&self->priv->pending);
+    
+    g_object_notify (G_OBJECT (self), "n-pending");
+    if (! job_start (job)) {
+      job_finish (job);
+    }
+  }
+}
+
+/* @template_ is only used for its type and settings, it isn't run itself */
+GvgRunQueue *
+gvg_run_queue_new (Gvg   *template_,
+                   guint  max_jobs)
+{
+  return g_object_new (GVG_TYPE_RUN_QUEUE,
+                       "template", template_,
+                       "max-jobs", max_jobs,
+                       NULL);
+}
+
+/* queues a program to be run, returns the job identifier, which is also the
+ * group of its results */
+guint
+gvg_run_queue_add (GvgRunQueue  *self,
+                   const gchar **program_argv)
+{
+  Job *job;
+  
+  g_return_val_if_fail (GVG_IS_RUN_QUEUE (self), 0);
+  g_return_val_if_fail (program_argv != NULL && program_argv[0] != NULL, 0);
+  
+  job = g_slice_new (Job);
+  job->queue            = self;
+  job->argv             = g_strdupv ((gchar **) program_argv);
+  job->state            = JOB_PENDING;
+  job->gvg              = NULL;
+  job->finished_handler = 0;
+  job->start_time       = 0;
+  job->end_time         = 0;
+  g_ptr_array_add (self->priv->jobs, job);
+  job->id = self->priv->jobs->len;
+  
+  g_queue_push_tail (&self->priv->pending, job);
+  g_object_notify (G_OBJECT (self), "n-pending");
+  schedule (self);
+  /* in case it failed to start */
+  check_finished (self);
+  
+  return job->id;
+}
+
+/* drops the pending jobs and stops the running ones, without waiting for
+ * them, see gvg_stop() */
+void
+gvg_run_queue_stop (GvgRunQueue *self)
+{
+  guint i;
+  
+  g_return_if_fail (GVG_IS_RUN_QUEUE (self));
+  
+  while (! g_queue_is_empty (&self->priv->pending)) {
+    Job *job = g_queue_pop_head (&self->priv->pending);
+    
+    job->state = JOB_DONE;
+  }
+  g_object_notify (G_OBJECT (self), "n-pending");
+  
+  for (i = 0; i < self->priv->jobs->len; i++) {
+    Job *job = g_ptr_array_index (self->priv->jobs, i);
+    
+    if (job->state == JOB_RUNNING) {
+      gvg_stop (job->gvg);
+    }
+  }
+  check_finished (self);
+}
+
+guint
+gvg_run_queue_get_n_pending (GvgRunQueue *self)
+{
+  g_return_val_if_fail (GVG_IS_RUN_QUEUE (self), 0);
+  
+  return g_queue_get_length (&self->priv->pending);
+}
+
+guint
+gvg_run_queue_get_n_running (GvgRunQueue *self)
+{
+  g_return_val_if_fail (GVG_IS_RUN_QUEUE (self), 0);
+  
+  return self->priv->n_running;
+}
+
+static Job *
+get_job (GvgRunQueue *self,
+         guint        id)
+{
+  g_return_val_if_fail (id > 0 && id <= self->priv->jobs->len, NULL);
+  
+  return g_ptr_array_index (self->priv->jobs, id - 1);
+}
+
+/* gets for how long a job ran, or has been running, in seconds */
+gdouble
+gvg_run_queue_get_job_wall_time (GvgRunQueue *self,
+                                 guint        id)
+{
+  Job    *job;
+  gint64  end;
+  
+  g_return_val_if_fail (GVG_IS_RUN_QUEUE (self), 0.0);
+  
+  job = get_job (self, id);
+  if (! job || job->start_time == 0) {
+    return 0.0;
+  }
+  
+  end = job->state == JOB_RUNNING ? g_get_monotonic_time () : job->end_time;
+  return (gdouble) (end - job->start_time) / G_USEC_PER_SEC;
+}
+
+const gchar *const *
+gvg_run_queue_get_job_argv (GvgRunQueue *self,
+                            guint        id)
+{
+  Job *job;
+  
+  g_return_val_if_fail (GVG_IS_RUN_QUEUE (self), NULL);
+  
+  job = get_job (self, id);
+  return job ? (const gchar *const *) job->argv : NULL;
+}
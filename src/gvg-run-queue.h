@@ -0,0 +1,80 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_RUN_QUEUE
+#define H_GVG_RUN_QUEUE
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "gvg.h"
+
+G_BEGIN_DECLS
+
+
+#define GVG_TYPE_RUN_QUEUE            (gvg_run_queue_get_type ())
+#define GVG_RUN_QUEUE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GVG_TYPE_RUN_QUEUE, GvgRunQueue))
+#define GVG_RUN_QUEUE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GVG_TYPE_RUN_QUEUE, GvgRunQueueClass))
+#define GVG_IS_RUN_QUEUE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GVG_TYPE_RUN_QUEUE))
+#define GVG_IS_RUN_QUEUE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GVG_TYPE_RUN_QUEUE))
+#define GVG_RUN_QUEUE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GVG_TYPE_RUN_QUEUE, GvgRunQueueClass))
+
+
+typedef struct _GvgRunQueue         GvgRunQueue;
+typedef struct _GvgRunQueueClass    GvgRunQueueClass;
+typedef struct _GvgRunQueuePrivate  GvgRunQueuePrivate;
+
+struct _GvgRunQueue
+{
+  GObject             parent;
+  GvgRunQueuePrivate *priv;
+};
+
+struct _GvgRunQueueClass
+{
+  GObjectClass parent_class;
+  
+  void        (*job_started)      (GvgRunQueue *self,
+                                   guint        job);
+  void        (*job_finished)     (GvgRunQueue *self,
+                                   guint        job,
+                                   gdouble      wall_time);
+  void        (*finished)         (GvgRunQueue *self);
+};
+
+
+GType         gvg_run_queue_get_type        (void) G_GNUC_CONST;
+GvgRunQueue  *gvg_run_queue_new             (Gvg          *template_,
+                                             guint         max_jobs);
+guint         gvg_run_queue_add             (GvgRunQueue  *self,
+                                             const gchar **program_argv);
+void          gvg_run_queue_stop            (GvgRunQueue *self);
+guint         gvg_run_queue_get_n_pending   (GvgRunQueue *self);
+guint         gvg_run_queue_get_n_running   (GvgRunQueue *self);
+gdouble       gvg_run_queue_get_job_wall_time (GvgRunQueue *self,
+                                               guint        job);
+const gchar *const *gvg_run_queue_get_job_argv (GvgRunQueue *self,
+                                                guint        job);
+
+
+G_END_DECLS
+
+#endif /* guard */
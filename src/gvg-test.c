@@ -21,10 +21,296 @@
 
 #include <glib.h>
 #include <gtk/gtk.h>
+#include <string.h>
+#include <stdlib.h>
 
 #include "gvg-memcheck.h"
 #include "gvg-memcheck-store.h"
+#include "gvg-run-queue.h"
+#include "gvg-enum-types.h"
 #include "gvg-ui.h"
+#include "gvg-watch.h"
+
+
+#define BENCHMARK_CHUNK_SIZE (1024 * 1024)
+
+static void
+usage (const gchar *prgname)
+{
+  g_printerr ("USAGE: %s [--threaded] [--trace-children] [--listen[=PORT]] "
+              "[--journal FILE] [--leak-snapshots=SECONDS] "
+              "[--fail-on=KIND[:COUNT]...] "
+              "[--wall-budget=SECONDS] [--cpu-budget=SECONDS] [--native] "
+              "[--capture-output=BYTES [--output-spill=FILE]] "
+              "[--cache[=DIR]] [--adaptive] [--watch[=libraries]] "
+              "[--xml-backend=libxml|tokenizer] "
+              "[--load FILE [--lazy] | --replay FILE | PROGRAM [ARGS...]]\n"
+              "       %s [--threaded] [--jobs=N] --queue \"COMMAND\"...\n"
+              "       %s [--cache=DIR] --cache-list | --cache-clear | "
+              "--cache-invalidate=KEY\n"
+              "       %s --benchmark=FILE\n"
+              "\n"
+              "KIND is an error kind such as invalid-write, or any\n"
+              "\n"
+              "Replay options:\n"
+              "  --pacing=fast|original|MB/S\n"
+              "  --chunk-size=BYTES\n",
+              prgname, prgname, prgname, prgname);
+}
+
+/* parses a KIND[:COUNT] threshold, COUNT defaulting to 1 */
+static gboolean
+parse_threshold (const gchar          *str,
+                 GvgMemcheckErrorKind *kind,
+                 guint                *count)
+{
+  GEnumClass *enum_class;
+  GEnumValue *value;
+  gchar      *name;
+  gchar      *sep;
+  
+  name = g_strdup (str);
+  *count = 1;
+  sep = strchr (name, ':');
+  if (sep) {
+    *sep = 0;
+    *count = (guint) strtoul (sep + 1, NULL, 10);
+  }
+  enum_class = g_type_class_ref (GVG_TYPE_MEMCHECK_ERROR_KIND);
+  value = g_enum_get_value_by_nick (enum_class, name);
+  if (value) {
+    *kind = value->value;
+  }
+  g_type_class_unref (enum_class);
+  g_free (name);
+  
+  return value != NULL;
+}
+
+static void
+memcheck_finished (Gvg     *gvg,
+                   gpointer data)
+{
+  const GvgRunSummary  *summary = gvg_get_run_summary (gvg);
+  const gchar          *message;
+  
+  if (gvg_get_stop_reason (gvg, &message) != GVG_STOP_REASON_NONE &&
+      message) {
+    g_message ("%s", message);
+  }
+  g_message ("wall %.2fs, user %.2fs, sys %.2fs, max RSS %ld KiB, "
+             "%ld+%ld context switches, %ld+%ld page faults",
+             summary->wall_time, summary->user_time, summary->system_time,
+             summary->max_rss, summary->voluntary_switches,
+             summary->involuntary_switches, summary->minor_faults,
+             summary->major_faults);
+  g_message ("%" G_GUINT64_FORMAT " XML bytes over %.2fs",
+             summary->n_bytes,
+             (summary->last_byte_time - summary->first_byte_time) / 1e6);
+  if (summary->native_wall_time > 0.0 && summary->native_max_rss > 0) {
+    g_message ("slowdown %.1fx, memory inflation %.1fx",
+               summary->wall_time / summary->native_wall_time,
+               (gdouble) summary->max_rss / (gdouble) summary->native_max_rss);
+  }
+  if (summary->cached) {
+    g_message ("results loaded from the cache");
+  }
+  if (gvg_memcheck_get_pass (GVG_MEMCHECK (gvg)) > 0) {
+    g_message ("adaptive pass %u", gvg_memcheck_get_pass (GVG_MEMCHECK (gvg)));
+  }
+  if (gvg_get_output_log (gvg)) {
+    GvgOutputLog *log = gvg_get_output_log (gvg);
+    
+    g_message ("%u output lines, %u spilled or dropped",
+               gvg_output_log_get_n_lines (log),
+               gvg_output_log_get_first_position (log));
+  }
+}
+
+static void
+run_progress (Gvg     *gvg,
+              guint64  n_bytes,
+              guint    n_errors,
+              gpointer data)
+{
+  g_debug ("%" G_GUINT64_FORMAT " XML bytes, %u errors", n_bytes, n_errors);
+}
+
+static void
+run_ready (GObject      *object,
+           GAsyncResult *result,
+           gpointer      data)
+{
+  GError *err = NULL;
+  
+  if (! gvg_run_finish (GVG (object), result, &err)) {
+    g_warning ("failed to run memcheck: %s", err->message);
+    g_error_free (err);
+    gtk_main_quit ();
+  } else {
+    g_message ("run complete, %u error(s)", gvg_get_n_errors (GVG (object)));
+  }
+}
+
+static void
+watch_rebuilt (GvgWatch *watch,
+               gpointer  data)
+{
+  g_message ("program rebuilt, running it again");
+}
+
+/* lists, invalidates or clears the result cache */
+static gint
+manage_cache (GvgResultCache *cache,
+              gboolean        clear,
+              const gchar    *invalidate)
+{
+  GError *err = NULL;
+  
+  if (clear) {
+    if (! gvg_result_cache_clear (cache, &err)) {
+      g_warning ("failed to clear cache: %s", err->message);
+      g_error_free (err);
+      return 1;
+    }
+  } else if (invalidate) {
+    if (! gvg_result_cache_invalidate (cache, invalidate, &err)) {
+      g_warning ("%s", err->message);
+      g_error_free (err);
+      return 1;
+    }
+  } else {
+    gchar **keys = gvg_result_cache_list (cache);
+    guint   i;
+    
+    for (i = 0; keys[i]; i++) {
+      GKeyFile  *info = gvg_result_cache_get_info (cache, keys[i], NULL);
+      gchar     *created = NULL;
+      gchar    **argv = NULL;
+      gchar     *command = NULL;
+      
+      if (info) {
+        created = g_key_file_get_string (info, "cache", "created", NULL);
+        argv = g_key_file_get_string_list (info, "run", "argv", NULL, NULL);
+        command = argv ? g_strjoinv (" ", argv) : NULL;
+        g_key_file_free (info);
+      }
+      g_print ("%s  %s  %s\n", keys[i], created ? created : "?",
+               command ? command : "?");
+      g_free (command);
+      g_strfreev (argv);
+      g_free (created);
+    }
+    g_strfreev (keys);
+  }
+  
+  return 0;
+}
+
+/* times the parsing of a saved report with each backend, the results being
+ * dropped right away */
+static gint
+benchmark_backends (const gchar *filename)
+{
+  GvgMemcheckStore   *store;
+  GMappedFile        *file;
+  GError             *err = NULL;
+  GvgXmlParserBackend backend;
+  
+  file = g_mapped_file_new (filename, FALSE, &err);
+  if (! file) {
+    g_warning ("failed to open \"%s\": %s", filename, err->message);
+    g_error_free (err);
+    return 1;
+  }
+  
+  store = gvg_memcheck_store_new ();
+  for (backend = GVG_XML_PARSER_BACKEND_LIBXML;
+       backend <= GVG_XML_PARSER_BACKEND_TOKENIZER; backend++) {
+    const gchar  *data  = g_mapped_file_get_contents (file);
+    gsize         len   = g_mapped_file_get_length (file);
+    GvgXmlParser *parser;
+    gint64        start;
+    gdouble       elapsed;
+    gsize         i;
+    
+    parser = gvg_memcheck_parser_new (store);
+    gvg_xml_parser_set_backend (parser, backend);
+    gvg_xml_parser_set_deferred (parser, TRUE);
+    start = g_get_monotonic_time ();
+    for (i = 0; i < len; i += BENCHMARK_CHUNK_SIZE) {
+      gsize       n = MIN (len - i, BENCHMARK_CHUNK_SIZE);
+      GPtrArray  *records;
+      
+      gvg_xml_parser_push (parser, &data[i], n, i + n >= len);
+      records = gvg_xml_parser_steal_records (parser);
+      if (records) {
+        g_ptr_array_unref (records);
+      }
+    }
+    elapsed = (g_get_monotonic_time () - start) / 1e6;
+    g_message ("%s: %.2fs, %.1f MiB/s",
+               backend == GVG_XML_PARSER_BACKEND_LIBXML ? "libxml" : "tokenizer",
+               elapsed, len / 1048576.0 / MAX (elapsed, 1e-6));
+    g_object_unref (parser);
+  }
+  g_object_unref (store);
+  g_mapped_file_unref (file);
+  
+  return 0;
+}
+
+/* stops the run before quitting so we get its last output */
+static void
+window_destroy (GtkWidget *window,
+                gpointer   data)
+{
+  Gvg *gvg = data;
+  
+  if (gvg && gvg_is_busy (gvg)) {
+    g_signal_connect (gvg, "finished", gtk_main_quit, NULL);
+    gvg_stop (gvg);
+  } else {
+    gtk_main_quit ();
+  }
+}
+
+static void
+queue_job_finished (GvgRunQueue *queue,
+                    guint        job,
+                    gdouble      wall_time,
+                    gpointer     data)
+{
+  gchar *command;
+  
+  command = g_strjoinv (" ", (gchar **) gvg_run_queue_get_job_argv (queue, job));
+  g_message ("job %u (%s) finished in %.2fs, %u pending", job, command,
+             wall_time, gvg_run_queue_get_n_pending (queue));
+  g_free (command);
+}
+
+/* queues each command line in @commands */
+static gboolean
+queue_commands (GvgRunQueue  *queue,
+                gchar       **commands)
+{
+  gint i;
+  
+  for (i = 0; commands[i]; i++) {
+    gchar  **argv;
+    GError  *err = NULL;
+    
+    if (! g_shell_parse_argv (commands[i], NULL, &argv, &err)) {
+      g_warning ("invalid command \"%s\": %s", commands[i], err->message);
+      g_error_free (err);
+      return FALSE;
+    }
+    gvg_run_queue_add (queue, (const gchar **) argv);
+    g_strfreev (argv);
+  }
+  
+  return TRUE;
+}
 
 int
 main (int     argc,
@@ -33,34 +319,258 @@ main (int     argc,
   GtkWidget          *window;
   GvgMemcheckStore   *store;
   GtkWidget          *ui;
+  GvgMemcheck        *memcheck  = NULL;
+  const gchar        *load_file = NULL;
+  gboolean            lazy      = FALSE;
+  const gchar        *journal   = NULL;
+  const gchar        *replay    = NULL;
+  GvgReplayPacing     pacing    = GVG_REPLAY_PACING_FAST;
+  gdouble             rate      = 0.0;
+  gsize               chunk_size = 0;
+  gboolean            threaded  = FALSE;
+  gboolean            listen    = FALSE;
+  gboolean            queue     = FALSE;
+  gboolean            trace     = FALSE;
+  gboolean            native    = FALSE;
+  guint               max_jobs  = 0;
+  guint               port      = 0;
+  guint               snapshots = 0;
+  guint               wall_budget = 0;
+  guint               output_size = 0;
+  const gchar        *output_spill = NULL;
+  gboolean            cache     = FALSE;
+  gboolean            adaptive  = FALSE;
+  gboolean            watch     = FALSE;
+  gboolean            watch_libraries = FALSE;
+  const gchar        *cache_dir = NULL;
+  gboolean            cache_list = FALSE;
+  gboolean            cache_clear = FALSE;
+  const gchar        *cache_invalidate = NULL;
+  const gchar        *benchmark = NULL;
+  GvgXmlParserBackend backend   = GVG_XML_PARSER_BACKEND_LIBXML;
+  guint               cpu_budget = 0;
+  guint               thresholds[GVG_MEMCHECK_ERROR_KIND_LEAK_STILL_REACHABLE + 1] = { 0 };
+  gint                i;
   
   gtk_init (&argc, &argv);
   
+  /* our own options must come before the program to run */
+  for (i = 1; i < argc && strncmp (argv[i], "--", 2) == 0; i++) {
+    if (strcmp (argv[i], "--") == 0) {
+      i++;
+      break;
+    } else if (strcmp (argv[i], "--threaded") == 0) {
+      threaded = TRUE;
+    } else if (strcmp (argv[i], "--trace-children") == 0) {
+      trace = TRUE;
+    } else if (strcmp (argv[i], "--native") == 0) {
+      native = TRUE;
+    } else if (strcmp (argv[i], "--queue") == 0) {
+      queue = TRUE;
+    } else if (strncmp (argv[i], "--jobs=", 7) == 0) {
+      max_jobs = (guint) strtoul (&argv[i][7], NULL, 10);
+    } else if (strncmp (argv[i], "--leak-snapshots=", 17) == 0) {
+      snapshots = (guint) strtoul (&argv[i][17], NULL, 10);
+    } else if (strncmp (argv[i], "--fail-on=", 10) == 0) {
+      GvgMemcheckErrorKind  kind;
+      guint                 count;
+      
+      if (! parse_threshold (&argv[i][10], &kind, &count)) {
+        usage (argv[0]);
+        return 1;
+      }
+      thresholds[kind] = count;
+    } else if (strncmp (argv[i], "--wall-budget=", 14) == 0) {
+      wall_budget = (guint) strtoul (&argv[i][14], NULL, 10);
+    } else if (strncmp (argv[i], "--cpu-budget=", 13) == 0) {
+      cpu_budget = (guint) strtoul (&argv[i][13], NULL, 10);
+    } else if (strncmp (argv[i], "--capture-output=", 17) == 0) {
+      output_size = (guint) strtoul (&argv[i][17], NULL, 10);
+    } else if (strncmp (argv[i], "--output-spill=", 15) == 0) {
+      output_spill = &argv[i][15];
+    } else if (strcmp (argv[i], "--watch") == 0) {
+      watch = TRUE;
+    } else if (strcmp (argv[i], "--watch=libraries") == 0) {
+      watch = TRUE;
+      watch_libraries = TRUE;
+    } else if (strcmp (argv[i], "--adaptive") == 0) {
+      adaptive = TRUE;
+    } else if (strcmp (argv[i], "--cache") == 0) {
+      cache = TRUE;
+    } else if (strncmp (argv[i], "--cache=", 8) == 0) {
+      cache = TRUE;
+      cache_dir = &argv[i][8];
+    } else if (strcmp (argv[i], "--cache-list") == 0) {
+      cache_list = TRUE;
+    } else if (strcmp (argv[i], "--cache-clear") == 0) {
+      cache_clear = TRUE;
+    } else if (strncmp (argv[i], "--cache-invalidate=", 19) == 0) {
+      cache_invalidate = &argv[i][19];
+    } else if (strcmp (argv[i], "--xml-backend=libxml") == 0) {
+      backend = GVG_XML_PARSER_BACKEND_LIBXML;
+    } else if (strcmp (argv[i], "--xml-backend=tokenizer") == 0) {
+      backend = GVG_XML_PARSER_BACKEND_TOKENIZER;
+    } else if (strncmp (argv[i], "--benchmark=", 12) == 0) {
+      benchmark = &argv[i][12];
+    } else if (strcmp (argv[i], "--listen") == 0) {
+      listen = TRUE;
+    } else if (strncmp (argv[i], "--listen=", 9) == 0) {
+      listen = TRUE;
+      port = (guint) strtoul (&argv[i][9], NULL, 10);
+    } else if (strcmp (argv[i], "--journal") == 0 && i + 1 < argc) {
+      journal = argv[++i];
+    } else if (strncmp (argv[i], "--journal=", 10) == 0) {
+      journal = &argv[i][10];
+    } else if (strcmp (argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay = argv[++i];
+    } else if (strncmp (argv[i], "--replay=", 9) == 0) {
+      replay = &argv[i][9];
+    } else if (strcmp (argv[i], "--pacing=fast") == 0) {
+      pacing = GVG_REPLAY_PACING_FAST;
+    } else if (strcmp (argv[i], "--pacing=original") == 0) {
+      pacing = GVG_REPLAY_PACING_ORIGINAL;
+    } else if (strncmp (argv[i], "--pacing=", 9) == 0 &&
+               (rate = g_ascii_strtod (&argv[i][9], NULL)) > 0.0) {
+      pacing = GVG_REPLAY_PACING_RATE;
+    } else if (strncmp (argv[i], "--chunk-size=", 13) == 0) {
+      chunk_size = (gsize) g_ascii_strtoull (&argv[i][13], NULL, 10);
+    } else if (strcmp (argv[i], "--load") == 0 && i + 1 < argc) {
+      load_file = argv[++i];
+    } else if (strncmp (argv[i], "--load=", 7) == 0) {
+      load_file = &argv[i][7];
+    } else if (strcmp (argv[i], "--lazy") == 0) {
+      lazy = TRUE;
+    } else {
+      usage (argv[0]);
+      return 1;
+    }
+  }
+  
+  if (cache_list || cache_clear || cache_invalidate) {
+    GvgResultCache *result_cache = gvg_result_cache_new (cache_dir);
+    gint            ret;
+    
+    ret = manage_cache (result_cache, cache_clear, cache_invalidate);
+    gvg_result_cache_free (result_cache);
+    return ret;
+  }
+  if (benchmark) {
+    return benchmark_backends (benchmark);
+  }
+  if (cache && ! cache_dir) {
+    GvgResultCache *result_cache = gvg_result_cache_new (NULL);
+    
+    /* use the default directory */
+    cache_dir = g_intern_string (gvg_result_cache_get_dir (result_cache));
+    gvg_result_cache_free (result_cache);
+  }
+  
   window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
-  g_signal_connect (window, "destroy", gtk_main_quit, NULL);
   
   store = gvg_memcheck_store_new ();
   
   ui = gvg_ui_new (store);
   gtk_container_add (GTK_CONTAINER (window), ui);
   
-  if (argc > 1) {
-    GvgMemcheck        *memcheck;
+  if (load_file || replay || listen || i < argc) {
     GvgMemcheckOptions *options;
     GvgMemcheckParser  *parser;
+    guint               kind;
     GError *err = NULL;
     
     options = gvg_memcheck_options_new ();
     parser = GVG_MEMCHECK_PARSER (gvg_memcheck_parser_new (store));
+    gvg_xml_parser_set_backend (GVG_XML_PARSER (parser), backend);
     memcheck = gvg_memcheck_new (options, parser);
     g_object_unref (parser);
-    if (! gvg_run (GVG (memcheck), (const gchar **) &argv[1], &err)) {
-      g_warning ("failed to run memcheck: %s", err->message);
-      g_error_free (err);
-      return 1;
+    g_object_set (memcheck,
+                  "threaded", threaded,
+                  "journal-file", journal,
+                  "trace-children", trace,
+                  "leak-snapshot-interval", snapshots,
+                  "wall-time-budget", wall_budget,
+                  "cpu-time-budget", cpu_budget,
+                  "native-run", native,
+                  "output-buffer-size", output_size,
+                  "output-spill-file", output_spill,
+                  "result-cache-dir", cache ? cache_dir : NULL,
+                  "adaptive", adaptive,
+                  NULL);
+    for (kind = 0; kind < G_N_ELEMENTS (thresholds); kind++) {
+      gvg_memcheck_set_error_threshold (memcheck, kind, thresholds[kind]);
+    }
+    g_signal_connect (memcheck, "finished",
+                      G_CALLBACK (memcheck_finished), NULL);
+    if (listen) {
+      if (! gvg_listen (GVG (memcheck), (guint16) port, &err)) {
+        g_warning ("failed to listen: %s", err->message);
+        g_error_free (err);
+        return 1;
+      }
+      g_message ("listening, run valgrind --xml=yes --xml-socket=127.0.0.1:%u",
+                 gvg_get_listen_port (GVG (memcheck)));
+    }
+    if (load_file && lazy) {
+      GTimer *timer = g_timer_new ();
+      
+      if (gvg_memcheck_parser_load_indexed (parser, load_file, &err)) {
+        g_message ("%u errors indexed in %.2fs",
+                   gvg_memcheck_parser_get_error_count (parser,
+                                                        GVG_MEMCHECK_ERROR_KIND_ANY),
+                   g_timer_elapsed (timer, NULL));
+      } else if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED)) {
+        /* e.g. a compressed file, load it all instead */
+        g_message ("\"%s\" can't be indexed: %s", load_file, err->message);
+        g_clear_error (&err);
+        if (! gvg_load_file (GVG (memcheck), load_file, &err)) {
+          g_warning ("failed to load \"%s\": %s", load_file, err->message);
+          g_error_free (err);
+          return 1;
+        }
+      } else {
+        g_warning ("failed to index \"%s\": %s", load_file, err->message);
+        g_error_free (err);
+        return 1;
+      }
+      g_timer_destroy (timer);
+    } else if (load_file) {
+      if (! gvg_load_file (GVG (memcheck), load_file, &err)) {
+        g_warning ("failed to load \"%s\": %s", load_file, err->message);
+        g_error_free (err);
+        return 1;
+      }
+    } else if (replay) {
+      if (! gvg_replay_file (GVG (memcheck), replay, pacing, rate, chunk_size,
+                             &err)) {
+        g_warning ("failed to replay \"%s\": %s", replay, err->message);
+        g_error_free (err);
+        return 1;
+      }
+    } else if (queue) {
+      GvgRunQueue *jobs = gvg_run_queue_new (GVG (memcheck), max_jobs);
+      
+      g_signal_connect (jobs, "job-finished",
+                        G_CALLBACK (queue_job_finished), NULL);
+      if (! queue_commands (jobs, &argv[i])) {
+        return 1;
+      }
+    } else if (watch && i < argc) {
+      GvgWatch *watcher = gvg_watch_new (GVG (memcheck));
+      
+      g_object_set (watcher, "watch-libraries", watch_libraries, NULL);
+      g_signal_connect (watcher, "rebuilt", G_CALLBACK (watch_rebuilt), NULL);
+      if (! gvg_watch_start (watcher, (const gchar **) &argv[i], &err)) {
+        g_warning ("failed to watch \"%s\": %s", argv[i], err->message);
+        g_error_free (err);
+        return 1;
+      }
+    } else if (i < argc) {
+      gvg_run_async (GVG (memcheck), (const gchar **) &argv[i], NULL,
+                     run_progress, NULL, run_ready, NULL);
     }
   }
   
+  g_signal_connect (window, "destroy", G_CALLBACK (window_destroy), memcheck);
   gtk_widget_show_all (window);
   gtk_main ();
   
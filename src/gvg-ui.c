@@ -44,6 +44,12 @@ struct _GvgUIPrivate
   GvgMemcheckStore *store;
   GtkTreeModel     *filter;
   GtkWidget        *view;
+  
+  /* settings of the filter while the store is being cleared */
+  GvgMemcheckErrorKind  filter_kind;
+  gchar                *filter_text;
+  gboolean              filter_invert;
+  guint                 filter_pid;
 };
 
 
@@ -162,6 +168,40 @@ gvg_ui_view_object_activated (GvgMemcheckView  *view,
   g_debug ("open object %s", obj);
 }
 
+/* clearing the store under a filter and a view takes time quadratic in the
+ * number of rows, so drop them first and use a new filter afterwards */
+static void
+gvg_ui_store_clear (GvgMemcheckStore *store,
+                    GvgUI            *self)
+{
+  GvgMemcheckStoreFilter *filter = GVG_MEMCHECK_STORE_FILTER (self->priv->filter);
+  
+  self->priv->filter_kind = gvg_memcheck_store_filter_get_kind (filter);
+  self->priv->filter_text = g_strdup (gvg_memcheck_store_filter_get_text (filter));
+  self->priv->filter_invert = gvg_memcheck_store_filter_get_invert (filter);
+  self->priv->filter_pid = gvg_memcheck_store_filter_get_pid (filter);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (self->priv->view), NULL);
+  g_object_unref (self->priv->filter);
+  self->priv->filter = NULL;
+}
+
+static void
+gvg_ui_store_cleared (GvgMemcheckStore *store,
+                      GvgUI            *self)
+{
+  self->priv->filter = gvg_memcheck_store_filter_new (store, NULL);
+  g_object_set (self->priv->filter,
+                "kind", self->priv->filter_kind,
+                "text", self->priv->filter_text,
+                "invert", self->priv->filter_invert,
+                "pid", self->priv->filter_pid,
+                NULL);
+  g_free (self->priv->filter_text);
+  self->priv->filter_text = NULL;
+  gtk_tree_view_set_model (GTK_TREE_VIEW (self->priv->view),
+                           self->priv->filter);
+}
+
 static void
 gvg_ui_init (GvgUI *self)
 {
@@ -173,6 +213,7 @@ gvg_ui_init (GvgUI *self)
   
   self->priv->store = NULL;
   self->priv->filter = NULL;
+  self->priv->filter_text = NULL;
   
   /* Top bar */
   hbox = gtk_hbox_new (FALSE, 0);
@@ -235,10 +276,26 @@ gvg_ui_set_model (GvgUI            *self,
   g_return_if_fail (GVG_IS_UI (self));
   g_return_if_fail (GVG_IS_MEMCHECK_STORE (model));
   
+  if (self->priv->store) {
+    g_signal_handlers_disconnect_by_func (self->priv->store,
+                                          gvg_ui_store_clear, self);
+    g_signal_handlers_disconnect_by_func (self->priv->store,
+                                          gvg_ui_store_cleared, self);
+  }
+  if (self->priv->filter) {
+    gtk_tree_view_set_model (GTK_TREE_VIEW (self->priv->view), NULL);
+    g_object_unref (self->priv->filter);
+  }
   self->priv->store = model;
   self->priv->filter = gvg_memcheck_store_filter_new (self->priv->store, NULL);
   gtk_tree_view_set_model (GTK_TREE_VIEW (self->priv->view),
                            self->priv->filter);
+  /* the store may outlive us */
+  g_signal_connect_object (model, "clear",
+                           G_CALLBACK (gvg_ui_store_clear), self, 0);
+  g_signal_connect_object (model, "clear",
+                           G_CALLBACK (gvg_ui_store_cleared), self,
+                           G_CONNECT_AFTER);
   
   g_object_notify (G_OBJECT (self), "model");
 }
@@ -0,0 +1,569 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * What an installed Valgrind supports: its version, the version of the XML
+ * protocol it writes, and the options it accepts.
+ * 
+ * They are found by running it with --version and --help, once per binary.
+ * The results are kept in memory, and in a key file in the user's cache
+ * directory with a group per binary path, valid as long as the binary's size
+ * and modification time don't change.  Probing takes a while, so it can be
+ * done in a thread with gvg_valgrind_info_get_async().
+ */
+
+#include "gvg-valgrind-info.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#include "gvg-args-builder.h"
+
+
+#define CACHE_FILENAME  "valgrind-info.ini"
+
+
+struct _GvgValgrindInfo
+{
+  gchar      *path;
+  gchar      *version;
+  guint       major;
+  guint       minor;
+  guint       micro;
+  guint       protocol_version;
+  GHashTable *options;  /* names of the accepted options, without dashes */
+  /* the binary the information is about */
+  gint64      size;
+  gint64      mtime;
+};
+
+
+/* all the binaries probed so far, by the name they were asked with, and those
+ * replaced since because their binary changed, that may still be in use */
+static GHashTable *infos = NULL;
+static GSList     *old_infos = NULL;
+G_LOCK_DEFINE_STATIC (infos);
+
+
+static gchar *
+get_cache_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gvg", CACHE_FILENAME,
+                           NULL);
+}
+
+static GvgValgrindInfo *
+info_new (const gchar *path)
+{
+  GvgValgrindInfo *info;
+  
+  info = g_slice_new (GvgValgrindInfo);
+  info->path              = g_strdup (path);
+  info->version           = NULL;
+  info->major             = 0;
+  info->minor             = 0;
+  info->micro             = 0;
+  info->protocol_version  = 0;
+  info->options           = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, NULL);
+  info->size              = 0;
+  info->mtime             = 0;
+  
+  return info;
+}
+
+static void
+info_free (GvgValgrindInfo *info)
+{
+  g_free (info->path);
+  g_free (info->version);
+  g_hash_table_destroy (info->options);
+  g_slice_free (GvgValgrindInfo, info);
+}
+
+/* parses the "valgrind-X.Y.Z" --version output */
+static gboolean
+info_set_version (GvgValgrindInfo *info,
+                  const gchar     *version)
+{
+  if (! g_str_has_prefix (version, "valgrind-") ||
+      sscanf (version + 9, "%u.%u.%u",
+              &info->major, &info->minor, &info->micro) < 2) {
+    return FALSE;
+  }
+  
+  info->version = g_strstrip (g_strdup (version + 9));
+  /* 3.5.0 introduced the current protocol, the only one we read */
+  info->protocol_version = gvg_valgrind_info_check_version (info, 3, 5, 0) ? 4 : 3;
+  
+  return TRUE;
+}
+
+/* runs Valgrind with @arg, giving what it printed */
+static gchar *
+run_valgrind (const gchar  *path,
+              const gchar  *arg,
+              GError      **error)
+{
+  const gchar  *argv[] = { path, arg, NULL };
+  gchar        *output = NULL;
+  gint          status;
+  
+  if (! g_spawn_sync (NULL, (gchar **) argv, NULL,
+                      G_SPAWN_STDERR_TO_DEV_NULL,
+                      NULL, NULL, &output, NULL, &status, error)) {
+    return NULL;
+  }
+  if (! WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+    g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                 "\"%s %s\" failed", path, arg);
+    g_free (output);
+    return NULL;
+  }
+  
+  return output;
+}
+
+/* asks Valgrind itself.  the options are all the --NAME the help mentions,
+ * those of the default tool (memcheck) included */
+static GvgValgrindInfo *
+probe (const gchar  *path,
+       GError      **error)
+{
+  GvgValgrindInfo  *info;
+  gchar            *output;
+  GRegex           *regex;
+  GMatchInfo       *match;
+  
+  output = run_valgrind (path, "--version", error);
+  if (! output) {
+    return NULL;
+  }
+  info = info_new (path);
+  if (! info_set_version (info, output)) {
+    g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                 "unexpected version \"%s\" from %s", g_strstrip (output),
+                 path);
+    g_free (output);
+    info_free (info);
+    return NULL;
+  }
+  g_free (output);
+  
+  output = run_valgrind (path, "--help", error);
+  if (! output) {
+    info_free (info);
+    return NULL;
+  }
+  regex = g_regex_new ("(?:^|[\\s\\[])--([a-z][a-z0-9-]*)", G_REGEX_MULTILINE,
+                       0, NULL);
+  g_regex_match (regex, output, 0, &match);
+  while (g_match_info_matches (match)) {
+    g_hash_table_insert (info->options, g_match_info_fetch (match, 1), NULL);
+    g_match_info_next (match, NULL);
+  }
+  g_match_info_free (match);
+  g_regex_unref (regex);
+  g_free (output);
+  
+  return info;
+}
+
+/* reads what was found earlier about @path from the disk cache, if the
+ * binary didn't change since */
+static GvgValgrindInfo *
+load_cached (GKeyFile       *cache,
+             const gchar    *path,
+             const GStatBuf *st)
+{
+  GvgValgrindInfo  *info;
+  gchar            *version;
+  gchar           **options;
+  gsize             i;
+  
+  if (g_key_file_get_int64 (cache, path, "size", NULL) != (gint64) st->st_size ||
+      g_key_file_get_int64 (cache, path, "mtime", NULL) != (gint64) st->st_mtime) {
+    return NULL;
+  }
+  version = g_key_file_get_string (cache, path, "version", NULL);
+  options = g_key_file_get_string_list (cache, path, "options", NULL, NULL);
+  if (! version || ! options) {
+    g_free (version);
+    g_strfreev (options);
+    return NULL;
+  }
+  
+  info = info_new (path);
+  if (! info_set_version (info, version)) {
+    info_free (info);
+    info = NULL;
+  } else {
+    for (i = 0; options[i]; i++) {
+      g_hash_table_insert (info->options, options[i], NULL);
+    }
+    /* the strings now belong to the table */
+    g_free (options);
+    options = NULL;
+    if (g_key_file_has_key (cache, path, "protocol", NULL)) {
+      info->protocol_version = (guint) g_key_file_get_uint64 (cache, path,
+                                                              "protocol", NULL);
+    }
+  }
+  g_free (version);
+  g_strfreev (options);
+  
+  return info;
+}
+
+/* saves @info to the disk cache.  failing to is harmless, we'll probe again
+ * next time */
+static void
+save_cached (GKeyFile              *cache,
+             const GvgValgrindInfo *info,
+             const GStatBuf        *st)
+{
+  gchar          *filename = get_cache_filename ();
+  gchar          *dir;
+  gchar          *version;
+  gchar          *data;
+  gsize           len;
+  GPtrArray      *options;
+  GHashTableIter  iter;
+  gpointer        name;
+  GError         *err = NULL;
+  
+  version = g_strconcat ("valgrind-", info->version, NULL);
+  options = g_ptr_array_new ();
+  g_hash_table_iter_init (&iter, info->options);
+  while (g_hash_table_iter_next (&iter, &name, NULL)) {
+    g_ptr_array_add (options, name);
+  }
+  g_key_file_set_int64 (cache, info->path, "size", st->st_size);
+  g_key_file_set_int64 (cache, info->path, "mtime", st->st_mtime);
+  g_key_file_set_string (cache, info->path, "version", version);
+  g_key_file_set_uint64 (cache, info->path, "protocol", info->protocol_version);
+  g_key_file_set_string_list (cache, info->path, "options",
+                              (const gchar **) options->pdata, options->len);
+  g_ptr_array_free (options, TRUE);
+  g_free (version);
+  
+  dir = g_path_get_dirname (filename);
+  data = g_key_file_to_data (cache, &len, NULL);
+  if (g_mkdir_with_parents (dir, 0700) < 0 ||
+      ! g_file_set_contents (filename, data, len, &err)) {
+    g_debug ("failed to save the Valgrind information to %s: %s", filename,
+             err ? err->message : g_strerror (errno));
+    g_clear_error (&err);
+  }
+  g_free (data);
+  g_free (dir);
+  g_free (filename);
+}
+
+/* loads the information about the Valgrind binary at @path from the disk
+ * cache, or finds it out and caches it */
+static GvgValgrindInfo *
+load (const gchar  *path,
+      GError      **error)
+{
+  GvgValgrindInfo  *info = NULL;
+  GKeyFile         *cache;
+  gchar            *filename;
+  GStatBuf          st;
+  
+  if (g_stat (path, &st) < 0) {
+    gint errsv = errno;
+    
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+                 "cannot stat \"%s\": %s", path, g_strerror (errsv));
+    return NULL;
+  }
+  
+  cache = g_key_file_new ();
+  filename = get_cache_filename ();
+  if (g_key_file_load_from_file (cache, filename, G_KEY_FILE_NONE, NULL)) {
+    info = load_cached (cache, path, &st);
+  }
+  if (! info) {
+    g_debug ("probing %s", path);
+    info = probe (path, error);
+    if (info) {
+      save_cached (cache, info, &st);
+    }
+  }
+  if (info) {
+    info->size = (gint64) st.st_size;
+    info->mtime = (gint64) st.st_mtime;
+  }
+  g_free (filename);
+  g_key_file_free (cache);
+  
+  return info;
+}
+
+/* whether @info is about the binary now at @path */
+static gboolean
+info_is_current (const GvgValgrindInfo *info,
+                 const gchar           *path)
+{
+  GStatBuf st;
+  
+  return (strcmp (info->path, path) == 0 &&
+          g_stat (path, &st) == 0 &&
+          (gint64) st.st_size == info->size &&
+          (gint64) st.st_mtime == info->mtime);
+}
+
+/* gets what is known about @valgrind if its binary, which is looked up into
+ * @path, didn't change since */
+static GvgValgrindInfo *
+lookup (const gchar  *valgrind,
+        gchar       **path)
+{
+  GvgValgrindInfo *info = NULL;
+  
+  *path = g_find_program_in_path (valgrind);
+  if (*path) {
+    G_LOCK (infos);
+    if (infos) {
+      info = g_hash_table_lookup (infos, valgrind);
+    }
+    G_UNLOCK (infos);
+    if (info && ! info_is_current (info, *path)) {
+      info = NULL;
+    }
+  }
+  
+  return info;
+}
+
+/*
+ * gets what the Valgrind binary @valgrind supports, looking it up in PATH if
+ * it isn't a path.  the information is found out the first time for each
+ * binary and again when it changed, which blocks (see
+ * gvg_valgrind_info_get_async()).  it is then kept for the whole process, so
+ * it belongs to GVG.  may be called from any thread
+ */
+GvgValgrindInfo *
+gvg_valgrind_info_get (const gchar  *valgrind,
+                       GError      **error)
+{
+  GvgValgrindInfo *info;
+  gchar           *path;
+  
+  g_return_val_if_fail (valgrind != NULL, NULL);
+  
+  info = lookup (valgrind, &path);
+  if (! info && ! path) {
+    g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_NOENT,
+                 "cannot find Valgrind (\"%s\")", valgrind);
+  } else if (! info) {
+    /* not locked while probing, so others can look up known binaries */
+    info = load (path, error);
+    if (info) {
+      GvgValgrindInfo *old;
+      
+      G_LOCK (infos);
+      if (! infos) {
+        infos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+      }
+      old = g_hash_table_lookup (infos, valgrind);
+      if (old && info_is_current (old, path)) {
+        /* another thread probed it meanwhile */
+        info_free (info);
+        info = old;
+      } else {
+        if (old) {
+          old_infos = g_slist_prepend (old_infos, old);
+        }
+        g_hash_table_insert (infos, g_strdup (valgrind), info);
+      }
+      G_UNLOCK (infos);
+    }
+  }
+  g_free (path);
+  
+  return info;
+}
+
+/* gets what the Valgrind binary @valgrind supports if it is already known and
+ * the binary didn't change since, without probing it.  returns %NULL
+ * otherwise */
+GvgValgrindInfo *
+gvg_valgrind_info_lookup (const gchar *valgrind)
+{
+  GvgValgrindInfo *info;
+  gchar           *path;
+  
+  g_return_val_if_fail (valgrind != NULL, NULL);
+  
+  info = lookup (valgrind, &path);
+  g_free (path);
+  
+  return info;
+}
+
+static void
+get_thread (GSimpleAsyncResult *result,
+            GObject            *object,
+            GCancellable       *cancellable)
+{
+  const gchar      *valgrind = g_simple_async_result_get_op_res_gpointer (result);
+  GvgValgrindInfo  *info;
+  GError           *err = NULL;
+  
+  info = gvg_valgrind_info_get (valgrind, &err);
+  if (! info) {
+    g_simple_async_result_take_error (result, err);
+  } else {
+    g_simple_async_result_set_op_res_gpointer (result, info, NULL);
+  }
+}
+
+/* like gvg_valgrind_info_get(), but probes in a thread so it doesn't block.
+ * @callback should call gvg_valgrind_info_get_finish() */
+void
+gvg_valgrind_info_get_async (const gchar         *valgrind,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  GSimpleAsyncResult *result;
+  
+  g_return_if_fail (valgrind != NULL);
+  
+  result = g_simple_async_result_new (NULL, callback, user_data,
+                                      gvg_valgrind_info_get_async);
+  g_simple_async_result_set_op_res_gpointer (result, g_strdup (valgrind),
+                                             g_free);
+  g_simple_async_result_set_check_cancellable (result, cancellable);
+  g_simple_async_result_run_in_thread (result, get_thread, G_PRIORITY_DEFAULT,
+                                       cancellable);
+  g_object_unref (result);
+}
+
+/* gets what gvg_valgrind_info_get_async() found out, or %NULL if it failed or
+ * was cancelled */
+GvgValgrindInfo *
+gvg_valgrind_info_get_finish (GAsyncResult  *result,
+                              GError       **error)
+{
+  g_return_val_if_fail (g_simple_async_result_is_valid (result, NULL,
+                                                        gvg_valgrind_info_get_async),
+                        NULL);
+  
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error)) {
+    return NULL;
+  }
+  
+  return g_simple_async_result_get_op_res_gpointer (G_SIMPLE_ASYNC_RESULT (result));
+}
+
+/* gets the absolute path of the binary */
+const gchar *
+gvg_valgrind_info_get_path (GvgValgrindInfo *info)
+{
+  g_return_val_if_fail (info != NULL, NULL);
+  
+  return info->path;
+}
+
+/* gets the version, e.g. "3.18.1" */
+const gchar *
+gvg_valgrind_info_get_version (GvgValgrindInfo *info)
+{
+  g_return_val_if_fail (info != NULL, NULL);
+  
+  return info->version;
+}
+
+/* checks whether the version is at least @major.@minor.@micro */
+gboolean
+gvg_valgrind_info_check_version (GvgValgrindInfo *info,
+                                 guint            major,
+                                 guint            minor,
+                                 guint            micro)
+{
+  g_return_val_if_fail (info != NULL, FALSE);
+  
+  return (info->major > major ||
+          (info->major == major &&
+           (info->minor > minor ||
+            (info->minor == minor && info->micro >= micro))));
+}
+
+/* gets the version of the XML protocol it writes, as in <protocolversion> */
+guint
+gvg_valgrind_info_get_protocol_version (GvgValgrindInfo *info)
+{
+  g_return_val_if_fail (info != NULL, 0);
+  
+  return info->protocol_version;
+}
+
+/* checks whether it accepts the option --@name */
+gboolean
+gvg_valgrind_info_has_option (GvgValgrindInfo *info,
+                              const gchar     *name)
+{
+  g_return_val_if_fail (info != NULL, FALSE);
+  g_return_val_if_fail (name != NULL, FALSE);
+  
+  return g_hash_table_lookup_extended (info->options, name, NULL, NULL);
+}
+
+/* removes from @args the --NAME=VALUE options it doesn't accept, so it
+ * doesn't refuse to run.  other arguments are left alone */
+void
+gvg_valgrind_info_filter_args (GvgValgrindInfo *info,
+                               GvgArgsBuilder  *args)
+{
+  guint i = 0;
+  
+  g_return_if_fail (info != NULL);
+  g_return_if_fail (args != NULL);
+  
+  while (i < args->len) {
+    gchar *arg = g_ptr_array_index (args, i);
+    gchar *eq;
+    
+    if (arg && g_str_has_prefix (arg, "--") && (eq = strchr (arg, '='))) {
+      gboolean known;
+      
+      *eq = 0;
+      known = gvg_valgrind_info_has_option (info, arg + 2);
+      *eq = '=';
+      if (! known) {
+        g_debug ("Valgrind %s doesn't support %s, skipping it",
+                 info->version, arg);
+        g_free (g_ptr_array_remove_index (args, i));
+        continue;
+      }
+    }
+    i++;
+  }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_VALGRIND_INFO
+#define H_GVG_VALGRIND_INFO
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gvg-args-builder.h"
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgValgrindInfo GvgValgrindInfo;
+
+
+GvgValgrindInfo  *gvg_valgrind_info_get             (const gchar  *valgrind,
+                                                     GError      **error);
+void              gvg_valgrind_info_get_async       (const gchar         *valgrind,
+                                                     GCancellable        *cancellable,
+                                                     GAsyncReadyCallback  callback,
+                                                     gpointer             user_data);
+GvgValgrindInfo  *gvg_valgrind_info_get_finish      (GAsyncResult  *result,
+                                                     GError       **error);
+GvgValgrindInfo  *gvg_valgrind_info_lookup          (const gchar *valgrind);
+const gchar      *gvg_valgrind_info_get_path        (GvgValgrindInfo *info);
+const gchar      *gvg_valgrind_info_get_version     (GvgValgrindInfo *info);
+gboolean          gvg_valgrind_info_check_version   (GvgValgrindInfo *info,
+                                                     guint            major,
+                                                     guint            minor,
+                                                     guint            micro);
+guint             gvg_valgrind_info_get_protocol_version  (GvgValgrindInfo *info);
+gboolean          gvg_valgrind_info_has_option      (GvgValgrindInfo *info,
+                                                     const gchar     *name);
+void              gvg_valgrind_info_filter_args     (GvgValgrindInfo *info,
+                                                     GvgArgsBuilder  *args);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,620 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Runs a program under Valgrind again each time it is rebuilt.
+ * 
+ * The program, and optionally the shared libraries it links to, are
+ * monitored for changes.  Once they stopped changing for a while, so the
+ * build is likely over, a run still going on is stopped and a new one is
+ * started.  Each run gets its own parser group (see
+ * gvg_xml_parser_set_group()), and when the results go to a
+ * GvgMemcheckStore, those of the previous run are kept until the new one
+ * finds its first error, or completes without any.
+ */
+
+#include "gvg-watch.h"
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "gvg.h"
+#include "gvg-xml-parser.h"
+#include "gvg-memcheck-parser.h"
+#include "gvg-memcheck-store.h"
+#include "gvg-result-cache.h"
+
+
+struct _GvgWatchPrivate
+{
+  Gvg        *gvg;
+  gboolean    watch_libraries;
+  guint       settle_time;
+  
+  gchar     **argv;     /* the program being watched, or %NULL */
+  gchar      *program;  /* its absolute path */
+  GPtrArray  *monitors;
+  GCancellable *list_cancellable; /* listing the files to watch */
+  guint       settle_timeout;
+  guint       restart_idle;
+  gboolean    restart_pending;  /* waiting for the stopped run to finish */
+  gulong      finished_handler;
+  gulong      error_handler;
+  
+  guint       shown_group;  /* group of the results on display */
+  guint       run_group;    /* group of the current run */
+  guint       next_group;
+};
+
+
+G_DEFINE_TYPE (GvgWatch,
+               gvg_watch,
+               G_TYPE_OBJECT)
+
+
+static void     gvg_watch_finalize      (GObject *object);
+static void     gvg_watch_get_property  (GObject    *object,
+                                         guint       prop_id,
+                                         GValue     *value,
+                                         GParamSpec *pspec);
+static void     gvg_watch_set_property  (GObject      *object,
+                                         guint         prop_id,
+                                         const GValue *value,
+                                         GParamSpec   *pspec);
+
+
+enum
+{
+  SIGNAL_REBUILT,
+  N_SIGNALS
+};
+
+enum
+{
+  PROP_0,
+  PROP_GVG,
+  PROP_WATCH_LIBRARIES,
+  PROP_SETTLE_TIME
+};
+
+
+static guint signals[N_SIGNALS] = { 0 };
+
+
+static void
+gvg_watch_class_init (GvgWatchClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  
+  object_class->finalize      = gvg_watch_finalize;
+  object_class->get_property  = gvg_watch_get_property;
+  object_class->set_property  = gvg_watch_set_property;
+  
+  g_object_class_install_property (object_class,
+                                   PROP_GVG,
+                                   g_param_spec_object ("gvg",
+                                                        "Gvg",
+                                                        "The Gvg running the program",
+                                                        GVG_TYPE_GVG,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_CONSTRUCT_ONLY));
+  g_object_class_install_property (object_class,
+                                   PROP_WATCH_LIBRARIES,
+                                   g_param_spec_boolean ("watch-libraries",
+                                                         "Watch libraries",
+                                                         "Whether to also run again when a shared "
+                                                         "library the program links to changes",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_SETTLE_TIME,
+                                   g_param_spec_uint ("settle-time",
+                                                      "Settle time",
+                                                      "Time in milliseconds the watched files must "
+                                                      "stay unchanged before running again",
+                                                      0, G_MAXUINT, 500,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_CONSTRUCT));
+  
+  /* emitted when the program was rebuilt, before it is run again */
+  signals[SIGNAL_REBUILT] = g_signal_new ("rebuilt",
+                                          GVG_TYPE_WATCH,
+                                          G_SIGNAL_RUN_LAST,
+                                          G_STRUCT_OFFSET (GvgWatchClass, rebuilt),
+                                          NULL, NULL,
+                                          g_cclosure_marshal_VOID__VOID,
+                                          G_TYPE_NONE,
+                                          0);
+  
+  g_type_class_add_private (klass, sizeof (GvgWatchPrivate));
+}
+
+static void
+gvg_watch_init (GvgWatch *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_WATCH,
+                                            GvgWatchPrivate);
+  
+  self->priv->gvg               = NULL;
+  self->priv->watch_libraries   = FALSE;
+  self->priv->settle_time       = 500;
+  self->priv->argv              = NULL;
+  self->priv->program           = NULL;
+  self->priv->monitors          = NULL;
+  self->priv->list_cancellable  = NULL;
+  self->priv->settle_timeout    = 0;
+  self->priv->restart_idle      = 0;
+  self->priv->restart_pending   = FALSE;
+  self->priv->finished_handler  = 0;
+  self->priv->error_handler     = 0;
+  self->priv->shown_group       = 0;
+  self->priv->run_group         = 0;
+  self->priv->next_group        = 0;
+}
+
+static void
+gvg_watch_finalize (GObject *object)
+{
+  GvgWatch *self = GVG_WATCH (object);
+  
+  gvg_watch_stop (self);
+  if (self->priv->gvg) {
+    g_object_unref (self->priv->gvg);
+  }
+  
+  G_OBJECT_CLASS (gvg_watch_parent_class)->finalize (object);
+}
+
+static void
+gvg_watch_get_property (GObject    *object,
+                        guint       prop_id,
+                        GValue     *value,
+                        GParamSpec *pspec)
+{
+  GvgWatch *self = GVG_WATCH (object);
+  
+  switch (prop_id) {
+    case PROP_GVG:
+      g_value_set_object (value, self->priv->gvg);
+      break;
+    
+    case PROP_WATCH_LIBRARIES:
+      g_value_set_boolean (value, self->priv->watch_libraries);
+      break;
+    
+    case PROP_SETTLE_TIME:
+      g_value_set_uint (value, self->priv->settle_time);
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+gvg_watch_set_property (GObject      *object,
+                        guint         prop_id,
+                        const GValue *value,
+                        GParamSpec   *pspec)
+{
+  GvgWatch *self = GVG_WATCH (object);
+  
+  switch (prop_id) {
+    case PROP_GVG:
+      self->priv->gvg = g_value_dup_object (value);
+      break;
+    
+    /* only affects the next gvg_watch_start() */
+    case PROP_WATCH_LIBRARIES:
+      self->priv->watch_libraries = g_value_get_boolean (value);
+      break;
+    
+    case PROP_SETTLE_TIME:
+      self->priv->settle_time = g_value_get_uint (value);
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+/* removes the results of @group, if they are in a store we know */
+static void
+remove_group (GvgWatch *self,
+              guint     group)
+{
+  GvgXmlParser *parser;
+  
+  g_object_get (self->priv->gvg, "parser", &parser, NULL);
+  if (GVG_IS_MEMCHECK_PARSER (parser)) {
+    GvgMemcheckStore *store;
+    
+    g_object_get (parser, "store", &store, NULL);
+    gvg_memcheck_store_remove_group (store, group);
+    g_object_unref (store);
+  }
+  g_object_unref (parser);
+}
+
+/* replaces the results on display with those of the current run */
+static void
+replace_results (GvgWatch *self)
+{
+  if (self->priv->shown_group != self->priv->run_group) {
+    remove_group (self, self->priv->shown_group);
+    self->priv->shown_group = self->priv->run_group;
+  }
+}
+
+static void
+parser_error (GvgMemcheckParser    *parser,
+              GvgMemcheckErrorKind  kind,
+              guint                 count,
+              GvgWatch             *self)
+{
+  replace_results (self);
+}
+
+static void settle_timeout_remove (GvgWatch *self);
+static void restart (GvgWatch *self);
+
+static gboolean
+settle_timeout_handler (gpointer data)
+{
+  GvgWatch *self = data;
+  
+  self->priv->settle_timeout = 0;
+  /* the build may have removed it and not written the new one yet, the next
+   * change will tell */
+  if (! g_file_test (self->priv->program, G_FILE_TEST_IS_EXECUTABLE)) {
+    g_debug ("%s is gone, waiting for it to come back", self->priv->program);
+  } else {
+    restart (self);
+  }
+  
+  return FALSE;
+}
+
+static void
+settle_timeout_remove (GvgWatch *self)
+{
+  if (self->priv->settle_timeout) {
+    g_source_remove (self->priv->settle_timeout);
+    self->priv->settle_timeout = 0;
+  }
+}
+
+/* waits for the files to settle again after each change, a build usually
+ * writes them in many steps */
+static void
+monitor_changed (GFileMonitor      *monitor,
+                 GFile             *file,
+                 GFile             *other_file,
+                 GFileMonitorEvent  event_type,
+                 GvgWatch          *self)
+{
+  if (event_type == G_FILE_MONITOR_EVENT_PRE_UNMOUNT ||
+      event_type == G_FILE_MONITOR_EVENT_UNMOUNTED) {
+    return;
+  }
+  
+  settle_timeout_remove (self);
+  self->priv->settle_timeout = g_timeout_add (self->priv->settle_time,
+                                              settle_timeout_handler, self);
+}
+
+static void
+monitor_free (gpointer data)
+{
+  GFileMonitor *monitor = data;
+  
+  g_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+/* monitors @files, the first one being the program, instead of those
+ * monitored so far.  fails if the program can't be */
+static gboolean
+set_monitors (GvgWatch  *self,
+              gchar    **files,
+              GError   **error)
+{
+  GPtrArray  *monitors;
+  gsize       i;
+  gboolean    success;
+  
+  monitors = g_ptr_array_new_with_free_func (monitor_free);
+  for (i = 0; files[i]; i++) {
+    GFile        *file = g_file_new_for_path (files[i]);
+    GFileMonitor *monitor;
+    GError       *err = NULL;
+    
+    monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, &err);
+    if (monitor) {
+      g_signal_connect (monitor, "changed",
+                        G_CALLBACK (monitor_changed), self);
+      g_ptr_array_add (monitors, monitor);
+    } else if (i == 0) {
+      g_propagate_error (error, err);
+      g_object_unref (file);
+      break;
+    } else {
+      g_warning ("cannot watch %s: %s", files[i], err->message);
+      g_error_free (err);
+    }
+    g_object_unref (file);
+  }
+  
+  /* keep the old ones on failure */
+  success = monitors->len > 0;
+  if (! success) {
+    g_ptr_array_unref (monitors);
+  } else {
+    if (self->priv->monitors) {
+      g_ptr_array_unref (self->priv->monitors);
+    }
+    self->priv->monitors = monitors;
+    g_free (self->priv->program);
+    self->priv->program = g_strdup (files[0]);
+  }
+  
+  return success;
+}
+
+static void
+files_listed (GObject      *object,
+              GAsyncResult *result,
+              gpointer      data)
+{
+  GvgWatch  *self = data;
+  gchar    **files;
+  GError    *err = NULL;
+  
+  files = gvg_result_cache_list_files_finish (result, &err);
+  if (! files) {
+    if (! g_error_matches (err, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning ("failed to list the watched files: %s", err->message);
+    }
+    g_error_free (err);
+  } else {
+    if (! set_monitors (self, files, &err)) {
+      g_warning ("failed to update the watched files: %s", err->message);
+      g_error_free (err);
+    }
+    g_strfreev (files);
+  }
+  g_object_unref (self);
+}
+
+/* monitors the program and the libraries it links to, once they are listed
+ * in a thread (see gvg_result_cache_list_files_async()).  the libraries may
+ * change with each build, so it is done again for each run */
+static void
+update_monitors (GvgWatch *self)
+{
+  if (self->priv->list_cancellable) {
+    g_cancellable_cancel (self->priv->list_cancellable);
+    g_object_unref (self->priv->list_cancellable);
+  }
+  self->priv->list_cancellable = g_cancellable_new ();
+  gvg_result_cache_list_files_async ((const gchar **) self->priv->argv,
+                                     self->priv->list_cancellable,
+                                     files_listed, g_object_ref (self));
+}
+
+/* monitors the program right away, and maybe its libraries later */
+static gboolean
+setup_monitors (GvgWatch  *self,
+                GError   **error)
+{
+  gchar   **files;
+  gboolean  success;
+  
+  files = gvg_result_cache_list_files ((const gchar **) self->priv->argv,
+                                       FALSE, error);
+  success = files && set_monitors (self, files, error);
+  g_strfreev (files);
+  if (success && self->priv->watch_libraries) {
+    update_monitors (self);
+  }
+  
+  return success;
+}
+
+/* starts a run in its own group */
+static gboolean
+start_run (GvgWatch  *self,
+           GError   **error)
+{
+  GvgXmlParser *parser;
+  
+  /* the results of a run stopped before it found anything are useless */
+  if (self->priv->run_group != self->priv->shown_group) {
+    remove_group (self, self->priv->run_group);
+  }
+  
+  g_object_get (self->priv->gvg, "parser", &parser, NULL);
+  self->priv->run_group = self->priv->next_group++;
+  gvg_xml_parser_set_group (parser, self->priv->run_group);
+  g_object_unref (parser);
+  
+  return gvg_run (self->priv->gvg, (const gchar **) self->priv->argv, error);
+}
+
+static gboolean
+restart_idle_handler (gpointer data)
+{
+  GvgWatch *self = data;
+  GError   *err = NULL;
+  
+  self->priv->restart_idle = 0;
+  /* somebody else started a run meanwhile */
+  if (gvg_is_busy (self->priv->gvg)) {
+    self->priv->restart_pending = TRUE;
+    gvg_stop (self->priv->gvg);
+    return FALSE;
+  }
+  if (self->priv->watch_libraries) {
+    update_monitors (self);
+  }
+  if (! start_run (self, &err)) {
+    g_warning ("failed to run again: %s", err->message);
+    g_error_free (err);
+  }
+  
+  return FALSE;
+}
+
+/* runs the program again, stopping the current run first.  the new run is
+ * started from an idle so it isn't nested in the handlers of the previous
+ * one */
+static void
+restart (GvgWatch *self)
+{
+  g_signal_emit (self, signals[SIGNAL_REBUILT], 0);
+  
+  if (gvg_is_busy (self->priv->gvg)) {
+    self->priv->restart_pending = TRUE;
+    gvg_stop (self->priv->gvg);
+  } else if (! self->priv->restart_idle) {
+    self->priv->restart_idle = g_idle_add (restart_idle_handler, self);
+  }
+}
+
+static void
+gvg_finished (Gvg      *gvg,
+              GvgWatch *self)
+{
+  if (self->priv->restart_pending) {
+    self->priv->restart_pending = FALSE;
+    if (! self->priv->restart_idle) {
+      self->priv->restart_idle = g_idle_add (restart_idle_handler, self);
+    }
+  } else if (gvg_get_stop_reason (gvg, NULL) == GVG_STOP_REASON_NONE) {
+    /* no error, but the results are just as new */
+    replace_results (self);
+  }
+}
+
+GvgWatch *
+gvg_watch_new (Gvg *gvg)
+{
+  return g_object_new (GVG_TYPE_WATCH, "gvg", gvg, NULL);
+}
+
+/*
+ * runs @program_argv under Valgrind, and again each time it is rebuilt until
+ * gvg_watch_stop() is called.  fails if the program can't be found or
+ * watched, or if the first run fails to start
+ */
+gboolean
+gvg_watch_start (GvgWatch      *self,
+                 const gchar  **program_argv,
+                 GError       **error)
+{
+  GvgXmlParser *parser;
+  
+  g_return_val_if_fail (GVG_IS_WATCH (self), FALSE);
+  g_return_val_if_fail (program_argv != NULL && program_argv[0] != NULL, FALSE);
+  g_return_val_if_fail (! gvg_watch_is_watching (self), FALSE);
+  g_return_val_if_fail (! gvg_is_busy (self->priv->gvg), FALSE);
+  
+  self->priv->argv = g_strdupv ((gchar **) program_argv);
+  if (! setup_monitors (self, error)) {
+    gvg_watch_stop (self);
+    return FALSE;
+  }
+  
+  /* the first run has nothing to replace */
+  g_object_get (self->priv->gvg, "parser", &parser, NULL);
+  self->priv->shown_group = gvg_xml_parser_get_group (parser);
+  self->priv->run_group = self->priv->shown_group;
+  self->priv->next_group = self->priv->shown_group + 1;
+  if (GVG_IS_MEMCHECK_PARSER (parser)) {
+    self->priv->error_handler = g_signal_connect (parser, "error",
+                                                  G_CALLBACK (parser_error),
+                                                  self);
+  }
+  g_object_unref (parser);
+  self->priv->finished_handler = g_signal_connect (self->priv->gvg, "finished",
+                                                   G_CALLBACK (gvg_finished),
+                                                   self);
+  
+  if (! gvg_run (self->priv->gvg, program_argv, error)) {
+    gvg_watch_stop (self);
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+/* stops watching the program.  a run going on isn't stopped, see
+ * gvg_stop() */
+void
+gvg_watch_stop (GvgWatch *self)
+{
+  g_return_if_fail (GVG_IS_WATCH (self));
+  
+  settle_timeout_remove (self);
+  if (self->priv->restart_idle) {
+    g_source_remove (self->priv->restart_idle);
+    self->priv->restart_idle = 0;
+  }
+  self->priv->restart_pending = FALSE;
+  if (self->priv->list_cancellable) {
+    g_cancellable_cancel (self->priv->list_cancellable);
+    g_object_unref (self->priv->list_cancellable);
+    self->priv->list_cancellable = NULL;
+  }
+  if (self->priv->monitors) {
+    g_ptr_array_unref (self->priv->monitors);
+    self->priv->monitors = NULL;
+  }
+  if (self->priv->finished_handler) {
+    g_signal_handler_disconnect (self->priv->gvg,
+                                 self->priv->finished_handler);
+    self->priv->finished_handler = 0;
+  }
+  if (self->priv->error_handler) {
+    GvgXmlParser *parser;
+    
+    g_object_get (self->priv->gvg, "parser", &parser, NULL);
+    g_signal_handler_disconnect (parser, self->priv->error_handler);
+    g_object_unref (parser);
+    self->priv->error_handler = 0;
+  }
+  g_strfreev (self->priv->argv);
+  self->priv->argv = NULL;
+  g_free (self->priv->program);
+  self->priv->program = NULL;
+}
+
+gboolean
+gvg_watch_is_watching (GvgWatch *self)
+{
+  g_return_val_if_fail (GVG_IS_WATCH (self), FALSE);
+  
+  return self->priv->argv != NULL;
+}
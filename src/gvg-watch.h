@@ -0,0 +1,70 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_WATCH
+#define H_GVG_WATCH
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include "gvg.h"
+
+G_BEGIN_DECLS
+
+
+#define GVG_TYPE_WATCH            (gvg_watch_get_type ())
+#define GVG_WATCH(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GVG_TYPE_WATCH, GvgWatch))
+#define GVG_WATCH_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GVG_TYPE_WATCH, GvgWatchClass))
+#define GVG_IS_WATCH(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GVG_TYPE_WATCH))
+#define GVG_IS_WATCH_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GVG_TYPE_WATCH))
+#define GVG_WATCH_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GVG_TYPE_WATCH, GvgWatchClass))
+
+
+typedef struct _GvgWatch        GvgWatch;
+typedef struct _GvgWatchClass   GvgWatchClass;
+typedef struct _GvgWatchPrivate GvgWatchPrivate;
+
+struct _GvgWatch
+{
+  GObject          parent;
+  GvgWatchPrivate *priv;
+};
+
+struct _GvgWatchClass
+{
+  GObjectClass parent_class;
+  
+  void        (*rebuilt)          (GvgWatch *self);
+};
+
+
+GType         gvg_watch_get_type      (void) G_GNUC_CONST;
+GvgWatch     *gvg_watch_new           (Gvg *gvg);
+gboolean      gvg_watch_start         (GvgWatch      *self,
+                                       const gchar  **program_argv,
+                                       GError       **error);
+void          gvg_watch_stop          (GvgWatch *self);
+gboolean      gvg_watch_is_watching   (GvgWatch *self);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Reads a saved Valgrind XML file in large slices.
+ * 
+ * The file is mapped in memory, and uncompressed files are handed out as
+ * slices of the mapping directly.  Compressed files (gzip or zstd, detected
+ * from their magic bytes) are decompressed progressively in a fixed-size
+ * buffer, so they are never inflated completely in memory.
+ * 
+ * Pages already handed out are released as we go so that reading a huge file
+ * doesn't keep it all resident.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "gvg-xml-file.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+
+#define SLICE_SIZE        (4 * 1024 * 1024)
+
+
+typedef enum {
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,
+  COMPRESSION_ZSTD
+} Compression;
+
+struct _GvgXmlFile
+{
+  GMappedFile  *mapping;
+  const gchar  *data;
+  gsize         size;
+  gsize         pos;
+  gsize         released;   /* how much of the mapping was released */
+  gsize         page_size;
+  
+  Compression   compression;
+  GConverter   *converter;
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *zstream;
+#endif
+  gchar        *buffer;
+  gboolean      finished;
+};
+
+
+static Compression
+detect_compression (const gchar *data,
+                    gsize        size)
+{
+  static const guchar gzip_magic[] = { 0x1f, 0x8b };
+  static const guchar zstd_magic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+  
+  if (size >= sizeof gzip_magic &&
+      memcmp (data, gzip_magic, sizeof gzip_magic) == 0) {
+    return COMPRESSION_GZIP;
+  } else if (size >= sizeof zstd_magic &&
+             memcmp (data, zstd_magic, sizeof zstd_magic) == 0) {
+    return COMPRESSION_ZSTD;
+  }
+  
+  return COMPRESSION_NONE;
+}
+
+GvgXmlFile *
+gvg_xml_file_open (const gchar  *filename,
+                   GError      **error)
+{
+  GvgXmlFile   *self;
+  GMappedFile  *mapping;
+  
+  g_return_val_if_fail (filename != NULL, NULL);
+  
+  mapping = g_mapped_file_new (filename, FALSE, error);
+  if (! mapping) {
+    return NULL;
+  }
+  
+  self = g_slice_new0 (GvgXmlFile);
+  self->mapping     = mapping;
+  self->data        = g_mapped_file_get_contents (mapping);
+  self->size        = g_mapped_file_get_length (mapping);
+  self->pos         = 0;
+  self->released    = 0;
+  self->page_size   = (gsize) sysconf (_SC_PAGESIZE);
+  self->finished    = FALSE;
+  self->compression = detect_compression (self->data, self->size);
+  
+#ifdef MADV_SEQUENTIAL
+  if (self->size > 0) {
+    madvise ((gpointer) self->data, self->size, MADV_SEQUENTIAL);
+  }
+#endif
+  
+  switch (self->compression) {
+    case COMPRESSION_NONE:
+      break;
+    
+    case COMPRESSION_GZIP:
+      self->converter = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+      self->buffer = g_malloc (SLICE_SIZE);
+      break;
+    
+    case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+      self->zstream = ZSTD_createDStream ();
+      ZSTD_initDStream (self->zstream);
+      self->buffer = g_malloc (SLICE_SIZE);
+      break;
+#else
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Cannot read \"%s\": zstd support is not available",
+                   filename);
+      gvg_xml_file_free (self);
+      return NULL;
+#endif
+  }
+  
+  return self;
+}
+
+void
+gvg_xml_file_free (GvgXmlFile *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  if (self->converter) {
+    g_object_unref (self->converter);
+  }
+#ifdef HAVE_ZSTD
+  if (self->zstream) {
+    ZSTD_freeDStream (self->zstream);
+  }
+#endif
+  g_free (self->buffer);
+  g_mapped_file_unref (self->mapping);
+  g_slice_free (GvgXmlFile, self);
+}
+
+/* releases the mapped pages before the current position, they won't be
+ * needed anymore */
+static void
+release_consumed (GvgXmlFile *self)
+{
+#ifdef MADV_DONTNEED
+  gsize end = self->pos - self->pos % self->page_size;
+  
+  if (end > self->released) {
+    madvise ((gpointer) (self->data + self->released), end - self->released,
+             MADV_DONTNEED);
+    self->released = end;
+  }
+#endif
+}
+
+static const gchar *
+next_gzip_slice (GvgXmlFile  *self,
+                 gsize       *len,
+                 GError     **error)
+{
+  GConverterResult  result;
+  gsize             bytes_read    = 0;
+  gsize             bytes_written = 0;
+  
+  result = g_converter_convert (self->converter,
+                                self->data + self->pos, self->size - self->pos,
+                                self->buffer, SLICE_SIZE,
+                                G_CONVERTER_INPUT_AT_END,
+                                &bytes_read, &bytes_written, error);
+  if (result == G_CONVERTER_ERROR) {
+    return NULL;
+  }
+  self->pos += bytes_read;
+  if (result == G_CONVERTER_FINISHED) {
+    if (self->pos < self->size &&
+        detect_compression (self->data + self->pos,
+                            self->size - self->pos) == COMPRESSION_GZIP) {
+      /* concatenated gzip members */
+      g_converter_reset (self->converter);
+    } else {
+      self->finished = TRUE;
+    }
+  }
+  
+  *len = bytes_written;
+  return self->buffer;
+}
+
+#ifdef HAVE_ZSTD
+static const gchar *
+next_zstd_slice (GvgXmlFile  *self,
+                 gsize       *len,
+                 GError     **error)
+{
+  ZSTD_inBuffer   in;
+  ZSTD_outBuffer  out;
+  gsize           ret;
+  
+  in.src    = self->data;
+  in.size   = self->size;
+  in.pos    = self->pos;
+  out.dst   = self->buffer;
+  out.size  = SLICE_SIZE;
+  out.pos   = 0;
+  
+  ret = ZSTD_decompressStream (self->zstream, &out, &in);
+  if (ZSTD_isError (ret)) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                 "Failed to decompress data: %s", ZSTD_getErrorName (ret));
+    return NULL;
+  }
+  self->pos = in.pos;
+  if (self->pos >= self->size && out.pos < out.size) {
+    /* all input consumed and the output flushed */
+    self->finished = TRUE;
+  }
+  
+  *len = out.pos;
+  return self->buffer;
+}
+#endif
+
+/* gets the next slice of the file's content.  the returned data is owned by
+ * @file and valid until the next call.  returns %NULL either at the end of the
+ * file or on error, check @error or gvg_xml_file_is_eof() */
+const gchar *
+gvg_xml_file_next_slice (GvgXmlFile  *self,
+                         gsize       *len,
+                         GError     **error)
+{
+  const gchar *slice = NULL;
+  
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (len != NULL, NULL);
+  
+  *len = 0;
+  if (self->finished) {
+    return NULL;
+  }
+  
+  release_consumed (self);
+  switch (self->compression) {
+    case COMPRESSION_NONE:
+      slice = self->data + self->pos;
+      *len = MIN (SLICE_SIZE, self->size - self->pos);
+      self->pos += *len;
+      self->finished = self->pos >= self->size;
+      break;
+    
+    case COMPRESSION_GZIP:
+      slice = next_gzip_slice (self, len, error);
+      break;
+    
+    case COMPRESSION_ZSTD:
+#ifdef HAVE_ZSTD
+      slice = next_zstd_slice (self, len, error);
+#endif
+      break;
+  }
+  
+  return slice;
+}
+
+gboolean
+gvg_xml_file_is_eof (GvgXmlFile *self)
+{
+  g_return_val_if_fail (self != NULL, TRUE);
+  
+  return self->finished;
+}
+
+/* the size and position are in the file, so may not match the amount of data
+ * returned for compressed files.  they can be used to report progress */
+goffset
+gvg_xml_file_get_size (GvgXmlFile *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return (goffset) self->size;
+}
+
+goffset
+gvg_xml_file_get_position (GvgXmlFile *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return (goffset) self->pos;
+}
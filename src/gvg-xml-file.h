@@ -0,0 +1,46 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_FILE
+#define H_GVG_XML_FILE
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlFile GvgXmlFile;
+
+
+GvgXmlFile     *gvg_xml_file_open         (const gchar  *filename,
+                                           GError      **error);
+void            gvg_xml_file_free         (GvgXmlFile *file);
+const gchar    *gvg_xml_file_next_slice   (GvgXmlFile  *file,
+                                           gsize       *len,
+                                           GError     **error);
+gboolean        gvg_xml_file_is_eof       (GvgXmlFile *file);
+goffset         gvg_xml_file_get_size     (GvgXmlFile *file);
+goffset         gvg_xml_file_get_position (GvgXmlFile *file);
+
+
+G_END_DECLS
+
+#endif /* guard */
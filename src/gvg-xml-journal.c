@@ -0,0 +1,368 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Saves a raw XML stream to a gzip-compressed file, so a run can be loaded
+ * again later with gvg_load_file().
+ * 
+ * Data is only copied by gvg_xml_journal_write(), compression and I/O are
+ * done by a background thread so they don't slow down the reading side.  If
+ * the thread doesn't keep up and would hold more than MAX_QUEUED_SIZE bytes,
+ * the journal is dropped rather than making the reading side wait: nothing
+ * more is written, and it is reported as incomplete when closed.
+ * gvg_xml_journal_mark() tells a record boundary
+ * was reached: the compressor is flushed right after the data written so
+ * far, so what the file contains is always readable up to the last record,
+ * even after a crash.  Closing is done by the thread too, which tells when
+ * it's done from the main loop.
+ * 
+ * The arrival time of each chunk is saved along in FILENAME.timing, one
+ * "END-OFFSET MICROSECONDS" line per chunk, so the stream can be replayed
+ * with its original pacing (see GvgXmlReplay).
+ */
+
+#include "gvg-xml-journal.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+
+
+/* how much data may wait to be written */
+#define MAX_QUEUED_SIZE (4 * 1024 * 1024)
+
+
+typedef struct _JournalChunk JournalChunk;
+
+/* data to write, or a flush if @data is %NULL */
+struct _JournalChunk
+{
+  GBytes *data;
+  gint64  time;
+};
+
+struct _GvgXmlJournal
+{
+  GOutputStream  *stream;
+  GOutputStream  *timing;
+  guint64         offset;
+  gint64          start_time;
+  gboolean        success;
+  
+  /* protected by @lock */
+  GMutex          lock;
+  GCond           cond;
+  GQueue          chunks;
+  gsize           queued_size;
+  gboolean        closing;
+  gboolean        dropped;  /* whether the queue overflowed */
+  
+  GvgXmlJournalClosedFunc closed_func;
+  gpointer                closed_data;
+};
+
+
+static gboolean
+journal_check (GvgXmlJournal *self,
+               gboolean       success,
+               GError        *err)
+{
+  if (! success) {
+    g_warning ("failed to write XML journal: %s", err->message);
+    g_error_free (err);
+    g_object_unref (self->stream);
+    self->stream = NULL;
+  }
+  
+  return success;
+}
+
+/* writes a chunk, or flushes if its data is %NULL.  on failure, the stream
+ * is dropped and nothing more will be written */
+static void
+journal_output (GvgXmlJournal *self,
+                JournalChunk  *chunk)
+{
+  GError   *err = NULL;
+  gboolean  success;
+  
+  if (! self->stream) {
+    return;
+  }
+  
+  if (chunk->data) {
+    gsize         len;
+    gconstpointer data = g_bytes_get_data (chunk->data, &len);
+    gchar         line[64];
+    
+    success = g_output_stream_write_all (self->stream, data, len, NULL, NULL,
+                                         &err);
+    if (journal_check (self, success, err)) {
+      self->offset += len;
+      g_snprintf (line, sizeof line,
+                  "%" G_GUINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+                  self->offset, chunk->time);
+      success = g_output_stream_write_all (self->timing, line, strlen (line),
+                                           NULL, NULL, &err);
+      journal_check (self, success, err);
+    }
+  } else {
+    success = (g_output_stream_flush (self->stream, NULL, &err) &&
+               g_output_stream_flush (self->timing, NULL, &err));
+    journal_check (self, success, err);
+  }
+}
+
+static gsize
+chunk_size (JournalChunk *chunk)
+{
+  return chunk->data ? g_bytes_get_size (chunk->data) : 0;
+}
+
+static void
+chunk_free (JournalChunk *chunk)
+{
+  if (chunk->data) {
+    g_bytes_unref (chunk->data);
+  }
+  g_slice_free (JournalChunk, chunk);
+}
+
+/* tells the journal was closed from the main loop, and frees it */
+static gboolean
+journal_closed (gpointer data)
+{
+  GvgXmlJournal *self = data;
+  
+  if (self->closed_func) {
+    self->closed_func (self->success, self->closed_data);
+  }
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+  g_slice_free (GvgXmlJournal, self);
+  
+  return FALSE;
+}
+
+static void
+journal_close_streams (GvgXmlJournal *self,
+                       gboolean       complete)
+{
+  if (self->stream) {
+    GError *err = NULL;
+    
+    if (! g_output_stream_close (self->stream, NULL, &err) ||
+        ! g_output_stream_close (self->timing, NULL, &err)) {
+      g_warning ("failed to close XML journal: %s", err->message);
+      g_error_free (err);
+    } else {
+      self->success = complete;
+    }
+    g_object_unref (self->stream);
+    self->stream = NULL;
+  }
+  g_object_unref (self->timing);
+  self->timing = NULL;
+}
+
+static gpointer
+journal_thread (gpointer data)
+{
+  GvgXmlJournal *self = data;
+  gboolean       dropped;
+  
+  g_mutex_lock (&self->lock);
+  for (;;) {
+    JournalChunk *chunk;
+    
+    while (g_queue_is_empty (&self->chunks) && ! self->closing) {
+      g_cond_wait (&self->cond, &self->lock);
+    }
+    chunk = g_queue_pop_head (&self->chunks);
+    if (! chunk) {
+      break;
+    }
+    self->queued_size -= chunk_size (chunk);
+    g_mutex_unlock (&self->lock);
+    
+    journal_output (self, chunk);
+    chunk_free (chunk);
+    
+    g_mutex_lock (&self->lock);
+  }
+  dropped = self->dropped;
+  g_mutex_unlock (&self->lock);
+  
+  journal_close_streams (self, ! dropped);
+  /* the main loop frees us, so don't touch anything afterwards */
+  g_idle_add (journal_closed, self);
+  
+  return NULL;
+}
+
+static GOutputStream *
+create_file (const gchar  *filename,
+             GError      **error)
+{
+  GFile             *file;
+  GFileOutputStream *stream;
+  
+  file = g_file_new_for_path (filename);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+  
+  return (GOutputStream *) stream;
+}
+
+/* creates or replaces @filename and its timing file */
+GvgXmlJournal *
+gvg_xml_journal_new (const gchar  *filename,
+                     GError      **error)
+{
+  GvgXmlJournal     *self;
+  GOutputStream     *file_stream;
+  GOutputStream     *timing_stream;
+  GZlibCompressor   *compressor;
+  gchar             *timing_filename;
+  GThread           *thread;
+  
+  g_return_val_if_fail (filename != NULL, NULL);
+  
+  file_stream = create_file (filename, error);
+  if (! file_stream) {
+    return NULL;
+  }
+  timing_filename = g_strconcat (filename, ".timing", NULL);
+  timing_stream = create_file (timing_filename, error);
+  g_free (timing_filename);
+  if (! timing_stream) {
+    g_object_unref (file_stream);
+    return NULL;
+  }
+  
+  self = g_slice_new (GvgXmlJournal);
+  compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+  self->stream = g_converter_output_stream_new (file_stream,
+                                                G_CONVERTER (compressor));
+  g_object_unref (compressor);
+  g_object_unref (file_stream);
+  self->timing = g_buffered_output_stream_new (timing_stream);
+  g_object_unref (timing_stream);
+  self->offset = 0;
+  self->start_time = -1;
+  self->success = FALSE;
+  self->queued_size = 0;
+  self->closing = FALSE;
+  self->dropped = FALSE;
+  self->closed_func = NULL;
+  self->closed_data = NULL;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  g_queue_init (&self->chunks);
+  /* the thread frees the journal once closed, it's never joined */
+  thread = g_thread_new ("gvg-xml-journal", journal_thread, self);
+  g_thread_unref (thread);
+  
+  return self;
+}
+
+/* closes the file once everything was written, without waiting for it.
+ * @closed_func, if not %NULL, is then called from the main loop with whether
+ * all was written successfully.  the journal is freed, and mustn't be used
+ * anymore */
+void
+gvg_xml_journal_close (GvgXmlJournal          *self,
+                       GvgXmlJournalClosedFunc closed_func,
+                       gpointer                data)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  self->closed_func = closed_func;
+  self->closed_data = data;
+  self->closing = TRUE;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+/* must be called with the lock held */
+static void
+journal_queue (GvgXmlJournal *self,
+               JournalChunk  *chunk)
+{
+  g_queue_push_tail (&self->chunks, chunk);
+  self->queued_size += chunk_size (chunk);
+  g_cond_signal (&self->cond);
+}
+
+/* queues @data to be written, never waiting: if there is no room in the
+ * queue, the journal is dropped instead.  may be called from any thread */
+void
+gvg_xml_journal_write (GvgXmlJournal *self,
+                       const gchar   *data,
+                       gsize          len)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  if (len > 0 && ! self->dropped &&
+      self->queued_size + len > MAX_QUEUED_SIZE) {
+    g_warning ("XML journal can't keep up, dropping it");
+    self->dropped = TRUE;
+    g_queue_foreach (&self->chunks, (GFunc) chunk_free, NULL);
+    g_queue_clear (&self->chunks);
+    self->queued_size = 0;
+  }
+  if (len > 0 && ! self->dropped) {
+    JournalChunk *chunk = g_slice_new (JournalChunk);
+    
+    chunk->data = g_bytes_new (data, len);
+    chunk->time = g_get_monotonic_time ();
+    if (self->start_time < 0) {
+      self->start_time = chunk->time;
+    }
+    chunk->time -= self->start_time;
+    journal_queue (self, chunk);
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+/* marks a record boundary after the data written so far, flushing the
+ * compressor there */
+void
+gvg_xml_journal_mark (GvgXmlJournal *self)
+{
+  JournalChunk *last;
+  
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  last = g_queue_peek_tail (&self->chunks);
+  /* a flush already follows the data */
+  if (! self->dropped && (! last || last->data)) {
+    JournalChunk *chunk = g_slice_new (JournalChunk);
+    
+    chunk->data = NULL;
+    chunk->time = 0;
+    journal_queue (self, chunk);
+  }
+  g_mutex_unlock (&self->lock);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_JOURNAL
+#define H_GVG_XML_JOURNAL
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlJournal GvgXmlJournal;
+
+/* called in the main thread once the journal was closed, see
+ * gvg_xml_journal_close() */
+typedef void (*GvgXmlJournalClosedFunc) (gboolean success,
+                                         gpointer data);
+
+
+GvgXmlJournal  *gvg_xml_journal_new       (const gchar  *filename,
+                                           GError      **error);
+void            gvg_xml_journal_close     (GvgXmlJournal          *journal,
+                                           GvgXmlJournalClosedFunc closed_func,
+                                           gpointer                data);
+void            gvg_xml_journal_write     (GvgXmlJournal *journal,
+                                           const gchar   *data,
+                                           gsize          len);
+void            gvg_xml_journal_mark      (GvgXmlJournal *journal);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Listens for Valgrind's XML output on a TCP socket, as sent with
+ * --xml-socket=127.0.0.1:PORT.  Any number of Valgrind processes may connect
+ * at the same time, and each connection is parsed independently by its own
+ * parser (see gvg_xml_parser_dup()) so the streams don't interfere.
+ */
+
+#include "gvg-xml-listener.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gvg-xml-parser.h"
+#include "gvg-xml-worker.h"
+#include "gvg-pipe-reader.h"
+
+
+typedef struct _Connection Connection;
+
+struct _Connection
+{
+  GvgXmlListener     *listener;
+  guint               id;
+  GSocketConnection  *connection;
+  GvgXmlParser       *parser;
+  /* main loop mode */
+  GvgPipeReader      *reader;
+  GSource            *source;
+  /* threaded mode */
+  GvgXmlWorker       *worker;
+};
+
+struct _GvgXmlListener
+{
+  GSocketService *service;
+  guint16         port;
+  GvgXmlParser   *parser;   /* template parser for new connections */
+  GList          *connections;
+  guint           next_id;
+  
+  gboolean        threaded;
+  guint           batch_size;
+  guint           latency;
+  guint           max_batches;
+};
+
+
+static void
+connection_free (Connection *conn)
+{
+  if (conn->source) {
+    g_source_destroy (conn->source);
+    g_source_unref (conn->source);
+  }
+  if (conn->worker) {
+    gvg_xml_worker_free (conn->worker);
+  }
+  if (conn->reader) {
+    gvg_pipe_reader_free (conn->reader);
+  }
+  /* terminate the stream, whatever it contained */
+  gvg_xml_parser_push (conn->parser, NULL, 0, TRUE);
+  g_object_unref (conn->parser);
+  g_io_stream_close (G_IO_STREAM (conn->connection), NULL, NULL);
+  g_object_unref (conn->connection);
+  g_slice_free (Connection, conn);
+}
+
+static void
+connection_close (Connection *conn)
+{
+  GvgXmlListener *self = conn->listener;
+  
+  g_debug ("connection %u closed", conn->id);
+  self->connections = g_list_remove (self->connections, conn);
+  connection_free (conn);
+}
+
+static gsize
+push_to_parser (const gchar *data,
+                gsize        len,
+                gpointer     user_data)
+{
+  gvg_xml_parser_push (user_data, data, len, FALSE);
+  
+  return len;
+}
+
+static gboolean
+connection_in_ready (GSocket      *socket,
+                     GIOCondition  cond,
+                     gpointer      data)
+{
+  Connection *conn = data;
+  gboolean    keep = TRUE;
+  
+  if (cond & (G_IO_IN | G_IO_PRI)) {
+    keep = gvg_pipe_reader_drain (conn->reader, push_to_parser, conn->parser);
+  }
+  if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    keep = FALSE;
+  }
+  
+  if (! keep) {
+    /* the source is being removed, so don't destroy it */
+    g_source_unref (conn->source);
+    conn->source = NULL;
+    connection_close (conn);
+  }
+  
+  return keep;
+}
+
+static void
+connection_worker_done (GvgXmlWorker *worker,
+                        gpointer      data)
+{
+  connection_close (data);
+}
+
+static gboolean
+incoming (GSocketService    *service,
+          GSocketConnection *connection,
+          GObject           *source_object,
+          gpointer           data)
+{
+  GvgXmlListener *self = data;
+  Connection     *conn;
+  GSocket        *socket;
+  gint            fd;
+  
+  socket = g_socket_connection_get_socket (connection);
+  fd = g_socket_get_fd (socket);
+  
+  conn = g_slice_new (Connection);
+  conn->listener    = self;
+  conn->id          = self->next_id++;
+  conn->connection  = g_object_ref (connection);
+  conn->parser      = gvg_xml_parser_dup (self->parser);
+  conn->reader      = NULL;
+  conn->source      = NULL;
+  conn->worker      = NULL;
+  
+  g_debug ("connection %u accepted", conn->id);
+  self->connections = g_list_prepend (self->connections, conn);
+  
+  if (self->threaded) {
+    conn->worker = gvg_xml_worker_new (fd, conn->parser, self->batch_size,
+                                       self->latency, self->max_batches,
+                                       connection_worker_done, conn);
+  } else {
+    conn->reader = gvg_pipe_reader_new (fd);
+    conn->source = g_socket_create_source (socket,
+                                           G_IO_IN | G_IO_PRI |
+                                           G_IO_ERR | G_IO_HUP,
+                                           NULL);
+    g_source_set_callback (conn->source, (GSourceFunc) connection_in_ready,
+                           conn, NULL);
+    g_source_attach (conn->source, NULL);
+  }
+  
+  return TRUE;
+}
+
+/* starts listening on the loopback interface.  if @port is 0, a free port is
+ * picked, see gvg_xml_listener_get_port() */
+GvgXmlListener *
+gvg_xml_listener_new (GvgXmlParser  *parser,
+                      guint16        port,
+                      gboolean       threaded,
+                      guint          batch_size,
+                      guint          latency,
+                      guint          max_batches,
+                      GError       **error)
+{
+  GvgXmlListener *self;
+  GInetAddress   *inet_address;
+  GSocketAddress *address;
+  GSocketAddress *effective_address = NULL;
+  gboolean        success;
+  
+  g_return_val_if_fail (GVG_IS_XML_PARSER (parser), NULL);
+  
+  self = g_slice_new (GvgXmlListener);
+  self->service     = g_socket_service_new ();
+  self->port        = port;
+  self->parser      = g_object_ref (parser);
+  self->connections = NULL;
+  self->next_id     = 0;
+  self->threaded    = threaded;
+  self->batch_size  = batch_size;
+  self->latency     = latency;
+  self->max_batches = max_batches;
+  
+  /* Valgrind only supports IPv4 */
+  inet_address = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  address = g_inet_socket_address_new (inet_address, port);
+  success = g_socket_listener_add_address (G_SOCKET_LISTENER (self->service),
+                                           address, G_SOCKET_TYPE_STREAM,
+                                           G_SOCKET_PROTOCOL_TCP, NULL,
+                                           &effective_address, error);
+  g_object_unref (address);
+  g_object_unref (inet_address);
+  if (! success) {
+    gvg_xml_listener_free (self);
+    return NULL;
+  }
+  
+  self->port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (effective_address));
+  g_object_unref (effective_address);
+  
+  g_signal_connect (self->service, "incoming", G_CALLBACK (incoming), self);
+  g_socket_service_start (self->service);
+  
+  return self;
+}
+
+/* stops listening and closes all connections, dropping what they didn't
+ * send yet */
+void
+gvg_xml_listener_free (GvgXmlListener *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_socket_service_stop (self->service);
+  g_socket_listener_close (G_SOCKET_LISTENER (self->service));
+  g_signal_handlers_disconnect_by_func (self->service, incoming, self);
+  g_object_unref (self->service);
+  while (self->connections) {
+    connection_free (self->connections->data);
+    self->connections = g_list_delete_link (self->connections,
+                                            self->connections);
+  }
+  g_object_unref (self->parser);
+  g_slice_free (GvgXmlListener, self);
+}
+
+guint16
+gvg_xml_listener_get_port (GvgXmlListener *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return self->port;
+}
+
+guint
+gvg_xml_listener_get_n_connections (GvgXmlListener *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  
+  return g_list_length (self->connections);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_LISTENER
+#define H_GVG_XML_LISTENER
+
+#include <glib.h>
+
+#include "gvg-xml-parser.h"
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlListener GvgXmlListener;
+
+
+GvgXmlListener *gvg_xml_listener_new              (GvgXmlParser  *parser,
+                                                   guint16        port,
+                                                   gboolean       threaded,
+                                                   guint          batch_size,
+                                                   guint          latency,
+                                                   guint          max_batches,
+                                                   GError       **error);
+void            gvg_xml_listener_free             (GvgXmlListener *listener);
+guint16         gvg_xml_listener_get_port         (GvgXmlListener *listener);
+guint           gvg_xml_listener_get_n_connections(GvgXmlListener *listener);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -22,41 +22,164 @@
 /*
  * A naive helper for progressive XML parsing using LibXML2.
  * 
- * It notifies the caller about open and close elements, with full the
- * element's full path (e.g. /root/node/leaf).
+ * Subclasses register the elements they are interested in by path (e.g.
+ * /root/node/leaf) with gvg_xml_parser_class_add_element(), and get notified
+ * about them with the ID they were given, so no path has to be built nor
+ * compared while parsing.  The registered paths form a tree that is walked
+ * as elements open, and element names are interned in the libxml2 context's
+ * dictionary so matching a child is a mere pointer comparison.
+ * 
+ * Subclasses may also get notified about all elements with their full path,
+ * which is slower.
+ * 
+ * Streams are either parsed by libxml2, or by a tokenizer only handling the
+ * subset of XML Valgrind writes (see GvgXmlTokenizer).  The latter hands the
+ * stream over to libxml2 as soon as it meets anything else, so the result is
+ * the same, only faster.
+ * 
+ * In recovery mode, a malformed stream isn't lost from the error on: the parser
+ * skips to the next boundary of the records the subclass declared (see
+ * gvg_xml_parser_class_set_record_element()) and starts over from there, as
+ * if the elements around records were open.
  * 
  * It can also gives a part of an element's content upon element close.
  * It only provides the data between the previous closed tag and this one,
  * but maybe it could be improved to contain the whole element's content.
+ * The content is only lent to the callback; values needed afterwards are kept
+ * with gvg_xml_parser_keep(), which shares identical ones so that the many
+ * repeated values of a stack trace don't cost a copy each.
+ * 
+ * Subclasses can also build complete records (e.g. a whole error) and emit
+ * them with gvg_xml_parser_emit_record().  By default records are applied
+ * right away, but in deferred mode they are kept aside until stolen with
+ * gvg_xml_parser_steal_records(), which allows to parse in a thread and only
+ * apply the results in the main one.
+ * 
+ * A journal can be attached to save the raw stream as it's parsed, in which
+ * case record boundaries are marked in it.
  */
 
 #include "gvg-xml-parser.h"
+#include "gvg-xml-tokenizer.h"
+#include "gvg-enum-types.h"
 
 #include <glib.h>
 #include <glib-object.h>
 #include <libxml/parser.h>
+#include <libxml/dict.h>
+#include <libxml/xmlerror.h>
 #include <string.h>
 
 
+#define NO_NODE G_MAXUINT
+
+/* libxml2 2.12 made the error given to structured error handlers const */
+#if LIBXML_VERSION >= 21200
+typedef const xmlError *GvgXmlErrorPtr;
+#else
+typedef xmlErrorPtr GvgXmlErrorPtr;
+#endif
+
+/* a node of the tree of registered elements, the first one in a schema being
+ * the document itself */
+typedef struct _SchemaNode SchemaNode;
+struct _SchemaNode
+{
+  const gchar  *name;     /* from g_intern_string() */
+  guint         id;       /* 0 if not registered but only leads to one */
+  GArray       *children; /* indexes of the child nodes, or %NULL */
+};
+
 struct _GvgXmlParserPrivate {
+  GvgXmlParserBackend     backend;
   xmlSAXHandler           saxh;
   xmlParserCtxtPtr        ctxt;
+  GvgXmlTokenizer        *tokenizer;
+  gboolean                use_tokenizer;  /* until it gives up on a stream */
+  guint                   n_replayed;     /* see parser_fall_back() */
+  gboolean                malformed;      /* beyond what libxml2 knows */
+  gsize                   malformed_at;   /* in the data pushed last */
+  guint64                 n_fed;          /* to the libxml2 context */
+  gint64                  error_offset;   /* of its first error, or -1 */
+  
+  /* recovery, see parser_resync() */
+  gboolean                recover;
+  const gchar            *record_path;
+  gchar                  *record_start;   /* markers of record boundaries */
+  gchar                  *record_end;
+  gchar                  *record_prefix;  /* the elements around records */
+  guint                   record_depth;
+  gboolean                resyncing;
+  GString                *carry;          /* may be the start of a marker */
+  guint64                 n_dropped;
+  guint64                 gap_start;      /* @n_dropped when resync began */
   
   GString                *content;
+  gboolean                capture;  /* whether anyone wants the content */
   GString                *path;
-  guint                   depth;
+  GPtrArray              *attrs;    /* name/value pairs for the callbacks */
+  
+  GStringChunk           *kept;     /* see gvg_xml_parser_keep(), per stream */
+  GString                *key;
+  
+  GArray                 *schema;   /* the class' one, or %NULL */
+  gboolean                bound;    /* whether the schema was looked up */
+  const xmlChar         **names;    /* schema names in the libxml2 dictionary */
+  GArray                 *nodes;    /* the schema node of each open element */
+  
+  gboolean                deferred;
+  GPtrArray              *records;
+  gboolean                emitted;  /* whether a record was emitted */
+  
+  GvgXmlJournal          *journal;
+  
+  guint                   group;
+  gboolean                complete; /* whether the root element ended */
+  
+  /* what was pushed since the last reset, times being monotonic */
+  guint64                 n_pushed;
+  gint64                  first_push_time;
+  gint64                  last_push_time;
+  
+  /* position in the program's own output, may be set from any thread */
+  volatile gint           output_position;
 };
 
 
 static void     gvg_xml_parser_finalize               (GObject *object);
+static void     gvg_xml_parser_get_property           (GObject    *object,
+                                                       guint       prop_id,
+                                                       GValue     *value,
+                                                       GParamSpec *pspec);
+static void     gvg_xml_parser_set_property           (GObject      *object,
+                                                       guint         prop_id,
+                                                       const GValue *value,
+                                                       GParamSpec   *pspec);
 static void     gvg_xml_parser_characters_handler     (void           *data,
                                                        const xmlChar  *chs,
                                                        int             len);
 static void     gvg_xml_parser_end_element_handler    (void          *data,
-                                                       const xmlChar *name);
+                                                       const xmlChar *name,
+                                                       const xmlChar *prefix,
+                                                       const xmlChar *uri);
 static void     gvg_xml_parser_start_element_hanlder  (void            *data,
                                                        const xmlChar   *name,
-                                                       const xmlChar  **atts);
+                                                       const xmlChar   *prefix,
+                                                       const xmlChar   *uri,
+                                                       int              n_namespaces,
+                                                       const xmlChar  **namespaces,
+                                                       int              n_attributes,
+                                                       int              n_defaulted,
+                                                       const xmlChar  **attributes);
+static void     gvg_xml_parser_error_handler          (void           *data,
+                                                       GvgXmlErrorPtr  error);
+static void     tokenizer_element_start               (const gchar *name,
+                                                       gsize        len,
+                                                       gpointer     data);
+static void     tokenizer_element_end                 (gpointer     data);
+static void     tokenizer_text                        (const gchar *text,
+                                                       gsize        len,
+                                                       gpointer     data);
 
 
 G_DEFINE_ABSTRACT_TYPE (GvgXmlParser,
@@ -64,12 +187,58 @@ G_DEFINE_ABSTRACT_TYPE (GvgXmlParser,
                         G_TYPE_OBJECT)
 
 
+enum
+{
+  PROP_0,
+  PROP_GROUP,
+  PROP_BACKEND,
+  PROP_RECOVER
+};
+
+static const GvgXmlTokenizerFuncs tokenizer_funcs = {
+  tokenizer_element_start,
+  tokenizer_element_end,
+  tokenizer_text
+};
+
+
 static void
 gvg_xml_parser_class_init (GvgXmlParserClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
-  object_class->finalize = gvg_xml_parser_finalize;
+  object_class->finalize      = gvg_xml_parser_finalize;
+  object_class->get_property  = gvg_xml_parser_get_property;
+  object_class->set_property  = gvg_xml_parser_set_property;
+  
+  g_object_class_install_property (object_class,
+                                   PROP_GROUP,
+                                   g_param_spec_uint ("group",
+                                                      "Group",
+                                                      "Identifier of the group the results belong to, "
+                                                      "or 0 for none",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_BACKEND,
+                                   g_param_spec_enum ("backend",
+                                                      "Backend",
+                                                      "What parses the streams",
+                                                      GVG_TYPE_XML_PARSER_BACKEND,
+                                                      GVG_XML_PARSER_BACKEND_LIBXML,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_RECOVER,
+                                   g_param_spec_boolean ("recover",
+                                                         "Recover",
+                                                         "Whether to skip malformed "
+                                                         "records rather than the "
+                                                         "rest of the stream",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
 
   g_type_class_add_private (klass, sizeof (GvgXmlParserPrivate));
 }
@@ -80,14 +249,52 @@ gvg_xml_parser_init (GvgXmlParser *self)
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_XML_PARSER,
                                             GvgXmlParserPrivate);
   
+  self->priv->backend           = GVG_XML_PARSER_BACKEND_LIBXML;
   self->priv->ctxt              = NULL;
+  self->priv->tokenizer         = gvg_xml_tokenizer_new (&tokenizer_funcs, self);
+  self->priv->use_tokenizer     = FALSE;
+  self->priv->n_replayed        = 0;
+  self->priv->malformed         = FALSE;
+  self->priv->malformed_at      = 0;
+  self->priv->n_fed             = 0;
+  self->priv->error_offset      = -1;
+  self->priv->recover           = FALSE;
+  self->priv->record_path       = NULL;
+  self->priv->record_start      = NULL;
+  self->priv->record_end        = NULL;
+  self->priv->record_prefix     = NULL;
+  self->priv->record_depth      = 0;
+  self->priv->resyncing         = FALSE;
+  self->priv->carry             = g_string_new (NULL);
+  self->priv->n_dropped         = 0;
+  self->priv->gap_start         = 0;
   memset (&self->priv->saxh, 0, sizeof self->priv->saxh);
-  self->priv->saxh.startElement = gvg_xml_parser_start_element_hanlder;
-  self->priv->saxh.endElement   = gvg_xml_parser_end_element_handler;
-  self->priv->saxh.characters   = gvg_xml_parser_characters_handler;
+  /* SAX2 gives element names from the context's dictionary */
+  self->priv->saxh.initialized    = XML_SAX2_MAGIC;
+  self->priv->saxh.startElementNs = gvg_xml_parser_start_element_hanlder;
+  self->priv->saxh.endElementNs   = gvg_xml_parser_end_element_handler;
+  self->priv->saxh.characters     = gvg_xml_parser_characters_handler;
+  self->priv->saxh.serror         = gvg_xml_parser_error_handler;
   self->priv->path              = g_string_new (NULL);
   self->priv->content           = g_string_new (NULL);
-  self->priv->depth             = 0;
+  self->priv->capture           = FALSE;
+  self->priv->attrs             = g_ptr_array_new_with_free_func (g_free);
+  self->priv->kept              = g_string_chunk_new (4096);
+  self->priv->key               = g_string_new (NULL);
+  self->priv->schema            = NULL;
+  self->priv->bound             = FALSE;
+  self->priv->names             = NULL;
+  self->priv->nodes             = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->priv->deferred          = FALSE;
+  self->priv->records           = NULL;
+  self->priv->emitted           = FALSE;
+  self->priv->journal           = NULL;
+  self->priv->group             = 0;
+  self->priv->complete          = FALSE;
+  self->priv->n_pushed          = 0;
+  self->priv->first_push_time   = 0;
+  self->priv->last_push_time    = 0;
+  self->priv->output_position   = 0;
 }
 
 static void
@@ -99,19 +306,346 @@ gvg_xml_parser_finalize (GObject *object)
     xmlFreeDoc (self->priv->ctxt->myDoc);
     xmlFreeParserCtxt (self->priv->ctxt);
   }
+  gvg_xml_tokenizer_free (self->priv->tokenizer);
+  g_free (self->priv->record_start);
+  g_free (self->priv->record_end);
+  g_free (self->priv->record_prefix);
+  g_string_free (self->priv->carry, TRUE);
   g_string_free (self->priv->content, TRUE);
   g_string_free (self->priv->path, TRUE);
+  g_ptr_array_unref (self->priv->attrs);
+  g_string_chunk_free (self->priv->kept);
+  g_string_free (self->priv->key, TRUE);
+  g_free (self->priv->names);
+  g_array_unref (self->priv->nodes);
+  if (self->priv->records) {
+    g_ptr_array_unref (self->priv->records);
+  }
   
   G_OBJECT_CLASS (gvg_xml_parser_parent_class)->finalize (object);
 }
 
+static void
+gvg_xml_parser_get_property (GObject    *object,
+                             guint       prop_id,
+                             GValue     *value,
+                             GParamSpec *pspec)
+{
+  GvgXmlParser *self = GVG_XML_PARSER (object);
+  
+  switch (prop_id) {
+    case PROP_GROUP:
+      g_value_set_uint (value, self->priv->group);
+      break;
+    
+    case PROP_BACKEND:
+      g_value_set_enum (value, self->priv->backend);
+      break;
+    
+    case PROP_RECOVER:
+      g_value_set_boolean (value, self->priv->recover);
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+gvg_xml_parser_set_property (GObject      *object,
+                             guint         prop_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  GvgXmlParser *self = GVG_XML_PARSER (object);
+  
+  switch (prop_id) {
+    case PROP_GROUP:
+      self->priv->group = g_value_get_uint (value);
+      break;
+    
+    case PROP_BACKEND:
+      gvg_xml_parser_set_backend (self, g_value_get_enum (value));
+      break;
+    
+    case PROP_RECOVER:
+      gvg_xml_parser_set_recover (self, g_value_get_boolean (value));
+      break;
+    
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static GQuark
+schema_quark (void)
+{
+  static GQuark quark = 0;
+  
+  if (G_UNLIKELY (quark == 0)) {
+    quark = g_quark_from_static_string ("gvg-xml-parser-schema");
+  }
+  
+  return quark;
+}
+
+/* gets the schema of @type, or the one it inherits */
+static GArray *
+schema_lookup (GType type)
+{
+  GArray *schema = NULL;
+  
+  while (! schema && type != 0) {
+    schema = g_type_get_qdata (type, schema_quark ());
+    type = g_type_parent (type);
+  }
+  
+  return schema;
+}
+
+/* creates an empty schema, or a copy of @parent's */
+static GArray *
+schema_new (GArray *parent)
+{
+  GArray *schema = g_array_new (FALSE, FALSE, sizeof (SchemaNode));
+  
+  if (! parent) {
+    SchemaNode root = { NULL, 0, NULL };
+    
+    g_array_append_val (schema, root);
+  } else {
+    guint i;
+    
+    g_array_append_vals (schema, parent->data, parent->len);
+    for (i = 0; i < schema->len; i++) {
+      SchemaNode *node = &g_array_index (schema, SchemaNode, i);
+      
+      if (node->children) {
+        GArray *children = node->children;
+        
+        node->children = g_array_sized_new (FALSE, FALSE, sizeof (guint),
+                                            children->len);
+        g_array_append_vals (node->children, children->data, children->len);
+      }
+    }
+  }
+  
+  return schema;
+}
+
+/* finds the child of @parent named @name, which must be interned */
+static guint
+schema_find_child (GArray      *schema,
+                   guint        parent,
+                   const gchar *name)
+{
+  GArray *children = g_array_index (schema, SchemaNode, parent).children;
+  guint   i;
+  
+  for (i = 0; children && i < children->len; i++) {
+    guint child = g_array_index (children, guint, i);
+    
+    if (g_array_index (schema, SchemaNode, child).name == name) {
+      return child;
+    }
+  }
+  
+  return NO_NODE;
+}
+
+/*
+ * registers the element at @path (e.g. /root/node/leaf) for the class'
+ * element_start_id() and element_end_id() to get called with @id for it.  IDs
+ * are chosen by the class and must not be 0, but several paths may share one.
+ * to be called from the class initialization function.  a subclass starts with
+ * the elements its parent registered
+ */
+void
+gvg_xml_parser_class_add_element (GvgXmlParserClass *klass,
+                                  const gchar       *path,
+                                  guint              id)
+{
+  GType     type;
+  GArray   *schema;
+  gchar   **names;
+  guint     node = 0;
+  guint     i;
+  
+  g_return_if_fail (GVG_IS_XML_PARSER_CLASS (klass));
+  g_return_if_fail (path != NULL && path[0] == '/' && path[1] != 0);
+  g_return_if_fail (id != 0);
+  
+  type = G_TYPE_FROM_CLASS (klass);
+  schema = g_type_get_qdata (type, schema_quark ());
+  if (! schema) {
+    schema = schema_new (schema_lookup (g_type_parent (type)));
+    g_type_set_qdata (type, schema_quark (), schema);
+  }
+  
+  names = g_strsplit (&path[1], "/", -1);
+  for (i = 0; names[i]; i++) {
+    const gchar  *name  = g_intern_string (names[i]);
+    guint         child = schema_find_child (schema, node, name);
+    
+    if (child == NO_NODE) {
+      SchemaNode  new_node = { name, 0, NULL };
+      SchemaNode *parent;
+      
+      child = schema->len;
+      g_array_append_val (schema, new_node);
+      parent = &g_array_index (schema, SchemaNode, node);
+      if (! parent->children) {
+        parent->children = g_array_new (FALSE, FALSE, sizeof (guint));
+      }
+      g_array_append_val (parent->children, child);
+    }
+    node = child;
+  }
+  g_strfreev (names);
+  
+  g_array_index (schema, SchemaNode, node).id = id;
+}
+
+static GQuark
+record_quark (void)
+{
+  static GQuark quark = 0;
+  
+  if (G_UNLIKELY (quark == 0)) {
+    quark = g_quark_from_static_string ("gvg-xml-parser-record");
+  }
+  
+  return quark;
+}
+
+/* declares the element at @path (e.g. /root/record) as the one that holds the
+ * records, for recovery to restart at its boundaries.  Valgrind writes it
+ * exactly as <name> and </name>.  a subclass inherits its parent's */
+void
+gvg_xml_parser_class_set_record_element (GvgXmlParserClass *klass,
+                                         const gchar       *path)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER_CLASS (klass));
+  g_return_if_fail (path != NULL && path[0] == '/' && path[1] != 0);
+  
+  g_type_set_qdata (G_TYPE_FROM_CLASS (klass), record_quark (),
+                    (gpointer) g_intern_string (path));
+}
+
+/* looks up the record element and builds the markers recovery looks for.
+ * returns whether there is one */
+static gboolean
+parser_bind_record (GvgXmlParser *self)
+{
+  GType   type;
+  gchar **names;
+  guint   n;
+  guint   i;
+  
+  if (self->priv->record_path) {
+    return TRUE;
+  }
+  for (type = G_OBJECT_TYPE (self); ! self->priv->record_path && type != 0;
+       type = g_type_parent (type)) {
+    self->priv->record_path = g_type_get_qdata (type, record_quark ());
+  }
+  if (! self->priv->record_path) {
+    return FALSE;
+  }
+  
+  names = g_strsplit (&self->priv->record_path[1], "/", -1);
+  n = g_strv_length (names);
+  self->priv->record_start = g_strdup_printf ("<%s>", names[n - 1]);
+  self->priv->record_end = g_strdup_printf ("</%s>", names[n - 1]);
+  g_free (names[n - 1]);
+  names[n - 1] = NULL;
+  self->priv->record_prefix = g_strdup (n > 1 ? "<" : "");
+  for (i = 0; names[i]; i++) {
+    gchar *prefix = self->priv->record_prefix;
+    
+    self->priv->record_prefix = g_strconcat (prefix, names[i],
+                                             names[i + 1] ? "><" : ">", NULL);
+    g_free (prefix);
+  }
+  self->priv->record_depth = n - 1;
+  g_strfreev (names);
+  
+  return TRUE;
+}
+
+/* looks up the schema of the instance and, if element names are in the
+ * context's dictionary (checked on @name, the first one from libxml2), the
+ * interned version of the schema's names */
+static void
+parser_bind_schema (GvgXmlParser  *self,
+                    const xmlChar *name)
+{
+  GArray         *schema  = schema_lookup (G_OBJECT_TYPE (self));
+  xmlDictPtr      dict    = self->priv->ctxt ? self->priv->ctxt->dict : NULL;
+  
+  self->priv->schema = schema;
+  self->priv->bound = TRUE;
+  g_free (self->priv->names);
+  self->priv->names = NULL;
+  if (schema && dict && name && xmlDictOwns (dict, name) == 1) {
+    guint i;
+    
+    self->priv->names = g_new (const xmlChar *, schema->len);
+    for (i = 0; i < schema->len; i++) {
+      const gchar *node_name = g_array_index (schema, SchemaNode, i).name;
+      
+      self->priv->names[i] = node_name ? xmlDictLookup (dict,
+                                                        (const xmlChar *) node_name,
+                                                        -1) : NULL;
+    }
+  }
+}
+
+/* finds the schema node of a new element among its parent's children.  @len
+ * is -1 for names from libxml2, which may be interned */
+static guint
+parser_find_node (GvgXmlParser *self,
+                  const gchar  *name,
+                  gssize        len)
+{
+  GArray *schema = self->priv->schema;
+  GArray *nodes  = self->priv->nodes;
+  GArray *children;
+  guint   parent;
+  guint   i;
+  
+  parent = nodes->len > 0 ? g_array_index (nodes, guint, nodes->len - 1) : 0;
+  if (! schema || parent == NO_NODE) {
+    return NO_NODE;
+  }
+  
+  children = g_array_index (schema, SchemaNode, parent).children;
+  for (i = 0; children && i < children->len; i++) {
+    guint         child       = g_array_index (children, guint, i);
+    const gchar  *child_name  = g_array_index (schema, SchemaNode, child).name;
+    
+    if (len >= 0) {
+      if (strncmp (child_name, name, (gsize) len) == 0 &&
+          child_name[len] == 0) {
+        return child;
+      }
+    } else if (self->priv->names ?
+               self->priv->names[child] == (const xmlChar *) name :
+               strcmp (child_name, name) == 0) {
+      return child;
+    }
+  }
+  
+  return NO_NODE;
+}
+
 static void
 parser_path_push (GvgXmlParser *self,
-                  const gchar  *element)
+                  const gchar  *element,
+                  gsize         len)
 {
   g_string_append_c (self->priv->path, '/');
-  g_string_append (self->priv->path, element);
-  self->priv->depth ++;
+  g_string_append_len (self->priv->path, element, (gssize) len);
 }
 
 static void
@@ -121,7 +655,6 @@ parser_path_pop (GvgXmlParser *self)
   
   g_return_if_fail (self->priv->path->len > 0);
   
-  self->priv->depth--;
   for (i = self->priv->path->len; i-- > 0; ) {
     if (self->priv->path->str[i] == '/') {
       g_string_truncate (self->priv->path, i);
@@ -130,53 +663,518 @@ parser_path_pop (GvgXmlParser *self)
   }
 }
 
+/* converts SAX2 attributes to the name/value pairs the callbacks get, or
+ * %NULL if there are none */
+static const gchar **
+parser_convert_attrs (GvgXmlParser   *self,
+                      gint            n_attributes,
+                      const xmlChar **attributes)
+{
+  gint i;
+  
+  if (n_attributes < 1) {
+    return NULL;
+  }
+  
+  g_ptr_array_set_size (self->priv->attrs, 0);
+  /* each is localname, prefix, URI, value start and value end */
+  for (i = 0; i < n_attributes; i++) {
+    const xmlChar **attr = &attributes[i * 5];
+    
+    g_ptr_array_add (self->priv->attrs, g_strdup ((const gchar *) attr[0]));
+    g_ptr_array_add (self->priv->attrs, g_strndup ((const gchar *) attr[3],
+                                                   (gsize) (attr[4] - attr[3])));
+  }
+  g_ptr_array_add (self->priv->attrs, NULL);
+  
+  return (const gchar **) self->priv->attrs->pdata;
+}
+
+/* whether anyone gets the content of an element of schema node @node */
+static gboolean
+parser_wants_content (GvgXmlParser      *self,
+                      GvgXmlParserClass *klass,
+                      guint              node)
+{
+  if (klass->element_start || klass->element_end) {
+    return TRUE;
+  } else if (node == NO_NODE || ! klass->element_end_id) {
+    return FALSE;
+  } else {
+    return g_array_index (self->priv->schema, SchemaNode, node).id != 0;
+  }
+}
+
+/* an element of schema node @node opens, whatever the backend */
 static void
-gvg_xml_parser_start_element_hanlder (void            *data,
-                                      const xmlChar   *name,
-                                      const xmlChar  **atts)
+parser_element_start (GvgXmlParser *self,
+                      guint         node,
+                      const gchar  *name,
+                      gsize         len,
+                      const gchar **atts)
 {
-  GvgXmlParser       *self  = data;
-  GvgXmlParserClass  *klass = GVG_XML_PARSER_GET_CLASS (self);
+  GvgXmlParserClass  *klass   = GVG_XML_PARSER_GET_CLASS (self);
+  gboolean            by_path = klass->element_start || klass->element_end;
   
-  parser_path_push (self, (const gchar *) name);
-  //~ g_debug ("start element %s", self->priv->path->str);
+  g_array_append_val (self->priv->nodes, node);
+  if (by_path) {
+    parser_path_push (self, name, len);
+  }
+  self->priv->capture = parser_wants_content (self, klass, node);
   
+  if (G_UNLIKELY (self->priv->n_replayed > 0)) {
+    /* reported already, see parser_fall_back().  the content gathered
+     * before is still valid */
+    self->priv->n_replayed--;
+    return;
+  }
+  
+  if (node != NO_NODE && klass->element_start_id) {
+    guint id = g_array_index (self->priv->schema, SchemaNode, node).id;
+    
+    if (id != 0) {
+      klass->element_start_id (self, id, atts);
+    }
+  }
   if (klass->element_start) {
+    //~ g_debug ("start element %s", self->priv->path->str);
     klass->element_start (self,
-                          (const gchar *) name,
-                          (const gchar **) atts,
-                          self->priv->path->str);
+                          &self->priv->path->str[self->priv->path->len - len],
+                          atts, self->priv->path->str);
   }
   g_string_truncate (self->priv->content, 0);
 }
 
+/* the last open element closes, whatever the backend */
 static void
-gvg_xml_parser_end_element_handler (void          *data,
-                                    const xmlChar *name)
+parser_element_end (GvgXmlParser *self)
 {
-  GvgXmlParser       *self  = data;
-  GvgXmlParserClass  *klass = GVG_XML_PARSER_GET_CLASS (self);
+  GvgXmlParserClass  *klass   = GVG_XML_PARSER_GET_CLASS (self);
+  GArray             *nodes   = self->priv->nodes;
+  GString            *content = self->priv->content;
+  guint               node;
+  
+  g_return_if_fail (nodes->len > 0);
   
-  //~ g_debug ("end element %s", self->priv->path->str);
-  if (klass->element_end) {
-    klass->element_end (self,
-                        (const gchar *) name,
-                        self->priv->content->str,
-                        self->priv->path->str);
+  node = g_array_index (nodes, guint, nodes->len - 1);
+  if (node != NO_NODE && klass->element_end_id) {
+    guint id = g_array_index (self->priv->schema, SchemaNode, node).id;
+    
+    if (id != 0) {
+      klass->element_end_id (self, id, content->str, content->len);
+    }
   }
-  parser_path_pop (self);
   
-  g_string_truncate (self->priv->content, 0);
+  if (klass->element_start || klass->element_end) {
+    //~ g_debug ("end element %s", self->priv->path->str);
+    if (klass->element_end) {
+      klass->element_end (self, strrchr (self->priv->path->str, '/') + 1,
+                          content->str, self->priv->path->str);
+    }
+    parser_path_pop (self);
+  }
+  g_array_set_size (nodes, nodes->len - 1);
+  if (nodes->len == 0) {
+    self->priv->complete = TRUE;
+    self->priv->capture = FALSE;
+  } else {
+    /* the parent gets what follows its last child */
+    node = g_array_index (nodes, guint, nodes->len - 1);
+    self->priv->capture = parser_wants_content (self, klass, node);
+  }
+  
+  g_string_truncate (content, 0);
+}
+
+static void
+parser_characters (GvgXmlParser *self,
+                   const gchar  *chs,
+                   gsize         len)
+{
+  /* the backend's buffer may move once we return, so this is the only copy */
+  if (self->priv->capture) {
+    g_string_append_len (self->priv->content, chs, (gssize) len);
+  }
+}
+
+static void
+gvg_xml_parser_start_element_hanlder (void            *data,
+                                      const xmlChar   *name,
+                                      const xmlChar   *prefix,
+                                      const xmlChar   *uri,
+                                      int              n_namespaces,
+                                      const xmlChar  **namespaces,
+                                      int              n_attributes,
+                                      int              n_defaulted,
+                                      const xmlChar  **attributes)
+{
+  GvgXmlParser *self = data;
+  guint         node;
+  
+  if (G_UNLIKELY (! self->priv->bound)) {
+    parser_bind_schema (self, name);
+  }
+  node = parser_find_node (self, (const gchar *) name, -1);
+  parser_element_start (self, node, (const gchar *) name,
+                        strlen ((const gchar *) name),
+                        parser_convert_attrs (self, n_attributes, attributes));
+}
+
+static void
+gvg_xml_parser_end_element_handler (void          *data,
+                                    const xmlChar *name,
+                                    const xmlChar *prefix,
+                                    const xmlChar *uri)
+{
+  parser_element_end (data);
 }
 
 static void
 gvg_xml_parser_characters_handler (void           *data,
                                    const xmlChar  *chs,
                                    int             len)
+{
+  parser_characters (data, (const gchar *) chs, (gsize) len);
+}
+
+static void
+tokenizer_element_start (const gchar *name,
+                         gsize        len,
+                         gpointer     data)
 {
   GvgXmlParser *self = data;
   
-  g_string_append_len (self->priv->content, (const gchar *) chs, len);
+  if (G_UNLIKELY (! self->priv->bound)) {
+    parser_bind_schema (self, NULL);
+  }
+  parser_element_start (self, parser_find_node (self, name, (gssize) len),
+                        name, len, NULL);
+}
+
+static void
+tokenizer_element_end (gpointer data)
+{
+  parser_element_end (data);
+}
+
+static void
+tokenizer_text (const gchar *text,
+                gsize        len,
+                gpointer     data)
+{
+  parser_characters (data, text, len);
+}
+
+/*
+ * gets a copy of @len bytes of @str that outlives the callback it was given
+ * to, e.g. an element's content.  identical values share the same copy, so
+ * this is cheap for the many repeated ones (e.g. file names).  the copy is
+ * owned by the parser, must not be modified and is valid until the parser is
+ * reset or finalized, so records holding it must be applied before.  must be
+ * called from the parsing thread
+ */
+const gchar *
+gvg_xml_parser_keep (GvgXmlParser  *self,
+                     const gchar   *str,
+                     gsize          len)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), NULL);
+  g_return_val_if_fail (str != NULL || len == 0, NULL);
+  
+  /* the lookup needs a nul-terminated key, which @str may not be */
+  g_string_truncate (self->priv->key, 0);
+  g_string_append_len (self->priv->key, str, (gssize) len);
+  
+  return g_string_chunk_insert_const (self->priv->kept, self->priv->key->str);
+}
+
+/* remembers where libxml2 met the first error, for recovery to know which
+ * data was handled */
+static void
+gvg_xml_parser_error_handler (void           *data,
+                              GvgXmlErrorPtr  error)
+{
+  GvgXmlParser *self = data;
+  
+  if (error->level == XML_ERR_FATAL && self->priv->error_offset < 0 &&
+      self->priv->ctxt) {
+    g_warning ("XML error at line %d: %s", error->line, error->message);
+    self->priv->error_offset = xmlByteConsumed (self->priv->ctxt);
+  }
+}
+
+static void
+parser_push_libxml (GvgXmlParser *self,
+                    const gchar  *data,
+                    gsize         len,
+                    gboolean      end)
+{
+  self->priv->n_fed += len;
+  if (! self->priv->ctxt) {
+    self->priv->ctxt = xmlCreatePushParserCtxt (&self->priv->saxh, self,
+                                                data, (gint) len, NULL);
+    if (end) {
+      xmlParseChunk (self->priv->ctxt, NULL, 0, end);
+    }
+  } else {
+    xmlParseChunk (self->priv->ctxt, data, (gint) len, end);
+  }
+}
+
+/*
+ * hands the stream over to libxml2 when the tokenizer gives up on it.  the
+ * elements open at this point are given to libxml2 again so it is in the
+ * same state, but they're not reported a second time.  @rest is what the
+ * tokenizer didn't handle
+ */
+static void
+parser_fall_back (GvgXmlParser *self,
+                  const gchar  *rest,
+                  gsize         rest_len,
+                  gboolean      end)
+{
+  const gchar  *path    = gvg_xml_tokenizer_get_path (self->priv->tokenizer);
+  GString      *prefix  = g_string_new (NULL);
+  gchar       **names;
+  guint         i;
+  
+  names = g_strsplit (path, "/", -1);
+  self->priv->n_replayed = 0;
+  for (i = 0; names[i]; i++) {
+    if (*names[i]) {
+      g_string_append_printf (prefix, "<%s>", names[i]);
+      self->priv->n_replayed ++;
+    }
+  }
+  g_strfreev (names);
+  
+  g_array_set_size (self->priv->nodes, 0);
+  g_string_truncate (self->priv->path, 0);
+  /* now names can come from the dictionary */
+  self->priv->bound = FALSE;
+  self->priv->use_tokenizer = FALSE;
+  
+  parser_push_libxml (self, prefix->str, prefix->len, FALSE);
+  parser_push_libxml (self, rest, rest_len, end);
+  g_string_free (prefix, TRUE);
+}
+
+/* pushes data to the current backend, returns whether the stream is still
+ * well-formed */
+static gboolean
+parser_push_data (GvgXmlParser *self,
+                  const gchar  *data,
+                  gsize         len,
+                  gboolean      end)
+{
+  if (self->priv->use_tokenizer) {
+    GvgXmlTokenizer  *tokenizer = self->priv->tokenizer;
+    const gchar      *rest;
+    gsize             rest_len;
+    
+    if (gvg_xml_tokenizer_push (tokenizer, data, len, &rest, &rest_len)) {
+      if (! end || gvg_xml_tokenizer_is_complete (tokenizer)) {
+        return TRUE;
+      }
+      /* let libxml2 tell what's wrong with the end of the stream */
+      rest = NULL;
+      rest_len = 0;
+    } else if (gvg_xml_tokenizer_is_complete (tokenizer)) {
+      /* libxml2 would take anything after the root as a new document, but
+       * it isn't well-formed.  only a pending token can make @rest longer
+       * than @data, and it would be where the error is */
+      self->priv->use_tokenizer = FALSE;
+      self->priv->malformed = TRUE;
+      self->priv->malformed_at = rest_len < len ? len - rest_len : 0;
+      return FALSE;
+    }
+    parser_fall_back (self, rest, rest_len, end);
+  } else if (self->priv->malformed) {
+    return FALSE;
+  } else {
+    parser_push_libxml (self, data, len, end);
+  }
+  
+  return self->priv->ctxt->wellFormed;
+}
+
+/* where the error is in the @len bytes pushed last, negative if it is in
+ * previous ones */
+static gint64
+parser_error_position (GvgXmlParser *self,
+                       gsize         len)
+{
+  if (self->priv->malformed) {
+    return (gint64) self->priv->malformed_at;
+  } else if (self->priv->error_offset < 0) {
+    /* unknown, so don't risk seeing anything twice */
+    return (gint64) len;
+  } else {
+    /* the end of what libxml2 got is always the end of the data */
+    return (gint64) len - (gint64) (self->priv->n_fed - (guint64) self->priv->error_offset);
+  }
+}
+
+/* forgets the state of the stream being parsed */
+static void
+parser_reset_stream (GvgXmlParser *self)
+{
+  if (self->priv->ctxt) {
+    xmlFreeDoc (self->priv->ctxt->myDoc);
+    self->priv->ctxt->myDoc = NULL;
+    xmlCtxtResetPush (self->priv->ctxt, NULL, 0, NULL, NULL);
+    /* the SAX callbacks get this as context */
+    self->priv->ctxt->userData = self;
+  }
+  self->priv->n_fed = 0;
+  self->priv->error_offset = -1;
+  gvg_xml_tokenizer_reset (self->priv->tokenizer);
+  self->priv->use_tokenizer = self->priv->backend == GVG_XML_PARSER_BACKEND_TOKENIZER;
+  self->priv->n_replayed = 0;
+  self->priv->malformed = FALSE;
+  g_string_truncate (self->priv->path, 0);
+  g_string_truncate (self->priv->content, 0);
+  self->priv->capture = FALSE;
+  g_array_set_size (self->priv->nodes, 0);
+  self->priv->complete = FALSE;
+}
+
+/* finds the first record boundary in @data, i.e. where to resume parsing,
+ * or -1 */
+static gssize
+find_record_boundary (GvgXmlParser *self,
+                      const gchar  *data,
+                      gsize         len)
+{
+  const gchar  *start     = self->priv->record_start;
+  const gchar  *end       = self->priv->record_end;
+  gsize         start_len = strlen (start);
+  gsize         end_len   = strlen (end);
+  const gchar  *p         = data;
+  
+  while ((p = memchr (p, '<', len - (gsize) (p - data))) != NULL) {
+    gsize left = len - (gsize) (p - data);
+    
+    if (left >= start_len && memcmp (p, start, start_len) == 0) {
+      return p - data;
+    } else if (left >= end_len && memcmp (p, end, end_len) == 0) {
+      return p + end_len - data;
+    }
+    p++;
+  }
+  
+  return -1;
+}
+
+/* keeps the end of @data in case a marker starts there */
+static void
+parser_carry (GvgXmlParser *self,
+              const gchar  *data,
+              gsize         len)
+{
+  gsize keep = MIN (len, strlen (self->priv->record_end) - 1);
+  gsize i;
+  
+  g_string_truncate (self->priv->carry, 0);
+  for (i = len - keep; i < len; i++) {
+    if (data[i] == '<') {
+      g_string_append_len (self->priv->carry, &data[i], (gssize) (len - i));
+      break;
+    }
+  }
+  self->priv->n_dropped += len - self->priv->carry->len;
+}
+
+/*
+ * recovers from an error at @from in @len bytes of @data: skips to the next
+ * record boundary, and parses the rest with a fresh context as if the elements
+ * around records were open.  if there's no boundary the search goes on with
+ * the next data.  returns whether parsing could go on
+ */
+static gboolean
+parser_resync (GvgXmlParser *self,
+               const gchar  *data,
+               gsize         len,
+               gboolean      end,
+               gint64        from)
+{
+  GvgXmlParserClass *klass = GVG_XML_PARSER_GET_CLASS (self);
+  
+  if (! parser_bind_record (self)) {
+    return FALSE;
+  }
+  
+  while (TRUE) {
+    GString  *carry   = self->priv->carry;
+    guint64   dropped;
+    gssize    resume  = -1;
+    gsize     head    = 0;  /* bytes of @carry to parse before @data */
+    gint64    error;
+    
+    /* the skipped data may span several pushes */
+    dropped = self->priv->resyncing ? self->priv->gap_start : self->priv->n_dropped;
+    if (from < 0) {
+      /* what libxml2 kept from previous data */
+      self->priv->n_dropped += (guint64) -from;
+      from = 0;
+    }
+    if (from == 0 && carry->len > 0) {
+      gsize carried = carry->len;
+      
+      g_string_append_len (carry, data,
+                           (gssize) MIN (len, strlen (self->priv->record_end)));
+      resume = find_record_boundary (self, carry->str, carry->len);
+      g_string_truncate (carry, carried);
+      if (resume >= 0 && (gsize) resume < carried) {
+        head = carried - (gsize) resume;
+        resume = 0;
+      } else if (resume >= 0) {
+        resume -= (gssize) carried;
+      }
+      self->priv->n_dropped += carried - head;
+    }
+    if (resume < 0) {
+      resume = find_record_boundary (self, &data[from], len - (gsize) from);
+      if (resume >= 0) {
+        resume += (gssize) from;
+      }
+    }
+    if (resume < 0) {
+      parser_carry (self, &data[from], len - (gsize) from);
+      self->priv->gap_start = dropped;
+      self->priv->resyncing = ! end;
+      return ! end;
+    }
+    
+    self->priv->n_dropped += (guint64) (resume - from);
+    self->priv->resyncing = FALSE;
+    if (self->priv->n_dropped > dropped) {
+      g_warning ("skipped %" G_GUINT64_FORMAT " bytes of malformed XML",
+                 self->priv->n_dropped - dropped);
+      if (klass->recovered) {
+        klass->recovered (self, self->priv->n_dropped - dropped);
+      }
+    }
+    
+    parser_reset_stream (self);
+    self->priv->n_replayed = self->priv->record_depth;
+    parser_push_data (self, self->priv->record_prefix,
+                      strlen (self->priv->record_prefix), FALSE);
+    if ((head == 0 ||
+         parser_push_data (self, &carry->str[carry->len - head], head, FALSE)) &&
+        parser_push_data (self, &data[resume], len - (gsize) resume, end)) {
+      g_string_truncate (carry, 0);
+      return TRUE;
+    }
+    g_string_truncate (carry, 0);
+    
+    error = parser_error_position (self, len - (gsize) resume);
+    /* make sure to get further than the last time */
+    from = MAX (error + resume, resume + 1);
+    if ((gsize) from > len) {
+      from = (gint64) len;
+    }
+  }
 }
 
 gboolean
@@ -185,24 +1183,328 @@ gvg_xml_parser_push (GvgXmlParser  *self,
                      gsize          len,
                      gboolean       end)
 {
+  gboolean well_formed;
+  
   g_return_val_if_fail (GVG_IS_XML_PARSER (self), FALSE);
   g_return_val_if_fail (len <= G_MAXINT, FALSE);
   
   //~ g_debug ("got data");
   /*fwrite (data, 1, len, stderr);*/
-  if (! self->priv->ctxt) {
-    self->priv->ctxt = xmlCreatePushParserCtxt (&self->priv->saxh, self,
-                                                data, (gint) len, NULL);
-    if (end) {
-      xmlParseChunk (self->priv->ctxt, NULL, 0, end);
+  if (self->priv->journal) {
+    gvg_xml_journal_write (self->priv->journal, data, len);
+  }
+  if (len > 0) {
+    self->priv->last_push_time = g_get_monotonic_time ();
+    if (self->priv->n_pushed == 0) {
+      self->priv->first_push_time = self->priv->last_push_time;
     }
+    self->priv->n_pushed += len;
+  }
+  self->priv->emitted = FALSE;
+  if (self->priv->resyncing) {
+    well_formed = parser_resync (self, data, len, end, 0);
   } else {
-    xmlParseChunk (self->priv->ctxt, data, (gint) len, end);
+    well_formed = parser_push_data (self, data, len, end);
+    if (! well_formed && self->priv->recover) {
+      well_formed = parser_resync (self, data, len, end,
+                                   parser_error_position (self, len));
+    }
   }
   
-  if (! self->priv->ctxt->wellFormed) {
+  if (! well_formed) {
     g_warning ("malformed XML");
   }
+  if (self->priv->journal && self->priv->emitted) {
+    gvg_xml_journal_mark (self->priv->journal);
+  }
   
-  return self->priv->ctxt->wellFormed;
+  return well_formed;
+}
+
+/* creates a parser for another stream, see GvgXmlParserClass::dup */
+GvgXmlParser *
+gvg_xml_parser_dup (GvgXmlParser *self)
+{
+  GvgXmlParserClass  *klass;
+  GvgXmlParser       *dup;
+  
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), NULL);
+  
+  klass = GVG_XML_PARSER_GET_CLASS (self);
+  g_return_val_if_fail (klass->dup != NULL, NULL);
+  
+  dup = klass->dup (self);
+  /* results of the copy belong to the same group by default */
+  gvg_xml_parser_set_group (dup, self->priv->group);
+  gvg_xml_parser_set_backend (dup, self->priv->backend);
+  gvg_xml_parser_set_recover (dup, self->priv->recover);
+  
+  return dup;
+}
+
+/* whether the whole document was parsed */
+gboolean
+gvg_xml_parser_is_complete (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), FALSE);
+  
+  return self->priv->complete;
+}
+
+/* emits a complete record, taking ownership of it.  if the parser isn't
+ * deferred the record is applied immediately, otherwise it is queued until
+ * gvg_xml_parser_steal_records() is called */
+void
+gvg_xml_parser_emit_record (GvgXmlParser *self,
+                            gpointer      record)
+{
+  GvgXmlParserClass *klass;
+  
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  g_return_if_fail (record != NULL);
+  
+  self->priv->emitted = TRUE;
+  klass = GVG_XML_PARSER_GET_CLASS (self);
+  if (! self->priv->deferred) {
+    klass->record_apply (self, record);
+    klass->record_free (record);
+  } else {
+    if (! self->priv->records) {
+      self->priv->records = g_ptr_array_new_with_free_func (klass->record_free);
+    }
+    g_ptr_array_add (self->priv->records, record);
+  }
+}
+
+gboolean
+gvg_xml_parser_get_deferred (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), FALSE);
+  
+  return self->priv->deferred;
+}
+
+/* when leaving deferred mode, pending records are applied right away */
+void
+gvg_xml_parser_set_deferred (GvgXmlParser *self,
+                             gboolean      deferred)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  self->priv->deferred = deferred;
+  if (! deferred) {
+    GPtrArray *records = gvg_xml_parser_steal_records (self);
+    
+    if (records) {
+      gvg_xml_parser_apply_records (self, records);
+      g_ptr_array_unref (records);
+    }
+  }
+}
+
+guint
+gvg_xml_parser_get_n_records (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), 0);
+  
+  return self->priv->records ? self->priv->records->len : 0;
+}
+
+/* returns the records emitted since the last call, or %NULL if there are
+ * none.  free with g_ptr_array_unref() */
+GPtrArray *
+gvg_xml_parser_steal_records (GvgXmlParser *self)
+{
+  GPtrArray *records;
+  
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), NULL);
+  
+  records = self->priv->records;
+  self->priv->records = NULL;
+  
+  return records;
+}
+
+/* applies records returned by gvg_xml_parser_steal_records().  unlike the
+ * parsing itself, this has to be called from the thread owning the data the
+ * records apply to */
+void
+gvg_xml_parser_apply_records (GvgXmlParser *self,
+                              GPtrArray    *records)
+{
+  GvgXmlParserClass  *klass;
+  guint               i;
+  
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  g_return_if_fail (records != NULL);
+  
+  klass = GVG_XML_PARSER_GET_CLASS (self);
+  for (i = 0; i < records->len; i++) {
+    klass->record_apply (self, g_ptr_array_index (records, i));
+  }
+}
+
+/* sets a journal to which save the data pushed to the parser, or %NULL to
+ * remove it.  the journal isn't owned by the parser, and must be removed
+ * before being freed */
+void
+gvg_xml_parser_set_journal (GvgXmlParser  *self,
+                            GvgXmlJournal *journal)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  self->priv->journal = journal;
+}
+
+/* results of parsers sharing the same storage can be grouped, e.g. by run.
+ * subclasses tag what they produce with this */
+guint
+gvg_xml_parser_get_group (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), 0);
+  
+  return self->priv->group;
+}
+
+void
+gvg_xml_parser_set_group (GvgXmlParser *self,
+                          guint         group)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  self->priv->group = group;
+  g_object_notify (G_OBJECT (self), "group");
+}
+
+/* gets how many bytes were pushed since the last reset, and when the first and
+ * last ones were, as g_get_monotonic_time() values (0 if none was) */
+void
+gvg_xml_parser_get_push_stats (GvgXmlParser *self,
+                               guint64      *n_bytes,
+                               gint64       *first_time,
+                               gint64       *last_time)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  if (n_bytes) {
+    *n_bytes = self->priv->n_pushed;
+  }
+  if (first_time) {
+    *first_time = self->priv->first_push_time;
+  }
+  if (last_time) {
+    *last_time = self->priv->last_push_time;
+  }
+}
+
+/* tells how much of the program's own output was received when the data
+ * being pushed arrived, for subclasses to link their results to it (see
+ * GvgOutputLog).  may be called from any thread */
+void
+gvg_xml_parser_set_output_position (GvgXmlParser *self,
+                                    guint         position)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  g_atomic_int_set (&self->priv->output_position, (gint) position);
+}
+
+guint
+gvg_xml_parser_get_output_position (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), 0);
+  
+  return (guint) g_atomic_int_get (&self->priv->output_position);
+}
+
+GvgXmlParserBackend
+gvg_xml_parser_get_backend (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), GVG_XML_PARSER_BACKEND_LIBXML);
+  
+  return self->priv->backend;
+}
+
+/* chooses what parses the streams.  it only applies from the next one, i.e.
+ * after the next reset if data was pushed already */
+void
+gvg_xml_parser_set_backend (GvgXmlParser        *self,
+                            GvgXmlParserBackend  backend)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  if (backend != self->priv->backend) {
+    self->priv->backend = backend;
+    if (self->priv->n_pushed == 0) {
+      self->priv->use_tokenizer = backend == GVG_XML_PARSER_BACKEND_TOKENIZER;
+    }
+    g_object_notify (G_OBJECT (self), "backend");
+  }
+}
+
+gboolean
+gvg_xml_parser_get_recover (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), FALSE);
+  
+  return self->priv->recover;
+}
+
+/* whether to skip to the next record after an error rather than losing the
+ * rest of the stream.  the class has to declare its records, see
+ * gvg_xml_parser_class_set_record_element() */
+void
+gvg_xml_parser_set_recover (GvgXmlParser *self,
+                            gboolean      recover)
+{
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  if (! recover != ! self->priv->recover) {
+    self->priv->recover = recover;
+    g_object_notify (G_OBJECT (self), "recover");
+  }
+}
+
+/* gets how many bytes were skipped by recovery since the last reset */
+guint64
+gvg_xml_parser_get_n_dropped (GvgXmlParser *self)
+{
+  g_return_val_if_fail (GVG_IS_XML_PARSER (self), 0);
+  
+  return self->priv->n_dropped;
+}
+
+/*
+ * makes the parser ready for a new stream, whether the previous one was
+ * complete or not.  the libxml2 context and buffers are kept for the new
+ * stream, and pending records are dropped, as well as the values kept for
+ * them.  subclasses reset their own state in GvgXmlParserClass::reset.  must
+ * not be called while parsing, nor before stolen records are applied
+ */
+void
+gvg_xml_parser_reset (GvgXmlParser *self)
+{
+  GvgXmlParserClass *klass;
+  
+  g_return_if_fail (GVG_IS_XML_PARSER (self));
+  
+  parser_reset_stream (self);
+  self->priv->resyncing = FALSE;
+  g_string_truncate (self->priv->carry, 0);
+  self->priv->n_dropped = 0;
+  self->priv->emitted = FALSE;
+  if (self->priv->records) {
+    g_ptr_array_set_size (self->priv->records, 0);
+  }
+  self->priv->n_pushed = 0;
+  self->priv->first_push_time = 0;
+  self->priv->last_push_time = 0;
+  g_atomic_int_set (&self->priv->output_position, 0);
+  
+  klass = GVG_XML_PARSER_GET_CLASS (self);
+  if (klass->reset) {
+    klass->reset (self);
+  }
+  /* nothing refers to the kept values anymore, applied records copied them */
+  g_string_chunk_clear (self->priv->kept);
 }
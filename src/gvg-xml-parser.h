@@ -25,9 +25,17 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include "gvg-xml-journal.h"
+
 G_BEGIN_DECLS
 
 
+typedef enum
+{
+  GVG_XML_PARSER_BACKEND_LIBXML,    /* libxml2's push parser */
+  GVG_XML_PARSER_BACKEND_TOKENIZER  /* faster, only for Valgrind's output */
+} GvgXmlParserBackend;
+
 #define GVG_TYPE_XML_PARSER             (gvg_xml_parser_get_type ())
 #define GVG_XML_PARSER(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), GVG_TYPE_XML_PARSER, GvgXmlParser))
 #define GVG_XML_PARSER_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST ((klass), GVG_TYPE_XML_PARSER, GvgXmlParserClass))
@@ -50,6 +58,16 @@ struct _GvgXmlParserClass
 {
   GObjectClass  parent_class;
   
+  /* elements registered with gvg_xml_parser_class_add_element(), by ID.
+   * @content is lent to the callback, see gvg_xml_parser_keep() */
+  void        (*element_start_id) (GvgXmlParser  *self,
+                                   guint          id,
+                                   const gchar  **attrs);
+  void        (*element_end_id)   (GvgXmlParser  *self,
+                                   guint          id,
+                                   const gchar   *content,
+                                   gsize          len);
+  /* all elements, by path.  slower, only used if set */
   void        (*element_start)    (GvgXmlParser  *self,
                                    const gchar   *name,
                                    const gchar  **attrs,
@@ -58,14 +76,69 @@ struct _GvgXmlParserClass
                                    const gchar   *name,
                                    const gchar   *content,
                                    const gchar   *path);
+  
+  /* records are complete results built by subclasses while parsing, that
+   * can be applied later on (e.g. from another thread) */
+  void        (*record_apply)     (GvgXmlParser  *self,
+                                   gpointer       record);
+  void        (*record_free)      (gpointer       record);
+  
+  /* creates a new parser with the same settings but a fresh state, e.g. to
+   * parse another stream with the same output */
+  GvgXmlParser *(*dup)            (GvgXmlParser  *self);
+  /* forgets the state of the current stream, see gvg_xml_parser_reset() */
+  void        (*reset)            (GvgXmlParser  *self);
+  /* @n_dropped bytes of malformed data were skipped, see
+   * gvg_xml_parser_set_recover().  the element being parsed is lost */
+  void        (*recovered)        (GvgXmlParser  *self,
+                                   guint64        n_dropped);
 };
 
 
 GType           gvg_xml_parser_get_type     (void) G_GNUC_CONST;
+void            gvg_xml_parser_class_add_element  (GvgXmlParserClass *klass,
+                                                   const gchar       *path,
+                                                   guint              id);
+void            gvg_xml_parser_class_set_record_element (GvgXmlParserClass *klass,
+                                                         const gchar       *path);
 gboolean        gvg_xml_parser_push         (GvgXmlParser  *parser,
                                              const gchar   *data,
                                              gsize          len,
                                              gboolean       end);
+GvgXmlParser   *gvg_xml_parser_dup          (GvgXmlParser  *self);
+gboolean        gvg_xml_parser_is_complete  (GvgXmlParser  *self);
+const gchar    *gvg_xml_parser_keep         (GvgXmlParser  *self,
+                                             const gchar   *str,
+                                             gsize          len);
+void            gvg_xml_parser_emit_record  (GvgXmlParser  *self,
+                                             gpointer       record);
+gboolean        gvg_xml_parser_get_deferred (GvgXmlParser  *self);
+void            gvg_xml_parser_set_deferred (GvgXmlParser  *self,
+                                             gboolean       deferred);
+guint           gvg_xml_parser_get_n_records  (GvgXmlParser *self);
+GPtrArray      *gvg_xml_parser_steal_records  (GvgXmlParser *self);
+void            gvg_xml_parser_apply_records  (GvgXmlParser *self,
+                                               GPtrArray    *records);
+void            gvg_xml_parser_set_journal  (GvgXmlParser  *self,
+                                             GvgXmlJournal *journal);
+guint           gvg_xml_parser_get_group    (GvgXmlParser  *self);
+void            gvg_xml_parser_set_group    (GvgXmlParser  *self,
+                                             guint          group);
+void            gvg_xml_parser_get_push_stats   (GvgXmlParser *self,
+                                                 guint64      *n_bytes,
+                                                 gint64       *first_time,
+                                                 gint64       *last_time);
+void            gvg_xml_parser_set_output_position  (GvgXmlParser *self,
+                                                     guint         position);
+guint           gvg_xml_parser_get_output_position  (GvgXmlParser *self);
+GvgXmlParserBackend gvg_xml_parser_get_backend  (GvgXmlParser *self);
+void            gvg_xml_parser_set_backend  (GvgXmlParser        *self,
+                                             GvgXmlParserBackend  backend);
+gboolean        gvg_xml_parser_get_recover  (GvgXmlParser  *self);
+void            gvg_xml_parser_set_recover  (GvgXmlParser  *self,
+                                             gboolean       recover);
+guint64         gvg_xml_parser_get_n_dropped  (GvgXmlParser *self);
+void            gvg_xml_parser_reset        (GvgXmlParser  *self);
 
 
 G_END_DECLS
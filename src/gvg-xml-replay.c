@@ -0,0 +1,345 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Replays a saved XML stream (e.g. a journal, see GvgXmlJournal) by writing it
+ * to a socket from a thread, so it goes through the exact same reading path as
+ * a real run.  The stream is cut in chunks of a given size, sent either as
+ * fast as possible, at a fixed rate, or with the pacing recorded in the
+ * journal's timing file.  The same file and settings always give the same
+ * sequence of writes, which makes a repeatable load.
+ */
+
+#include "gvg-xml-replay.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "gvg-xml-file.h"
+
+
+/* chunk size for a fixed rate when none is given */
+#define DEFAULT_RATE_CHUNK_SIZE (64 * 1024)
+
+
+typedef struct _TimingEntry TimingEntry;
+
+struct _TimingEntry
+{
+  guint64 offset; /* end offset of the chunk */
+  gint64  time;   /* when it arrived, in microseconds */
+};
+
+struct _GvgXmlReplay
+{
+  GvgXmlFile       *file;
+  gint              fd;
+  GvgReplayPacing   pacing;
+  gdouble           rate;       /* in MB/s */
+  gsize             chunk_size; /* 0 for natural chunks */
+  GArray           *timing;     /* TimingEntry, for the original pacing */
+  guint             timing_pos;
+  
+  /* current slice of the file */
+  const gchar      *slice;
+  gsize             slice_len;
+  gsize             slice_pos;
+  guint64           offset;
+  
+  GThread          *thread;
+  
+  /* protected by @lock */
+  GMutex            lock;
+  GCond             cond;
+  gboolean          stopping;
+};
+
+
+static GArray *
+load_timing (const gchar  *filename,
+             GError      **error)
+{
+  gchar  *timing_filename;
+  gchar  *contents;
+  gchar  *p;
+  GArray *timing = NULL;
+  
+  timing_filename = g_strconcat (filename, ".timing", NULL);
+  if (g_file_get_contents (timing_filename, &contents, NULL, error)) {
+    timing = g_array_new (FALSE, FALSE, sizeof (TimingEntry));
+    for (p = contents; *p; ) {
+      TimingEntry entry;
+      gchar      *end;
+      
+      entry.offset = g_ascii_strtoull (p, &end, 10);
+      if (end == p) {
+        break;
+      }
+      p = end;
+      entry.time = g_ascii_strtoll (p, &end, 10);
+      if (end == p) {
+        break;
+      }
+      p = end;
+      while (g_ascii_isspace (*p)) {
+        p++;
+      }
+      g_array_append_val (timing, entry);
+    }
+    if (*p) {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "malformed timing file \"%s\"", timing_filename);
+      g_array_unref (timing);
+      timing = NULL;
+    }
+    g_free (contents);
+  }
+  g_free (timing_filename);
+  
+  return timing;
+}
+
+/* gets the next chunk to send.  returns %FALSE at the end or on error */
+static gboolean
+next_chunk (GvgXmlReplay *self,
+            const gchar **chunk,
+            gsize        *len)
+{
+  gsize size;
+  
+  while (self->slice_pos >= self->slice_len) {
+    GError *err = NULL;
+    
+    if (gvg_xml_file_is_eof (self->file)) {
+      return FALSE;
+    }
+    self->slice = gvg_xml_file_next_slice (self->file, &self->slice_len, &err);
+    self->slice_pos = 0;
+    if (err) {
+      g_warning ("failed to read XML file: %s", err->message);
+      g_error_free (err);
+      return FALSE;
+    }
+  }
+  
+  if (self->timing) {
+    /* skip the timings of what was already sent */
+    while (self->timing_pos < self->timing->len &&
+           g_array_index (self->timing, TimingEntry,
+                          self->timing_pos).offset <= self->offset) {
+      self->timing_pos++;
+    }
+  }
+  
+  size = self->slice_len - self->slice_pos;
+  if (self->chunk_size > 0) {
+    size = MIN (size, self->chunk_size);
+  } else if (self->pacing == GVG_REPLAY_PACING_RATE) {
+    size = MIN (size, DEFAULT_RATE_CHUNK_SIZE);
+  } else if (self->pacing == GVG_REPLAY_PACING_ORIGINAL) {
+    /* the chunks as they were read */
+    if (self->timing_pos < self->timing->len) {
+      guint64 end = g_array_index (self->timing, TimingEntry,
+                                   self->timing_pos).offset;
+      
+      size = (gsize) MIN ((guint64) size, end - self->offset);
+    }
+  }
+  
+  *chunk = &self->slice[self->slice_pos];
+  *len = size;
+  self->slice_pos += size;
+  
+  return TRUE;
+}
+
+/* when the data up to @end should be sent, in microseconds since the start */
+static gint64
+get_due_time (GvgXmlReplay *self,
+              guint64       end)
+{
+  switch (self->pacing) {
+    case GVG_REPLAY_PACING_RATE:
+      /* MB/s are bytes per microsecond */
+      return (gint64) ((gdouble) end / self->rate);
+    
+    case GVG_REPLAY_PACING_ORIGINAL: {
+      guint i;
+      
+      /* when the last byte of the chunk arrived */
+      for (i = self->timing_pos; i < self->timing->len; i++) {
+        TimingEntry *entry = &g_array_index (self->timing, TimingEntry, i);
+        
+        if (entry->offset >= end) {
+          return entry->time;
+        }
+      }
+      return 0;
+    }
+    
+    default:
+      return 0;
+  }
+}
+
+/* waits until @time, returns %FALSE if asked to stop meanwhile */
+static gboolean
+wait_until (GvgXmlReplay *self,
+            gint64        time)
+{
+  gboolean stopping;
+  
+  g_mutex_lock (&self->lock);
+  while (! self->stopping && g_get_monotonic_time () < time) {
+    g_cond_wait_until (&self->cond, &self->lock, time);
+  }
+  stopping = self->stopping;
+  g_mutex_unlock (&self->lock);
+  
+  return ! stopping;
+}
+
+static gboolean
+send_all (gint         fd,
+          const gchar *data,
+          gsize        len)
+{
+  while (len > 0) {
+    /* don't get SIGPIPE if the reader is gone */
+    gssize n = send (fd, data, len, MSG_NOSIGNAL);
+    
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EPIPE) {
+        g_warning ("failed to replay XML: %s", g_strerror (errno));
+      }
+      return FALSE;
+    }
+    data += n;
+    len -= (gsize) n;
+  }
+  
+  return TRUE;
+}
+
+static gpointer
+replay_thread (gpointer data)
+{
+  GvgXmlReplay *self  = data;
+  gint64        start = g_get_monotonic_time ();
+  const gchar  *chunk;
+  gsize         len;
+  
+  while (next_chunk (self, &chunk, &len)) {
+    if (! wait_until (self, start + get_due_time (self, self->offset + len)) ||
+        ! send_all (self->fd, chunk, len)) {
+      break;
+    }
+    self->offset += len;
+  }
+  /* let the reader see the end */
+  close (self->fd);
+  self->fd = -1;
+  
+  return NULL;
+}
+
+/* starts replaying @filename to @fd, which is then owned by the replay.  @rate
+ * is in MB/s and only used with GVG_REPLAY_PACING_RATE, and @chunk_size is the
+ * size of the writes, or 0 for the natural size of the pacing */
+GvgXmlReplay *
+gvg_xml_replay_new (const gchar     *filename,
+                    GvgReplayPacing  pacing,
+                    gdouble          rate,
+                    gsize            chunk_size,
+                    gint             fd,
+                    GError         **error)
+{
+  GvgXmlReplay *self;
+  GvgXmlFile   *file;
+  GArray       *timing = NULL;
+  
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (pacing != GVG_REPLAY_PACING_RATE || rate > 0.0, NULL);
+  g_return_val_if_fail (fd >= 0, NULL);
+  
+  if (pacing == GVG_REPLAY_PACING_ORIGINAL) {
+    timing = load_timing (filename, error);
+    if (! timing) {
+      return NULL;
+    }
+  }
+  file = gvg_xml_file_open (filename, error);
+  if (! file) {
+    if (timing) {
+      g_array_unref (timing);
+    }
+    return NULL;
+  }
+  
+  self = g_slice_new (GvgXmlReplay);
+  self->file        = file;
+  self->fd          = fd;
+  self->pacing      = pacing;
+  self->rate        = rate;
+  self->chunk_size  = chunk_size;
+  self->timing      = timing;
+  self->timing_pos  = 0;
+  self->slice       = NULL;
+  self->slice_len   = 0;
+  self->slice_pos   = 0;
+  self->offset      = 0;
+  self->stopping    = FALSE;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  self->thread = g_thread_new ("gvg-xml-replay", replay_thread, self);
+  
+  return self;
+}
+
+/* stops the replay.  the reading side must have been closed already if it
+ * isn't reading anymore, not to block the writes */
+void
+gvg_xml_replay_free (GvgXmlReplay *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  self->stopping = TRUE;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->lock);
+  g_thread_join (self->thread);
+  
+  gvg_xml_file_free (self->file);
+  if (self->timing) {
+    g_array_unref (self->timing);
+  }
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+  g_slice_free (GvgXmlReplay, self);
+}
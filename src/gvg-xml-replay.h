@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_REPLAY
+#define H_GVG_XML_REPLAY
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef enum
+{
+  GVG_REPLAY_PACING_FAST,     /* as fast as the reader can take it */
+  GVG_REPLAY_PACING_ORIGINAL, /* as the data arrived when journaled */
+  GVG_REPLAY_PACING_RATE      /* at a fixed rate */
+} GvgReplayPacing;
+
+typedef struct _GvgXmlReplay GvgXmlReplay;
+
+
+GvgXmlReplay   *gvg_xml_replay_new      (const gchar     *filename,
+                                         GvgReplayPacing  pacing,
+                                         gdouble          rate,
+                                         gsize            chunk_size,
+                                         gint             fd,
+                                         GError         **error);
+void            gvg_xml_replay_free     (GvgXmlReplay *replay);
+
+
+G_END_DECLS
+
+#endif /* guard */
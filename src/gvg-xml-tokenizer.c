@@ -0,0 +1,441 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * A streaming tokenizer for the subset of XML Valgrind writes.
+ * 
+ * Valgrind's XML output only uses a handful of elements, without attributes,
+ * namespaces, DTD, comments nor CDATA, and text only contains the predefined
+ * and numeric character references.  This tokenizer handles exactly that, and
+ * reports elements and text without building anything.  Most of the input is
+ * text, which is searched for the next '<' or '&' with SSE2 or AVX2 when the
+ * compiler targets them.
+ * 
+ * Data can be split anywhere: a tag or reference cut by the end of a chunk is
+ * kept aside until it is complete.  Anything else (or anything malformed)
+ * stops the tokenizer, which then gives back the input it didn't handle, and
+ * the caller is expected to go on with a real parser (see GvgXmlParser).
+ */
+
+#include "gvg-xml-tokenizer.h"
+
+#include <glib.h>
+#include <string.h>
+
+#if defined (__AVX2__)
+# include <immintrin.h>
+#elif defined (__SSE2__)
+# include <emmintrin.h>
+#endif
+
+
+/* longer tags or references aren't from Valgrind */
+#define MAX_TOKEN_LEN 1024
+
+
+struct _GvgXmlTokenizer
+{
+  GvgXmlTokenizerFuncs  funcs;
+  gpointer              user_data;
+  
+  GString              *pending;  /* a token cut by the end of a chunk */
+  GString              *path;     /* the open elements, e.g. /root/node */
+  gboolean              complete; /* whether the root element ended */
+  gboolean              failed;
+};
+
+
+GvgXmlTokenizer *
+gvg_xml_tokenizer_new (const GvgXmlTokenizerFuncs  *funcs,
+                       gpointer                     user_data)
+{
+  GvgXmlTokenizer *self;
+  
+  g_return_val_if_fail (funcs != NULL, NULL);
+  
+  self = g_slice_new (GvgXmlTokenizer);
+  self->funcs     = *funcs;
+  self->user_data = user_data;
+  self->pending   = g_string_new (NULL);
+  self->path      = g_string_new (NULL);
+  self->complete  = FALSE;
+  self->failed    = FALSE;
+  
+  return self;
+}
+
+void
+gvg_xml_tokenizer_free (GvgXmlTokenizer *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_string_free (self->pending, TRUE);
+  g_string_free (self->path, TRUE);
+  g_slice_free (GvgXmlTokenizer, self);
+}
+
+/* finds the first character that ends a run of text: '<', '&' or '\r' (which
+ * XML normalizes), or @end */
+static const gchar *
+scan_text (const gchar *p,
+           const gchar *end)
+{
+#if defined (__AVX2__)
+  const __m256i lt32  = _mm256_set1_epi8 ('<');
+  const __m256i amp32 = _mm256_set1_epi8 ('&');
+  const __m256i cr32  = _mm256_set1_epi8 ('\r');
+  
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+    __m256i m = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, lt32),
+                                                  _mm256_cmpeq_epi8 (v, amp32)),
+                                 _mm256_cmpeq_epi8 (v, cr32));
+    guint32 bits = (guint32) _mm256_movemask_epi8 (m);
+    
+    if (bits) {
+      return p + g_bit_nth_lsf (bits, -1);
+    }
+    p += 32;
+  }
+#endif
+#if defined (__SSE2__)
+  {
+    const __m128i lt16  = _mm_set1_epi8 ('<');
+    const __m128i amp16 = _mm_set1_epi8 ('&');
+    const __m128i cr16  = _mm_set1_epi8 ('\r');
+    
+    while (end - p >= 16) {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i m = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, lt16),
+                                              _mm_cmpeq_epi8 (v, amp16)),
+                                _mm_cmpeq_epi8 (v, cr16));
+      guint32 bits = (guint32) _mm_movemask_epi8 (m);
+      
+      if (bits) {
+        return p + g_bit_nth_lsf (bits, -1);
+      }
+      p += 16;
+    }
+  }
+#endif
+  
+  for (; p < end; p++) {
+    if (*p == '<' || *p == '&' || *p == '\r') {
+      break;
+    }
+  }
+  
+  return p;
+}
+
+static gboolean
+is_blank (const gchar *str,
+          gsize        len)
+{
+  gsize i;
+  
+  for (i = 0; i < len; i++) {
+    if (str[i] != ' ' && str[i] != '\t' && str[i] != '\n') {
+      return FALSE;
+    }
+  }
+  
+  return TRUE;
+}
+
+/* only ASCII names, others are left to the real parser */
+static gboolean
+is_name (const gchar *name,
+         gsize        len)
+{
+  gsize i;
+  
+  if (len == 0 || ! (g_ascii_isalpha (name[0]) ||
+                     name[0] == '_' || name[0] == ':')) {
+    return FALSE;
+  }
+  for (i = 1; i < len; i++) {
+    if (! (g_ascii_isalnum (name[i]) || name[i] == '_' || name[i] == ':' ||
+           name[i] == '-' || name[i] == '.')) {
+      return FALSE;
+    }
+  }
+  
+  return TRUE;
+}
+
+static gboolean
+tokenizer_text (GvgXmlTokenizer *self,
+                const gchar     *text,
+                gsize            len)
+{
+  if (self->path->len == 0) {
+    /* only blanks may surround the root element */
+    return is_blank (text, len);
+  }
+  
+  self->funcs.text (text, len, self->user_data);
+  
+  return TRUE;
+}
+
+static gboolean
+tokenizer_start (GvgXmlTokenizer *self,
+                 const gchar     *name,
+                 gsize            len,
+                 gboolean         empty)
+{
+  if (! is_name (name, len) || (self->path->len == 0 && self->complete)) {
+    return FALSE;
+  }
+  
+  g_string_append_c (self->path, '/');
+  g_string_append_len (self->path, name, (gssize) len);
+  self->funcs.element_start (name, len, self->user_data);
+  if (empty) {
+    self->funcs.element_end (self->user_data);
+    g_string_truncate (self->path, self->path->len - len - 1);
+    self->complete = self->path->len == 0;
+  }
+  
+  return TRUE;
+}
+
+static gboolean
+tokenizer_end (GvgXmlTokenizer *self,
+               const gchar     *name,
+               gsize            len)
+{
+  gsize start;
+  
+  while (len > 0 && g_ascii_isspace (name[len - 1])) {
+    len--;
+  }
+  /* it has to close the last open element */
+  if (self->path->len <= len) {
+    return FALSE;
+  }
+  start = self->path->len - len;
+  if (self->path->str[start - 1] != '/' ||
+      memcmp (&self->path->str[start], name, len) != 0) {
+    return FALSE;
+  }
+  
+  self->funcs.element_end (self->user_data);
+  g_string_truncate (self->path, start - 1);
+  self->complete = self->path->len == 0;
+  
+  return TRUE;
+}
+
+static gboolean
+tokenizer_reference (GvgXmlTokenizer *self,
+                     const gchar     *name,
+                     gsize            len)
+{
+  static const struct {
+    const gchar  *name;
+    gsize         len;
+    const gchar  *text;
+  } entities[] = {
+    { "lt",   2, "<" },
+    { "gt",   2, ">" },
+    { "amp",  3, "&" },
+    { "quot", 4, "\"" },
+    { "apos", 4, "'" }
+  };
+  gchar buf[8];
+  guint i;
+  
+  if (len > 1 && name[0] == '#') {
+    gboolean  hex   = name[1] == 'x';
+    gsize     start = hex ? 2 : 1;
+    gchar    *end;
+    guint64   value;
+    
+    /* strtoull() would skip blanks and take a sign */
+    if (start >= len || ! g_ascii_isxdigit (name[start])) {
+      return FALSE;
+    }
+    /* @name is followed by the ';' so the conversion stops there */
+    value = g_ascii_strtoull (&name[start], &end, hex ? 16 : 10);
+    if (end != &name[len] || value == 0 || value > G_MAXUINT32 ||
+        ! g_unichar_validate ((gunichar) value)) {
+      return FALSE;
+    }
+    
+    len = (gsize) g_unichar_to_utf8 ((gunichar) value, buf);
+    return tokenizer_text (self, buf, len);
+  }
+  
+  for (i = 0; i < G_N_ELEMENTS (entities); i++) {
+    if (len == entities[i].len && memcmp (name, entities[i].name, len) == 0) {
+      return tokenizer_text (self, entities[i].text, 1);
+    }
+  }
+  
+  return FALSE;
+}
+
+/* handles a whole "<...>" or "&...;" token */
+static gboolean
+tokenizer_token (GvgXmlTokenizer *self,
+                 const gchar     *token,
+                 gsize            len)
+{
+  const gchar  *inner = &token[1];
+  gsize         n     = len - 2;
+  
+  if (token[0] == '&') {
+    /* a reference outside of the root element goes through text */
+    return tokenizer_reference (self, inner, n);
+  } else if (n == 0) {
+    return FALSE;
+  } else if (inner[0] == '?') {
+    /* processing instructions, i.e. the XML declaration, mean nothing to us */
+    return n > 1 && inner[n - 1] == '?';
+  } else if (inner[0] == '!') {
+    /* comments, CDATA and DTD */
+    return FALSE;
+  } else if (inner[0] == '/') {
+    return tokenizer_end (self, &inner[1], n - 1);
+  } else if (inner[n - 1] == '/') {
+    return tokenizer_start (self, inner, n - 1, TRUE);
+  } else {
+    return tokenizer_start (self, inner, n, FALSE);
+  }
+}
+
+/* stops at @p, keeping what's left of the input for the caller */
+static gboolean
+tokenizer_fail (GvgXmlTokenizer  *self,
+                const gchar      *p,
+                const gchar      *end,
+                const gchar     **rest,
+                gsize            *rest_len)
+{
+  self->failed = TRUE;
+  g_string_append_len (self->pending, p, end - p);
+  *rest = self->pending->str;
+  *rest_len = self->pending->len;
+  
+  return FALSE;
+}
+
+/*
+ * feeds @len bytes of @data to the tokenizer.  if it meets something it
+ * doesn't handle it returns %FALSE, and sets @rest and @rest_len to the input
+ * it didn't report, including what it kept from previous chunks.  it is then
+ * unusable until reset.  gvg_xml_tokenizer_get_path() tells which elements
+ * are open at this point
+ */
+gboolean
+gvg_xml_tokenizer_push (GvgXmlTokenizer  *self,
+                        const gchar      *data,
+                        gsize             len,
+                        const gchar     **rest,
+                        gsize            *rest_len)
+{
+  const gchar *p    = data;
+  const gchar *end  = data + len;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (! self->failed, FALSE);
+  g_return_val_if_fail (rest != NULL && rest_len != NULL, FALSE);
+  
+  if (self->pending->len > 0) {
+    gchar         term = self->pending->str[0] == '<' ? '>' : ';';
+    const gchar  *t    = memchr (p, term, len);
+    
+    if (! t) {
+      if (self->pending->len + len > MAX_TOKEN_LEN) {
+        return tokenizer_fail (self, p, end, rest, rest_len);
+      }
+      g_string_append_len (self->pending, p, (gssize) len);
+      return TRUE;
+    }
+    g_string_append_len (self->pending, p, t + 1 - p);
+    if (! tokenizer_token (self, self->pending->str, self->pending->len)) {
+      return tokenizer_fail (self, t + 1, end, rest, rest_len);
+    }
+    g_string_truncate (self->pending, 0);
+    p = t + 1;
+  }
+  
+  while (p < end) {
+    const gchar  *s = scan_text (p, end);
+    const gchar  *t;
+    
+    if (s > p && ! tokenizer_text (self, p, (gsize) (s - p))) {
+      return tokenizer_fail (self, p, end, rest, rest_len);
+    }
+    if (s == end) {
+      break;
+    } else if (*s == '\r') {
+      return tokenizer_fail (self, s, end, rest, rest_len);
+    }
+    
+    t = memchr (s + 1, *s == '<' ? '>' : ';', (gsize) (end - s - 1));
+    if (! t) {
+      if (end - s > MAX_TOKEN_LEN) {
+        return tokenizer_fail (self, s, end, rest, rest_len);
+      }
+      g_string_append_len (self->pending, s, end - s);
+      break;
+    }
+    if (! tokenizer_token (self, s, (gsize) (t + 1 - s))) {
+      return tokenizer_fail (self, s, end, rest, rest_len);
+    }
+    p = t + 1;
+  }
+  
+  return TRUE;
+}
+
+/* gets the path of the open elements, e.g. /root/node, or "" if none is */
+const gchar *
+gvg_xml_tokenizer_get_path (GvgXmlTokenizer *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  
+  return self->path->str;
+}
+
+/* whether the root element ended */
+gboolean
+gvg_xml_tokenizer_is_complete (GvgXmlTokenizer *self)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  
+  return self->complete;
+}
+
+/* makes the tokenizer ready for a new stream */
+void
+gvg_xml_tokenizer_reset (GvgXmlTokenizer *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_string_truncate (self->pending, 0);
+  g_string_truncate (self->path, 0);
+  self->complete = FALSE;
+  self->failed = FALSE;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_TOKENIZER
+#define H_GVG_XML_TOKENIZER
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlTokenizer       GvgXmlTokenizer;
+typedef struct _GvgXmlTokenizerFuncs  GvgXmlTokenizerFuncs;
+
+/* what the tokenizer reports.  @name and @text are only lent to the callback,
+ * and text may come in several pieces */
+struct _GvgXmlTokenizerFuncs
+{
+  void  (*element_start)  (const gchar *name,
+                           gsize        len,
+                           gpointer     user_data);
+  void  (*element_end)    (gpointer     user_data);
+  void  (*text)           (const gchar *text,
+                           gsize        len,
+                           gpointer     user_data);
+};
+
+
+GvgXmlTokenizer  *gvg_xml_tokenizer_new       (const GvgXmlTokenizerFuncs *funcs,
+                                               gpointer                    user_data);
+void              gvg_xml_tokenizer_free      (GvgXmlTokenizer *self);
+gboolean          gvg_xml_tokenizer_push      (GvgXmlTokenizer  *self,
+                                               const gchar      *data,
+                                               gsize             len,
+                                               const gchar     **rest,
+                                               gsize            *rest_len);
+const gchar      *gvg_xml_tokenizer_get_path  (GvgXmlTokenizer *self);
+gboolean          gvg_xml_tokenizer_is_complete (GvgXmlTokenizer *self);
+void              gvg_xml_tokenizer_reset     (GvgXmlTokenizer *self);
+
+
+G_END_DECLS
+
+#endif /* guard */
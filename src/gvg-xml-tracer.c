@@ -0,0 +1,282 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Follows the XML output of a process tree traced by Valgrind with
+ * --trace-children=yes --xml-file=DIR/%p.xml: each process writes its own file
+ * in a temporary directory we monitor, and each file is read as it grows and
+ * parsed by its own copy of the parser (see gvg_xml_parser_dup()).
+ */
+
+#include "gvg-xml-tracer.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "gvg-xml-parser.h"
+
+
+#define READ_BUFFER_SIZE    (64 * 1024)
+/* how often a growing file may be read, in milliseconds */
+#define MONITOR_RATE_LIMIT  100
+
+
+typedef struct _Stream Stream;
+
+struct _Stream
+{
+  gchar        *path;
+  gint          fd;
+  GvgXmlParser *parser;
+};
+
+struct _GvgXmlTracer
+{
+  gchar            *dir;
+  GFileMonitor     *monitor;
+  GHashTable       *streams;  /* path -> Stream */
+  GvgXmlParser     *parser;   /* template parser for new streams */
+  gchar            *buffer;
+  
+  GvgXmlTracerFunc  complete_func;
+  gpointer          data;
+};
+
+
+static void
+stream_free (Stream *stream)
+{
+  /* terminate the stream, whatever it contained */
+  gvg_xml_parser_push (stream->parser, NULL, 0, TRUE);
+  g_object_unref (stream->parser);
+  close (stream->fd);
+  g_unlink (stream->path);
+  g_free (stream->path);
+  g_slice_free (Stream, stream);
+}
+
+static Stream *
+stream_open (GvgXmlTracer *self,
+             const gchar  *path)
+{
+  Stream *stream;
+  gint    fd;
+  
+  fd = g_open (path, O_RDONLY, 0);
+  if (fd < 0) {
+    g_warning ("failed to open \"%s\": %s", path, g_strerror (errno));
+    return NULL;
+  }
+  
+  g_debug ("following %s", path);
+  stream = g_slice_new (Stream);
+  stream->path = g_strdup (path);
+  stream->fd = fd;
+  stream->parser = gvg_xml_parser_dup (self->parser);
+  g_hash_table_insert (self->streams, stream->path, stream);
+  
+  return stream;
+}
+
+/* reads and parses whatever was appended to the file since last time */
+static void
+stream_read (GvgXmlTracer *self,
+             Stream       *stream)
+{
+  for (;;) {
+    gssize n = read (stream->fd, self->buffer, READ_BUFFER_SIZE);
+    
+    if (n > 0) {
+      gvg_xml_parser_push (stream->parser, self->buffer, (gsize) n, FALSE);
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      if (n < 0) {
+        g_warning ("failed to read \"%s\": %s", stream->path,
+                   g_strerror (errno));
+      }
+      break;
+    }
+  }
+}
+
+static void
+monitor_changed (GFileMonitor      *monitor,
+                 GFile             *file,
+                 GFile             *other_file,
+                 GFileMonitorEvent  event_type,
+                 gpointer           data)
+{
+  GvgXmlTracer *self = data;
+  gchar        *path;
+  Stream       *stream;
+  
+  if (event_type != G_FILE_MONITOR_EVENT_CREATED &&
+      event_type != G_FILE_MONITOR_EVENT_CHANGED) {
+    return;
+  }
+  
+  path = g_file_get_path (file);
+  stream = g_hash_table_lookup (self->streams, path);
+  if (! stream && g_str_has_suffix (path, ".xml")) {
+    stream = stream_open (self, path);
+  }
+  g_free (path);
+  
+  if (stream && ! gvg_xml_parser_is_complete (stream->parser)) {
+    stream_read (self, stream);
+    if (gvg_xml_parser_is_complete (stream->parser) &&
+        gvg_xml_tracer_is_complete (self) && self->complete_func) {
+      self->complete_func (self, self->data);
+    }
+  }
+}
+
+/* creates a temporary directory for the streams and starts monitoring it */
+GvgXmlTracer *
+gvg_xml_tracer_new (GvgXmlParser      *parser,
+                    GvgXmlTracerFunc   complete_func,
+                    gpointer           data,
+                    GError           **error)
+{
+  GvgXmlTracer *self;
+  gchar        *dir;
+  GFile        *file;
+  GFileMonitor *monitor;
+  
+  g_return_val_if_fail (GVG_IS_XML_PARSER (parser), NULL);
+  
+  dir = g_dir_make_tmp ("gvg-XXXXXX", error);
+  if (! dir) {
+    return NULL;
+  }
+  file = g_file_new_for_path (dir);
+  monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, error);
+  g_object_unref (file);
+  if (! monitor) {
+    g_rmdir (dir);
+    g_free (dir);
+    return NULL;
+  }
+  
+  self = g_slice_new (GvgXmlTracer);
+  self->dir           = dir;
+  self->monitor       = monitor;
+  self->streams       = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                               (GDestroyNotify) stream_free);
+  self->parser        = g_object_ref (parser);
+  self->buffer        = g_malloc (READ_BUFFER_SIZE);
+  self->complete_func = complete_func;
+  self->data          = data;
+  
+  g_file_monitor_set_rate_limit (self->monitor, MONITOR_RATE_LIMIT);
+  g_signal_connect (self->monitor, "changed",
+                    G_CALLBACK (monitor_changed), self);
+  
+  return self;
+}
+
+/* reads what's left and removes the streams and the directory */
+void
+gvg_xml_tracer_free (GvgXmlTracer *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_file_monitor_cancel (self->monitor);
+  g_signal_handlers_disconnect_by_func (self->monitor, monitor_changed, self);
+  g_object_unref (self->monitor);
+  gvg_xml_tracer_update (self);
+  g_hash_table_destroy (self->streams);
+  g_rmdir (self->dir);
+  g_free (self->dir);
+  g_free (self->buffer);
+  g_object_unref (self->parser);
+  g_slice_free (GvgXmlTracer, self);
+}
+
+/* the directory in which the processes should write their output */
+const gchar *
+gvg_xml_tracer_get_dir (GvgXmlTracer *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  
+  return self->dir;
+}
+
+/* reads all the streams now, including ones not reported by the monitor
+ * yet */
+void
+gvg_xml_tracer_update (GvgXmlTracer *self)
+{
+  GDir           *dir;
+  const gchar    *name;
+  GHashTableIter  iter;
+  gpointer        stream;
+  
+  g_return_if_fail (self != NULL);
+  
+  dir = g_dir_open (self->dir, 0, NULL);
+  if (dir) {
+    while ((name = g_dir_read_name (dir))) {
+      gchar *path = g_build_filename (self->dir, name, NULL);
+      
+      if (g_str_has_suffix (name, ".xml") &&
+          ! g_hash_table_lookup (self->streams, path)) {
+        stream_open (self, path);
+      }
+      g_free (path);
+    }
+    g_dir_close (dir);
+  }
+  
+  g_hash_table_iter_init (&iter, self->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &stream)) {
+    stream_read (self, stream);
+  }
+}
+
+/* whether at least a stream was seen, and all of them are complete */
+gboolean
+gvg_xml_tracer_is_complete (GvgXmlTracer *self)
+{
+  GHashTableIter  iter;
+  gpointer        value;
+  
+  g_return_val_if_fail (self != NULL, FALSE);
+  
+  if (g_hash_table_size (self->streams) == 0) {
+    return FALSE;
+  }
+  g_hash_table_iter_init (&iter, self->streams);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    Stream *stream = value;
+    
+    if (! gvg_xml_parser_is_complete (stream->parser)) {
+      return FALSE;
+    }
+  }
+  
+  return TRUE;
+}
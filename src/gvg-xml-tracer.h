@@ -0,0 +1,51 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_TRACER
+#define H_GVG_XML_TRACER
+
+#include <glib.h>
+
+#include "gvg-xml-parser.h"
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlTracer GvgXmlTracer;
+
+/* called when all the streams seen so far are complete */
+typedef void (*GvgXmlTracerFunc) (GvgXmlTracer *tracer,
+                                  gpointer      data);
+
+
+GvgXmlTracer   *gvg_xml_tracer_new          (GvgXmlParser      *parser,
+                                             GvgXmlTracerFunc   complete_func,
+                                             gpointer           data,
+                                             GError           **error);
+void            gvg_xml_tracer_free         (GvgXmlTracer *tracer);
+const gchar    *gvg_xml_tracer_get_dir      (GvgXmlTracer *tracer);
+void            gvg_xml_tracer_update       (GvgXmlTracer *tracer);
+gboolean        gvg_xml_tracer_is_complete  (GvgXmlTracer *tracer);
+
+
+G_END_DECLS
+
+#endif /* guard */
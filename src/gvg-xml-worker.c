@@ -0,0 +1,462 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+/*
+ * Reads Valgrind's XML output and parses it in a separate thread.
+ * 
+ * The worker thread owns the input (a pipe or a saved file) and the parser,
+ * which is put in deferred mode so the records it builds are gathered in
+ * batches.  Batches are sent to the main thread through a bounded queue,
+ * where they are applied from an idle callback, so the UI only ever applies
+ * ready-made results.
+ * 
+ * A batch is sent as soon as it holds @batch_size records, or when its first
+ * record waited for @latency milliseconds.  If the main thread doesn't keep
+ * up and the queue holds @max_batches batches, the worker stops reading
+ * until some get applied.
+ */
+
+#include "gvg-xml-worker.h"
+
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "gvg-xml-parser.h"
+#include "gvg-pipe-reader.h"
+#include "gvg-xml-file.h"
+
+
+struct _GvgXmlWorker
+{
+  gint                  fd;
+  GvgPipeReader        *reader;
+  GvgXmlFile           *file;
+  gint                  wake_pipe[2];
+  GvgXmlParser         *parser;
+  guint                 batch_size;
+  guint                 latency;
+  guint                 max_batches;
+  
+  GThread              *thread;
+  
+  /* protected by @lock */
+  GMutex                lock;
+  GCond                 cond;
+  GQueue                batches;
+  gboolean              finished;
+  gboolean              stopping;
+  GSource              *dispatch_source;
+  guint64               n_bytes;
+  guint64               n_reads;
+  
+  GvgXmlWorkerDoneFunc  done_func;
+  gpointer              data;
+};
+
+
+static gboolean
+dispatch_batches (gpointer data)
+{
+  GvgXmlWorker *self = data;
+  GPtrArray    *batch;
+  gboolean      more;
+  gboolean      done;
+  
+  g_mutex_lock (&self->lock);
+  batch = g_queue_pop_head (&self->batches);
+  if (batch) {
+    /* there's room in the queue again */
+    g_cond_signal (&self->cond);
+  }
+  done = self->finished && g_queue_is_empty (&self->batches);
+  more = ! done && ! g_queue_is_empty (&self->batches);
+  if (! more) {
+    g_source_unref (self->dispatch_source);
+    self->dispatch_source = NULL;
+  }
+  g_mutex_unlock (&self->lock);
+  
+  if (batch) {
+    gvg_xml_parser_apply_records (self->parser, batch);
+    g_ptr_array_unref (batch);
+  }
+  /* the callback may free us, so don't touch anything afterwards */
+  if (done && self->done_func) {
+    self->done_func (self, self->data);
+  }
+  
+  return more;
+}
+
+/* must be called with the lock held */
+static void
+schedule_dispatch (GvgXmlWorker *self)
+{
+  if (! self->dispatch_source) {
+    self->dispatch_source = g_idle_source_new ();
+    /* below redraws so the UI keeps up even under a constant flow */
+    g_source_set_priority (self->dispatch_source, G_PRIORITY_DEFAULT_IDLE);
+    g_source_set_callback (self->dispatch_source, dispatch_batches, self, NULL);
+    g_source_attach (self->dispatch_source, NULL);
+  }
+}
+
+/* sends the parser's pending records to the main thread, waiting for some
+ * room in the queue if necessary */
+static void
+send_batch (GvgXmlWorker *self)
+{
+  GPtrArray *batch = gvg_xml_parser_steal_records (self->parser);
+  
+  if (! batch) {
+    return;
+  }
+  
+  g_mutex_lock (&self->lock);
+  while (! self->stopping &&
+         g_queue_get_length (&self->batches) >= self->max_batches) {
+    g_cond_wait (&self->cond, &self->lock);
+  }
+  if (self->stopping) {
+    g_ptr_array_unref (batch);
+  } else {
+    g_queue_push_tail (&self->batches, batch);
+    schedule_dispatch (self);
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static gsize
+push_to_parser (const gchar *data,
+                gsize        len,
+                gpointer     user_data)
+{
+  gvg_xml_parser_push (user_data, data, len, FALSE);
+  
+  return len;
+}
+
+/* sends the pending records if the batch is full or waited long enough.
+ * @batch_start holds when the first pending record was seen, or -1 */
+static void
+check_batch (GvgXmlWorker *self,
+             gint64       *batch_start,
+             gboolean      force)
+{
+  guint n_records = gvg_xml_parser_get_n_records (self->parser);
+  
+  if (n_records == 0) {
+    *batch_start = -1;
+  } else {
+    if (*batch_start < 0) {
+      *batch_start = g_get_monotonic_time ();
+    }
+    if (force || n_records >= self->batch_size ||
+        (g_get_monotonic_time () - *batch_start) / 1000 >= self->latency) {
+      send_batch (self);
+      *batch_start = -1;
+    }
+  }
+}
+
+static void
+read_pipe (GvgXmlWorker *self)
+{
+  gint64    batch_start = -1;
+  gboolean  eof         = FALSE;
+  
+  while (! eof) {
+    struct pollfd fds[2];
+    gint          timeout = -1;
+    
+    if (batch_start >= 0) {
+      gint64 elapsed = (g_get_monotonic_time () - batch_start) / 1000;
+      
+      timeout = (gint) MAX (0, (gint64) self->latency - elapsed);
+    }
+    
+    fds[0].fd = self->fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = self->wake_pipe[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    
+    if (poll (fds, G_N_ELEMENTS (fds), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      g_warning ("failed to poll XML pipe: %s", g_strerror (errno));
+      break;
+    }
+    if (fds[1].revents) {
+      if (g_atomic_int_get (&self->stopping)) {
+        /* we're asked to stop */
+        break;
+      }
+      /* we're asked to finish: read what's left and take it as the end */
+      fds[0].revents = POLLIN;
+      eof = TRUE;
+    }
+    if (fds[0].revents) {
+      eof = ! gvg_pipe_reader_drain (self->reader, push_to_parser,
+                                     self->parser) || eof;
+      
+      g_mutex_lock (&self->lock);
+      gvg_pipe_reader_get_stats (self->reader, &self->n_bytes, &self->n_reads);
+      g_mutex_unlock (&self->lock);
+    }
+    
+    check_batch (self, &batch_start, eof);
+  }
+}
+
+static void
+read_file (GvgXmlWorker *self)
+{
+  gint64 batch_start = -1;
+  
+  while (! gvg_xml_file_is_eof (self->file) &&
+         ! g_atomic_int_get (&self->stopping)) {
+    const gchar  *slice;
+    gsize         len;
+    GError       *err = NULL;
+    
+    slice = gvg_xml_file_next_slice (self->file, &len, &err);
+    if (err) {
+      g_warning ("failed to read XML file: %s", err->message);
+      g_error_free (err);
+      break;
+    }
+    if (len > 0) {
+      gvg_xml_parser_push (self->parser, slice, len, FALSE);
+      
+      g_mutex_lock (&self->lock);
+      self->n_bytes += len;
+      self->n_reads ++;
+      g_mutex_unlock (&self->lock);
+    }
+    
+    check_batch (self, &batch_start, FALSE);
+  }
+  check_batch (self, &batch_start, TRUE);
+}
+
+static gpointer
+worker_thread (gpointer data)
+{
+  GvgXmlWorker *self = data;
+  
+  if (self->file) {
+    read_file (self);
+  } else {
+    read_pipe (self);
+  }
+  
+  g_mutex_lock (&self->lock);
+  self->finished = TRUE;
+  if (! self->stopping) {
+    schedule_dispatch (self);
+  }
+  g_mutex_unlock (&self->lock);
+  
+  return NULL;
+}
+
+static GvgXmlWorker *
+worker_new (GvgXmlParser         *parser,
+            guint                 batch_size,
+            guint                 latency,
+            guint                 max_batches,
+            GvgXmlWorkerDoneFunc  done_func,
+            gpointer              data)
+{
+  GvgXmlWorker *self;
+  
+  self = g_slice_new0 (GvgXmlWorker);
+  if (pipe (self->wake_pipe) < 0) {
+    g_critical ("failed to create worker wake up pipe: %s", g_strerror (errno));
+    g_slice_free (GvgXmlWorker, self);
+    return NULL;
+  }
+  self->fd              = -1;
+  self->reader          = NULL;
+  self->file            = NULL;
+  self->parser          = g_object_ref (parser);
+  self->batch_size      = MAX (1, batch_size);
+  self->latency         = latency;
+  self->max_batches     = max_batches;
+  self->finished        = FALSE;
+  self->stopping        = FALSE;
+  self->dispatch_source = NULL;
+  self->n_bytes         = 0;
+  self->n_reads         = 0;
+  self->done_func       = done_func;
+  self->data            = data;
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+  g_queue_init (&self->batches);
+  
+  return self;
+}
+
+static void
+worker_start (GvgXmlWorker *self)
+{
+  gvg_xml_parser_set_deferred (self->parser, TRUE);
+  self->thread = g_thread_new ("gvg-xml-worker", worker_thread, self);
+}
+
+/* @fd is not owned by the worker, but must stay open until it is freed */
+GvgXmlWorker *
+gvg_xml_worker_new (gint                  fd,
+                    GvgXmlParser         *parser,
+                    guint                 batch_size,
+                    guint                 latency,
+                    guint                 max_batches,
+                    GvgXmlWorkerDoneFunc  done_func,
+                    gpointer              data)
+{
+  GvgXmlWorker *self;
+  
+  g_return_val_if_fail (fd >= 0, NULL);
+  g_return_val_if_fail (latency <= G_MAXINT, NULL);
+  g_return_val_if_fail (GVG_IS_XML_PARSER (parser), NULL);
+  g_return_val_if_fail (max_batches > 0, NULL);
+  
+  self = worker_new (parser, batch_size, latency, max_batches,
+                     done_func, data);
+  if (self) {
+    self->fd = fd;
+    self->reader = gvg_pipe_reader_new (fd);
+    worker_start (self);
+  }
+  
+  return self;
+}
+
+/* takes ownership of @file */
+GvgXmlWorker *
+gvg_xml_worker_new_for_file (GvgXmlFile           *file,
+                             GvgXmlParser         *parser,
+                             guint                 batch_size,
+                             guint                 latency,
+                             guint                 max_batches,
+                             GvgXmlWorkerDoneFunc  done_func,
+                             gpointer              data)
+{
+  GvgXmlWorker *self;
+  
+  g_return_val_if_fail (file != NULL, NULL);
+  g_return_val_if_fail (latency <= G_MAXINT, NULL);
+  g_return_val_if_fail (GVG_IS_XML_PARSER (parser), NULL);
+  g_return_val_if_fail (max_batches > 0, NULL);
+  
+  self = worker_new (parser, batch_size, latency, max_batches,
+                     done_func, data);
+  if (self) {
+    self->file = file;
+    worker_start (self);
+  } else {
+    gvg_xml_file_free (file);
+  }
+  
+  return self;
+}
+
+/* stops the worker, discarding any batch not yet applied */
+void
+gvg_xml_worker_free (GvgXmlWorker *self)
+{
+  GPtrArray *records;
+  
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  self->stopping = TRUE;
+  g_cond_signal (&self->cond);
+  if (self->dispatch_source) {
+    g_source_destroy (self->dispatch_source);
+    g_source_unref (self->dispatch_source);
+    self->dispatch_source = NULL;
+  }
+  g_mutex_unlock (&self->lock);
+  
+  /* wake the thread up if it's waiting for data */
+  while (write (self->wake_pipe[1], "", 1) < 0 && errno == EINTR);
+  g_thread_join (self->thread);
+  
+  g_queue_foreach (&self->batches, (GFunc) g_ptr_array_unref, NULL);
+  g_queue_clear (&self->batches);
+  /* drop whatever the thread didn't send */
+  records = gvg_xml_parser_steal_records (self->parser);
+  if (records) {
+    g_ptr_array_unref (records);
+  }
+  gvg_xml_parser_set_deferred (self->parser, FALSE);
+  g_object_unref (self->parser);
+  if (self->reader) {
+    gvg_pipe_reader_free (self->reader);
+  }
+  if (self->file) {
+    gvg_xml_file_free (self->file);
+  }
+  
+  close (self->wake_pipe[0]);
+  close (self->wake_pipe[1]);
+  g_mutex_clear (&self->lock);
+  g_cond_clear (&self->cond);
+  g_slice_free (GvgXmlWorker, self);
+}
+
+/* asks the worker to stop reading once it got what is currently in the pipe,
+ * even if the pipe isn't closed.  everything read is applied and the done
+ * callback is called as usual */
+void
+gvg_xml_worker_finish (GvgXmlWorker *self)
+{
+  g_return_if_fail (self != NULL);
+  
+  if (self->reader) {
+    while (write (self->wake_pipe[1], "", 1) < 0 && errno == EINTR);
+  }
+}
+
+/* statistics about the pipe reads, see gvg_pipe_reader_get_stats() */
+void
+gvg_xml_worker_get_stats (GvgXmlWorker *self,
+                          guint64      *n_bytes,
+                          guint64      *n_reads)
+{
+  g_return_if_fail (self != NULL);
+  
+  g_mutex_lock (&self->lock);
+  if (n_bytes) {
+    *n_bytes = self->n_bytes;
+  }
+  if (n_reads) {
+    *n_reads = self->n_reads;
+  }
+  g_mutex_unlock (&self->lock);
+}
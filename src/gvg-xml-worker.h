@@ -0,0 +1,63 @@
+/*
+ * Copyright 2011 Colomban Wendling <ban@herbesfolles.org>
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ * 
+ */
+
+#ifndef H_GVG_XML_WORKER
+#define H_GVG_XML_WORKER
+
+#include <glib.h>
+
+#include "gvg-xml-parser.h"
+#include "gvg-xml-file.h"
+
+G_BEGIN_DECLS
+
+
+typedef struct _GvgXmlWorker GvgXmlWorker;
+
+/* called in the main thread once all the data has been read and applied */
+typedef void (*GvgXmlWorkerDoneFunc) (GvgXmlWorker *worker,
+                                      gpointer      data);
+
+
+GvgXmlWorker   *gvg_xml_worker_new      (gint                  fd,
+                                         GvgXmlParser         *parser,
+                                         guint                 batch_size,
+                                         guint                 latency,
+                                         guint                 max_batches,
+                                         GvgXmlWorkerDoneFunc  done_func,
+                                         gpointer              data);
+GvgXmlWorker   *gvg_xml_worker_new_for_file (GvgXmlFile           *file,
+                                             GvgXmlParser         *parser,
+                                             guint                 batch_size,
+                                             guint                 latency,
+                                             guint                 max_batches,
+                                             GvgXmlWorkerDoneFunc  done_func,
+                                             gpointer              data);
+void            gvg_xml_worker_free     (GvgXmlWorker *worker);
+void            gvg_xml_worker_finish   (GvgXmlWorker *worker);
+void            gvg_xml_worker_get_stats  (GvgXmlWorker *worker,
+                                           guint64      *n_bytes,
+                                           guint64      *n_reads);
+
+
+G_END_DECLS
+
+#endif /* guard */
@@ -23,19 +23,44 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <glib/gi18n.h>
 #include <gio/gio.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <signal.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdlib.h>
 
 #include "gvg-xml-parser.h"
 #include "gvg-args-builder.h"
 #include "gvg-options.h"
+#include "gvg-xml-worker.h"
+#include "gvg-pipe-reader.h"
+#include "gvg-xml-file.h"
+#include "gvg-xml-listener.h"
+#include "gvg-xml-journal.h"
+#include "gvg-xml-replay.h"
+#include "gvg-xml-tracer.h"
+#include "gvg-child-watch.h"
+#include "gvg-output-log.h"
+#include "gvg-valgrind-info.h"
 
 
+/* how many parsed batches may wait for the main thread in threaded mode */
+#define MAX_QUEUED_BATCHES 8
+/* how long a child may take to exit after SIGTERM before being killed */
+#define TERMINATE_TIMEOUT 5
+/* how often the budgets of a run are checked, in seconds */
+#define BUDGET_CHECK_INTERVAL 1
+/* how often the progress of gvg_run_async() is reported, in milliseconds */
+#define PROGRESS_INTERVAL 250
+
 #ifdef G_OS_WIN32
 # define INVALID_PID NULL
 #else
@@ -43,15 +68,96 @@
 #endif
 
 
+typedef struct _RunAsync RunAsync;
+
+/* the gvg_run_async() going on */
+struct _RunAsync
+{
+  GSimpleAsyncResult *result;
+  GCancellable       *cancellable;
+  GSource            *cancel_source;
+  GvgRunProgressFunc  progress;
+  gpointer            progress_data;
+  guint               progress_timeout;
+  gulong              finished_handler;
+};
+
 struct _GvgPrivate
 {
   GPid          pid;
+  GvgChildWatch *child_watch;
+  guint         kill_timeout;
+  gboolean      stopping;  /* whether gvg_stop() was called on the child */
+  gboolean      running;  /* whether ::finished is to be emitted */
+  GvgStopReason stop_reason;  /* why the current or last run was stopped */
+  gchar        *stop_message;
   gint          xml_pipe;
   GSource      *pipe_source;
   GIOChannel   *pipe_channel;
+  GvgPipeReader *reader;
+  GvgXmlWorker *worker;
+  GvgXmlFile   *file;
+  GSource      *load_source;
+  GvgXmlListener *listener;
+  GvgXmlJournal *journal;
+  GvgXmlReplay *replay;
+  GvgXmlTracer *tracer;
+  
+  /* pipe statistics of the current or last run */
+  guint64       n_bytes;
+  guint64       n_reads;
   
   GvgXmlParser *parser;
   GvgOptions   *options;
+  
+  gboolean      threaded;
+  guint         batch_size;
+  guint         batch_latency;
+  gchar        *journal_file;
+  gboolean      trace_children;
+  guint         wall_time_budget;
+  guint         cpu_time_budget;
+  
+  guint         budget_timeout;
+  gint64        start_time;
+  
+  gboolean      native_run;
+  gchar       **program_argv;
+  GPid          native_pid;
+  GvgChildWatch *native_watch;
+  gint64        native_start_time;
+  GvgRunSummary summary;
+  /* costs of the run the current one carries on with, see
+   * GvgClass::continue_run */
+  GvgRunSummary carried;
+  gboolean      carrying;
+  
+  /* capture of the program's own output */
+  guint         output_buffer_size;
+  gchar        *output_spill_file;
+  GvgOutputLog *output_log;
+  gint          output_fds[2];
+  GvgPipeReader *output_readers[2];
+  GSource      *output_sources[2];
+  
+  /* result cache, and the entry the current run is for if it is to be
+   * cached */
+  gchar        *result_cache_dir;
+  GvgResultCache *result_cache;
+  gchar        *cache_key;
+  GKeyFile     *cache_description;
+  /* the run waiting for Valgrind to be probed or for its cache lookup */
+  GCancellable *pending_cancellable;
+  gchar       **pending_argv;
+  GvgOptions   *pending_options;
+  gchar       **pending_option_args;
+  gboolean      journal_ok; /* whether the last journal was fully written */
+  gboolean      journal_closing;
+  
+  gchar        *valgrind;
+  GvgValgrindInfo *valgrind_info; /* what the Valgrind of the run supports */
+  
+  RunAsync     *run_async;
 };
 
 
@@ -70,20 +176,54 @@ static void     gvg_set_property    (GObject      *object,
                                      const GValue *value,
                                      GParamSpec   *pspec);
 
-static void     cleanup_child       (Gvg     *self,
-                                     gboolean kill_it);
+static void     cleanup_child       (Gvg *self);
+static void     detach_child        (Gvg *self);
+static void     detach_native       (Gvg *self);
 static void     cleanup_pipe        (Gvg *self);
+static void     cleanup_file        (Gvg *self);
+static void     cleanup_tracer      (Gvg *self);
+static void     cleanup_output      (Gvg *self);
+static void     cleanup_cache_entry (Gvg     *self,
+                                     gboolean commit);
+static gboolean load_file           (Gvg          *self,
+                                     const gchar  *filename,
+                                     const gchar **program_argv,
+                                     GError      **error);
+static void     gvg_real_budget_exceeded  (Gvg         *self,
+                                           const gchar *message);
+
 
 
+enum
+{
+  SIGNAL_STARTED,
+  SIGNAL_FINISHED,
+  N_SIGNALS
+};
 
 enum
 {
   PROP_0,
   PROP_PARSER,
-  PROP_OPTIONS
+  PROP_OPTIONS,
+  PROP_THREADED,
+  PROP_BATCH_SIZE,
+  PROP_BATCH_LATENCY,
+  PROP_JOURNAL_FILE,
+  PROP_TRACE_CHILDREN,
+  PROP_WALL_TIME_BUDGET,
+  PROP_CPU_TIME_BUDGET,
+  PROP_NATIVE_RUN,
+  PROP_OUTPUT_BUFFER_SIZE,
+  PROP_OUTPUT_SPILL_FILE,
+  PROP_RESULT_CACHE_DIR,
+  PROP_VALGRIND
 };
 
 
+static guint signals[N_SIGNALS] = { 0 };
+
+
 static void
 gvg_class_init (GvgClass *klass)
 {
@@ -93,6 +233,8 @@ gvg_class_init (GvgClass *klass)
   object_class->set_property  = gvg_set_property;
   object_class->get_property  = gvg_get_property;
   
+  klass->budget_exceeded      = gvg_real_budget_exceeded;
+  
   g_object_class_install_property (object_class,
                                    PROP_PARSER,
                                    g_param_spec_object ("parser",
@@ -111,6 +253,135 @@ gvg_class_init (GvgClass *klass)
                                                         G_PARAM_READWRITE |
                                                         G_PARAM_STATIC_STRINGS |
                                                         G_PARAM_CONSTRUCT_ONLY));
+  g_object_class_install_property (object_class,
+                                   PROP_THREADED,
+                                   g_param_spec_boolean ("threaded",
+                                                         "Threaded",
+                                                         "Whether to read and parse Valgrind's output in a "
+                                                         "separate thread",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_BATCH_SIZE,
+                                   g_param_spec_uint ("batch-size",
+                                                      "Batch size",
+                                                      "Maximum number of records parsed in a thread "
+                                                      "to apply at once",
+                                                      1, G_MAXUINT, 256,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_BATCH_LATENCY,
+                                   g_param_spec_uint ("batch-latency",
+                                                      "Batch latency",
+                                                      "Maximum time in milliseconds a record parsed in a "
+                                                      "thread may wait before being applied",
+                                                      0, G_MAXINT, 100,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_JOURNAL_FILE,
+                                   g_param_spec_string ("journal-file",
+                                                        "Journal file",
+                                                        "File in which to save Valgrind's raw XML output "
+                                                        "of the runs, gzip-compressed",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_TRACE_CHILDREN,
+                                   g_param_spec_boolean ("trace-children",
+                                                         "Trace children",
+                                                         "Whether to also check the processes the program "
+                                                         "executes, each writing its output to its own file",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_WALL_TIME_BUDGET,
+                                   g_param_spec_uint ("wall-time-budget",
+                                                      "Wall time budget",
+                                                      "Time in seconds after which a run is stopped, "
+                                                      "or 0 for no limit",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_CPU_TIME_BUDGET,
+                                   g_param_spec_uint ("cpu-time-budget",
+                                                      "CPU time budget",
+                                                      "CPU time in seconds after which a run is stopped, "
+                                                      "or 0 for no limit",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_NATIVE_RUN,
+                                   g_param_spec_boolean ("native-run",
+                                                         "Native run",
+                                                         "Whether to also run the program without Valgrind "
+                                                         "after it, to compare their costs",
+                                                         FALSE,
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_OUTPUT_BUFFER_SIZE,
+                                   g_param_spec_uint ("output-buffer-size",
+                                                      "Output buffer size",
+                                                      "Size in bytes of the buffer keeping the last "
+                                                      "output of the program, or 0 not to capture it",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_OUTPUT_SPILL_FILE,
+                                   g_param_spec_string ("output-spill-file",
+                                                        "Output spill file",
+                                                        "File in which to save the captured output that "
+                                                        "doesn't fit in the buffer anymore",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_RESULT_CACHE_DIR,
+                                   g_param_spec_string ("result-cache-dir",
+                                                        "Result cache directory",
+                                                        "Directory in which to cache run results, so an "
+                                                        "unchanged program is not run again, or NULL "
+                                                        "not to cache them",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class,
+                                   PROP_VALGRIND,
+                                   g_param_spec_string ("valgrind",
+                                                        "Valgrind",
+                                                        "The Valgrind binary to run, looked up in PATH "
+                                                        "if it isn't a path, or NULL for \"valgrind\"",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_STRINGS));
+  
+  /* emitted when a run or load starts */
+  signals[SIGNAL_STARTED] = g_signal_new ("started",
+                                          GVG_TYPE_GVG,
+                                          G_SIGNAL_RUN_LAST,
+                                          G_STRUCT_OFFSET (GvgClass, started),
+                                          NULL, NULL,
+                                          g_cclosure_marshal_VOID__VOID,
+                                          G_TYPE_NONE,
+                                          0);
+  /* emitted when a run or load completed: the child exited and all its output
+   * was parsed */
+  signals[SIGNAL_FINISHED] = g_signal_new ("finished",
+                                           GVG_TYPE_GVG,
+                                           G_SIGNAL_RUN_LAST,
+                                           G_STRUCT_OFFSET (GvgClass, finished),
+                                           NULL, NULL,
+                                           g_cclosure_marshal_VOID__VOID,
+                                           G_TYPE_NONE,
+                                           0);
     
   g_type_class_add_private (klass, sizeof (GvgPrivate));
 }
@@ -121,10 +392,65 @@ gvg_init (Gvg *self)
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, GVG_TYPE_GVG, GvgPrivate);
   
   self->priv->pid           = INVALID_PID;
+  self->priv->child_watch   = NULL;
+  self->priv->kill_timeout  = 0;
+  self->priv->stopping      = FALSE;
+  self->priv->running       = FALSE;
+  self->priv->stop_reason   = GVG_STOP_REASON_NONE;
+  self->priv->stop_message  = NULL;
   self->priv->xml_pipe      = -1;
   self->priv->pipe_source   = NULL;
   self->priv->pipe_channel  = NULL;
+  self->priv->reader        = NULL;
+  self->priv->worker        = NULL;
+  self->priv->file          = NULL;
+  self->priv->load_source   = NULL;
+  self->priv->listener      = NULL;
+  self->priv->journal       = NULL;
+  self->priv->replay        = NULL;
+  self->priv->tracer        = NULL;
+  self->priv->n_bytes       = 0;
+  self->priv->n_reads       = 0;
   self->priv->parser        = NULL;
+  self->priv->threaded      = FALSE;
+  self->priv->batch_size    = 256;
+  self->priv->batch_latency = 100;
+  self->priv->journal_file  = NULL;
+  self->priv->trace_children = FALSE;
+  self->priv->wall_time_budget = 0;
+  self->priv->cpu_time_budget = 0;
+  self->priv->budget_timeout = 0;
+  self->priv->start_time = 0;
+  self->priv->native_run = FALSE;
+  self->priv->program_argv = NULL;
+  self->priv->native_pid = INVALID_PID;
+  self->priv->native_watch = NULL;
+  self->priv->native_start_time = 0;
+  memset (&self->priv->summary, 0, sizeof self->priv->summary);
+  memset (&self->priv->carried, 0, sizeof self->priv->carried);
+  self->priv->carrying = FALSE;
+  self->priv->output_buffer_size = 0;
+  self->priv->output_spill_file = NULL;
+  self->priv->output_log = NULL;
+  self->priv->output_fds[0] = -1;
+  self->priv->output_fds[1] = -1;
+  self->priv->output_readers[0] = NULL;
+  self->priv->output_readers[1] = NULL;
+  self->priv->output_sources[0] = NULL;
+  self->priv->output_sources[1] = NULL;
+  self->priv->result_cache_dir = NULL;
+  self->priv->result_cache = NULL;
+  self->priv->cache_key = NULL;
+  self->priv->cache_description = NULL;
+  self->priv->pending_cancellable = NULL;
+  self->priv->pending_argv = NULL;
+  self->priv->pending_options = NULL;
+  self->priv->pending_option_args = NULL;
+  self->priv->journal_ok = FALSE;
+  self->priv->journal_closing = FALSE;
+  self->priv->valgrind = NULL;
+  self->priv->valgrind_info = NULL;
+  self->priv->run_async = NULL;
 }
 
 static void
@@ -132,14 +458,34 @@ gvg_finalize (GObject *object)
 {
   Gvg *self = GVG (object);
   
-  cleanup_child (self, TRUE);
+  /* the run won't complete anymore, see cleanup_journal() */
+  self->priv->running = FALSE;
+  detach_child (self);
+  detach_native (self);
   cleanup_pipe (self);
+  cleanup_file (self);
+  cleanup_tracer (self);
+  cleanup_output (self);
+  cleanup_cache_entry (self, FALSE);
+  gvg_stop_listening (self);
   if (self->priv->parser) {
     /* ensure the parser terminated */
     gvg_xml_parser_push (self->priv->parser, NULL, 0, TRUE);
     g_object_unref (self->priv->parser);
     self->priv->parser = NULL;
   }
+  g_free (self->priv->journal_file);
+  g_free (self->priv->stop_message);
+  g_strfreev (self->priv->program_argv);
+  g_free (self->priv->output_spill_file);
+  g_free (self->priv->result_cache_dir);
+  g_free (self->priv->valgrind);
+  if (self->priv->result_cache) {
+    gvg_result_cache_free (self->priv->result_cache);
+  }
+  if (self->priv->output_log) {
+    gvg_output_log_free (self->priv->output_log);
+  }
   
   G_OBJECT_CLASS (gvg_parent_class)->finalize (object);
 }
@@ -161,6 +507,54 @@ gvg_get_property (GObject    *object,
       g_value_set_object (value, self->priv->options);
       break;
     
+    case PROP_THREADED:
+      g_value_set_boolean (value, self->priv->threaded);
+      break;
+    
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, self->priv->batch_size);
+      break;
+    
+    case PROP_BATCH_LATENCY:
+      g_value_set_uint (value, self->priv->batch_latency);
+      break;
+    
+    case PROP_JOURNAL_FILE:
+      g_value_set_string (value, self->priv->journal_file);
+      break;
+    
+    case PROP_TRACE_CHILDREN:
+      g_value_set_boolean (value, self->priv->trace_children);
+      break;
+    
+    case PROP_WALL_TIME_BUDGET:
+      g_value_set_uint (value, self->priv->wall_time_budget);
+      break;
+    
+    case PROP_CPU_TIME_BUDGET:
+      g_value_set_uint (value, self->priv->cpu_time_budget);
+      break;
+    
+    case PROP_NATIVE_RUN:
+      g_value_set_boolean (value, self->priv->native_run);
+      break;
+    
+    case PROP_OUTPUT_BUFFER_SIZE:
+      g_value_set_uint (value, self->priv->output_buffer_size);
+      break;
+    
+    case PROP_OUTPUT_SPILL_FILE:
+      g_value_set_string (value, self->priv->output_spill_file);
+      break;
+    
+    case PROP_RESULT_CACHE_DIR:
+      g_value_set_string (value, self->priv->result_cache_dir);
+      break;
+    
+    case PROP_VALGRIND:
+      g_value_set_string (value, self->priv->valgrind);
+      break;
+    
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -182,6 +576,7 @@ gvg_set_property (GObject      *object,
       self->priv->parser = g_value_dup_object (value);
       break;
     
+    /* only affects the next run */
     case PROP_OPTIONS:
       if (self->priv->options) {
         g_object_unref (self->priv->options);
@@ -189,6 +584,69 @@ gvg_set_property (GObject      *object,
       self->priv->options = g_value_dup_object (value);
       break;
     
+    /* these only affect the next run */
+    case PROP_THREADED:
+      self->priv->threaded = g_value_get_boolean (value);
+      break;
+    
+    case PROP_BATCH_SIZE:
+      self->priv->batch_size = g_value_get_uint (value);
+      break;
+    
+    case PROP_BATCH_LATENCY:
+      self->priv->batch_latency = g_value_get_uint (value);
+      break;
+    
+    case PROP_JOURNAL_FILE:
+      g_free (self->priv->journal_file);
+      self->priv->journal_file = g_value_dup_string (value);
+      break;
+    
+    case PROP_TRACE_CHILDREN:
+      self->priv->trace_children = g_value_get_boolean (value);
+      break;
+    
+    case PROP_WALL_TIME_BUDGET:
+      self->priv->wall_time_budget = g_value_get_uint (value);
+      break;
+    
+    case PROP_CPU_TIME_BUDGET:
+      self->priv->cpu_time_budget = g_value_get_uint (value);
+      break;
+    
+    case PROP_NATIVE_RUN:
+      self->priv->native_run = g_value_get_boolean (value);
+      break;
+    
+    case PROP_OUTPUT_BUFFER_SIZE:
+      self->priv->output_buffer_size = g_value_get_uint (value);
+      break;
+    
+    case PROP_OUTPUT_SPILL_FILE:
+      g_free (self->priv->output_spill_file);
+      self->priv->output_spill_file = g_value_dup_string (value);
+      break;
+    
+    case PROP_RESULT_CACHE_DIR:
+      g_free (self->priv->result_cache_dir);
+      self->priv->result_cache_dir = g_value_dup_string (value);
+      /* the current run can't be cached anymore */
+      cleanup_cache_entry (self, FALSE);
+      if (self->priv->result_cache) {
+        gvg_result_cache_free (self->priv->result_cache);
+        self->priv->result_cache = NULL;
+      }
+      if (self->priv->result_cache_dir) {
+        self->priv->result_cache = gvg_result_cache_new (self->priv->result_cache_dir);
+      }
+      break;
+    
+    /* only affects the next run */
+    case PROP_VALGRIND:
+      g_free (self->priv->valgrind);
+      self->priv->valgrind = g_value_dup_string (value);
+      break;
+    
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -207,32 +665,72 @@ close_and_invalidate (gint *fd)
   return ret;
 }
 
-/* terminates a process, giving it 5 seconds to terminate or kill it */
+#ifndef G_OS_WIN32
+/* a child that is being terminated after its Gvg went away */
+typedef struct _Terminator Terminator;
+
+struct _Terminator
+{
+  GPid  pid;
+  guint kill_timeout;
+};
+
+static gboolean
+terminator_kill (gpointer data)
+{
+  Terminator *terminator = data;
+  
+  g_debug ("child won't exit, killing it");
+  kill (terminator->pid, SIGKILL);
+  terminator->kill_timeout = 0;
+  
+  return FALSE;
+}
+
+static void
+terminator_child_exited (GPid                 pid,
+                         gint                 status,
+                         const struct rusage *usage,
+                         gpointer             data)
+{
+  Terminator *terminator = data;
+  
+  if (terminator->kill_timeout) {
+    g_source_remove (terminator->kill_timeout);
+  }
+  g_spawn_close_pid (terminator->pid);
+  g_slice_free (Terminator, terminator);
+}
+#endif
+
+/* terminates a process we no longer care about without waiting for it: it
+ * gets SIGTERM now, and SIGKILL if it didn't exit after TERMINATE_TIMEOUT
+ * seconds.  @watch is the process' watch, which is taken over */
 static void
-terminate_child (GPid pid_)
+terminate_child (GPid           pid,
+                 GvgChildWatch *watch)
 {
 #ifdef G_OS_WIN32
   /* FIXME: */
   g_warning ("don't know how to kill child on Windows");
 #else
-  pid_t pid = pid_;
-  gint  pass;
+  Terminator *terminator;
   
   /* first, try to terminate the child.  if it fails, it may mean the child
-   * already terminated, and anyway we can't recover the error so give up */
+   * already terminated, and anyway we can't recover the error so give up.
+   * the watch still reaps it */
   if (kill (pid, SIGTERM) < 0) {
+    gvg_child_watch_free (watch);
+    g_spawn_close_pid (pid);
     return;
   }
-  /* wait for up to 5 seconds for the process to die */
-  for (pass = 0; pass < 10; pass ++) {
-    if (waitpid (pid, NULL, WNOHANG) != 0) {
-      return;
-    }
-    g_usleep (500000);
-  }
-  /* finally destroy the child if it still exists */
-  g_debug ("child won't exit, killing it");
-  kill (pid, SIGKILL);
+  
+  terminator = g_slice_new (Terminator);
+  terminator->pid = pid;
+  terminator->kill_timeout = g_timeout_add_seconds (TERMINATE_TIMEOUT,
+                                                    terminator_kill,
+                                                    terminator);
+  gvg_child_watch_set_func (watch, terminator_child_exited, terminator);
 #endif
 }
 
@@ -253,79 +751,326 @@ create_io_channel (gint fd)
   return channel;
 }
 
-/* wrapper around g_poll() on an IO channel */
-static gint
-io_channel_poll (GIOChannel  *channel,
-                 GIOCondition events,
-                 gint         timeout)
+static gsize
+push_to_parser (const gchar *data,
+                gsize        len,
+                gpointer     user_data)
 {
-  GPollFD fd = { -1, 0, 0 };
+  gvg_xml_parser_push (user_data, data, len, FALSE);
   
-#ifdef G_OS_WIN32
-  g_io_channel_win32_make_pollfd (channel, events, &fd);
-#else
-  fd.events = events;
-  fd.fd = g_io_channel_unix_get_fd (channel);
-#endif
+  return len;
+}
+
+/* reads everything available in the pipe, returns %FALSE on end of file */
+static gboolean
+read_xml_pipe (Gvg *self)
+{
+  if (! gvg_pipe_reader_drain (self->priv->reader, push_to_parser,
+                               self->priv->parser)) {
+    g_debug ("pipe end");
+    return FALSE;
+  }
+  
+  return TRUE;
+}
+
+static gsize
+push_to_stdout (const gchar *data,
+                gsize        len,
+                gpointer     user_data)
+{
+  gvg_output_log_append (user_data, GVG_OUTPUT_STREAM_STDOUT, data, len);
+  
+  return len;
+}
+
+static gsize
+push_to_stderr (const gchar *data,
+                gsize        len,
+                gpointer     user_data)
+{
+  gvg_output_log_append (user_data, GVG_OUTPUT_STREAM_STDERR, data, len);
+  
+  return len;
+}
+
+/* reads everything available of the program's output on @stream, returns
+ * %FALSE on end of file */
+static gboolean
+read_output (Gvg             *self,
+             GvgOutputStream  stream)
+{
+  gboolean  alive;
   
-  return g_poll (&fd, 1, timeout);
+  alive = gvg_pipe_reader_drain (self->priv->output_readers[stream],
+                                 stream == GVG_OUTPUT_STREAM_STDERR
+                                 ? push_to_stderr : push_to_stdout,
+                                 self->priv->output_log);
+  /* what arrives on the XML pipe from now on follows these lines */
+  gvg_xml_parser_set_output_position (self->priv->parser,
+                                      gvg_output_log_get_n_lines (self->priv->output_log));
+  
+  return alive;
+}
+
+static void
+cleanup_output_stream (Gvg             *self,
+                       GvgOutputStream  stream)
+{
+  if (self->priv->output_sources[stream]) {
+    g_source_destroy (self->priv->output_sources[stream]);
+    g_source_unref (self->priv->output_sources[stream]);
+    self->priv->output_sources[stream] = NULL;
+  }
+  if (self->priv->output_readers[stream]) {
+    read_output (self, stream);
+    gvg_pipe_reader_free (self->priv->output_readers[stream]);
+    self->priv->output_readers[stream] = NULL;
+  }
+  close_and_invalidate (&self->priv->output_fds[stream]);
+}
+
+/* stops capturing the program's output, keeping what was read.  processes
+ * that inherited the pipes might still write to them, but we're not
+ * interested in anything after the program exited */
+static void
+cleanup_output (Gvg *self)
+{
+  cleanup_output_stream (self, GVG_OUTPUT_STREAM_STDOUT);
+  cleanup_output_stream (self, GVG_OUTPUT_STREAM_STDERR);
+  if (self->priv->output_log) {
+    gvg_output_log_flush (self->priv->output_log);
+  }
 }
 
 static gboolean
-read_xml_pipe (Gvg     *self,
-               gboolean check)
+output_fd_in_ready (GIOChannel  *channel,
+                    GIOCondition cond,
+                    gpointer     data)
+{
+  Gvg             *self   = data;
+  GvgOutputStream  stream = GVG_OUTPUT_STREAM_STDOUT;
+  gboolean         keep   = TRUE;
+  
+  if (g_io_channel_unix_get_fd (channel) ==
+      self->priv->output_fds[GVG_OUTPUT_STREAM_STDERR]) {
+    stream = GVG_OUTPUT_STREAM_STDERR;
+  }
+  
+  if (cond & (G_IO_IN | G_IO_PRI)) {
+    keep = read_output (self, stream);
+  }
+  if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+    keep = FALSE;
+  }
+  
+  if (! keep) {
+    cleanup_output_stream (self, stream);
+  }
+  return keep;
+}
+
+/* starts capturing @stream from @fd, which then belongs to us */
+static void
+start_output_stream (Gvg             *self,
+                     GvgOutputStream  stream,
+                     gint             fd)
+{
+  GIOChannel *channel;
+  
+  self->priv->output_fds[stream] = fd;
+  self->priv->output_readers[stream] = gvg_pipe_reader_new (fd);
+  channel = create_io_channel (fd);
+  self->priv->output_sources[stream] = g_io_create_watch (channel,
+                                                         G_IO_IN | G_IO_PRI |
+                                                         G_IO_ERR | G_IO_HUP);
+  g_source_set_callback (self->priv->output_sources[stream],
+                         (GSourceFunc) output_fd_in_ready, self, NULL);
+  g_source_attach (self->priv->output_sources[stream], NULL);
+  g_io_channel_unref (channel);
+}
+
+/* forgets about a child that exited */
+static void
+cleanup_child (Gvg *self)
+{
+  if (self->priv->budget_timeout) {
+    g_source_remove (self->priv->budget_timeout);
+    self->priv->budget_timeout = 0;
+  }
+  if (self->priv->kill_timeout) {
+    g_source_remove (self->priv->kill_timeout);
+    self->priv->kill_timeout = 0;
+  }
+  self->priv->stopping = FALSE;
+  if (self->priv->child_watch) {
+    gvg_child_watch_free (self->priv->child_watch);
+    self->priv->child_watch = NULL;
+  }
+  if (self->priv->pid != INVALID_PID) {
+    g_spawn_close_pid (self->priv->pid);
+    self->priv->pid = INVALID_PID;
+  }
+}
+
+/* forgets about a child that may still be running, terminating it in the
+ * background */
+static void
+detach_child (Gvg *self)
+{
+  GPid            pid   = self->priv->pid;
+  GvgChildWatch  *watch = self->priv->child_watch;
+  
+  if (pid != INVALID_PID) {
+    /* don't let cleanup_child() close the PID nor free the watch, the
+     * terminator owns them */
+    self->priv->pid = INVALID_PID;
+    self->priv->child_watch = NULL;
+    cleanup_child (self);
+    cleanup_output (self);
+    terminate_child (pid, watch);
+  }
+}
+
+/* same as detach_child() for the native run */
+static void
+detach_native (Gvg *self)
+{
+  if (self->priv->native_pid != INVALID_PID) {
+    terminate_child (self->priv->native_pid, self->priv->native_watch);
+    self->priv->native_pid = INVALID_PID;
+    self->priv->native_watch = NULL;
+  }
+}
+
+/* marks the beginning of a run or load, emitting ::started.  ::finished
+ * follows once it completes */
+static void
+start_run (Gvg *self)
+{
+  gvg_reset (self);
+  self->priv->running = TRUE;
+  g_signal_emit (self, signals[SIGNAL_STARTED], 0);
+}
+
+/* adds the costs of the run the current one carries on with to its own */
+static void
+add_carried_summary (Gvg *self)
 {
-  gchar buf[BUFSIZ];
-  gsize len;
+  GvgRunSummary *summary = &self->priv->summary;
+  GvgRunSummary *carried = &self->priv->carried;
   
-  do {
-    GIOStatus status;
+  summary->wall_time += carried->wall_time;
+  summary->user_time += carried->user_time;
+  summary->system_time += carried->system_time;
+  summary->max_rss = MAX (summary->max_rss, carried->max_rss);
+  summary->voluntary_switches += carried->voluntary_switches;
+  summary->involuntary_switches += carried->involuntary_switches;
+  summary->minor_faults += carried->minor_faults;
+  summary->major_faults += carried->major_faults;
+  summary->n_bytes += carried->n_bytes;
+  if (carried->first_byte_time != 0) {
+    summary->first_byte_time = carried->first_byte_time;
+  }
+  if (summary->last_byte_time == 0) {
+    summary->last_byte_time = carried->last_byte_time;
+  }
+  /* the program ran natively for one of the runs at most */
+  if (summary->native_wall_time == 0) {
+    summary->native_wall_time = carried->native_wall_time;
+    summary->native_user_time = carried->native_user_time;
+    summary->native_system_time = carried->native_system_time;
+    summary->native_max_rss = carried->native_max_rss;
+  }
+  summary->cached = summary->cached && carried->cached;
+  self->priv->carrying = FALSE;
+}
+
+/* emits ::finished if the current run or load just completed, unless the
+ * class carries on with another run, see GvgClass::continue_run */
+static void
+check_finished (Gvg *self)
+{
+  if (self->priv->running && ! gvg_is_busy (self)) {
+    GvgClass     *klass = GVG_GET_CLASS (self);
+    GvgRunSummary summary;
     
-    /* we're asked to check whether the channel has available data */
-    if (check) {
-      gint ret;
-      
-      ret = io_channel_poll (self->priv->pipe_channel, G_IO_IN, 0);
-      if (ret < 0) {
-        return FALSE;
-      } else if (ret == 0) {
-        return TRUE;
-      }
+    gvg_xml_parser_get_push_stats (self->priv->parser,
+                                   &self->priv->summary.n_bytes,
+                                   &self->priv->summary.first_byte_time,
+                                   &self->priv->summary.last_byte_time);
+    if (self->priv->carrying) {
+      add_carried_summary (self);
+    }
+    summary = self->priv->summary;
+    self->priv->running = FALSE;
+    /* only keep complete results */
+    cleanup_cache_entry (self,
+                         self->priv->stop_reason == GVG_STOP_REASON_NONE &&
+                         self->priv->journal_ok &&
+                         gvg_xml_parser_is_complete (self->priv->parser));
+    if (klass->continue_run && klass->continue_run (self)) {
+      /* the next run adds to the costs of this one */
+      self->priv->carried = summary;
+      self->priv->carrying = TRUE;
+    } else {
+      g_signal_emit (self, signals[SIGNAL_FINISHED], 0);
     }
+  }
+}
+
+/* forgets about the cache entry the current run is for, adding it to the
+ * cache if @commit is %TRUE */
+static void
+cleanup_cache_entry (Gvg     *self,
+                     gboolean commit)
+{
+  if (self->priv->cache_key) {
+    GError *err = NULL;
     
-    do {
-      len = 0u;
-      status = g_io_channel_read_chars (self->priv->pipe_channel,
-                                        buf, sizeof buf, &len, NULL);
-    } while (status == G_IO_STATUS_AGAIN);
-    
-    if (status == G_IO_STATUS_NORMAL) {
-      gvg_xml_parser_push (self->priv->parser, buf, len, FALSE);
-      if (len == sizeof (buf)) {
-        /* if we read a whole packet, we'll try again but we also need to
-         * ensure we didn't read *all* the data, so we need to poll() */
-        check = TRUE;
-      }
+    if (! commit) {
+      gvg_result_cache_abort (self->priv->result_cache, self->priv->cache_key);
+    } else if (! gvg_result_cache_commit (self->priv->result_cache,
+                                          self->priv->cache_key,
+                                          self->priv->cache_description,
+                                          &err)) {
+      g_warning ("failed to cache results: %s", err->message);
+      g_error_free (err);
     }
-  } while (len == sizeof (buf));
-  
-  if (len == 0) {
-    g_debug ("pipe end");
+    g_free (self->priv->cache_key);
+    self->priv->cache_key = NULL;
+    g_key_file_free (self->priv->cache_description);
+    self->priv->cache_description = NULL;
   }
+}
+
+static void
+journal_closed (gboolean success,
+                gpointer data)
+{
+  Gvg *self = data;
   
-  return len > 0;
+  self->priv->journal_ok = success;
+  self->priv->journal_closing = FALSE;
+  check_finished (self);
+  g_object_unref (self);
 }
 
+/* closes the journal in the background.  a run only completes once it's
+ * closed, for its results to be cached only if they were all written */
 static void
-cleanup_child (Gvg     *self,
-               gboolean kill_it)
+cleanup_journal (Gvg *self)
 {
-  if (self->priv->pid != INVALID_PID) {
-    if (kill_it) {
-      terminate_child (self->priv->pid);
+  if (self->priv->journal) {
+    gvg_xml_parser_set_journal (self->priv->parser, NULL);
+    if (self->priv->running) {
+      self->priv->journal_closing = TRUE;
+      gvg_xml_journal_close (self->priv->journal, journal_closed,
+                             g_object_ref (self));
+    } else {
+      gvg_xml_journal_close (self->priv->journal, NULL, NULL);
     }
-    g_spawn_close_pid (self->priv->pid);
-    self->priv->pid = INVALID_PID;
+    self->priv->journal = NULL;
   }
 }
 
@@ -337,13 +1082,57 @@ cleanup_pipe (Gvg *self)
     g_source_destroy (self->priv->pipe_source);
     self->priv->pipe_source = NULL;
   }
+  if (self->priv->worker) {
+    gvg_xml_worker_get_stats (self->priv->worker,
+                              &self->priv->n_bytes, &self->priv->n_reads);
+    gvg_xml_worker_free (self->priv->worker);
+    self->priv->worker = NULL;
+  }
+  if (self->priv->reader) {
+    read_xml_pipe (self);
+    gvg_pipe_reader_get_stats (self->priv->reader,
+                               &self->priv->n_bytes, &self->priv->n_reads);
+    gvg_pipe_reader_free (self->priv->reader);
+    self->priv->reader = NULL;
+  }
   if (self->priv->pipe_channel) {
-    read_xml_pipe (self, TRUE);
-    g_io_channel_shutdown (self->priv->pipe_channel, TRUE, NULL);
     g_io_channel_unref (self->priv->pipe_channel);
     self->priv->pipe_channel = NULL;
   }
+  if (self->priv->xml_pipe >= 0) {
+    g_debug ("read %" G_GUINT64_FORMAT " bytes in %" G_GUINT64_FORMAT " calls",
+             self->priv->n_bytes, self->priv->n_reads);
+  }
   close_and_invalidate (&self->priv->xml_pipe);
+  /* only after closing our side so it can't block writing */
+  if (self->priv->replay) {
+    gvg_xml_replay_free (self->priv->replay);
+    self->priv->replay = NULL;
+  }
+  cleanup_journal (self);
+}
+
+static void
+cleanup_file (Gvg *self)
+{
+  if (self->priv->load_source) {
+    g_source_destroy (self->priv->load_source);
+    g_source_unref (self->priv->load_source);
+    self->priv->load_source = NULL;
+  }
+  if (self->priv->file) {
+    gvg_xml_file_free (self->priv->file);
+    self->priv->file = NULL;
+  }
+}
+
+static void
+cleanup_tracer (Gvg *self)
+{
+  if (self->priv->tracer) {
+    gvg_xml_tracer_free (self->priv->tracer);
+    self->priv->tracer = NULL;
+  }
 }
 
 static gboolean
@@ -364,7 +1153,7 @@ xml_fd_in_ready (GIOChannel  *channel,
   if (cond & G_IO_NVAL) g_debug ("nval");*/
   
   if (cond & (G_IO_IN | G_IO_PRI)) {
-    keep = read_xml_pipe (self, FALSE);
+    keep = read_xml_pipe (self);
   }
   if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
     keep = FALSE;
@@ -373,43 +1162,209 @@ xml_fd_in_ready (GIOChannel  *channel,
   if (! keep) {
     g_debug ("removing pipe watch");
     cleanup_pipe (self);
+    check_finished (self);
   }
   return keep;
 }
 
 static void
-watch_child (GPid     pid,
-             gint     status,
-             gpointer data)
+xml_worker_done (GvgXmlWorker *worker,
+                 gpointer      data)
 {
   Gvg *self = data;
   
-  g_debug ("child terminated");
-  cleanup_child (self, FALSE);
+  g_assert (self->priv->worker == worker);
+  
+  g_debug ("worker done");
+  cleanup_pipe (self);
+  check_finished (self);
 }
 
-static gchar **
-build_argv (Gvg          *self,
-            const gchar **program_argv,
-            gint          xml_fd)
+static void
+xml_tracer_complete (GvgXmlTracer *tracer,
+                     gpointer      data)
 {
-  GvgArgsBuilder *args  = gvg_args_builder_new ();
-  
-  gvg_args_builder_add (args, "valgrind");
-  /* FIXME: this options isn't supported by Valgrind < 3.6.1 */
-  /*gvg_args_builder_add_string (args, "fullpath-after", "");*/
-  gvg_args_builder_add_bool (args, "xml", TRUE);
-  gvg_args_builder_add_arg (args, "xml-fd", "%d", xml_fd);
-  gvg_args_builder_add (args, "-q");
-  /* this avoids having wrong XML because of forked children (see Valgrind
-   * manual man) */
-  gvg_args_builder_add_string (args, "child-silent-after-fork", "yes");
+  Gvg *self = data;
   
-  if (self->priv->options) {
-    gvg_options_to_args (self->priv->options, args);
+  /* traced children may only start after a while, so only consider being
+   * done once the main one exited */
+  if (self->priv->pid == INVALID_PID) {
+    g_debug ("all traced processes done");
+    cleanup_tracer (self);
+    check_finished (self);
   }
-  
-  /* add program and NULL terminator */
+}
+
+static gdouble
+timeval_to_seconds (const struct timeval *tv)
+{
+  return (gdouble) tv->tv_sec + (gdouble) tv->tv_usec / 1e6;
+}
+
+static void
+watch_native (GPid                 pid,
+              gint                 status,
+              const struct rusage *usage,
+              gpointer             data)
+{
+  Gvg *self = data;
+  
+  self->priv->summary.native_wall_time = (g_get_monotonic_time () -
+                                          self->priv->native_start_time) / 1e6;
+  self->priv->summary.native_user_time = timeval_to_seconds (&usage->ru_utime);
+  self->priv->summary.native_system_time = timeval_to_seconds (&usage->ru_stime);
+  self->priv->summary.native_max_rss = usage->ru_maxrss;
+  /* the watch is freed after this */
+  self->priv->native_watch = NULL;
+  g_spawn_close_pid (self->priv->native_pid);
+  self->priv->native_pid = INVALID_PID;
+  check_finished (self);
+}
+
+/* runs the program again, without Valgrind, for comparison */
+static void
+start_native (Gvg *self)
+{
+  GError *err = NULL;
+  
+  if (! g_spawn_async (NULL, self->priv->program_argv, NULL,
+                       G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH |
+                       G_SPAWN_STDOUT_TO_DEV_NULL | G_SPAWN_STDERR_TO_DEV_NULL,
+                       NULL, NULL, &self->priv->native_pid, &err)) {
+    g_warning ("failed to run the program natively: %s", err->message);
+    g_error_free (err);
+    self->priv->native_pid = INVALID_PID;
+  } else {
+    self->priv->native_start_time = g_get_monotonic_time ();
+    self->priv->native_watch = gvg_child_watch_new (self->priv->native_pid,
+                                                    watch_native, self);
+  }
+}
+
+static void
+watch_child (GPid                 pid,
+             gint                 status,
+             const struct rusage *usage,
+             gpointer             data)
+{
+  Gvg      *self    = data;
+  gboolean  stopped = self->priv->stopping;
+  
+  g_debug ("child terminated");
+  self->priv->summary.wall_time = (g_get_monotonic_time () -
+                                   self->priv->start_time) / 1e6;
+  self->priv->summary.user_time = timeval_to_seconds (&usage->ru_utime);
+  self->priv->summary.system_time = timeval_to_seconds (&usage->ru_stime);
+  self->priv->summary.max_rss = usage->ru_maxrss;
+  self->priv->summary.voluntary_switches = usage->ru_nvcsw;
+  self->priv->summary.involuntary_switches = usage->ru_nivcsw;
+  self->priv->summary.minor_faults = usage->ru_minflt;
+  self->priv->summary.major_faults = usage->ru_majflt;
+  /* the watch is freed after this, so don't free it */
+  self->priv->child_watch = NULL;
+  cleanup_child (self);
+  cleanup_output (self);
+  /* a stopped run is not representative */
+  if (self->priv->native_run && self->priv->program_argv &&
+      self->priv->stop_reason == GVG_STOP_REASON_NONE) {
+    start_native (self);
+  }
+  if (self->priv->tracer) {
+    /* other processes may still be running, wait for their output unless
+     * we were asked to stop */
+    gvg_xml_tracer_update (self->priv->tracer);
+    if (stopped || gvg_xml_tracer_is_complete (self->priv->tracer)) {
+      cleanup_tracer (self);
+    }
+  } else if (stopped) {
+    /* traced children might still hold the pipe open, but we were asked to
+     * stop so only read what's left */
+    if (self->priv->worker && self->priv->xml_pipe >= 0) {
+      gvg_xml_worker_finish (self->priv->worker);
+    } else {
+      cleanup_pipe (self);
+    }
+  }
+  check_finished (self);
+}
+
+static gboolean
+kill_child (gpointer data)
+{
+  Gvg *self = data;
+  
+  g_debug ("child won't exit, killing it");
+#ifndef G_OS_WIN32
+  kill (self->priv->pid, SIGKILL);
+#endif
+  self->priv->kill_timeout = 0;
+  
+  return FALSE;
+}
+
+/* adds the arguments for @options, without those the Valgrind of the run
+ * doesn't support */
+static void
+add_option_args (Gvg            *self,
+                 GvgOptions     *options,
+                 GvgArgsBuilder *args)
+{
+  GvgArgsBuilder *option_args = gvg_args_builder_new ();
+  guint           i;
+  
+  if (options) {
+    gvg_options_to_args (options, option_args);
+  }
+  gvg_valgrind_info_filter_args (self->priv->valgrind_info, option_args);
+  for (i = 0; i < option_args->len; i++) {
+    gvg_args_builder_take (args, g_ptr_array_index (option_args, i));
+  }
+  gvg_args_builder_free (option_args, FALSE);
+}
+
+static gchar **
+build_argv (Gvg          *self,
+            const gchar **program_argv,
+            const gchar **option_args,
+            gint          xml_fd)
+{
+  GvgArgsBuilder *args  = gvg_args_builder_new ();
+  
+  gvg_args_builder_add (args, gvg_valgrind_info_get_path (self->priv->valgrind_info));
+  /* full source paths in the text output we may capture, see
+   * GvgOutputLog.  the XML always has the directory and file apart so it
+   * doesn't change what we parse.  older versions don't have it */
+  if (gvg_valgrind_info_has_option (self->priv->valgrind_info,
+                                    "fullpath-after")) {
+    gvg_args_builder_add_string (args, "fullpath-after", "");
+  }
+  gvg_args_builder_add_bool (args, "xml", TRUE);
+  if (self->priv->tracer) {
+    gchar *xml_file;
+    
+    /* Valgrind replaces %p with the PID */
+    xml_file = g_build_filename (gvg_xml_tracer_get_dir (self->priv->tracer),
+                                 "%p.xml", NULL);
+    gvg_args_builder_add_bool (args, "trace-children", TRUE);
+    gvg_args_builder_add_string (args, "xml-file", xml_file);
+    g_free (xml_file);
+  } else if (self->priv->listener) {
+    gvg_args_builder_add_arg (args, "xml-socket", "127.0.0.1:%u",
+                              gvg_xml_listener_get_port (self->priv->listener));
+  } else {
+    gvg_args_builder_add_arg (args, "xml-fd", "%d", xml_fd);
+  }
+  gvg_args_builder_add (args, "-q");
+  /* this avoids having wrong XML because of forked children (see Valgrind
+   * manual man).  when traced, each child writes its own file so we want
+   * forked ones too */
+  if (! self->priv->tracer) {
+    gvg_args_builder_add_string (args, "child-silent-after-fork", "yes");
+  }
+  
+  gvg_args_builder_add_args (args, option_args);
+  
+  /* add program and NULL terminator */
   gvg_args_builder_add_args (args, program_argv);
   gvg_args_builder_add (args, NULL);
   
@@ -441,58 +1396,1073 @@ make_pipe (gint     p[2],
   return TRUE;
 }
 
-gboolean
-gvg_run (Gvg           *self,
-         const gchar  **program_argv,
-         GError       **error)
+/* starts reading @fd, which then belongs to us */
+static void
+start_reading (Gvg *self,
+               gint fd)
+{
+  self->priv->xml_pipe = fd;
+  self->priv->n_bytes = 0;
+  self->priv->n_reads = 0;
+  if (self->priv->threaded) {
+    self->priv->worker = gvg_xml_worker_new (self->priv->xml_pipe,
+                                             self->priv->parser,
+                                             self->priv->batch_size,
+                                             self->priv->batch_latency,
+                                             MAX_QUEUED_BATCHES,
+                                             xml_worker_done, self);
+  } else {
+    self->priv->reader = gvg_pipe_reader_new (self->priv->xml_pipe);
+    /* pipe channel watch */
+    self->priv->pipe_channel = create_io_channel (self->priv->xml_pipe);
+    self->priv->pipe_source = g_io_create_watch (self->priv->pipe_channel,
+                                                 G_IO_IN | G_IO_PRI |
+                                                 G_IO_ERR | G_IO_HUP);
+    g_source_set_callback (self->priv->pipe_source,
+                           (GSourceFunc) xml_fd_in_ready, self, NULL);
+    g_source_attach (self->priv->pipe_source, NULL);
+  }
+}
+
+/* gets the CPU time used by @pid so far, in seconds, from /proc */
+static gboolean
+get_cpu_time (GPid     pid,
+              gdouble *seconds)
 {
-  gboolean  success     = FALSE;
-  gint      xml_pipe[2] = { -1, -1 };
+  gchar    *filename;
+  gchar    *contents;
+  gboolean  success = FALSE;
   
-  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
-  g_return_val_if_fail (self->priv->parser != NULL, FALSE);
-  g_return_val_if_fail (! gvg_is_busy (self), FALSE);
+  filename = g_strdup_printf ("/proc/%d/stat", (gint) pid);
+  if (g_file_get_contents (filename, &contents, NULL, NULL)) {
+    /* the command name may contain anything, so split after its closing
+     * paren.  utime and stime are the 14th and 15th fields of the line */
+    const gchar *p = strrchr (contents, ')');
+    gchar      **fields = p ? g_strsplit (p + 1, " ", 15) : NULL;
+    
+    if (fields && g_strv_length (fields) >= 15) {
+      *seconds = (gdouble) (g_ascii_strtoull (fields[12], NULL, 10) +
+                            g_ascii_strtoull (fields[13], NULL, 10)) /
+                 (gdouble) sysconf (_SC_CLK_TCK);
+      success = TRUE;
+    }
+    g_strfreev (fields);
+    g_free (contents);
+  }
+  g_free (filename);
+  
+  return success;
+}
+
+static void
+gvg_real_budget_exceeded (Gvg         *self,
+                          const gchar *message)
+{
+  gvg_stop_for_reason (self, GVG_STOP_REASON_BUDGET_EXCEEDED, message);
+}
+
+static gboolean
+check_budgets (gpointer data)
+{
+  Gvg    *self = data;
+  gchar  *message = NULL;
+  gdouble cpu_time;
+  
+  if (self->priv->wall_time_budget > 0 &&
+      g_get_monotonic_time () - self->priv->start_time >=
+      self->priv->wall_time_budget * G_GINT64_CONSTANT (1000000)) {
+    message = g_strdup_printf (_("Wall time budget of %us exceeded"),
+                               self->priv->wall_time_budget);
+  } else if (self->priv->cpu_time_budget > 0 &&
+             get_cpu_time (self->priv->pid, &cpu_time) &&
+             cpu_time >= self->priv->cpu_time_budget) {
+    message = g_strdup_printf (_("CPU time budget of %us exceeded"),
+                               self->priv->cpu_time_budget);
+  }
+  
+  if (! message) {
+    return TRUE;
+  } else {
+    self->priv->budget_timeout = 0;
+    GVG_GET_CLASS (self)->budget_exceeded (self, message);
+    g_free (message);
+    return FALSE;
+  }
+}
+
+/* gets the Valgrind arguments of a run with @options */
+static gchar **
+get_option_args (Gvg        *self,
+                 GvgOptions *options)
+{
+  GvgArgsBuilder *args = gvg_args_builder_new ();
+  
+  add_option_args (self, options, args);
+  gvg_args_builder_add (args, NULL);
+  
+  return gvg_args_builder_free (args, FALSE);
+}
+
+/* looks the run of @program_argv described by @description up in the result
+ * cache.  returns %TRUE if its results were found and are being loaded,
+ * otherwise prepares for them to be cached when the run completes */
+static gboolean
+load_cached_results (Gvg          *self,
+                     GKeyFile     *description,
+                     const gchar **program_argv)
+{
+  gchar          *key;
+  gchar          *results;
+  GError         *err     = NULL;
+  gboolean        loaded  = FALSE;
+  
+  key = gvg_result_cache_get_key (description);
+  results = gvg_result_cache_lookup (self->priv->result_cache, key);
+  if (results) {
+    g_debug ("loading cached results %s", key);
+    if (load_file (self, results, program_argv, &err)) {
+      self->priv->summary.cached = TRUE;
+      loaded = TRUE;
+    } else {
+      g_warning ("failed to load cached results: %s", err->message);
+      g_error_free (err);
+    }
+    g_free (results);
+  }
+  if (! loaded) {
+    self->priv->cache_key = key;
+    self->priv->cache_description = description;
+  } else {
+    g_free (key);
+    g_key_file_free (description);
+  }
+  
+  return loaded;
+}
+
+/* spawns Valgrind on @program_argv with options @option_args */
+static gboolean
+spawn_run (Gvg           *self,
+           const gchar  **program_argv,
+           const gchar  **option_args,
+           GError       **error)
+{
+  gboolean      success     = FALSE;
+  gint          xml_pipe[2] = { -1, -1 };
+  gint          out_fd      = -1;
+  gint          err_fd      = -1;
+  GvgOutputLog *output_log  = NULL;
+  gchar        *journal_file = NULL;
+  
+  if (self->priv->output_buffer_size > 0) {
+    output_log = gvg_output_log_new (self->priv->output_buffer_size,
+                                     self->priv->output_spill_file, error);
+    if (! output_log) {
+      cleanup_cache_entry (self, FALSE);
+      return FALSE;
+    }
+  }
+  if (self->priv->trace_children) {
+    self->priv->tracer = gvg_xml_tracer_new (self->priv->parser,
+                                             xml_tracer_complete, self, error);
+    if (! self->priv->tracer) {
+      if (output_log) {
+        gvg_output_log_free (output_log);
+      }
+      return FALSE;
+    }
+  }
+  /* the journal only records our own pipe, not the socket's connections or
+   * the traced processes' files.  the results are cached through it, so they
+   * aren't if the user wants it somewhere else */
+  if (self->priv->journal_file) {
+    journal_file = g_strdup (self->priv->journal_file);
+    cleanup_cache_entry (self, FALSE);
+  } else if (self->priv->cache_key) {
+    journal_file = gvg_result_cache_begin (self->priv->result_cache,
+                                           self->priv->cache_key, error);
+    if (! journal_file) {
+      cleanup_cache_entry (self, FALSE);
+      if (output_log) {
+        gvg_output_log_free (output_log);
+      }
+      return FALSE;
+    }
+  }
+  if (journal_file && ! self->priv->listener && ! self->priv->tracer) {
+    self->priv->journal = gvg_xml_journal_new (journal_file, error);
+    g_free (journal_file);
+    if (! self->priv->journal) {
+      cleanup_cache_entry (self, FALSE);
+      cleanup_tracer (self);
+      if (output_log) {
+        gvg_output_log_free (output_log);
+      }
+      return FALSE;
+    }
+    gvg_xml_parser_set_journal (self->priv->parser, self->priv->journal);
+  }
   
-  if (make_pipe (xml_pipe, error)) {
+  /* when tracing or listening the output doesn't come through a pipe */
+  if (self->priv->tracer || self->priv->listener ||
+      make_pipe (xml_pipe, error)) {
     GPid    pid;
     gchar **argv;
     
-    argv = build_argv (self, program_argv, xml_pipe[1]);
+    argv = build_argv (self, program_argv, option_args, xml_pipe[1]);
     if (! g_spawn_async_with_pipes (NULL, argv, NULL,
                                     G_SPAWN_CHILD_INHERITS_STDIN |
                                     G_SPAWN_DO_NOT_REAP_CHILD |
                                     G_SPAWN_LEAVE_DESCRIPTORS_OPEN |
                                     G_SPAWN_SEARCH_PATH,
-                                    NULL, NULL, &pid, NULL, NULL, NULL,
+                                    NULL, NULL, &pid, NULL,
+                                    output_log ? &out_fd : NULL,
+                                    output_log ? &err_fd : NULL,
                                     error)) {
       close_and_invalidate (&xml_pipe[0]);
+      cleanup_journal (self);
+      cleanup_cache_entry (self, FALSE);
+      cleanup_tracer (self);
+      if (output_log) {
+        gvg_output_log_free (output_log);
+      }
     } else {
       self->priv->pid = pid;
-      g_child_watch_add_full (G_PRIORITY_DEFAULT, self->priv->pid, watch_child,
-                              self, NULL);
-      /* pipe channel watch */
-      self->priv->xml_pipe = xml_pipe[0];
-      self->priv->pipe_channel = create_io_channel (self->priv->xml_pipe);
-      self->priv->pipe_source = g_io_create_watch (self->priv->pipe_channel,
-                                                   G_IO_IN | G_IO_PRI |
-                                                   G_IO_ERR | G_IO_HUP);
-      g_source_set_callback (self->priv->pipe_source,
-                             (GSourceFunc) xml_fd_in_ready, self, NULL);
-      g_source_attach (self->priv->pipe_source, NULL);
+      self->priv->child_watch = gvg_child_watch_new (self->priv->pid,
+                                                     watch_child, self);
+      g_strfreev (self->priv->program_argv);
+      self->priv->program_argv = g_strdupv ((gchar **) program_argv);
+      start_run (self);
+      self->priv->start_time = g_get_monotonic_time ();
+      if (output_log) {
+        self->priv->output_log = output_log;
+        start_output_stream (self, GVG_OUTPUT_STREAM_STDOUT, out_fd);
+        start_output_stream (self, GVG_OUTPUT_STREAM_STDERR, err_fd);
+      }
+      if (self->priv->wall_time_budget > 0 || self->priv->cpu_time_budget > 0) {
+        self->priv->budget_timeout = g_timeout_add_seconds (BUDGET_CHECK_INTERVAL,
+                                                            check_budgets,
+                                                            self);
+      }
+      /* when tracing or listening there is nothing to read here */
+      if (xml_pipe[0] >= 0) {
+        start_reading (self, xml_pipe[0]);
+      }
       
       success = TRUE;
     }
     close_and_invalidate (&xml_pipe[1]);
     g_strfreev (argv);
+  } else {
+    cleanup_journal (self);
+    cleanup_cache_entry (self, FALSE);
+    cleanup_tracer (self);
+    if (output_log) {
+      gvg_output_log_free (output_log);
+    }
   }
   
   return success;
 }
 
+/* completes a run that couldn't be started because of @reason, so ::finished
+ * is still emitted for it */
+static void
+abort_run (Gvg           *self,
+           const gchar  **program_argv,
+           GvgStopReason  reason,
+           const gchar   *message)
+{
+  g_strfreev (self->priv->program_argv);
+  self->priv->program_argv = g_strdupv ((gchar **) program_argv);
+  start_run (self);
+  self->priv->stop_reason = reason;
+  self->priv->stop_message = g_strdup (message);
+  check_finished (self);
+}
+
+static void
+run_described (GObject      *object,
+               GAsyncResult *result,
+               gpointer      data)
+{
+  Gvg          *self         = data;
+  gchar       **program_argv = self->priv->pending_argv;
+  gchar       **option_args  = self->priv->pending_option_args;
+  GKeyFile     *description;
+  gboolean      cancelled;
+  GError       *err          = NULL;
+  
+  description = gvg_result_cache_describe_finish (result, &err);
+  cancelled = g_cancellable_is_cancelled (self->priv->pending_cancellable);
+  g_object_unref (self->priv->pending_cancellable);
+  self->priv->pending_cancellable = NULL;
+  self->priv->pending_argv = NULL;
+  self->priv->pending_options = NULL;
+  self->priv->pending_option_args = NULL;
+  
+  if (cancelled) {
+    if (description) {
+      g_key_file_free (description);
+    }
+    g_clear_error (&err);
+    abort_run (self, (const gchar **) program_argv, GVG_STOP_REASON_USER,
+               NULL);
+  } else if (description &&
+             load_cached_results (self, description,
+                                  (const gchar **) program_argv)) {
+    /* the cached results are being loaded */
+  } else {
+    if (! description) {
+      g_debug ("not caching results: %s", err->message);
+      g_clear_error (&err);
+    }
+    if (! spawn_run (self, (const gchar **) program_argv,
+                     (const gchar **) option_args, &err)) {
+      g_warning ("failed to run Valgrind: %s", err->message);
+      abort_run (self, (const gchar **) program_argv, GVG_STOP_REASON_FAILED,
+                 err->message);
+      g_error_free (err);
+    }
+  }
+  
+  g_strfreev (option_args);
+  g_strfreev (program_argv);
+  g_object_unref (self);
+}
+
+/* runs @program_argv with @options by the Valgrind of the run, looking the
+ * results up in the cache first if they may be there */
+static gboolean
+run_with_valgrind (Gvg           *self,
+                   const gchar  **program_argv,
+                   GvgOptions    *options,
+                   GError       **error)
+{
+  gchar  **option_args;
+  gboolean success;
+  
+  if (gvg_valgrind_info_get_protocol_version (self->priv->valgrind_info) < 4) {
+    g_set_error (error, G_SPAWN_ERROR, G_SPAWN_ERROR_FAILED,
+                 "Valgrind %s is too old, 3.5.0 or newer is needed",
+                 gvg_valgrind_info_get_version (self->priv->valgrind_info));
+    return FALSE;
+  }
+  
+  option_args = get_option_args (self, options);
+  /* the cache only knows about results coming through our own pipe */
+  if (self->priv->result_cache && ! self->priv->trace_children &&
+      ! self->priv->listener) {
+    self->priv->pending_cancellable = g_cancellable_new ();
+    self->priv->pending_argv = g_strdupv ((gchar **) program_argv);
+    self->priv->pending_option_args = option_args;
+    gvg_result_cache_describe_async (program_argv, (const gchar **) option_args,
+                                     self->priv->valgrind_info,
+                                     self->priv->pending_cancellable,
+                                     run_described, g_object_ref (self));
+    return TRUE;
+  }
+  
+  success = spawn_run (self, program_argv, (const gchar **) option_args, error);
+  g_strfreev (option_args);
+  
+  return success;
+}
+
+static void
+valgrind_probed (GObject      *object,
+                 GAsyncResult *result,
+                 gpointer      data)
+{
+  Gvg          *self         = data;
+  gchar       **program_argv = self->priv->pending_argv;
+  GvgOptions   *options      = self->priv->pending_options;
+  gboolean      cancelled;
+  GError       *err          = NULL;
+  
+  self->priv->valgrind_info = gvg_valgrind_info_get_finish (result, &err);
+  cancelled = g_cancellable_is_cancelled (self->priv->pending_cancellable);
+  g_object_unref (self->priv->pending_cancellable);
+  self->priv->pending_cancellable = NULL;
+  self->priv->pending_argv = NULL;
+  self->priv->pending_options = NULL;
+  
+  if (cancelled) {
+    g_clear_error (&err);
+    abort_run (self, (const gchar **) program_argv, GVG_STOP_REASON_USER,
+               NULL);
+  } else if (! self->priv->valgrind_info ||
+             ! run_with_valgrind (self, (const gchar **) program_argv, options,
+                                  &err)) {
+    g_warning ("failed to run Valgrind: %s", err->message);
+    abort_run (self, (const gchar **) program_argv, GVG_STOP_REASON_FAILED,
+               err->message);
+    g_error_free (err);
+  }
+  
+  if (options) {
+    g_object_unref (options);
+  }
+  g_strfreev (program_argv);
+  g_object_unref (self);
+}
+
+/* runs Valgrind on @program_argv.  when Valgrind has to be probed first (see
+ * GvgValgrindInfo) or the results may come from the cache, this is done in a
+ * thread and this only fails for invalid settings: if the run then can't be
+ * started ::finished is emitted with GVG_STOP_REASON_FAILED.  gvg_stop()
+ * cancels what is done in the thread */
+gboolean
+gvg_run (Gvg           *self,
+         const gchar  **program_argv,
+         GError       **error)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  
+  return gvg_run_with_options (self, program_argv, self->priv->options, error);
+}
+
+/* like gvg_run(), but with @options instead of the "options" property, for
+ * this run only */
+gboolean
+gvg_run_with_options (Gvg           *self,
+                      const gchar  **program_argv,
+                      GvgOptions    *options,
+                      GError       **error)
+{
+  const gchar *valgrind;
+  
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  g_return_val_if_fail (options == NULL || GVG_IS_OPTIONS (options), FALSE);
+  g_return_val_if_fail (self->priv->parser != NULL, FALSE);
+  g_return_val_if_fail (! gvg_is_busy (self), FALSE);
+  
+  valgrind = self->priv->valgrind ? self->priv->valgrind : "valgrind";
+  self->priv->valgrind_info = gvg_valgrind_info_lookup (valgrind);
+  if (self->priv->valgrind_info) {
+    return run_with_valgrind (self, program_argv, options, error);
+  }
+  
+  /* probing runs Valgrind twice, don't wait for it */
+  self->priv->pending_cancellable = g_cancellable_new ();
+  self->priv->pending_argv = g_strdupv ((gchar **) program_argv);
+  self->priv->pending_options = options ? g_object_ref (options) : NULL;
+  gvg_valgrind_info_get_async (valgrind, self->priv->pending_cancellable,
+                               valgrind_probed, g_object_ref (self));
+  
+  return TRUE;
+}
+
+static gboolean
+load_file_slice (gpointer data)
+{
+  Gvg          *self = data;
+  const gchar  *slice;
+  gsize         len;
+  GError       *err = NULL;
+  
+  slice = gvg_xml_file_next_slice (self->priv->file, &len, &err);
+  if (err) {
+    g_warning ("failed to read XML file: %s", err->message);
+    g_error_free (err);
+  } else if (len > 0) {
+    gvg_xml_parser_push (self->priv->parser, slice, len, FALSE);
+    self->priv->n_bytes += len;
+    self->priv->n_reads ++;
+  }
+  
+  if (! err && ! gvg_xml_file_is_eof (self->priv->file)) {
+    return TRUE;
+  } else {
+    g_debug ("file end");
+    /* the source is being removed, so don't destroy it */
+    g_source_unref (self->priv->load_source);
+    self->priv->load_source = NULL;
+    cleanup_file (self);
+    check_finished (self);
+    return FALSE;
+  }
+}
+
+static void
+run_async_report_progress (Gvg *self)
+{
+  RunAsync *async = self->priv->run_async;
+  guint64   n_bytes;
+  
+  if (async->progress) {
+    gvg_get_read_stats (self, &n_bytes, NULL);
+    async->progress (self, n_bytes, gvg_get_n_errors (self),
+                     async->progress_data);
+  }
+}
+
+static gboolean
+run_async_progress_timeout (gpointer data)
+{
+  run_async_report_progress (data);
+  
+  return TRUE;
+}
+
+/* completes the gvg_run_async() going on, with @error if not %NULL */
+static void
+run_async_complete (Gvg    *self,
+                    GError *error)
+{
+  RunAsync *async = self->priv->run_async;
+  
+  self->priv->run_async = NULL;
+  if (async->progress_timeout) {
+    g_source_remove (async->progress_timeout);
+  }
+  if (async->cancel_source) {
+    g_source_destroy (async->cancel_source);
+    g_source_unref (async->cancel_source);
+  }
+  if (async->finished_handler) {
+    g_signal_handler_disconnect (self, async->finished_handler);
+  }
+  if (async->cancellable) {
+    g_object_unref (async->cancellable);
+  }
+  if (error) {
+    g_simple_async_result_take_error (async->result, error);
+  } else {
+    g_simple_async_result_set_op_res_gboolean (async->result, TRUE);
+  }
+  /* we may be in a ::finished handler */
+  g_simple_async_result_complete_in_idle (async->result);
+  g_object_unref (async->result);
+  g_slice_free (RunAsync, async);
+}
+
+/* connected after the default handler, for it to be done with the results */
+static void
+run_async_finished (Gvg      *self,
+                    gpointer  data)
+{
+  RunAsync *async = self->priv->run_async;
+  GError   *err = NULL;
+  
+  run_async_report_progress (self);
+  g_cancellable_set_error_if_cancelled (async->cancellable, &err);
+  run_async_complete (self, err);
+}
+
+/* stops the run without waiting, it completes with its ::finished */
+static gboolean
+run_async_cancelled (GCancellable *cancellable,
+                     gpointer      data)
+{
+  Gvg *self = data;
+  
+  gvg_stop (self);
+  
+  return FALSE;
+}
+
+/*
+ * like gvg_run(), but tells when the run completed: @callback is called once
+ * the child exited and all its output was parsed, and should call
+ * gvg_run_finish().  @progress, if not %NULL, is called periodically and one
+ * last time before @callback.  cancelling @cancellable stops the run like
+ * gvg_stop(), and makes it complete with %G_IO_ERROR_CANCELLED.  a run
+ * stopped for any other reason completes normally, see
+ * gvg_get_stop_reason()
+ */
+void
+gvg_run_async (Gvg                 *self,
+               const gchar        **program_argv,
+               GCancellable        *cancellable,
+               GvgRunProgressFunc   progress,
+               gpointer             progress_data,
+               GAsyncReadyCallback  callback,
+               gpointer             user_data)
+{
+  RunAsync *async;
+  GError   *err = NULL;
+  
+  g_return_if_fail (GVG_IS_GVG (self));
+  g_return_if_fail (self->priv->parser != NULL);
+  g_return_if_fail (! gvg_is_busy (self));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  
+  async = g_slice_new (RunAsync);
+  async->result           = g_simple_async_result_new (G_OBJECT (self),
+                                                       callback, user_data,
+                                                       gvg_run_async);
+  async->cancellable      = cancellable ? g_object_ref (cancellable) : NULL;
+  async->cancel_source    = NULL;
+  async->progress         = progress;
+  async->progress_data    = progress_data;
+  async->progress_timeout = 0;
+  async->finished_handler = 0;
+  self->priv->run_async = async;
+  
+  if (g_cancellable_set_error_if_cancelled (cancellable, &err) ||
+      ! gvg_run (self, program_argv, &err)) {
+    run_async_complete (self, err);
+    return;
+  }
+  
+  async->finished_handler = g_signal_connect_after (self, "finished",
+                                                    G_CALLBACK (run_async_finished),
+                                                    NULL);
+  if (cancellable) {
+    /* the cancellable may be cancelled from any thread, but the run can only
+     * be stopped from ours */
+    async->cancel_source = g_cancellable_source_new (cancellable);
+    g_source_set_callback (async->cancel_source,
+                           (GSourceFunc) run_async_cancelled, self, NULL);
+    g_source_attach (async->cancel_source, NULL);
+  }
+  if (progress) {
+    async->progress_timeout = g_timeout_add (PROGRESS_INTERVAL,
+                                             run_async_progress_timeout, self);
+  }
+}
+
+/* gets how a gvg_run_async() completed.  returns %FALSE if the run failed to
+ * start or was cancelled */
+gboolean
+gvg_run_finish (Gvg           *self,
+                GAsyncResult  *result,
+                GError       **error)
+{
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (self),
+                                                        gvg_run_async),
+                        FALSE);
+  
+  if (g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+                                             error)) {
+    return FALSE;
+  }
+  
+  return g_simple_async_result_get_op_res_gboolean (G_SIMPLE_ASYNC_RESULT (result));
+}
+
+/* loads @filename as the results of a run of @program_argv, or of an unknown
+ * program if it is %NULL */
+static gboolean
+load_file (Gvg          *self,
+           const gchar  *filename,
+           const gchar **program_argv,
+           GError      **error)
+{
+  GvgXmlFile *file;
+  
+  file = gvg_xml_file_open (filename, error);
+  if (! file) {
+    return FALSE;
+  }
+  
+  g_strfreev (self->priv->program_argv);
+  self->priv->program_argv = g_strdupv ((gchar **) program_argv);
+  self->priv->n_bytes = 0;
+  self->priv->n_reads = 0;
+  start_run (self);
+  if (self->priv->threaded) {
+    self->priv->worker = gvg_xml_worker_new_for_file (file,
+                                                      self->priv->parser,
+                                                      self->priv->batch_size,
+                                                      self->priv->batch_latency,
+                                                      MAX_QUEUED_BATCHES,
+                                                      xml_worker_done, self);
+  } else {
+    self->priv->file = file;
+    self->priv->load_source = g_idle_source_new ();
+    g_source_set_priority (self->priv->load_source, G_PRIORITY_DEFAULT_IDLE);
+    g_source_set_callback (self->priv->load_source, load_file_slice, self,
+                           NULL);
+    g_source_attach (self->priv->load_source, NULL);
+  }
+  
+  return TRUE;
+}
+
+/* loads a memcheck XML file previously saved by Valgrind (e.g. with
+ * --xml-file), optionally compressed with gzip or zstd.  like a run, the file
+ * is loaded progressively */
+gboolean
+gvg_load_file (Gvg          *self,
+               const gchar  *filename,
+               GError      **error)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (self->priv->parser != NULL, FALSE);
+  g_return_val_if_fail (! gvg_is_busy (self), FALSE);
+  
+  return load_file (self, filename, NULL, error);
+}
+
+/* stops the current run or load without waiting for it to complete.  the
+ * child first gets a chance to exit cleanly, and is killed if it didn't after
+ * a few seconds.  the output it wrote until then is still parsed, and
+ * ::finished is emitted as usual once all is done */
+void
+gvg_stop (Gvg *self)
+{
+  g_return_if_fail (GVG_IS_GVG (self));
+  
+  if (self->priv->running &&
+      self->priv->stop_reason == GVG_STOP_REASON_NONE) {
+    self->priv->stop_reason = GVG_STOP_REASON_USER;
+  }
+  detach_native (self);
+  if (self->priv->pending_cancellable) {
+    /* the run didn't start yet, see run_described() */
+    g_cancellable_cancel (self->priv->pending_cancellable);
+  } else if (self->priv->pid != INVALID_PID) {
+    if (! self->priv->stopping) {
+      self->priv->stopping = TRUE;
+#ifdef G_OS_WIN32
+      /* FIXME: */
+      g_warning ("don't know how to kill child on Windows");
+#else
+      if (kill (self->priv->pid, SIGTERM) == 0) {
+        self->priv->kill_timeout = g_timeout_add_seconds (TERMINATE_TIMEOUT,
+                                                          kill_child, self);
+      }
+#endif
+    }
+  } else if (self->priv->worker && self->priv->xml_pipe >= 0) {
+    /* the child already exited, don't wait for traced children */
+    gvg_xml_worker_finish (self->priv->worker);
+  } else {
+    /* reading what's left in the pipe or traced processes' output, or
+     * loading a file */
+    cleanup_pipe (self);
+    cleanup_file (self);
+    cleanup_tracer (self);
+    check_finished (self);
+  }
+}
+
+/* listens for the XML output of any number of Valgrind processes started
+ * with --xml-socket=127.0.0.1:PORT, each connection being parsed separately.
+ * if @port is 0 a free port is chosen, see gvg_get_listen_port().  while
+ * listening, gvg_run() makes Valgrind send its output to the socket too */
+gboolean
+gvg_listen (Gvg      *self,
+            guint16   port,
+            GError  **error)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  g_return_val_if_fail (self->priv->parser != NULL, FALSE);
+  g_return_val_if_fail (self->priv->listener == NULL, FALSE);
+  
+  self->priv->listener = gvg_xml_listener_new (self->priv->parser, port,
+                                               self->priv->threaded,
+                                               self->priv->batch_size,
+                                               self->priv->batch_latency,
+                                               MAX_QUEUED_BATCHES, error);
+  
+  return self->priv->listener != NULL;
+}
+
+/* closes the listening socket and all its connections */
+void
+gvg_stop_listening (Gvg *self)
+{
+  g_return_if_fail (GVG_IS_GVG (self));
+  
+  if (self->priv->listener) {
+    gvg_xml_listener_free (self->priv->listener);
+    self->priv->listener = NULL;
+  }
+}
+
+gboolean
+gvg_is_listening (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  
+  return self->priv->listener != NULL;
+}
+
+/* gets the port on which we listen, or 0 if not listening */
+guint16
+gvg_get_listen_port (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), 0);
+  
+  if (! self->priv->listener) {
+    return 0;
+  }
+  
+  return gvg_xml_listener_get_port (self->priv->listener);
+}
+
+/* like gvg_stop(), but records why the run is stopped, see
+ * gvg_get_stop_reason().  only the first reason given for a run is kept */
+void
+gvg_stop_for_reason (Gvg           *self,
+                     GvgStopReason  reason,
+                     const gchar   *message)
+{
+  g_return_if_fail (GVG_IS_GVG (self));
+  
+  if (self->priv->running &&
+      self->priv->stop_reason == GVG_STOP_REASON_NONE) {
+    self->priv->stop_reason = reason;
+    self->priv->stop_message = g_strdup (message);
+  }
+  gvg_stop (self);
+}
+
+/* gets why the current or last run was stopped, and the associated message
+ * if any.  GVG_STOP_REASON_NONE means it wasn't */
+GvgStopReason
+gvg_get_stop_reason (Gvg          *self,
+                     const gchar **message)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), GVG_STOP_REASON_NONE);
+  
+  if (message) {
+    *message = self->priv->stop_message;
+  }
+  
+  return self->priv->stop_reason;
+}
+
+/* whether gvg_stop() was called on the current run, which didn't complete
+ * yet */
+gboolean
+gvg_is_stopping (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  
+  return self->priv->stopping;
+}
+
+/* gets the PID of the running Valgrind process, or 0 if none is running */
+GPid
+gvg_get_pid (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), 0);
+  
+  return self->priv->pid != INVALID_PID ? self->priv->pid : 0;
+}
+
+/* replays a saved XML stream (see the "journal-file" property) through the
+ * same path as a run's output, at a controlled pace.  @rate is in MB/s and
+ * only used with GVG_REPLAY_PACING_RATE.  @chunk_size is the size of the
+ * writes, or 0 to use the natural one of the pacing.  the same file and
+ * settings always produce the same sequence of writes */
+gboolean
+gvg_replay_file (Gvg              *self,
+                 const gchar      *filename,
+                 GvgReplayPacing   pacing,
+                 gdouble           rate,
+                 gsize             chunk_size,
+                 GError          **error)
+{
+  gint sv[2];
+  
+  g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (self->priv->parser != NULL, FALSE);
+  g_return_val_if_fail (! gvg_is_busy (self), FALSE);
+  
+  /* a socket rather than a pipe so the writer doesn't get SIGPIPE */
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+    gint errsv = errno;
+    
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "failed to create socket for replay (%s)",
+                 g_strerror (errsv));
+    return FALSE;
+  }
+  
+  self->priv->replay = gvg_xml_replay_new (filename, pacing, rate, chunk_size,
+                                           sv[1], error);
+  if (! self->priv->replay) {
+    close (sv[0]);
+    close (sv[1]);
+    return FALSE;
+  }
+  g_strfreev (self->priv->program_argv);
+  self->priv->program_argv = NULL;
+  start_run (self);
+  start_reading (self, sv[0]);
+  
+  return TRUE;
+}
+
 gboolean
 gvg_is_busy (Gvg *self)
 {
   g_return_val_if_fail (GVG_IS_GVG (self), FALSE);
   
-  return self->priv->pid != INVALID_PID || self->priv->xml_pipe >= 0;
+  return (self->priv->pid != INVALID_PID ||
+          self->priv->pending_cancellable != NULL ||
+          self->priv->native_pid != INVALID_PID ||
+          self->priv->xml_pipe >= 0 ||
+          self->priv->worker != NULL ||
+          self->priv->file != NULL ||
+          self->priv->tracer != NULL ||
+          self->priv->journal_closing);
+}
+
+/* properties naming the files of a run, that two Gvgs can't share */
+static gboolean
+is_run_property (const gchar *name)
+{
+  return (strcmp (name, "journal-file") == 0 ||
+          strcmp (name, "output-spill-file") == 0);
+}
+
+/*
+ * gives @self the settings of @source, which has to be of the same type: all
+ * its writable properties but the construct-only ones and those naming the
+ * files of a run, and what the class keeps apart (see
+ * GvgClass::copy_settings)
+ */
+void
+gvg_copy_settings (Gvg *self,
+                   Gvg *source)
+{
+  GvgClass     *klass;
+  guint         i;
+  guint         n_props;
+  GParamSpec  **props;
+  
+  g_return_if_fail (GVG_IS_GVG (self));
+  g_return_if_fail (GVG_IS_GVG (source));
+  g_return_if_fail (G_OBJECT_TYPE (self) == G_OBJECT_TYPE (source));
+  
+  klass = GVG_GET_CLASS (source);
+  props = g_object_class_list_properties (G_OBJECT_CLASS (klass), &n_props);
+  g_object_freeze_notify (G_OBJECT (self));
+  for (i = 0; i < n_props; i++) {
+    GValue value = {0};
+    
+    if ((props[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+        (props[i]->flags & G_PARAM_CONSTRUCT_ONLY) ||
+        is_run_property (props[i]->name)) {
+      continue;
+    }
+    g_value_init (&value, props[i]->value_type);
+    g_object_get_property (G_OBJECT (source), props[i]->name, &value);
+    g_object_set_property (G_OBJECT (self), props[i]->name, &value);
+    g_value_unset (&value);
+  }
+  g_free (props);
+  if (klass->copy_settings) {
+    klass->copy_settings (self, source);
+  }
+  g_object_thaw_notify (G_OBJECT (self));
+}
+
+/* gets how many bytes were read from Valgrind, and in how many read() calls,
+ * for the current or last run */
+void
+gvg_get_read_stats (Gvg     *self,
+                    guint64 *n_bytes,
+                    guint64 *n_reads)
+{
+  g_return_if_fail (GVG_IS_GVG (self));
+  
+  if (self->priv->worker) {
+    gvg_xml_worker_get_stats (self->priv->worker,
+                              &self->priv->n_bytes, &self->priv->n_reads);
+  } else if (self->priv->reader) {
+    gvg_pipe_reader_get_stats (self->priv->reader,
+                               &self->priv->n_bytes, &self->priv->n_reads);
+  }
+  if (n_bytes) {
+    *n_bytes = self->priv->n_bytes;
+  }
+  if (n_reads) {
+    *n_reads = self->priv->n_reads;
+  }
+}
+
+/*
+ * forgets about the last run: its summary, stop reason, read statistics and
+ * captured output,
+ * and resets the parser so it can take a new stream (see
+ * gvg_xml_parser_reset()).  this is done automatically when a run starts,
+ * but allows to reuse the same objects explicitly.  the results already
+ * produced by the parser are left alone.  must not be called during a run
+ */
+void
+gvg_reset (Gvg *self)
+{
+  g_return_if_fail (GVG_IS_GVG (self));
+  g_return_if_fail (! self->priv->running);
+  
+  memset (&self->priv->summary, 0, sizeof self->priv->summary);
+  self->priv->stop_reason = GVG_STOP_REASON_NONE;
+  g_free (self->priv->stop_message);
+  self->priv->stop_message = NULL;
+  self->priv->n_bytes = 0;
+  self->priv->n_reads = 0;
+  if (self->priv->output_log) {
+    gvg_output_log_free (self->priv->output_log);
+    self->priv->output_log = NULL;
+  }
+  if (self->priv->parser) {
+    gvg_xml_parser_reset (self->priv->parser);
+  }
+}
+
+/* gets the output of the current or last run captured so far, or %NULL if it
+ * wasn't captured (see the output-buffer-size property).  errors are linked
+ * to it by their position in it.  it belongs to @self and is only valid until
+ * the next run or reset */
+GvgOutputLog *
+gvg_get_output_log (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), NULL);
+  
+  return self->priv->output_log;
+}
+
+/* gets the arguments of the program the current or last results are for, or
+ * %NULL if they were loaded from a file */
+const gchar *const *
+gvg_get_program_argv (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), NULL);
+  
+  return (const gchar *const *) self->priv->program_argv;
+}
+
+/* gets the result cache set up with the result-cache-dir property, for
+ * inspecting or invalidating it, or %NULL */
+GvgResultCache *
+gvg_get_result_cache (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), NULL);
+  
+  return self->priv->result_cache;
+}
+
+/* gets how many errors the current or last run found so far, including in
+ * traced processes and listener connections.  a plain Gvg doesn't know what
+ * an error is, and always says 0 */
+guint
+gvg_get_n_errors (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), 0);
+  
+  if (GVG_GET_CLASS (self)->get_n_errors) {
+    return GVG_GET_CLASS (self)->get_n_errors (self);
+  }
+  
+  return 0;
+}
+
+/* gets what the current or last run cost.  only complete once ::finished was
+ * emitted */
+const GvgRunSummary *
+gvg_get_run_summary (Gvg *self)
+{
+  g_return_val_if_fail (GVG_IS_GVG (self), NULL);
+  
+  return &self->priv->summary;
 }
@@ -24,10 +24,14 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #include "gvg-xml-parser.h"
 #include "gvg-options.h"
 #include "gvg-args-builder.h"
+#include "gvg-xml-replay.h"
+#include "gvg-output-log.h"
+#include "gvg-result-cache.h"
 
 G_BEGIN_DECLS
 
@@ -48,9 +52,55 @@ typedef enum
   GVG_ROW_TYPE_STATUS
 } GvgRowType;
 
-typedef struct _Gvg         Gvg;
-typedef struct _GvgClass    GvgClass;
-typedef struct _GvgPrivate  GvgPrivate;
+typedef enum
+{
+  GVG_STOP_REASON_NONE,
+  GVG_STOP_REASON_USER,
+  GVG_STOP_REASON_ERROR_THRESHOLD,
+  GVG_STOP_REASON_BUDGET_EXCEEDED,
+  GVG_STOP_REASON_FAILED
+} GvgStopReason;
+
+typedef struct _Gvg           Gvg;
+typedef struct _GvgClass      GvgClass;
+typedef struct _GvgPrivate    GvgPrivate;
+typedef struct _GvgRunSummary GvgRunSummary;
+
+/* reports the progress of gvg_run_async(): the XML bytes read and the errors
+ * found so far */
+typedef void  (*GvgRunProgressFunc)   (Gvg     *self,
+                                       guint64  n_bytes,
+                                       guint    n_errors,
+                                       gpointer data);
+
+/* what a run cost.  times are in seconds and sizes in KiB.  the native_*
+ * fields are only set when the program was also run without Valgrind (see the
+ * "native-run" property), and are 0 otherwise */
+struct _GvgRunSummary
+{
+  gdouble wall_time;
+  gdouble user_time;
+  gdouble system_time;
+  glong   max_rss;
+  glong   voluntary_switches;
+  glong   involuntary_switches;
+  glong   minor_faults;
+  glong   major_faults;
+  
+  /* the XML output, times being g_get_monotonic_time() values */
+  guint64 n_bytes;
+  gint64  first_byte_time;
+  gint64  last_byte_time;
+  
+  gdouble native_wall_time;
+  gdouble native_user_time;
+  gdouble native_system_time;
+  glong   native_max_rss;
+  
+  /* whether the results were loaded from the result cache instead of
+   * running the program, in which case the costs are all 0 */
+  gboolean cached;
+};
 
 struct _Gvg
 {
@@ -61,6 +111,26 @@ struct _Gvg
 struct _GvgClass
 {
   GObjectClass parent_class;
+  
+  void        (*started)          (Gvg *self);
+  void        (*finished)         (Gvg *self);
+  
+  /* called when a run exceeds its budget, stops it by default */
+  void        (*budget_exceeded)  (Gvg         *self,
+                                   const gchar *message);
+  /* gets how many errors the current or last run found so far in all its
+   * streams, 0 by default */
+  guint       (*get_n_errors)     (Gvg         *self);
+  /* called when a run or load completed, before ::finished.  may start
+   * another run carrying on with this one and return %TRUE, in which case
+   * ::finished is only emitted once that one completes (::started is emitted
+   * for each), and the summary covers the costs of both.  returns %FALSE by
+   * default */
+  gboolean    (*continue_run)     (Gvg         *self);
+  /* copies the settings that aren't properties from @source, see
+   * gvg_copy_settings() */
+  void        (*copy_settings)    (Gvg         *self,
+                                   Gvg         *source);
 };
 
 
@@ -68,7 +138,55 @@ GType         gvg_get_type          (void) G_GNUC_CONST;
 gboolean      gvg_run               (Gvg           *self,
                                      const gchar  **program_argv,
                                      GError       **error);
+gboolean      gvg_run_with_options  (Gvg           *self,
+                                     const gchar  **program_argv,
+                                     GvgOptions    *options,
+                                     GError       **error);
+void          gvg_run_async         (Gvg                 *self,
+                                     const gchar        **program_argv,
+                                     GCancellable        *cancellable,
+                                     GvgRunProgressFunc   progress,
+                                     gpointer             progress_data,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data);
+gboolean      gvg_run_finish        (Gvg           *self,
+                                     GAsyncResult  *result,
+                                     GError       **error);
+gboolean      gvg_load_file         (Gvg           *self,
+                                     const gchar   *filename,
+                                     GError       **error);
+gboolean      gvg_replay_file       (Gvg              *self,
+                                     const gchar      *filename,
+                                     GvgReplayPacing   pacing,
+                                     gdouble           rate,
+                                     gsize             chunk_size,
+                                     GError          **error);
+void          gvg_stop              (Gvg *self);
+void          gvg_stop_for_reason   (Gvg           *self,
+                                     GvgStopReason  reason,
+                                     const gchar   *message);
+GvgStopReason gvg_get_stop_reason   (Gvg          *self,
+                                     const gchar **message);
+gboolean      gvg_is_stopping       (Gvg *self);
+GPid          gvg_get_pid           (Gvg *self);
+gboolean      gvg_listen            (Gvg      *self,
+                                     guint16   port,
+                                     GError  **error);
+void          gvg_stop_listening    (Gvg *self);
+gboolean      gvg_is_listening      (Gvg *self);
+guint16       gvg_get_listen_port   (Gvg *self);
 gboolean      gvg_is_busy           (Gvg *self);
+void          gvg_reset             (Gvg *self);
+void          gvg_copy_settings     (Gvg *self,
+                                     Gvg *source);
+const GvgRunSummary *gvg_get_run_summary (Gvg *self);
+guint         gvg_get_n_errors      (Gvg *self);
+GvgOutputLog *gvg_get_output_log    (Gvg *self);
+GvgResultCache *gvg_get_result_cache (Gvg *self);
+const gchar *const *gvg_get_program_argv (Gvg *self);
+void          gvg_get_read_stats    (Gvg     *self,
+                                     guint64 *n_bytes,
+                                     guint64 *n_reads);
 
 
 G_END_DECLS